@@ -4,11 +4,35 @@
 
 // Settings definitions
 #define SETTINGS_IDENT_CURR 111
+#define SETTINGS_VERSION_CURR 2
+#define SETTINGS_FIXED_SCALE 100
 #define SETTINGS_ADDRS 64
+#define SETTINGSSTORE_IDENT 127
+#define SETTINGSSTORE_ADDRS 256
+#define SETTINGSSTORE_SLOTS 16
+#define SETTINGSSTORE_PAYLOAD_SIZE 40
+
+// Persistence parameters
+#define PERSIST_QUIET_PERIOD 10000
 
 // EnvironmentalManager parameters
 #define EM_BLOCKTHREADBELOWMS 650
 #define EM_MAXJUMPLEN 3600000
+#define EM_RATE_WEIGHT 0.3
+#define EM_LAG_WEIGHT 0.5
+#define EM_LAG_MIN 5.0
+#define EM_LAG_MAX 900.0
+#define EM_WARMUP_COAST_MAX 1800000
+#define EM_DUTY_BAND 1.0
+// Percentage points an alarm has to come back by before it clears
+#define EM_ALARM_HYSTERESIS 2.0
+
+// Degraded mode parameters, used when a sensor is lost
+#define SENSOR_LOSS_PERIOD 30000
+#define DUTY_WINDOW 600000
+#define DUTY_WEIGHT 0.3
+#define OPENLOOP_PERIOD 60000
+#define OPENLOOP_SCALE 0.9
 
 // Sensor Wrapper parameters
 #define READSENSOR_MODBUS_TIMEOUT 1500
@@ -16,11 +40,74 @@
 
 // User Interface parameters
 #define MENU_UI_LOAD_DELAY 75
-#define MENU_UI_POST_DELAY 250
+#define MENU_UI_MESSAGE_TIME 1200
 #define MENU_UI_REDRAW_DELAY 500
 #define BUTTON_SECONDPOLLDELAY 250
 #define BUTTON_LOOPCOUNTFASTFORWARD 5
 #define BUTTON_FASTFORWARDRATE 10
+// Buttons are read at most once per debounce time, held for the long press time they start repeating
+#define BUTTON_DEBOUNCE_TIME 20
+#define BUTTON_LONGPRESS_TIME 750
+#define BUTTON_QUEUE_SIZE 8
+
+// LCD definitions, each character or command is one MCP23017 write: address, register and four GPIO bytes strobing
+// the two nibbles in, with a filler byte for port A between each
+#define LCD_COLS 16
+#define LCD_ROWS 2
+#define LCD_I2C_BYTES_PER_SEND 9
+
+// Alarm annunciator, patterns are 16 steps of ALARM_STEP_TIME played from the top bit, acknowledging mutes for
+// ALARM_MUTE_TIME
+#define ALARM_STEP_TIME 250
+#define ALARM_MUTE_TIME 600000
+#define ALARM_PATTERN_HEAT 0xFFF0
+#define ALARM_PATTERN_CO2 0xCCC0
+#define ALARM_PATTERN_O2 0xCC00
+#define ALARM_PATTERN_SENSOR 0xC000
+// Alarm raises and clears kept for the status line
+#define ALARM_HISTORY_SIZE 8
+
+// Trend history, minute averages in fixed point: TREND_MINUTES of them for the sparkline (five to a custom character,
+// the LCD has eight) and the lows, highs and means of TREND_BLOCKS blocks of TREND_BLOCK_MINUTES, a day's worth.  The
+// lows and highs are kept to TREND_SPREAD_STEP.  The sparkline is never scaled to less than TREND_SPARK_MIN_SPAN
+#define TREND_SAMPLE_TIME 60000
+#define TREND_SCALE 100
+#define TREND_MINUTES 40
+#define TREND_BLOCKS 12
+#define TREND_BLOCK_MINUTES 120
+#define TREND_SPREAD_STEP 10
+#define TREND_SPARK_MIN_SPAN 20
+
+// USB status line, sent every STATUS_LINE_INTERVAL ms if the last one has gone
+#define STATUS_SERIAL_BAUD 9600
+#define STATUS_LINE_INTERVAL 1000
+#define STATUS_LINE_SIZE 384
+
+// PiLink, binary frames at PILINK_BAUD_DEFAULT (8E2, as the Pi's port is set up) until the Pi asks for a faster rate (8N1,
+// up to PILINK_BAUD_MAX).  The unit says hello every PILINK_HELLO_INTERVAL at the default rate, and goes back to it if
+// it hasn't had a good frame from the Pi for PILINK_LINK_TIMEOUT.  Frames are up to PILINK_FRAME_SIZE bytes decoded
+#define PILINK_BAUD_DEFAULT 9600
+#define PILINK_BAUD_MAX 115200
+#define PILINK_HELLO_INTERVAL 2000
+#define PILINK_LINK_TIMEOUT 10000
+#define PILINK_FRAME_SIZE 96
+
+// PiLink publishing until the Pi sets it: a status when something moved more than its deadband (hundredths of a degree
+// or percent, ten thousandths of duty), no more often than PILINK_STATUS_INTERVAL.  The Pi can't ask for statuses
+// closer than PILINK_INTERVAL_MIN.  A heartbeat goes when nothing else has for PILINK_HEARTBEAT_INTERVAL
+#define PILINK_PUBLISH_MODE PILINK_PUBLISH_CHANGE
+#define PILINK_STATUS_INTERVAL 1000
+#define PILINK_INTERVAL_MIN 100
+#define PILINK_REFRESH_INTERVAL 60000
+#define PILINK_HEARTBEAT_INTERVAL 5000
+#define PILINK_DEADBAND_LEVEL 10
+#define PILINK_DEADBAND_DUTY 100
+
+// I2C bus, transactions are queued and run from the TWI interrupt
+#define TWI_FREQUENCY 400000L
+#define TWI_QUEUE_SIZE 16
+#define TWI_BUFFER_SIZE 8
+#define TWI_TIMEOUT 10
 
 // Temperature control definitions
 #define TEMPERATURE_MIN 5.0
@@ -30,8 +117,13 @@
 #define TEMPERATURE_STEP_LEN 1200
 #define TEMPERATURE_JUMP_LEN 60000
 #define TEMPERATURE_JUMP_WT 60000
+#define TEMPERATURE_WARMUP_ENTRY 85.0
+#define TEMPERATURE_WARMUP_LAG 90.0
+#define TEMPERATURE_OPENLOOP_DEF 0.2
+#define TEMPERATURE_OPENLOOP_MAX 0.5
 #define TEMP_ALARM_THRESH 114.0
 #define TEMP_ALARM_ON_PERIOD 7200000
+#define TEMP_ALARM_MIN_DURATION 15000
 
 // CO2 control definitions
 #define CO2_MIN 0.1
@@ -41,12 +133,18 @@
 #define CO2_STEP_THRESH 0.7
 #define CO2_MULTIPLIER 10.0
 #define CO2_DELTA_JUMP 3000
+#define CO2_DELTA_JUMP_RECOVERY 6000
+#define CO2_DUTY_BAND 0.05
+#define CO2_OPENLOOP_DEF 0.005
+#define CO2_OPENLOOP_MAX 0.05
 #define CO2_DELTA_STEPPING 250
 #define CO2_BLEEDTIME_JUMP 5000
 #define CO2_BLEEDTIME_STEPPING 5000
 #define CO2_ALARM_THRESH 1.10
 #define CO2_ALARM_OPEN_PERIOD 600000
 #define CO2_ALARM_READING_PERIOD 1000
+#define CO2_ALARM_HYSTERESIS 0.05
+#define CO2_ALARM_MIN_DURATION 30000
 
 //O2 control definitions
 #define OO_STEP_THRESH 1.01
@@ -61,4 +159,59 @@
 #define OO_ALARM_THRESH 1.10
 #define OO_ALARM_READING_PERIOD 1000
 #define OO_ALARM_OPEN_PERIOD 600000
+#define OO_ALARM_HYSTERESIS 0.05
+#define OO_ALARM_MIN_DURATION 30000
+
+// Gas metering definitions, flow coefficients are in mL/s and cylinder sizes in L
+#define GASMETER_IDENT 126
+#define GASMETER_ADDRS_CO2 128
+#define GASMETER_ADDRS_N 144
+#define GASMETER_CHECKPOINT_PERIOD 3600000
+#define GASMETER_RATE_WINDOW 3600000
+#define GASMETER_RATE_WEIGHT 0.25
+#define CO2_FLOW_COEFF 15.0
+#define CO2_CYLINDER_SIZE 1270.0
+#define N_FLOW_COEFF 15.0
+#define N_CYLINDER_SIZE 6000.0
+
+// Power management definitions, draws and the budget are in mA
+#define POWER_BUDGET 3000
+#define POWER_DRAW_HEATCHAMBER 1500
+#define POWER_DRAW_HEATDOOR 1000
+#define POWER_DRAW_GASVALVE 500
+#define POWER_DRAW_FAN 250
+#define POWER_DRAW_LIGHT 500
+#define POWER_PRIORITY_HEATCHAMBER 100
+#define POWER_PRIORITY_HEATDOOR 0
+#define POWER_PRIORITY_GAS 50
+#define POWER_PRIORITY_LIGHT 1
+#define POWER_STAGGER_DELAY 100
+#define POWER_REQUEST_HOLD 5000
+
+
+// Door detection definitions, rates are per s
+#define DOOR_SAMPLE_PERIOD 2000
+#define DOOR_RATE_WEIGHT 0.5
+#define DOOR_TEMP_RATE 0.02
+#define DOOR_CO2_RATE 0.01
+#define DOOR_O2_RATE 0.02
+#define DOOR_OPEN_VOTES 2
+#define DOOR_RECOVERED_PCT 0.98
+#define DOOR_RECOVERY_MAX 3600000
+
+// Set point profile definitions, programs are PROFILE_STRIDE bytes apart in the EEPROM
+#define PROFILE_IDENT 124
+#define PROFILE_ADDRS 1024
+#define PROFILE_STRIDE 64
+#define PROFILE_COUNT 4
+#define PROFILE_TICK_PERIOD 1000
+#define PROFILE_MINUTES_DLT 5
+#define PROFILE_MINUTES_MAX 6000
 
+// OneWire sensor table definitions, the table follows the profiles in the EEPROM.  A sensor is picked out during the
+// guided setup by warming it SENSORSETUP_RISE degrees C.
+#define SENSORTABLE_IDENT 123
+#define SENSORTABLE_ADDRS 1280
+#define SENSORTABLE_MAX 8
+#define SENSORSETUP_RISE 1.0
+#define SENSORSETUP_TIMEOUT 120000
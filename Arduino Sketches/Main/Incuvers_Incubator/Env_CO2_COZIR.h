@@ -14,13 +14,25 @@ class IncuversCO2System {
     boolean on;
     boolean stepping;
     boolean started;
-    boolean alarmOver;
-    boolean alarmUnder;
+    IncuversAlarmPoint alarmOver;
+    IncuversAlarmPoint alarmUnder;
+    boolean recovering;
+    boolean degraded;               // Sensor lost, holding the learned valve duty open loop
     
     float level;
     float setPoint;
+    long lastReadingAt;             // When we last got a valid reading
+
+    float learnedDuty;              // Fraction of the time the valve is open when holding the setpoint
+    boolean dutyLearned;            // Has learnedDuty been measured at the current setpoint
+    long dutyWindowStart;
+    unsigned long dutyWindowMillis; // Gas meter open time at the start of the window
+    boolean dutySteady;             // Has the level stayed near the setpoint for the whole window
+    long openLoopCycleStart;
     
     IncuversSerialSensor* iSS;
+    IncuversGasMeter gasMeter;
+    IncuversPowerArbiter* arbiter;
 
     void CheckJumpStatus() {
       #ifdef DEBUG_CO2
@@ -29,7 +41,8 @@ class IncuversCO2System {
 
       if (this->on) {
         if (this->tickTime >= this->shutCO2At) {
-          digitalWrite(pinAssignment_Valve, LOW);
+          this->arbiter->Release(POWER_CH_CO2);
+          this->gasMeter.ValveClosed(this->tickTime);
           #ifdef DEBUG_CO2 
             Serial.print(F("CO2 shut "));
             Serial.print((this->tickTime-this->shutCO2At));
@@ -41,6 +54,17 @@ class IncuversCO2System {
       }
     }
 
+    byte GetUrgency() {
+      // The further we are below the setpoint the more urgent our request for power is.
+      float deficit = (this->setPoint - this->level) / this->setPoint * 100.0;
+      if (deficit < 1.0) {
+        deficit = 1.0;
+      } else if (deficit > 100.0) {
+        deficit = 100.0;
+      }
+      return POWER_PRIORITY_GAS + (byte)deficit;
+    }
+
     void GetCO2Reading_Cozir() {
       #ifdef DEBUG_CO2 
           Serial.println(F("GetCO2Reading_Cozir"));
@@ -60,6 +84,7 @@ class IncuversCO2System {
     
         if (reading > 0 && reading < 300000) {
           level = (float)((CO2_MULTIPLIER * reading)/10000);  
+          this->lastReadingAt = this->tickTime;
           #ifdef  DEBUG_CO2
             Serial.print("  CO2 level: ");
             Serial.println(level);
@@ -74,6 +99,62 @@ class IncuversCO2System {
       }
     }
     
+    void ResetDutyWindow() {
+      this->dutyWindowStart = this->tickTime;
+      this->dutyWindowMillis = this->gasMeter.getOpenMillis();
+      this->dutySteady = true;
+    }
+
+    void UpdateDuty() {
+      // Measure how much gas it takes to hold the setpoint, in case we ever lose our sensor.
+      if (this->level < this->setPoint * (1.0 - CO2_DUTY_BAND) || this->level > this->setPoint * (1.0 + CO2_DUTY_BAND) || this->recovering) {
+        this->dutySteady = false;
+      }
+      if (this->tickTime - this->dutyWindowStart >= DUTY_WINDOW) {
+        if (this->dutySteady) {
+          float windowDuty = (float)(this->gasMeter.getOpenMillis() - this->dutyWindowMillis) / (this->tickTime - this->dutyWindowStart);
+          if (this->dutyLearned) {
+            this->learnedDuty = this->learnedDuty + (windowDuty - this->learnedDuty) * DUTY_WEIGHT;
+          } else {
+            this->learnedDuty = windowDuty;
+            this->dutyLearned = true;
+          }
+          #ifdef DEBUG_CO2
+            Serial.print(F("CO2 duty "));
+            Serial.println(this->learnedDuty, 4);
+          #endif
+        }
+        this->ResetDutyWindow();
+      }
+    }
+
+    void CheckOpenLoop() {
+      // No sensor, open the valve for the learned share of every cycle.
+      if (this->on || this->tickTime - this->openLoopCycleStart < OPENLOOP_PERIOD) {
+        return;
+      }
+      float duty = CO2_OPENLOOP_DEF;
+      if (this->dutyLearned) {
+        duty = this->learnedDuty * OPENLOOP_SCALE;
+        if (duty > CO2_OPENLOOP_MAX) {
+          duty = CO2_OPENLOOP_MAX;
+        }
+      }
+      long openTime = (long)(duty * OPENLOOP_PERIOD);
+      if (openTime <= 0) {
+        this->openLoopCycleStart = this->tickTime;
+      } else if (this->arbiter->RequestOn(POWER_CH_CO2, POWER_PRIORITY_GAS)) {
+        this->on = true;
+        this->shutCO2At = this->tickTime + openTime;
+        this->gasMeter.ValveOpened(this->tickTime);
+        this->openLoopCycleStart = this->tickTime;
+        #ifdef DEBUG_CO2
+          Serial.print(F("\tCO2 open loop for "));
+          Serial.println(openTime);
+        #endif
+      } // if the power was deferred we will start the cycle on the next tick.
+    }
+
     void CheckCO2Maintenance() {
       #ifdef DEBUG_CO2 
         Serial.print(F("CO2Maintenance()"));
@@ -82,31 +163,33 @@ class IncuversCO2System {
         if (level > (setPoint * CO2_STEP_THRESH)) {
           if (this->tickTime > actionpoint + CO2_BLEEDTIME_STEPPING) {
             // In stepping mode and not worried about bleed delay.
-            digitalWrite(pinAssignment_Valve, HIGH);
-            delay(CO2_DELTA_STEPPING);
-            digitalWrite(pinAssignment_Valve, LOW);
-            this->actionpoint = this->tickTime;
-            #ifdef DEBUG_CO2 
-              Serial.println(F("\tCO2 step mode"));
-            #endif
+            if (this->arbiter->RequestOn(POWER_CH_CO2, this->GetUrgency())) {
+              delay(CO2_DELTA_STEPPING);
+              this->arbiter->Release(POWER_CH_CO2);
+              this->gasMeter.AddPulse(CO2_DELTA_STEPPING);
+              this->actionpoint = this->tickTime;
+              #ifdef DEBUG_CO2 
+                Serial.println(F("\tCO2 step mode"));
+              #endif
+            } // if the power was deferred we will step on the next tick.
           } // there is no else, we need to wait for the bleedtime to expire.
         } else {
           // below the setpoint and the stepping threshold, 
-          if (!this->on && this->tickTime > (this->actionpoint + CO2_BLEEDTIME_JUMP)) {
+          if (!this->on && (this->recovering || this->tickTime > (this->actionpoint + CO2_BLEEDTIME_JUMP)) && this->arbiter->RequestOn(POWER_CH_CO2, this->GetUrgency())) {
             if (this->started == false) {
               this->started = true;
               this->startCO2At = this->tickTime;
-            } else {
-              if (this->startCO2At + CO2_ALARM_OPEN_PERIOD < this->tickTime) {
-                alarmUnder = true;
-                #ifdef DEBUG_CO2 
-                  Serial.println(F("\tCO2 under-saturation alarm thrown"));
-                #endif
-              }
+            } else if (this->recovering) {
+              // The door was open, don't count this towards the under-saturation alarm.
+              this->startCO2At = this->tickTime;
             }
             this->on = true;
-            this->shutCO2At = (this->tickTime + CO2_DELTA_JUMP);
-            digitalWrite(pinAssignment_Valve, HIGH);
+            if (this->recovering) {
+              this->shutCO2At = (this->tickTime + CO2_DELTA_JUMP_RECOVERY);
+            } else {
+              this->shutCO2At = (this->tickTime + CO2_DELTA_JUMP);
+            }
+            this->gasMeter.ValveOpened(this->tickTime);
             #ifdef DEBUG_CO2 
               Serial.print(F("\tCO2 opening from "));
               Serial.print(this->tickTime);
@@ -115,31 +198,42 @@ class IncuversCO2System {
             #endif
           } else {
            #ifdef DEBUG_CO2 
-             Serial.println(F("\tCO2 under but bleed remaining"));
+             Serial.println(F("\tCO2 under but bleed remaining or power deferred"));
            #endif 
           }
         }
       } else {
         // CO2 level above setpoint.
-        digitalWrite(pinAssignment_Valve, LOW); // just to make sure
+        this->arbiter->Release(POWER_CH_CO2); // just to make sure
+        this->gasMeter.ValveClosed(this->tickTime);
         this->started = false;
-        if (level > (setPoint * CO2_ALARM_THRESH)) {
-          // Alarm
-          alarmOver = true;
-          #ifdef DEBUG_CO2 
-            Serial.println(F("\tO2 over-saturation alarm"));
-          #endif
-        }
       }
     }
 
+    void UpdateAlarms() {
+      // Once per tick, isAlarmed() only returns what was worked out here.  A lost sensor is an alarm of its own.
+      if (!this->enabled || mode != 2 || this->degraded || this->level < 0) {
+        this->alarmOver.Clear();
+        this->alarmUnder.Clear();
+        return;
+      }
+      this->alarmOver.UpdateLevel(this->level, this->setPoint * CO2_ALARM_THRESH, this->setPoint * (CO2_ALARM_THRESH - CO2_ALARM_HYSTERESIS));
+      // Under-saturated: the valve has been opening for CO2_ALARM_OPEN_PERIOD without reaching the setpoint.
+      this->alarmUnder.Update(this->started && !this->recovering && this->startCO2At + CO2_ALARM_OPEN_PERIOD < this->tickTime, !this->started);
+    }
+
   public:
-    void SetupCO2(int rxPin, int txPin, int relayPin) {
+    void SetupCO2(int rxPin, int txPin, int relayPin, IncuversPowerArbiter* iPower) {
       #ifdef DEBUG_CO2
         Serial.println(F("CO2::Setup"));
       #endif
       
       this->enabled = false;
+      this->recovering = false;
+      this->alarmOver.Setup(ALARM_ID_CO2_OVER, ALARM_SEVERITY_WARNING, CO2_ALARM_MIN_DURATION);
+      this->alarmUnder.Setup(ALARM_ID_CO2_UNDER, ALARM_SEVERITY_WARNING, CO2_ALARM_MIN_DURATION);
+      this->degraded = false;
+      this->dutyLearned = false;
       level = -100;
       // Setup Serial Interface
       this->iSS = new IncuversSerialSensor();
@@ -147,7 +241,9 @@ class IncuversCO2System {
       
       //Setup the gas system
       this->pinAssignment_Valve = relayPin;
-      pinMode(this->pinAssignment_Valve, OUTPUT);
+      this->arbiter = iPower;
+      this->arbiter->RegisterChannel(POWER_CH_CO2, this->pinAssignment_Valve, POWER_DRAW_GASVALVE, false);
+      this->gasMeter.SetupGasMeter('C', GASMETER_ADDRS_CO2, CO2_FLOW_COEFF, CO2_CYLINDER_SIZE);
       
       #ifdef DEBUG_CO2
         Serial.println(F("Enabled"));
@@ -163,12 +259,23 @@ class IncuversCO2System {
     }
 
     void SetSetPoint(float tempSetPoint) {
+      if (tempSetPoint != this->setPoint) {
+        // What we learned only holds for the old setpoint.
+        this->dutyLearned = false;
+        this->tickTime = millis();
+        this->ResetDutyWindow();
+      }
       this->setPoint = tempSetPoint;
     }
+
+    void SetRecoveryMode(boolean recovering) {
+      this->recovering = recovering;
+    }
     
     void MakeSafeState() {
       if (this->enabled) {
-        digitalWrite(this->pinAssignment_Valve, LOW);   // Set LOW (solenoid closed off)
+        this->arbiter->Release(POWER_CH_CO2);   // Set LOW (solenoid closed off)
+        this->gasMeter.ValveClosed(millis());
         this->on = false;
         this->stepping = false;
         this->started = false;
@@ -176,6 +283,8 @@ class IncuversCO2System {
     }
 
     void DoTick() {
+      this->gasMeter.DoTick();
+      
       if (this->enabled) {
         this->tickTime = millis();
       
@@ -185,10 +294,35 @@ class IncuversCO2System {
 
         this->GetCO2Reading_Cozir();
 
-        if (mode == 2) {
-          this->CheckCO2Maintenance();
+        if (this->tickTime - this->lastReadingAt > SENSOR_LOSS_PERIOD) {
+          // Rather than stop regulating, keep feeding gas at the learned rate.
+          if (!this->degraded) {
+            #ifdef DEBUG_CO2
+              Serial.println(F("CO2 sensor lost, running open loop"));
+            #endif
+            this->degraded = true;
+            this->level = -100;
+            this->started = false;
+            this->openLoopCycleStart = this->tickTime - OPENLOOP_PERIOD;
+          }
+          if (mode == 2) {
+            this->CheckOpenLoop();
+          }
+        } else {
+          if (this->degraded) {
+            #ifdef DEBUG_CO2
+              Serial.println(F("CO2 sensor restored"));
+            #endif
+            this->degraded = false;
+            this->ResetDutyWindow();
+          }
+          if (mode == 2) {
+            this->UpdateDuty();
+            this->CheckCO2Maintenance();
+          }
         }
       }
+      this->UpdateAlarms();
     }
 
     float getCO2Level() {
@@ -203,6 +337,22 @@ class IncuversCO2System {
       return stepping;
     }
 
+    boolean isDegraded() {
+      return this->degraded;
+    }
+
+    float getLearnedDuty() {
+      // -1 = not learned at the current setpoint
+      if (!this->dutyLearned) {
+        return -1;
+      }
+      return this->learnedDuty;
+    }
+
+    IncuversGasMeter* getGasMeter() {
+      return &this->gasMeter;
+    }
+
     void UpdateMode(int mode) {
       this->mode = mode;
       if (mode == 0) {
@@ -211,21 +361,21 @@ class IncuversCO2System {
         level = -100;
       } else {
         this->enabled = true;
+        this->degraded = false;
+        this->tickTime = millis();
+        this->lastReadingAt = this->tickTime;
+        this->ResetDutyWindow();
         this->iSS->StartSensor();
       }
     }
 
     boolean isAlarmed() {
-      if (alarmOver || alarmUnder) {
-        return true;
-      } else {
-        return false;
-      }
+      return this->alarmOver.isAlarmed() || this->alarmUnder.isAlarmed();
     }
 
     void ResetAlarms() {
-      alarmOver = false;
-      alarmUnder = false;
+      this->alarmOver.Reset();
+      this->alarmUnder.Reset();
     }
 
 };
@@ -233,13 +383,15 @@ class IncuversCO2System {
 #else
 class IncuversCO2System {
   public:
-    void SetupCO2(int rxPin, int txPin, int relayPin) {
-      pinMode(relayPin, OUTPUT);  
-      digitalWrite(relayPin, LOW);   // Set LOW (solenoid closed off)
+    void SetupCO2(int rxPin, int txPin, int relayPin, IncuversPowerArbiter* iPower) {
+      iPower->RegisterChannel(POWER_CH_CO2, relayPin, POWER_DRAW_GASVALVE, false);   // Set LOW (solenoid closed off)
     }
 
     void SetSetPoint(float tempSetPoint) {
     }
+
+    void SetRecoveryMode(boolean recovering) {
+    }
     
     void MakeSafeState() {
     }
@@ -262,6 +414,18 @@ class IncuversCO2System {
       return false;
     }
 
+    boolean isDegraded() {
+      return false;
+    }
+
+    float getLearnedDuty() {
+      return -1;
+    }
+
+    IncuversGasMeter* getGasMeter() {
+      return NULL;
+    }
+
     void UpdateMode(int mode) {
     }
 
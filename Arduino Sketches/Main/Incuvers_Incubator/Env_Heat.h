@@ -8,76 +8,18 @@ class IncuversHeatingSystem {
     float tempChamber;
     float tempOther;
 
-    bool otherTempSensorPresent;
+    bool chamberDegraded;           // Chamber sensor lost, its heater is running open loop
+    unsigned long chamberReadAt;    // When we last got a valid chamber reading
     
-    byte sensorAddrDoorTemp[8];
+    byte sensorAddrDoorTemp[8];     // From the hardware definition, for sensors the bus doesn't know the role of yet
     byte sensorAddrChamberTemp[8];
-    byte sensorAddrOtherTemp[8];
     
     IncuversEM EMHandleDoor;
     IncuversEM EMHandleChamber;
     
-    OneWire* oneWire;
-    DallasTemperature* tempSensors;
+    IncuversSensorBus sensorBus;
+    IncuversPowerArbiter* arbiter;
 
-    bool AreSensorsSame(byte addrA[], byte addrB[]) {
-      bool result = true;
-      for (int i = 0; i < 8; i++) {
-        #ifdef DEBUG_TEMP
-        Serial.print(addrA[i]);
-        Serial.print(" to ");
-        Serial.println(addrB[i]);
-        #endif
-        if (addrA[i] != addrB[i]) {
-          result = false;  
-        }
-      }
-      
-      return result;
-    }
-    
-    void CheckForOtherTempSonsors() {
-      int i, j, k;
-      byte addr[8];
-      bool allocated;
-      j=0;
-      k=0;
-      
-      this->otherTempSensorPresent = false;
-      
-      while(oneWire->search(addr)) {
-        #ifdef DEBUG_TEMP
-        Serial.print(addr[0]);
-        Serial.print(addr[1]);
-        Serial.print(addr[2]);
-        Serial.print(addr[3]);
-        Serial.print(addr[4]);
-        Serial.print(addr[5]);
-        Serial.print(addr[6]);
-        Serial.print(addr[7]);
-        #endif
-        if (!AreSensorsSame(addr, sensorAddrDoorTemp) && !AreSensorsSame(addr, sensorAddrChamberTemp)) {
-          Serial.println(" :: No match");
-          k++;
-          for( i = 0; i < 8; i++) {
-            sensorAddrOtherTemp[i] = addr[i]; 
-            this->otherTempSensorPresent = true;
-          }
-        }
-        j++;
-      }
-
-      #ifdef DEBUG_TEMP
-        Serial.print(F("Heat::CFOTS - Found "));
-        Serial.print(j);
-        Serial.print(F(" sensors, "));
-        Serial.print(k);
-        Serial.println(F(" weren't allocated."));
-        Serial.println(F("\tAn address was added as the other temp sensor."));
-      #endif
-    }
-
-    
     void GetTemperatureReadings() {
       #ifdef DEBUG_TEMP
         Serial.println(F("Heat::GetTempRead"));
@@ -85,16 +27,17 @@ class IncuversHeatingSystem {
       boolean updateCompleted = false;
       int i = 0;
       float tD, tC, tO;
+      // Without a chamber sensor (a new board, or during the sensor setup) retrying can't help: read once and let the
+      // chamber go degraded.
+      boolean noChamber = this->sensorBus.FindRole(SENSOR_ROLE_CHAMBER) < 0;
       
       while (!updateCompleted) {
         // Request the temperatures
-        this->tempSensors->requestTemperatures();
+        this->sensorBus.Update();
         // Record the values
-        tD = this->tempSensors->getTempC(this->sensorAddrDoorTemp);
-        tC = this->tempSensors->getTempC(this->sensorAddrChamberTemp);
-        if (this->otherTempSensorPresent) {
-          tO = this->tempSensors->getTempC(this->sensorAddrOtherTemp);
-        }
+        tD = this->sensorBus.getRoleTemperature(SENSOR_ROLE_DOOR);
+        tC = this->sensorBus.getRoleTemperature(SENSOR_ROLE_CHAMBER);
+        tO = this->sensorBus.getRoleTemperature(SENSOR_ROLE_AMBIENT);
         
         #ifdef DEBUG_TEMP
           Serial.print(F("Door: "));
@@ -104,7 +47,7 @@ class IncuversHeatingSystem {
           Serial.println("*C");
         #endif  
 
-        if (this->otherTempSensorPresent && tO > -40.0 && tO < 85.0 ) {
+        if (tO > -40.0 && tO < 85.0 ) {
           this->tempOther = tO;
         }
         if (tD > -40.0 && tD < 85.0 ) {
@@ -113,6 +56,7 @@ class IncuversHeatingSystem {
         
         if (tC > -40.0 && tC < 85.0 ) {
           this->tempChamber = tC;
+          this->chamberReadAt = millis();
           updateCompleted = true;
         } else {
           i++;
@@ -120,7 +64,8 @@ class IncuversHeatingSystem {
             Serial.print(F("Temperature sensors returned invalid reading"));
             Serial.println(i);
           #endif 
-          if (i > 5) {
+          if (i > 5 || this->chamberDegraded || noChamber) {
+            // Once degraded don't hold up the loop retrying, we'll try again next tick.
             //statusHolder.AlarmTempSensorMalfunction = true;
             updateCompleted = true;
           }
@@ -130,7 +75,7 @@ class IncuversHeatingSystem {
   
     
   public:
-    void SetupHeating(int doorPin, int chamberPin, int oneWirePin, byte doorSensorID[8], byte chamberSensorID[8], int heatMode, int fanPin, int fanMode, float tempSetPoint) {
+    void SetupHeating(int doorPin, int chamberPin, int oneWirePin, byte doorSensorID[8], byte chamberSensorID[8], int heatMode, int fanPin, int fanMode, float tempSetPoint, IncuversPowerArbiter* iPower, IncuversPersistence* iPersist) {
       #ifdef DEBUG_TEMP
         Serial.println(F("Heat::Setup"));
         Serial.println(doorPin);
@@ -157,13 +102,19 @@ class IncuversHeatingSystem {
         Serial.println(fanMode);
       #endif
 
+      this->arbiter = iPower;
+
       // Setup EMs
-      this->EMHandleChamber.SetupEM(char('C'), true, tempSetPoint, 0, chamberPin);
+      this->EMHandleChamber.SetupEM(char('C'), true, tempSetPoint, 0, chamberPin, this->arbiter, POWER_CH_HEATCHAMBER, POWER_DRAW_HEATCHAMBER, POWER_PRIORITY_HEATCHAMBER);
       this->EMHandleChamber.SetupEM_Timing(false, TEMP_ALARM_ON_PERIOD, 90.0, true, false, TEMPERATURE_STEP_LEN, false, 0.0);
-      this->EMHandleChamber.setupEM_Alarms(true, TEMP_ALARM_THRESH, true, TEMP_ALARM_ON_PERIOD);
-      this->EMHandleDoor.SetupEM(char('D'), true, tempSetPoint, 0, doorPin);
+      this->EMHandleChamber.setupEM_Alarms(true, TEMP_ALARM_THRESH, true, TEMP_ALARM_ON_PERIOD, ALARM_ID_CHAMBER_OVER, ALARM_ID_CHAMBER_UNDER, TEMP_ALARM_MIN_DURATION);
+      this->EMHandleChamber.SetupEM_WarmUp(true, TEMPERATURE_WARMUP_ENTRY, TEMPERATURE_WARMUP_LAG);
+      this->EMHandleChamber.SetupEM_OpenLoop(TEMPERATURE_OPENLOOP_DEF, TEMPERATURE_OPENLOOP_MAX);
+      this->EMHandleDoor.SetupEM(char('D'), true, tempSetPoint, 0, doorPin, this->arbiter, POWER_CH_HEATDOOR, POWER_DRAW_HEATDOOR, POWER_PRIORITY_HEATDOOR);
       this->EMHandleDoor.SetupEM_Timing(false, TEMP_ALARM_ON_PERIOD, 90.0, true, false, TEMPERATURE_STEP_LEN, false, 0.0);
-      this->EMHandleDoor.setupEM_Alarms(true, TEMP_ALARM_THRESH, true, RESET_AFTER_DELTA);  // We have a really long alarm period for the door as we aren't as concerned if it never reaches its destination temperature
+      // No undershoot alarm for the door as we aren't concerned if it never reaches its destination temperature (the period
+      // doesn't fit in a long anyway).
+      this->EMHandleDoor.setupEM_Alarms(true, TEMP_ALARM_THRESH, false, RESET_AFTER_DELTA, ALARM_ID_DOOR_OVER, ALARM_ID_DOOR_UNDER, TEMP_ALARM_MIN_DURATION);
       
 
       // MakeSafe
@@ -176,14 +127,10 @@ class IncuversHeatingSystem {
       
       // Setup Temperature sensors
       this->pinAssignment_OneWire = oneWirePin;
-      this->oneWire = new OneWire(PINASSIGN_ONEWIRE_BUS);       // Setup a oneWire instance to communicate with ANY OneWire devices
-      this->tempSensors = new DallasTemperature(this->oneWire);          // Pass our oneWire reference to Dallas Temperature.
-
-      this->CheckForOtherTempSonsors();
+      this->sensorBus.SetupSensorBus(this->pinAssignment_OneWire, this->sensorAddrDoorTemp, this->sensorAddrChamberTemp, iPersist);
       tempOther = -100;
-      
-      // Starting the temperature sensors
-      this->tempSensors->begin();
+      this->chamberDegraded = false;
+      this->chamberReadAt = millis();
     
       if (heatMode == 0) {
         this->EMHandleDoor.Disable();
@@ -198,11 +145,11 @@ class IncuversHeatingSystem {
       // Setup fans
       this->pinAssignment_Fan = fanPin;
       this->fanMode = fanMode;
-      pinMode(this->pinAssignment_Fan, OUTPUT);
+      this->arbiter->RegisterChannel(POWER_CH_FAN, this->pinAssignment_Fan, POWER_DRAW_FAN, false);
       if (this->fanMode == 4) {
-        digitalWrite(this->pinAssignment_Fan, HIGH);       // Turn on the Fan  
+        this->arbiter->ForceOn(POWER_CH_FAN);              // Turn on the Fan  
       } else {
-        digitalWrite(this->pinAssignment_Fan, LOW);        // Turn off the Fan
+        this->arbiter->Release(POWER_CH_FAN);              // Turn off the Fan
       }
     }
   
@@ -211,6 +158,11 @@ class IncuversHeatingSystem {
       this->EMHandleChamber.UpdateDesiredLevel(tempSetPoint);
     }
 
+    void SetRecoveryMode(boolean recovering) {
+      this->EMHandleDoor.SetRecoveryMode(recovering);
+      this->EMHandleChamber.SetRecoveryMode(recovering);
+    }
+
     void UpdateHeatMode(int mode) {
       if (mode == 0) {
         this->EMHandleDoor.Disable();
@@ -226,9 +178,9 @@ class IncuversHeatingSystem {
     void UpdateFanMode(int mode) {
       this->fanMode = mode;
       if (this->fanMode == 4) {
-        digitalWrite(this->pinAssignment_Fan, HIGH);       // Turn on the Fan  
+        this->arbiter->ForceOn(POWER_CH_FAN);              // Turn on the Fan  
       } else {
-        digitalWrite(this->pinAssignment_Fan, LOW);        // Turn off the Fan
+        this->arbiter->Release(POWER_CH_FAN);              // Turn off the Fan
       }
     }
   
@@ -238,7 +190,7 @@ class IncuversHeatingSystem {
       #endif
       this->EMHandleDoor.Disable();
       this->EMHandleChamber.Disable();
-      digitalWrite(this->pinAssignment_Fan, LOW);        // Turn off the Fan
+      this->arbiter->Release(POWER_CH_FAN);              // Turn off the Fan
     }
 
     void ResumeState(int heatMode) {
@@ -250,28 +202,62 @@ class IncuversHeatingSystem {
         this->EMHandleDoor.Enable();
       }
       if (this->fanMode == 4) {
-        digitalWrite(this->pinAssignment_Fan, HIGH);       // Turn on the Fan  
+        this->arbiter->ForceOn(POWER_CH_FAN);              // Turn on the Fan  
       } 
     }
 
     void DoQuickTick() {
       this->EMHandleChamber.DoQuickTick();
-      // Only doing Chamber as we are only Jolt-Ticking the door.
       this->EMHandleDoor.DoQuickTick();
     }
     
     void DoTick() {
+      this->sensorBus.DoTick();
       this->GetTemperatureReadings();
-      this->EMHandleChamber.DoUpdateTick(this->tempChamber);
+      if (this->sensorBus.FindRole(SENSOR_ROLE_CHAMBER) < 0 || millis() - this->chamberReadAt > SENSOR_LOSS_PERIOD) {
+        // Rather than shut down and let the culture cool, keep the chamber heater at its learned duty.
+        if (!this->chamberDegraded) {
+          #ifdef DEBUG_TEMP
+            Serial.println(F("Chamber sensor lost, running open loop"));
+          #endif
+          this->chamberDegraded = true;
+          this->tempChamber = -100;
+        }
+        this->EMHandleChamber.DoOpenLoopTick();
+      } else {
+        if (this->chamberDegraded) {
+          #ifdef DEBUG_TEMP
+            Serial.println(F("Chamber sensor restored"));
+          #endif
+          this->chamberDegraded = false;
+        }
+        this->EMHandleChamber.DoUpdateTick(this->tempChamber);
+      }
+      // The door is ticked after the chamber so the arbiter can give the chamber first pick of the power budget.
       this->EMHandleDoor.DoUpdateTick(this->tempDoor);
-      //if (!this->EMHandleChamber.isActive()) {
-        //this->EMHandleDoor.DoJoltTick(this->tempDoor);
-      //}
     }
 
     float getOtherTemperature() {
       return tempOther;
     }
+
+    float getZoneTemperature(byte zone) {
+      // Zones count from 0, -100 when there's no valid reading.
+      return this->sensorBus.getRoleTemperature(SENSOR_ROLE_ZONE + zone);
+    }
+
+    byte getZoneCount() {
+      return this->sensorBus.getZoneCount();
+    }
+
+    IncuversSensorBus* getSensorBus() {
+      return &this->sensorBus;
+    }
+
+    void RescanSensors() {
+      // Picks up sensors added or swapped since boot, for the sensor setup.
+      this->sensorBus.Rescan(this->sensorAddrDoorTemp, this->sensorAddrChamberTemp);
+    }
     
     float getDoorTemperature() {
       return tempDoor;
@@ -297,8 +283,30 @@ class IncuversHeatingSystem {
       return this->EMHandleChamber.isStepping();
     }
 
+    boolean isChamberDegraded() {
+      return this->chamberDegraded;
+    }
+
+    float getChamberDuty() {
+      return this->EMHandleChamber.getLearnedDuty();
+    }
+
+    boolean isChamberWarmingUp() {
+      return this->EMHandleChamber.isWarmingUp();
+    }
+
+    long getWarmUpTime() {
+      // Time it took the chamber to reach the set point after the last warm-up, in s (-1 = none yet)
+      long t = this->EMHandleChamber.getTimeToDesired();
+      if (t < 0) {
+        return -1;
+      }
+      return t / 1000;
+    }
+
     boolean isAlarmed() {
-      if (this->EMHandleDoor.isAlarm_Overshoot() || this->EMHandleChamber.isAlarm_Overshoot() || this->EMHandleChamber.isAlarm_Undershoot()) {
+      // A lost chamber sensor is handled by running open loop, its stale readings mustn't shut us down.
+      if (this->EMHandleDoor.isAlarm_Overshoot() || (!this->chamberDegraded && (this->EMHandleChamber.isAlarm_Overshoot() || this->EMHandleChamber.isAlarm_Undershoot()))) {
         return true;
       } else {
         return false;
@@ -306,6 +314,7 @@ class IncuversHeatingSystem {
     }
 
     void ResetAlarms() {
-      // Deprecated
+      this->EMHandleChamber.ResetAlarms();
+      this->EMHandleDoor.ResetAlarms();
     }
 };
@@ -16,8 +16,9 @@ class IncuversO2System {
     boolean on;
     boolean stepping;
     boolean started;
-    boolean alarmOver;
-    boolean alarmUnder;
+    IncuversAlarmPoint alarmOver;
+    IncuversAlarmPoint alarmUnder;
+    boolean recovering;
     
     float level;
     float setPoint;
@@ -25,6 +26,8 @@ class IncuversO2System {
     int pressure;
     
     IncuversSerialSensor* iSS;
+    IncuversGasMeter gasMeter;
+    IncuversPowerArbiter* arbiter;
 
     void CheckJumpStatus() {
       #ifdef DEBUG_O2
@@ -33,7 +36,8 @@ class IncuversO2System {
 
       if (this->on) {
         if (this->tickTime >= this->shutO2At) {
-          digitalWrite(pinAssignment_Valve, LOW);
+          this->arbiter->Release(POWER_CH_N);
+          this->gasMeter.ValveClosed(this->tickTime);
           #ifdef DEBUG_O2
             Serial.print(F("O2 shut "));
             Serial.print((this->tickTime-this->shutO2At));
@@ -45,6 +49,17 @@ class IncuversO2System {
       }
     }
 
+    byte GetUrgency() {
+      // The further we are above the setpoint the more urgent our request for power is.
+      float deficit = (this->level - this->setPoint) / this->setPoint * 100.0;
+      if (deficit < 1.0) {
+        deficit = 1.0;
+      } else if (deficit > 100.0) {
+        deficit = 100.0;
+      }
+      return POWER_PRIORITY_GAS + (byte)deficit;
+    }
+
     void GetO2Reading_Luminox() {
       #ifdef DEBUG_O2 
           Serial.println(F("O2Reading_Luminox"));
@@ -102,31 +117,29 @@ class IncuversO2System {
         if (level < (setPoint * OO_STEP_THRESH)) {
           if (tickTime > actionpoint + N_BLEEDTIME_STEPPING) {
             // In stepping mode and not worried about bleed delay.
-            digitalWrite(pinAssignment_Valve, HIGH);
-            delay(N_DELTA_STEPPING);
-            digitalWrite(pinAssignment_Valve, LOW);
-            actionpoint = tickTime;
-            #ifdef DEBUG_O2
-              Serial.println(F("\tO2 step mode"));
-            #endif
+            if (arbiter->RequestOn(POWER_CH_N, GetUrgency())) {
+              delay(N_DELTA_STEPPING);
+              arbiter->Release(POWER_CH_N);
+              gasMeter.AddPulse(N_DELTA_STEPPING);
+              actionpoint = tickTime;
+              #ifdef DEBUG_O2
+                Serial.println(F("\tO2 step mode"));
+              #endif
+            } // if the power was deferred we will step on the next tick.
           } // there is no else, we need to wait for the bleedtime to expire.
         } else {
           // below the setpoint and the stepping threshold, 
-          if (!on && tickTime > (actionpoint + N_BLEEDTIME_JUMP)) {
+          if (!on && (recovering || tickTime > (actionpoint + N_BLEEDTIME_JUMP)) && arbiter->RequestOn(POWER_CH_N, GetUrgency())) {
             if (started == false) {
               started = true;
               startO2At = tickTime;
-            } else {
-              if (startO2At + OO_ALARM_OPEN_PERIOD < tickTime) {
-                alarmOver = true;
-                #ifdef DEBUG_O2
-                  Serial.println(F("\tO2 over-saturation alarm"));
-                #endif
-              }
+            } else if (recovering) {
+              // The door was open, don't count this towards the over-saturation alarm.
+              startO2At = tickTime;
             }
             on = true;
             shutO2At = (tickTime + N_DELTA_JUMP);
-            digitalWrite(pinAssignment_Valve, HIGH);
+            gasMeter.ValveOpened(tickTime);
             #ifdef DEBUG_O2
              Serial.print(F("\tN jump from "));
               Serial.print(tickTime);
@@ -135,31 +148,40 @@ class IncuversO2System {
             #endif
           } else {
            #ifdef DEBUG_O2
-             Serial.println(F("\tO2 over-saturated but bleeding"));
+             Serial.println(F("\tO2 over-saturated but bleeding or power deferred"));
            #endif
           }
         }
       } else {
         // O2 level below setpoint.
-        digitalWrite(pinAssignment_Valve, LOW); // just to make sure
+        arbiter->Release(POWER_CH_N); // just to make sure
+        gasMeter.ValveClosed(tickTime);
         started = false;
-        if (level > (setPoint * (1.0 - OO_ALARM_THRESH))) {
-          // Alarm
-          alarmUnder = true;
-          #ifdef DEBUG_O2
-            Serial.println(F("\tO2 under-saturation alarm"));
-          #endif
-        }
       }
     }
 
+    void UpdateAlarms() {
+      // Once per tick, isAlarmed() only returns what was worked out here.
+      if (!this->enabled || mode != 2 || this->level < 0) {
+        this->alarmOver.Clear();
+        this->alarmUnder.Clear();
+        return;
+      }
+      // Over-saturated: nitrogen has been going in for OO_ALARM_OPEN_PERIOD without getting down to the setpoint.
+      this->alarmOver.Update(this->started && !this->recovering && this->startO2At + OO_ALARM_OPEN_PERIOD < this->tickTime, !this->started);
+      this->alarmUnder.UpdateLevel(this->level, this->setPoint * (2.0 - OO_ALARM_THRESH), this->setPoint * (2.0 - OO_ALARM_THRESH + OO_ALARM_HYSTERESIS));
+    }
+
   public:
-    void SetupO2(int rxPin, int txPin, int relayPin) {
+    void SetupO2(int rxPin, int txPin, int relayPin, IncuversPowerArbiter* iPower) {
       #ifdef DEBUG_O2
         Serial.println(F("O2::Setup"));
       #endif
       
       this->enabled = false;
+      this->recovering = false;
+      this->alarmOver.Setup(ALARM_ID_O2_OVER, ALARM_SEVERITY_WARNING, OO_ALARM_MIN_DURATION);
+      this->alarmUnder.Setup(ALARM_ID_O2_UNDER, ALARM_SEVERITY_WARNING, OO_ALARM_MIN_DURATION);
       level = -100;
       // Setup Serial Interface
       this->iSS = new IncuversSerialSensor();
@@ -167,7 +189,9 @@ class IncuversO2System {
       
       //Setup the gas system
       this->pinAssignment_Valve = relayPin;
-      pinMode(this->pinAssignment_Valve, OUTPUT);  
+      this->arbiter = iPower;
+      this->arbiter->RegisterChannel(POWER_CH_N, this->pinAssignment_Valve, POWER_DRAW_GASVALVE, false);
+      this->gasMeter.SetupGasMeter('N', GASMETER_ADDRS_N, N_FLOW_COEFF, N_CYLINDER_SIZE);
       
       #ifdef DEBUG_O2
         Serial.println(F("Enabled."));
@@ -186,15 +210,22 @@ class IncuversO2System {
       this->setPoint = tempSetPoint;
       this->setPointTime = millis();
     }
+
+    void SetRecoveryMode(boolean recovering) {
+      this->recovering = recovering;
+    }
     
     void MakeSafeState() {
-      digitalWrite(this->pinAssignment_Valve, LOW);   // Set LOW (solenoid closed off)
+      this->arbiter->Release(POWER_CH_N);   // Set LOW (solenoid closed off)
+      this->gasMeter.ValveClosed(millis());
       this->on = false;
       this->stepping = false;
       this->started = false;
     }
 
     void DoTick() {
+      this->gasMeter.DoTick();
+
       if (this->enabled) {
         this->tickTime = millis();
       
@@ -207,6 +238,7 @@ class IncuversO2System {
           this->CheckO2Maintenance();
         }
       }
+      this->UpdateAlarms();
     }
 
     float getO2Level() {
@@ -221,6 +253,10 @@ class IncuversO2System {
       return stepping;
     }
 
+    IncuversGasMeter* getGasMeter() {
+      return &this->gasMeter;
+    }
+
     void UpdateMode(int mode) {
       this->mode = mode;
       if (mode == 0) {
@@ -234,16 +270,12 @@ class IncuversO2System {
     }
 
     boolean isAlarmed() {
-      if (alarmOver || alarmUnder) {
-        return true;
-      } else {
-        return false;
-      }
+      return this->alarmOver.isAlarmed() || this->alarmUnder.isAlarmed();
     }
 
     void ResetAlarms() {
-      alarmOver = false;
-      alarmUnder = false;
+      this->alarmOver.Reset();
+      this->alarmUnder.Reset();
     }
 };
 
@@ -252,13 +284,15 @@ class IncuversO2System {
   private:
     
   public:
-    void SetupO2(int rxPin, int txPin, int relayPin) {
-      pinMode(relayPin, OUTPUT);  
-      digitalWrite(relayPin, LOW);   // Set LOW (solenoid closed off)
+    void SetupO2(int rxPin, int txPin, int relayPin, IncuversPowerArbiter* iPower) {
+      iPower->RegisterChannel(POWER_CH_N, relayPin, POWER_DRAW_GASVALVE, false);   // Set LOW (solenoid closed off)
     }
 
     void SetSetPoint(float tempSetPoint) {
     }
+
+    void SetRecoveryMode(boolean recovering) {
+    }
     
     void MakeSafeState() {
     }
@@ -281,6 +315,10 @@ class IncuversO2System {
       return false;
     }
 
+    IncuversGasMeter* getGasMeter() {
+      return NULL;
+    }
+
     void UpdateMode(int mode) {
     }
 
@@ -0,0 +1,131 @@
+/*
+ * Incuvers alarm annunciator.
+ *
+ * Sounds the buzzer for whatever is alarmed, without ever waiting: each tick works out which pattern should be playing
+ * and where in it we are from millis(), and only writes the buzzer when it has to change.  The most severe alarm
+ * raised plays its pattern (heat, then CO2, then O2, then a lost sensor), each a 16 step bit pattern of
+ * ALARM_STEP_TIME steps played from the top bit.  Steps are only as fine as the loop passes that tick us.
+ *
+ * Alarms only sound in alarm mode 2; in mode 1 they are reported (status line) but quiet.  Acknowledging mutes the
+ * alarms raised at that moment for ALARM_MUTE_TIME and resets the latched ones; anything raised since still sounds.
+ */
+#define ALARM_SOURCE_HEAT 0x01
+#define ALARM_SOURCE_CO2 0x02
+#define ALARM_SOURCE_O2 0x04
+#define ALARM_SOURCE_SENSOR 0x08      // Chamber temperature or CO2 sensor lost, running open loop
+
+class IncuversAlarm {
+  private:
+    IncuversSettingsHandler* incSet;
+    IncuversLCD* lcd;
+    byte active;                    // ALARM_SOURCE_ bits raised as of the last tick
+    byte muted;                     // Acknowledged, quiet until ALARM_MUTE_TIME is up
+    unsigned long mutedAt;
+    byte playing;                   // Source whose pattern is playing, 0 = quiet
+    unsigned long playingSince;
+    boolean buzzerOn;
+
+    byte GetActiveSources() {
+      byte sources = 0;
+      if (this->incSet->isHeatAlarmed()) {
+        sources |= ALARM_SOURCE_HEAT;
+      }
+      if (this->incSet->isCO2Alarmed()) {
+        sources |= ALARM_SOURCE_CO2;
+      }
+      if (this->incSet->isO2Alarmed()) {
+        sources |= ALARM_SOURCE_O2;
+      }
+      if (this->incSet->isChamberDegraded() || this->incSet->isCO2Degraded()) {
+        sources |= ALARM_SOURCE_SENSOR;
+      }
+      return sources;
+    }
+
+    unsigned int GetPattern(byte source) {
+      switch (source) {
+        case ALARM_SOURCE_HEAT:
+          return ALARM_PATTERN_HEAT;
+        case ALARM_SOURCE_CO2:
+          return ALARM_PATTERN_CO2;
+        case ALARM_SOURCE_O2:
+          return ALARM_PATTERN_O2;
+        default:
+          return ALARM_PATTERN_SENSOR;
+      }
+    }
+
+    void SetBuzzer(boolean on) {
+      if (on != this->buzzerOn) {
+        this->buzzerOn = on;
+        this->lcd->setBuzzer(on);
+      }
+    }
+
+  public:
+    void SetupAlarm(IncuversSettingsHandler* iSettings, IncuversLCD* iLCD) {
+      this->incSet = iSettings;
+      this->lcd = iLCD;
+      this->active = 0;
+      this->muted = 0;
+      this->playing = 0;
+      this->buzzerOn = true;
+      this->SetBuzzer(false);
+    }
+
+    void DoTick() {
+      unsigned long nowTime = millis();
+
+      this->active = this->GetActiveSources();
+      if (this->muted != 0 && nowTime - this->mutedAt >= ALARM_MUTE_TIME) {
+        this->muted = 0;
+      }
+
+      byte sounding = 0;
+      if (this->incSet->getAlarmMode() == 2) {
+        sounding = this->active & ~this->muted;
+      }
+      // The lowest bit is the most severe.
+      byte source = sounding & -sounding;
+      if (source != this->playing) {
+        #ifdef DEBUG_UI
+          Serial.print(F("Alarm: playing "));
+          Serial.println(source);
+        #endif
+        this->playing = source;
+        this->playingSince = nowTime;
+      }
+
+      if (this->playing == 0) {
+        this->SetBuzzer(false);
+      } else {
+        byte step = ((nowTime - this->playingSince) / ALARM_STEP_TIME) % 16;
+        this->SetBuzzer(bitRead(this->GetPattern(this->playing), 15 - step));
+      }
+    }
+
+    boolean Acknowledge() {
+      // Mutes what's sounding, false if nothing was.
+      if (this->playing == 0) {
+        return false;
+      }
+      this->muted |= this->active;
+      this->mutedAt = millis();
+      this->incSet->ResetAlarms();
+      this->playing = 0;
+      this->SetBuzzer(false);
+      return true;
+    }
+
+    boolean isSounding() {
+      return this->playing != 0;
+    }
+
+    byte getActive() {
+      return this->active;
+    }
+
+    byte getMuted() {
+      return this->muted;
+    }
+};
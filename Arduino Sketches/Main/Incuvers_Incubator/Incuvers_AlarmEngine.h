@@ -0,0 +1,153 @@
+/*
+ * Incuvers alarm engine.
+ *
+ * Each alarm is an IncuversAlarmPoint which its module updates once per tick with the condition to raise it and the
+ * (separate, so there's hysteresis) condition to clear it.  Either has to hold for the point's minimum duration before
+ * the alarm changes state, so a noisy reading can't flick it on and off.  A raised alarm also latches, and the latch
+ * survives the alarm clearing until it's reset (acknowledged), so a transient alarm isn't missed.  The getters only
+ * return what the last update worked out.
+ *
+ * Every raise and clear goes into alarmHistory, a small ring of the most recent transitions which the status line
+ * reports.
+ */
+#define ALARM_ID_CHAMBER_OVER 1
+#define ALARM_ID_CHAMBER_UNDER 2
+#define ALARM_ID_DOOR_OVER 3
+#define ALARM_ID_DOOR_UNDER 4
+#define ALARM_ID_CO2_OVER 5
+#define ALARM_ID_CO2_UNDER 6
+#define ALARM_ID_O2_OVER 7
+#define ALARM_ID_O2_UNDER 8
+
+#define ALARM_SEVERITY_WARNING 1
+#define ALARM_SEVERITY_CRITICAL 2
+
+#define ALARM_TRANSITION_CLEARED 0
+#define ALARM_TRANSITION_RAISED 1
+
+struct AlarmTransition {
+  unsigned long at;
+  byte id;
+  byte transition;                  // ALARM_TRANSITION_
+};
+
+class IncuversAlarmHistory {
+  private:
+    AlarmTransition entries[ALARM_HISTORY_SIZE];
+    byte next;                      // Where the next transition goes
+    byte count;
+
+  public:
+    void Record(byte id, byte transition) {
+      AlarmTransition* e = &this->entries[this->next];
+      e->at = millis();
+      e->id = id;
+      e->transition = transition;
+      this->next = (this->next + 1) % ALARM_HISTORY_SIZE;
+      if (this->count < ALARM_HISTORY_SIZE) {
+        this->count++;
+      }
+      #ifdef DEBUG_GENERAL
+        Serial.print(F("Alarm "));
+        Serial.print(id);
+        Serial.println(transition == ALARM_TRANSITION_RAISED ? F(" raised") : F(" cleared"));
+      #endif
+    }
+
+    byte getCount() {
+      return this->count;
+    }
+
+    AlarmTransition* getEntry(byte age) {
+      // 0 is the most recent, NULL past the oldest.
+      if (age >= this->count) {
+        return NULL;
+      }
+      return &this->entries[(this->next + ALARM_HISTORY_SIZE - 1 - age) % ALARM_HISTORY_SIZE];
+    }
+
+    void Print(Print* out) {
+      // Newest first, alarm, R(aised) or C(leared) and how many seconds ago.  Nothing when there's no history.
+      unsigned long nowTime = millis();
+      for (byte i = 0; i < this->count; i++) {
+        AlarmTransition* e = this->getEntry(i);
+        out->print(i == 0 ? F(" AH ") : F(","));  // Alarm history
+        out->print(e->id);
+        out->print(e->transition == ALARM_TRANSITION_RAISED ? 'R' : 'C');
+        out->print((nowTime - e->at) / 1000);
+      }
+    }
+};
+
+IncuversAlarmHistory alarmHistory;
+
+class IncuversAlarmPoint {
+  private:
+    byte id;                        // ALARM_ID_
+    byte severity;                  // ALARM_SEVERITY_
+    unsigned long minDuration;      // How long a condition has to hold before the alarm changes state, ms
+    boolean raised;
+    boolean latched;                // Raised since the last Reset()
+    boolean pending;                // The condition to change state holds, since pendingSince
+    unsigned long pendingSince;
+
+  public:
+    void Setup(byte id, byte severity, unsigned long minDuration) {
+      this->id = id;
+      this->severity = severity;
+      this->minDuration = minDuration;
+      this->raised = false;
+      this->latched = false;
+      this->pending = false;
+    }
+
+    void Update(boolean raiseCondition, boolean clearCondition) {
+      boolean change = this->raised ? clearCondition : raiseCondition;
+      if (!change) {
+        this->pending = false;
+        return;
+      }
+      unsigned long nowTime = millis();
+      if (!this->pending) {
+        this->pending = true;
+        this->pendingSince = nowTime;
+      }
+      if (nowTime - this->pendingSince >= this->minDuration) {
+        this->raised = !this->raised;
+        this->latched = this->latched || this->raised;
+        this->pending = false;
+        alarmHistory.Record(this->id, this->raised ? ALARM_TRANSITION_RAISED : ALARM_TRANSITION_CLEARED);
+      }
+    }
+
+    void UpdateLevel(float value, float raiseAt, float clearAt) {
+      // Raised past raiseAt, cleared back past clearAt; a high alarm when raiseAt is above clearAt, else a low one.
+      if (raiseAt >= clearAt) {
+        this->Update(value > raiseAt, value < clearAt);
+      } else {
+        this->Update(value < raiseAt, value > clearAt);
+      }
+    }
+
+    void Clear() {
+      // The alarm no longer applies (its controller was turned off, say), clear it after the minimum duration.
+      this->Update(false, true);
+    }
+
+    void Reset() {
+      // Acknowledged, forget the latch.  An alarm which is still raised stays raised.
+      this->latched = this->raised;
+    }
+
+    boolean isRaised() {
+      return this->raised;
+    }
+
+    boolean isAlarmed() {
+      return this->raised || this->latched;
+    }
+
+    byte getSeverity() {
+      return this->severity;
+    }
+};
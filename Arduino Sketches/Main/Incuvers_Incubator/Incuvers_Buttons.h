@@ -0,0 +1,187 @@
+/*
+ * Incuvers buttons.
+ *
+ * The two buttons are on port A of the LCD's MCP23017.  Rather than reading the port over I2C on every pass of the
+ * loop, the MCP23017 raises its INTA line when a button changes, which sets a flag from an external interrupt; the
+ * port is only read when the flag is set, so no I2C traffic at all while nobody touches the buttons.  A read gets both
+ * the port as it was when the interrupt fired (INTCAPA) and as it is now (GPIOA), so a press and release which both
+ * happened during one pass of the loop isn't lost.  The reads are queued on the TWI bus and their results handled
+ * when they come back, on a later tick.
+ *
+ * What was read goes through a small state machine which turns it into events, queued for the UI:
+ *   press    one button, once it's been down BUTTON_SECONDPOLLDELAY without the other joining it
+ *   chord    both buttons, pressed within BUTTON_SECONDPOLLDELAY of each other
+ *   long     a button held BUTTON_LONGPRESS_TIME, repeated every MENU_UI_REDRAW_DELAY while it's held
+ *   release  all buttons up again
+ * Nothing here ever waits.  Without PINASSIGN_BUTTON_INT the port is read every tick instead.
+ *
+ * INTA has to be wired to PINASSIGN_BUTTON_INT for the interrupt to do anything.  On a board without that wire the port
+ * is still read every BUTTON_SECONDPOLLDELAY, slower to answer but the buttons keep working, and INTCAPA still holds
+ * a tap which came and went between two of those reads.
+ */
+#define BUTTON_EVENT_PRESS 0x10
+#define BUTTON_EVENT_CHORD 0x20
+#define BUTTON_EVENT_LONG 0x30
+#define BUTTON_EVENT_RELEASE 0x40
+#define BUTTON_EVENT_TYPE(event) ((event) & 0xF0)
+#define BUTTON_EVENT_BUTTONS(event) ((event) & 0x03)   // 1 = upper, 2 = lower, 3 = both
+
+volatile boolean buttonsChanged = true;     // Set from the interrupt, read the port on the next tick
+
+void ButtonsInterrupt() {
+  buttonsChanged = true;
+}
+
+class IncuversButtons {
+  private:
+    byte events[BUTTON_QUEUE_SIZE];
+    byte eventHead;                 // Next event to hand out
+    byte eventCount;
+
+    byte buttons;                   // Buttons down as of the last read
+    byte pressButtons;              // Buttons which made up the press in progress (0 = none)
+    boolean pressReported;          // The press/chord event has gone out
+    unsigned long pressStartedAt;
+    unsigned long lastRepeat;       // When the last long event went out
+    unsigned long lastRead;
+    byte readsPending;              // Port reads queued on the bus and not back yet
+    boolean readFailed;
+
+    void Queue(byte event) {
+      if (this->eventCount >= BUTTON_QUEUE_SIZE) {
+        return;                     // Nobody's taking them, drop it
+      }
+      this->events[(this->eventHead + this->eventCount) % BUTTON_QUEUE_SIZE] = event;
+      this->eventCount++;
+      #ifdef DEBUG_UI
+        Serial.print(F("Buttons: event "));
+        Serial.println(event, HEX);
+      #endif
+    }
+
+    void ReportPress() {
+      this->Queue((this->pressButtons == 3 ? BUTTON_EVENT_CHORD : BUTTON_EVENT_PRESS) | this->pressButtons);
+      this->pressReported = true;
+      this->lastRepeat = millis();
+    }
+
+    void Update(byte state, unsigned long nowTime) {
+      if (state == this->buttons) {
+        return;
+      }
+      this->buttons = state;
+      if (state == 0) {
+        if (this->pressButtons != 0) {
+          if (!this->pressReported) {
+            this->ReportPress();    // A tap shorter than the chord window
+          }
+          this->Queue(BUTTON_EVENT_RELEASE | this->pressButtons);
+          this->pressButtons = 0;
+        }
+      } else if (this->pressButtons == 0) {
+        this->pressButtons = state;
+        this->pressReported = false;
+        this->pressStartedAt = nowTime;
+      } else if (!this->pressReported) {
+        this->pressButtons |= state;  // The other button joined in, make it a chord
+      }
+    }
+
+    static void PortRead(byte status, byte* data, byte length, void* context) {
+      IncuversButtons* buttons = (IncuversButtons*)context;
+      // INTCAPA comes back first, then GPIOA.
+      if (status == TWI_STATUS_OK) {
+        #ifdef DEBUG_UI
+          Serial.print(F("Buttons: read "));
+          Serial.println(data[0]);
+        #endif
+        buttons->Update(data[0] & 3, millis());
+      } else {
+        buttons->readFailed = true;
+      }
+      buttons->readsPending--;
+      if (buttons->readsPending == 0 && buttons->readFailed) {
+        buttonsChanged = true;      // Try again
+      }
+    }
+
+    void ReadPort() {
+      // INTCAPA then GPIOA, one byte each as the MCP23017 is in byte mode for the LCD.  Reading them clears its
+      // interrupt.
+      byte intcap = 0x10;
+      byte gpio = 0x12;
+
+      this->readFailed = false;
+      if (!incTWI.Queue(LCD_MCP_ADDRESS, &intcap, 1, 1, PortRead, this)) {
+        buttonsChanged = true;      // The bus is busy with the LCD, next tick
+        return;
+      }
+      this->readsPending++;
+      if (incTWI.Queue(LCD_MCP_ADDRESS, &gpio, 1, 1, PortRead, this)) {
+        this->readsPending++;
+      } else {
+        this->readFailed = true;
+      }
+    }
+
+  public:
+    void SetupButtons() {
+      this->eventHead = 0;
+      this->eventCount = 0;
+      this->buttons = 0;
+      this->pressButtons = 0;
+      this->lastRead = 0;
+      this->readsPending = 0;
+      this->readFailed = false;
+
+      incTWI.WriteRegister(LCD_MCP_ADDRESS, 0x00, 0xFF);    // IODIRA: all of port A is input
+      #ifdef PINASSIGN_BUTTON_INT
+        // GPINTENA: interrupt on change of the buttons, compared with their last state (INTCONA = 0)
+        incTWI.WriteRegister(LCD_MCP_ADDRESS, 0x04, 0x03);
+        pinMode(PINASSIGN_BUTTON_INT, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(PINASSIGN_BUTTON_INT), ButtonsInterrupt, FALLING);
+      #endif
+      buttonsChanged = true;        // Clear anything the MCP23017 is already holding
+    }
+
+    void DoTick() {
+      // Handles what came back from the bus first, so call incTWI.DoTick() before this.
+      unsigned long nowTime = millis();
+
+      #ifdef PINASSIGN_BUTTON_INT
+        // Also catch an edge we missed, INTA stays low until the port is read, and poll slowly in case INTA isn't wired.
+        if (digitalRead(PINASSIGN_BUTTON_INT) == LOW || nowTime - this->lastRead >= BUTTON_SECONDPOLLDELAY) {
+          buttonsChanged = true;
+        }
+      #else
+        buttonsChanged = true;
+      #endif
+
+      // Let contacts which are still bouncing settle before reading them again.
+      if (buttonsChanged && this->readsPending == 0 && nowTime - this->lastRead >= BUTTON_DEBOUNCE_TIME) {
+        buttonsChanged = false;
+        this->lastRead = nowTime;
+        this->ReadPort();
+      }
+
+      if (this->pressButtons != 0) {
+        if (!this->pressReported && nowTime - this->pressStartedAt >= BUTTON_SECONDPOLLDELAY) {
+          this->ReportPress();
+        } else if (this->pressReported && this->pressButtons != 3 && nowTime - this->pressStartedAt >= BUTTON_LONGPRESS_TIME && nowTime - this->lastRepeat >= MENU_UI_REDRAW_DELAY) {
+          this->Queue(BUTTON_EVENT_LONG | this->pressButtons);
+          this->lastRepeat = nowTime;
+        }
+      }
+    }
+
+    byte GetEvent() {
+      // 0 when there's nothing queued.
+      if (this->eventCount == 0) {
+        return 0;
+      }
+      byte event = this->events[this->eventHead];
+      this->eventHead = (this->eventHead + 1) % BUTTON_QUEUE_SIZE;
+      this->eventCount--;
+      return event;
+    }
+};
@@ -1,75 +1,125 @@
-String PadToWidth(int source, int intSize) {
-  if (String(source).length() >= intSize) {
-    return String(source);
-  } else {
-    return String("0" + PadToWidth(source, intSize - 1));
-  }
-}
-
 int freeMemory() {
   extern int __heap_start, *__brkval; 
   int v; 
   return (int) &v - (__brkval == 0 ? (int) &__heap_start : (int) __brkval);
 }
 
-String ConvertMillisToScaledReadable(long totalMillisCount, int maxLen, bool includeMillis) {
-  long runningAmount;
-  int pureMillis = totalMillisCount % 1000;
-  runningAmount = floor(totalMillisCount / 1000);
-  int seconds = runningAmount % 60;
-  runningAmount = floor(runningAmount / 60);
-  int minutes = runningAmount % 60;
-  runningAmount = floor(runningAmount / 60);
-  int hours = runningAmount % 24;
-  int days = floor(runningAmount / 24);
-  
-  String readable = "";
-  int len = 0;
-  if (days > 0) {
-    readable = String(PadToWidth(days, 2) + "d");
-    len = 3; // can't be more than 3 as the atmega will reboot before 100 days are reached.
+/*
+ * Formatting for the LCD and the status line.  Numbers and durations are written with integer arithmetic into a buffer
+ * the caller owns, so drawing a screen never touches the heap.  Each returns where its text ends (on the terminating
+ * 0), so pieces can be strung together.
+ */
+char* FormatUnsigned(char* out, unsigned long value, byte width) {
+  // Zero padded to at least width digits.
+  char digits[10];
+  byte count = 0;
+  do {
+    digits[count++] = '0' + (value % 10);
+    value = value / 10;
+  } while (value > 0);
+  for (; width > count; width--) {
+    *out++ = '0';
+  }
+  while (count > 0) {
+    *out++ = digits[--count];
   }
+  *out = 0;
+  return out;
+}
 
-  if (maxLen > len + 3 && (hours > 0 || days > 0)) { // if we have room and have more than zero hours remaining or if we had days, report on hours.
-    readable = String(readable + PadToWidth(hours, 2) + "H");
-    len = len + 3; 
+char* FormatScaled(char* out, long value, byte decimals) {
+  // value is in units of 10^-decimals: (375, 1) is "37.5".
+  unsigned long scale = 1;
+  for (byte i = 0; i < decimals; i++) {
+    scale = scale * 10;
+  }
+  if (value < 0) {
+    *out++ = '-';
+    value = -value;
+  }
+  out = FormatUnsigned(out, value / scale, 1);
+  if (decimals > 0) {
+    *out++ = '.';
+    out = FormatUnsigned(out, value % scale, decimals);
   }
+  return out;
+}
 
-  if (maxLen > len + 3 && (minutes > 0 || hours > 0 || days > 0)) { // if we have room and have more than zero minutes remaining or if we had hours or days, report on minutes.
-    readable = String(readable + PadToWidth(minutes, 2) + "m");
-    len = len + 3; 
+char* FormatFixed(char* out, float value, byte decimals) {
+  // Rounded as print(value, decimals) would, but with one float multiply rather than a float division per digit.
+  float scale = 1;
+  for (byte i = 0; i < decimals; i++) {
+    scale = scale * 10;
   }
+  return FormatScaled(out, (long)(value * scale + (value < 0 ? -0.5 : 0.5)), decimals);
+}
 
-  if (maxLen > len + 3 && (seconds > 0 || minutes > 0 || hours > 0 || days > 0)) { // if we have room and have more than zero seconds remaining or if we had minutes, hours, or days, report on seconds.
-    readable = String(readable + PadToWidth(seconds, 2) + "s");
-    len = len + 3; 
+char* FormatDuration(char* out, long totalMillisCount, byte maxLen, boolean includeMillis) {
+  // Largest units first and as many as fit in maxLen, "01d02H03m" or "05m07s0250"; at most 16 characters.
+  if (totalMillisCount < 0) {
+    totalMillisCount = 0;
   }
+  unsigned int pureMillis = totalMillisCount % 1000;
+  unsigned long runningAmount = totalMillisCount / 1000;
+  byte seconds = runningAmount % 60;
+  runningAmount = runningAmount / 60;
+  byte minutes = runningAmount % 60;
+  runningAmount = runningAmount / 60;
+  byte hours = runningAmount % 24;
+  unsigned int days = runningAmount / 24;
 
+  byte len = 0;
+  boolean shown = days > 0;         // A larger unit was reported, so report this one even if it's zero
+  if (shown) {
+    out = FormatUnsigned(out, days, 2);
+    *out++ = 'd';
+    len = 3; // can't be more than 3 as the atmega will reboot before 100 days are reached.
+  }
+  shown = shown || hours > 0;
+  if (maxLen > len + 3 && shown) {
+    out = FormatUnsigned(out, hours, 2);
+    *out++ = 'H';
+    len = len + 3;
+  }
+  shown = shown || minutes > 0;
+  if (maxLen > len + 3 && shown) {
+    out = FormatUnsigned(out, minutes, 2);
+    *out++ = 'm';
+    len = len + 3;
+  }
+  shown = shown || seconds > 0;
+  if (maxLen > len + 3 && shown) {
+    out = FormatUnsigned(out, seconds, 2);
+    *out++ = 's';
+    len = len + 3;
+  }
   if (maxLen > len + 4 && includeMillis) {
-    readable = String(readable + PadToWidth(pureMillis, 4));
-    len = len + 3; 
+    out = FormatUnsigned(out, pureMillis, 4);
   }
-
-  return readable;
+  *out = 0;
+  return out;
 }
 
-String ConvertMillisToReadable(long totalMillisCount) {
-  return ConvertMillisToScaledReadable(totalMillisCount, 20, true);
+void PrintSpaces(Print* out, int count) {
+  for (; count > 0; count--) {
+    out->write(' ');
+  }
 }
 
-String CentreStringForDisplay(String prn, int width) {
-  String ret = "";
-  int padding = ((width - prn.length())/2);
-
-  for (int i = 0; i < padding; i++) {
-    ret += " ";
-  }
-  ret += prn;
-  for (int i = 0; i < (width-(padding + prn.length())); i++) {
-    ret += " ";
-  }
+void PrintCentred(Print* out, const char* text, byte width) {
+  int length = strlen(text);
+  int padding = (width - length) / 2;
+  PrintSpaces(out, padding);
+  out->print(text);
+  PrintSpaces(out, width - padding - length);
+}
 
-  return ret;
+void PrintCentred(Print* out, const __FlashStringHelper* text, byte width) {
+  int length = strlen_P((PGM_P)text);
+  int padding = (width - length) / 2;
+  PrintSpaces(out, padding);
+  out->print(text);
+  PrintSpaces(out, width - padding - length);
 }
 
 char GetIndicator(boolean enabled, boolean stepping, boolean altSymbol, boolean altBlank) {
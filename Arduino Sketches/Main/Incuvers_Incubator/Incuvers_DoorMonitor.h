@@ -0,0 +1,196 @@
+/*
+ * Incuvers door monitor.
+ *
+ * Opening the door shows up as the chamber temperature and CO2 falling and the O2 rising, all at once and faster than
+ * anything the controllers do on their own.  Each enabled sensor votes on whether its rate of change looks like an open
+ * door; once the votes go away the door is considered closed and the controllers are kept in recovery mode until every
+ * level is back near its set point.  Each event and its recovery time is logged to the serial port.
+ */
+class IncuversDoorMonitor {
+  private:
+    IncuversSettingsHandler* incSet;
+
+    byte state;                     // 0 = closed, 1 = open, 2 = closed and recovering
+    unsigned long lastSampleAt;
+    float lastTemp;
+    float lastCO2;
+    float lastO2;
+    float rateTemp;                 // Smoothed rates of change, per s
+    float rateCO2;
+    float rateO2;
+
+    unsigned long openedAt;
+    unsigned long closedAt;
+    unsigned long eventCount;       // Door openings since startup
+    long lastOpenTime;              // How long the door was open last time, in s (-1 = not yet)
+    long lastRecoveryTime;          // How long it took to recover after the door was closed last time, in s (-1 = not yet)
+
+    float UpdateRate(float rate, float newLevel, float oldLevel, unsigned long dt) {
+      float instRate = (newLevel - oldLevel) * 1000.0 / dt;
+      return rate + (instRate - rate) * DOOR_RATE_WEIGHT;
+    }
+
+    byte CountVotes(byte* voters) {
+      // Returns how many sensors look like an open door, and how many sensors could vote.
+      byte votes = 0;
+      *voters = 0;
+
+      if (this->incSet->getHeatMode() > 0 && this->lastTemp > -40) {
+        (*voters)++;
+        if (this->rateTemp < -DOOR_TEMP_RATE) {
+          votes++;
+        }
+      }
+      if (this->incSet->getCO2Mode() > 0 && this->lastCO2 >= 0) {
+        (*voters)++;
+        if (this->rateCO2 < -DOOR_CO2_RATE) {
+          votes++;
+        }
+      }
+      if (this->incSet->getO2Mode() > 0 && this->lastO2 >= 0) {
+        (*voters)++;
+        if (this->rateO2 > DOOR_O2_RATE) {
+          votes++;
+        }
+      }
+      return votes;
+    }
+
+    boolean IsRecovered() {
+      if (this->incSet->getHeatMode() > 0 && this->lastTemp < this->incSet->getTemperatureSetPoint() * DOOR_RECOVERED_PCT) {
+        return false;
+      }
+      if (this->incSet->getCO2Mode() == 2 && this->lastCO2 < this->incSet->getCO2SetPoint() * DOOR_RECOVERED_PCT) {
+        return false;
+      }
+      if (this->incSet->getO2Mode() == 2 && this->lastO2 > this->incSet->getO2SetPoint() / DOOR_RECOVERED_PCT) {
+        return false;
+      }
+      return true;
+    }
+
+    void DoorOpened(unsigned long nowTime) {
+      this->state = 1;
+      this->openedAt = nowTime;
+      this->eventCount++;
+      this->incSet->SetRecoveryMode(true);
+      #ifdef DEBUG_DOOR
+        Serial.println(F("Door opened"));
+      #endif
+    }
+
+    void DoorClosed(unsigned long nowTime) {
+      this->state = 2;
+      this->closedAt = nowTime;
+      this->lastOpenTime = (nowTime - this->openedAt) / 1000;
+      #ifdef DEBUG_DOOR
+        Serial.print(F("Door closed after "));
+        Serial.print(this->lastOpenTime);
+        Serial.println(F("s"));
+      #endif
+    }
+
+    void Recovered(unsigned long nowTime) {
+      this->state = 0;
+      this->lastRecoveryTime = (nowTime - this->closedAt) / 1000;
+      this->incSet->SetRecoveryMode(false);
+      #ifdef DEBUG_DOOR
+        Serial.print(F("Door recovery took "));
+        Serial.print(this->lastRecoveryTime);
+        Serial.println(F("s"));
+      #endif
+    }
+
+  public:
+    void SetupDoorMonitor(IncuversSettingsHandler* iSettings) {
+      this->incSet = iSettings;
+      this->state = 0;
+      this->lastSampleAt = 0;
+      this->rateTemp = 0;
+      this->rateCO2 = 0;
+      this->rateO2 = 0;
+      this->eventCount = 0;
+      this->lastOpenTime = -1;
+      this->lastRecoveryTime = -1;
+    }
+
+    void DoTick() {
+      unsigned long nowTime = millis();
+      unsigned long dt = nowTime - this->lastSampleAt;
+
+      if (dt < DOOR_SAMPLE_PERIOD) {
+        return;
+      }
+
+      float temp = this->incSet->getChamberTemperature();
+      float co2 = this->incSet->getCO2Level();
+      float o2 = this->incSet->getO2Level();
+
+      if (this->lastSampleAt != 0) {
+        if (temp > -40 && this->lastTemp > -40) {
+          this->rateTemp = this->UpdateRate(this->rateTemp, temp, this->lastTemp, dt);
+        }
+        if (co2 >= 0 && this->lastCO2 >= 0) {
+          this->rateCO2 = this->UpdateRate(this->rateCO2, co2, this->lastCO2, dt);
+        }
+        if (o2 >= 0 && this->lastO2 >= 0) {
+          this->rateO2 = this->UpdateRate(this->rateO2, o2, this->lastO2, dt);
+        }
+      }
+      this->lastSampleAt = nowTime;
+      this->lastTemp = temp;
+      this->lastCO2 = co2;
+      this->lastO2 = o2;
+
+      byte voters;
+      byte votes = this->CountVotes(&voters);
+      byte needed = DOOR_OPEN_VOTES;
+      if (voters < needed) {
+        needed = voters;
+      }
+
+      #ifdef DEBUG_DOOR
+        Serial.print(F("Door :: "));
+        Serial.print(this->rateTemp, 4);
+        Serial.print(F(" "));
+        Serial.print(this->rateCO2, 4);
+        Serial.print(F(" "));
+        Serial.print(this->rateO2, 4);
+        Serial.print(F(" ("));
+        Serial.print(votes);
+        Serial.print(F("/"));
+        Serial.print(voters);
+        Serial.println(F(")"));
+      #endif
+
+      if (this->state != 1) {
+        if (needed > 0 && votes >= needed) {
+          this->DoorOpened(nowTime);
+        } else if (this->state == 2 && (this->IsRecovered() || nowTime - this->closedAt > DOOR_RECOVERY_MAX)) {
+          this->Recovered(nowTime);
+        }
+      } else if (votes == 0) {
+        this->DoorClosed(nowTime);
+      }
+    }
+
+    byte getState() {
+      return this->state;
+    }
+
+    boolean isRecovering() {
+      return this->state != 0;
+    }
+
+    unsigned long getEventCount() {
+      return this->eventCount;
+    }
+
+    long getLastOpenTime() {
+      return this->lastOpenTime;
+    }
+
+    long getLastRecoveryTime() {
+      return this->lastRecoveryTime;
+    }
+};
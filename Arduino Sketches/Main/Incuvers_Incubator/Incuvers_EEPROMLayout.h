@@ -0,0 +1,95 @@
+/*
+ * Incuvers EEPROM layout.
+ *
+ * The records the firmware keeps in the EEPROM, shared with the host tools in Support/ which build and check EEPROM
+ * images.  Only fixed width types (byte is uint8_t, float is 4 bytes on both), and the host tools include this packed
+ * the way avr-gcc lays it out and check the sizes, so a change here that would move things shows up there.
+ */
+struct HardwareStruct {
+  // Layout of the hardware definition in the EEPROM.  Nothing keeps a copy of it, fields are read when needed (see
+  // IncuversSettingsHandler::ReadHardware()).
+  uint8_t ident[3];
+  // Identification
+  uint8_t hVer[3];
+  int16_t serial;
+  // Temp settings
+  uint8_t countOfTempSensors;
+  uint8_t sensorAddrDoorTemp[8];
+  uint8_t sensorAddrChamberTemp[8];
+  // CO2 settings
+  uint8_t hasCO2Sensor;
+  uint8_t CO2RxPin;
+  uint8_t CO2TxPin;
+  // O2 settings
+  uint8_t hasO2Sensor;
+  uint8_t O2RxPin;
+  uint8_t O2TxPin;
+  // Gas Relay(s)
+  uint8_t CO2GasRelay;
+  uint8_t CO2RelayPin;
+  uint8_t O2GasRelay;
+  uint8_t O2RelayPin;
+    // PiLink
+  uint8_t piSupport;
+  uint8_t piRxPin;
+  uint8_t piTxPin;
+  // Lighting
+  uint8_t lightingSupport;
+  uint8_t lightPin;
+};
+#define HARDWARE_FIELD(field) offsetof(HardwareStruct, field)
+
+// Roles of the temperature sensors on the OneWire bus, anything from SENSOR_ROLE_ZONE up is an extra zone (the first
+// being SENSOR_ROLE_ZONE itself).
+#define SENSOR_ROLE_NONE 0
+#define SENSOR_ROLE_DOOR 1
+#define SENSOR_ROLE_CHAMBER 2
+#define SENSOR_ROLE_AMBIENT 3
+#define SENSOR_ROLE_ZONE 4
+
+struct SensorTableEntry {
+  uint8_t rom[8];
+  uint8_t role;           // SENSOR_ROLE_*
+};
+
+struct SensorTableStruct {
+  // The sensors last found on the OneWire bus, so they don't have to be searched for at every boot (see
+  // IncuversSensorBus).
+  uint8_t ident;
+  uint8_t count;
+  SensorTableEntry sensors[SENSORTABLE_MAX];
+};
+
+struct SettingsStructV1 {
+  // Version 1 layout, only kept to migrate old records.
+  byte ident;
+  byte fanMode;
+  byte heatMode;
+  float heatSetPoint;
+  byte CO2Mode;
+  float CO2SetPoint;
+  byte O2Mode;
+  float O2SetPoint;
+  byte lightMode;
+  int32_t millisOn;
+  int32_t millisOff;
+  byte alarmMode;
+};
+
+struct SettingsStruct {
+  byte ident;
+  // Modes
+  uint8_t fanMode : 3;    // 0 = off, 1 = on during heat + 30 seconds after, 2 = on during heat + 60 seconds, 3 = on during heat + 50% of time, 4 = on
+  uint8_t heatMode : 1;   // 0 = off, 1 = on
+  uint8_t CO2Mode : 2;    // 0 = off, 1 = read, 2 = maintain
+  uint8_t O2Mode : 2;     // 0 = off, 1 = read, 2 = maintain
+  uint8_t lightMode : 2;  // 0 = off, 1 = internal timing, 2 = external timing
+  uint8_t alarmMode : 2;  // 0 = off, 1 = report, 2 = alarm
+  // Set points, in hundredths of a degree C or a percent (see ToFixed())
+  int16_t heatSetPoint;
+  int16_t CO2SetPoint;
+  int16_t O2SetPoint;
+  // Lighting
+  int32_t millisOn;
+  int32_t millisOff;
+};
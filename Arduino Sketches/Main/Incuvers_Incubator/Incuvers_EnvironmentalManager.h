@@ -5,7 +5,9 @@ class IncuversEM {
     boolean additiveElement;        // Are we trying to go up to the desired level (versus down to it)
     float desiredLevel;             // What level we are trying to reach
     float defaultLevel;             // What is the default level we are trying to get from (used only when descending)
-    int outputPin;                  // Where to send a signal to help get to the desired level
+    IncuversPowerArbiter* arbiter;  // Who to ask before sending a signal to help get to the desired level
+    byte powerChannel;              // Which arbiter channel drives our output
+    byte powerPriority;             // Base urgency of our requests to the arbiter
 
     boolean activeManagement;       // Is this Environmental Manager active?
 
@@ -32,19 +34,90 @@ class IncuversEM {
     boolean alarmOnUndershoot;      // Raise alarm if we don't reach our desired level in a timely time
     long undershootAlarmDelta;      // At what time does this alarm sound?
     boolean alarmSupressor;         // Flag to supress alarm if a desiredLevel has been changed.
+    boolean recoveryMode;           // Recovering from a door opening: don't bleed and don't raise undershoot alarms
+    IncuversAlarmPoint overshootAlarm;
+    IncuversAlarmPoint undershootAlarm;
+
+    // warm-up items
+    boolean useWarmUp;              // From a cold start, work at full power and coast into the desired level
+    float warmUpEntryPercentage;    // Below what percentage of the desired level do we start a warm-up
+    float thermalLag;               // Learned time constant of the overshoot after the output is cut, in s
+    byte warmUpState;               // 0 = idle, 1 = driving, 2 = coasting
+    boolean warmUpTiming;           // Still waiting to reach the desired level after a warm-up started
+    long warmUpStartedAt;           // When the current warm-up started
+    long warmUpCutAt;               // When the output was cut to coast in
+    float warmUpCutLevel;           // Level when the output was cut
+    float warmUpCutRate;            // Rate of change when the output was cut, per s
+    float warmUpPeakLevel;          // Highest level seen while coasting
+    long timeToDesired;             // Duration of the last warm-up, in ms (-1 = none completed yet)
+    float levelRate;                // Smoothed rate of change of the level, per s
+    long lastLevelAt;               // When the previous level was recorded
+
+    // degraded mode items
+    float learnedDuty;              // Fraction of the time the output is on when holding the desired level
+    boolean dutyLearned;            // Has learnedDuty been measured at the current desired level
+    float defaultDuty;              // Duty to use on sensor loss when nothing has been learned yet
+    float maxDuty;                  // Never run open loop above this duty
+    long dutyWindowStart;           // When the current measurement window started
+    long dutyOnMillis;              // How long the output has been on in the current window
+    boolean dutySteady;             // Has the level stayed near the desired level for the whole window
+    boolean openLoop;               // Sensor lost, holding the duty without feedback
+    long openLoopCycleStart;        // When the current open loop cycle started
+
+
+  byte GetUrgency() {
+    // The further we are from the desired level the more urgent our request for power is.
+    float deficit = 100.0 - this->percentageToDesired;
+    if (deficit < 1.0) {
+      deficit = 1.0;
+    } else if (deficit > 100.0) {
+      deficit = 100.0;
+    }
+    return this->powerPriority + (byte)deficit;
+  }
 
+  void UpdateAlarms() {
+    // Once per tick, isAlarm_Overshoot() and isAlarm_Undershoot() only return what was worked out here.
+    if (!this->activeManagement || this->openLoop) {
+      this->overshootAlarm.Clear();
+      this->undershootAlarm.Clear();
+      return;
+    }
+    if (this->alarmOnOvershoot && !this->alarmSupressor) {
+      this->overshootAlarm.UpdateLevel(this->percentageToDesired, this->overshootAlarmLevel, this->overshootAlarmLevel - EM_ALARM_HYSTERESIS);
+    } else {
+      this->overshootAlarm.Clear();
+    }
+    if (this->alarmOnUndershoot && !this->alarmSupressor && !this->recoveryMode) {
+      boolean late = this->startedWorkAt + this->undershootAlarmDelta < millis();
+      this->undershootAlarm.Update(late && this->percentageToDesired < 100.0 - EM_ALARM_HYSTERESIS, this->percentageToDesired >= 100.0);
+    } else {
+      this->undershootAlarm.Clear();
+    }
+  }
 
-  void DoStep(long len) {
+  boolean SwitchOn() {
+    return this->arbiter->RequestOn(this->powerChannel, this->GetUrgency());
+  }
+
+  void SwitchOff() {
+    this->arbiter->Release(this->powerChannel);
+  }
+
+  boolean DoStep(long len) {
     long now = millis();
 
+    if (!this->SwitchOn()) {
+      // Not enough power available right now, we'll try again on the next tick.
+      return false;
+    }
     if (len <= EM_BLOCKTHREADBELOWMS) {
       // We are in the stepping range and intend to step for shorter than a cycle
-      digitalWrite(this->outputPin, HIGH);
       delay(len);
-      digitalWrite(this->outputPin, LOW);
+      this->SwitchOff();
+      this->dutyOnMillis += len;
       this->scheduledWorkEnd = now;
     } else {
-      digitalWrite(this->outputPin, HIGH);
       if (!this->inWork) {
         this->startedWorkAt = millis();
         this->scheduledWorkEnd = this->startedWorkAt + len;
@@ -55,6 +128,7 @@ class IncuversEM {
       this->activeWork = true;
       this->inStep = true;
     }
+    return true;
   }
 
   long CalculateExponentialStepLength() {
@@ -76,6 +150,136 @@ class IncuversEM {
     return len;
   }
 
+  boolean CheckWarmUp() {
+    // Returns true while the warm-up owns the output.
+    long nowStamp = millis();
+
+    if (!this->useWarmUp) {
+      return false;
+    }
+
+    if (this->warmUpState == 0) {
+      if (this->percentageToDesired >= this->warmUpEntryPercentage) {
+        return false;
+      }
+      #ifdef DEBUG_EM
+        Serial.print(this->ident);
+        Serial.print(F(" :: Warm-up from "));
+        Serial.println(this->mostRecentLevel);
+      #endif
+      this->warmUpState = 1;
+      this->warmUpTiming = true;
+      this->warmUpStartedAt = nowStamp;
+      this->startedWorkAt = nowStamp;
+    }
+
+    if (this->warmUpState == 1) {
+      // Where would we end up if we cut the output right now?
+      float rate = this->levelRate;
+      if (rate < 0) {
+        rate = 0;
+      }
+      if (this->mostRecentLevel + rate * this->thermalLag >= this->desiredLevel || this->percentageToDesired >= 100.0) {
+        #ifdef DEBUG_EM
+          Serial.print(this->ident);
+          Serial.print(F(" :: Warm-up coasting from "));
+          Serial.print(this->mostRecentLevel);
+          Serial.print(F(" @ "));
+          Serial.print(rate, 4);
+          Serial.println(F("/s"));
+        #endif
+        this->SwitchOff();
+        this->activeWork = false;
+        this->inWork = false;
+        this->inStep = false;
+        this->warmUpState = 2;
+        this->warmUpCutAt = nowStamp;
+        this->warmUpCutLevel = this->mostRecentLevel;
+        this->warmUpCutRate = rate;
+        this->warmUpPeakLevel = this->mostRecentLevel;
+      } else if (this->SwitchOn()) {
+        this->scheduledWorkEnd = nowStamp + EM_MAXJUMPLEN;
+        this->activeWork = true;
+        this->inWork = true;
+        this->inStep = false;
+      }
+      return true;
+    }
+
+    // Coasting, wait for the level to peak before handing back to the regular maintenance.
+    if (this->mostRecentLevel > this->warmUpPeakLevel) {
+      this->warmUpPeakLevel = this->mostRecentLevel;
+    }
+    if (this->levelRate > 0 && nowStamp - this->warmUpCutAt < EM_WARMUP_COAST_MAX) {
+      return true;
+    }
+
+    if (this->warmUpCutRate > 0) {
+      // Learn from what the level actually did after the cut.
+      float observedLag = (this->warmUpPeakLevel - this->warmUpCutLevel) / this->warmUpCutRate;
+      this->thermalLag = this->thermalLag + (observedLag - this->thermalLag) * EM_LAG_WEIGHT;
+      if (this->thermalLag < EM_LAG_MIN) {
+        this->thermalLag = EM_LAG_MIN;
+      } else if (this->thermalLag > EM_LAG_MAX) {
+        this->thermalLag = EM_LAG_MAX;
+      }
+    }
+    #ifdef DEBUG_EM
+      Serial.print(this->ident);
+      Serial.print(F(" :: Warm-up peaked at "));
+      Serial.print(this->warmUpPeakLevel);
+      Serial.print(F(", lag now "));
+      Serial.print(this->thermalLag);
+      Serial.println(F("s"));
+    #endif
+    this->warmUpState = 0;
+    return false;
+  }
+
+  void UpdateDuty(long nowTime, long dt) {
+    // Measure how hard we work to hold the desired level, in case we ever lose our sensor.
+    if (this->arbiter->isOn(this->powerChannel)) {
+      this->dutyOnMillis += dt;
+    }
+    if (this->percentageToDesired < 100.0 - EM_DUTY_BAND || this->percentageToDesired > 100.0 + EM_DUTY_BAND || this->warmUpState != 0) {
+      this->dutySteady = false;
+    }
+    if (nowTime - this->dutyWindowStart >= DUTY_WINDOW) {
+      if (this->dutySteady) {
+        float windowDuty = (float)this->dutyOnMillis / (nowTime - this->dutyWindowStart);
+        if (this->dutyLearned) {
+          this->learnedDuty = this->learnedDuty + (windowDuty - this->learnedDuty) * DUTY_WEIGHT;
+        } else {
+          this->learnedDuty = windowDuty;
+          this->dutyLearned = true;
+        }
+        #ifdef DEBUG_EM
+          Serial.print(this->ident);
+          Serial.print(F(" :: Duty "));
+          Serial.println(this->learnedDuty, 3);
+        #endif
+      }
+      this->ResetDutyWindow(nowTime);
+    }
+  }
+
+  void ResetDutyWindow(long nowTime) {
+    this->dutyWindowStart = nowTime;
+    this->dutyOnMillis = 0;
+    this->dutySteady = true;
+  }
+
+  float GetOpenLoopDuty() {
+    if (!this->dutyLearned) {
+      return this->defaultDuty;
+    }
+    float duty = this->learnedDuty * OPENLOOP_SCALE;
+    if (duty > this->maxDuty) {
+      duty = this->maxDuty;
+    }
+    return duty;
+  }
+
   void CheckMaintenance() {
     long nowStamp = millis();
     #ifdef DEBUG_EM
@@ -86,6 +290,10 @@ class IncuversEM {
       Serial.println(F("%)"));
     #endif
 
+    if (this->CheckWarmUp()) {
+      return;
+    }
+
     if (this->percentageToDesired >= 100.1 && this->activeWork) {
       #ifdef DEBUG_EM
         Serial.print(F("  "));
@@ -93,7 +301,7 @@ class IncuversEM {
         Serial.println(F(": We are over 100% to our target, shutdown time"));
 
       #endif
-      digitalWrite(this->outputPin, LOW);
+      this->SwitchOff();
       this->inWork = false;
       this->activeWork = false;
       this->inStep = false;
@@ -104,7 +312,7 @@ class IncuversEM {
         this->alarmSupressor = false;
       }
 
-      if ((this->activeWork && this->percentageToDesired > this->jumpPercentageLimit && this->useStepping && !this->inStep) || (!this->activeWork && (!this->useBleeding || this->scheduledWorkEnd + this->bleedDelta < nowStamp))) {
+      if ((this->activeWork && this->percentageToDesired > this->jumpPercentageLimit && this->useStepping && !this->inStep) || (!this->activeWork && (!this->useBleeding || this->recoveryMode || this->scheduledWorkEnd + this->bleedDelta < nowStamp))) {
         // We either aren't already doing anything and we aren't waiting on a bleed or we are not in step mode but in step territory so should start a stepping cycle.
         if (this->useStepping && this->percentageToDesired > this->jumpPercentageLimit) {
           // Stepping mode
@@ -113,17 +321,19 @@ class IncuversEM {
             Serial.print((this->ident));
             Serial.println(F(": We are not at our target, but close, stepping!"));
           #endif
+          long stepLen;
           if (this->flatStepping) {
-            this->DoStep(this->steppingDelta);
+            stepLen = this->steppingDelta;
           } else {
-            this->DoStep(this->CalculateExponentialStepLength());
+            stepLen = this->CalculateExponentialStepLength();
           }
-          this->inWork = true;
-          this->activeWork = true;
-          this->inStep = true;
-          this->startedWorkAt = millis();
-        } else {
-          digitalWrite(this->outputPin, HIGH);
+          if (this->DoStep(stepLen)) {
+            this->inWork = true;
+            this->activeWork = true;
+            this->inStep = true;
+            this->startedWorkAt = millis();
+          }
+        } else if (this->SwitchOn()) {
           if (this->useJumpLength) {
             #ifdef DEBUG_EM
               Serial.print(F("  "));
@@ -140,14 +350,17 @@ class IncuversEM {
           this->startedWorkAt = millis();
         }
       } else {
-        if (this->activeWork && !this->inStep && !this->useBleeding) {
+        if (this->activeWork && !this->inStep && (!this->useBleeding || this->recoveryMode)) {
           // we are jumping, re-enable, just in case
           #ifdef DEBUG_EM
             Serial.print(F("  "));
             Serial.print((this->ident));
             Serial.println(F(": I'm jumping, but making sure"));
           #endif
-          digitalWrite(this->outputPin, HIGH);
+          this->SwitchOn();
+        } else if (this->activeWork && this->scheduledWorkEnd > nowStamp && !this->arbiter->isOn(this->powerChannel)) {
+          // A step or jump paused for a more urgent load, ask for the power again for what's left of it.
+          this->SwitchOn();
         } else {
           #ifdef DEBUG_EM
             Serial.print(F("  "));
@@ -160,20 +373,34 @@ class IncuversEM {
   }
 
   public:
-    void SetupEM(char id, boolean additive, float level, float def, int pin) {
+    void SetupEM(char id, boolean additive, float level, float def, int pin, IncuversPowerArbiter* iPower, byte channel, int draw, byte priority) {
       this->ident = id;
       this->additiveElement = additive;
       this->desiredLevel = level;
       this->defaultLevel = def;
-      this->outputPin = pin;
+      this->arbiter = iPower;
+      this->powerChannel = channel;
+      this->powerPriority = priority;
 
-      pinMode(this->outputPin, OUTPUT);
-      digitalWrite(this->outputPin, LOW);
+      this->arbiter->RegisterChannel(this->powerChannel, pin, draw, true);   // Work in progress re-requests power every tick, so we can be paused
 
       this->activeManagement = false;
       this->mostRecentLevel = -100;
       this->inWork = false;
       this->inStep = false;
+
+      this->useWarmUp = false;
+      this->warmUpState = 0;
+      this->warmUpTiming = false;
+      this->timeToDesired = -1;
+      this->levelRate = 0;
+      this->lastLevelAt = 0;
+
+      this->dutyLearned = false;
+      this->defaultDuty = 0;
+      this->maxDuty = 0;
+      this->openLoop = false;
+      this->ResetDutyWindow(millis());
     }
 
     void SetupEM_Timing(boolean useStaticJump, long jmpDlt, float jmpPct, boolean useStp, boolean fltStp, long stpDlt, boolean useBld, long bldDlt) {
@@ -187,13 +414,27 @@ class IncuversEM {
       this->bleedDelta = bldDlt;
     }
 
-    void setupEM_Alarms(boolean osAlrm, float osLvl, boolean usAlrm, long usDlt) {
+    void setupEM_Alarms(boolean osAlrm, float osLvl, boolean usAlrm, long usDlt, byte osID, byte usID, unsigned long minDuration) {
       this->alarmOnOvershoot = osAlrm;
       this->overshootAlarmLevel = osLvl;
       this->alarmOnUndershoot = usAlrm;
       this->undershootAlarmDelta = usDlt;
+      this->overshootAlarm.Setup(osID, ALARM_SEVERITY_CRITICAL, minDuration);
+      this->undershootAlarm.Setup(usID, ALARM_SEVERITY_WARNING, minDuration);
 
       this->alarmSupressor = false;
+      this->recoveryMode = false;
+    }
+
+    void SetupEM_WarmUp(boolean useWrm, float wrmPct, float lag) {
+      this->useWarmUp = useWrm;
+      this->warmUpEntryPercentage = wrmPct;
+      this->thermalLag = lag;
+    }
+
+    void SetupEM_OpenLoop(float defDuty, float mxDuty) {
+      this->defaultDuty = defDuty;
+      this->maxDuty = mxDuty;
     }
 
     void Enable() {
@@ -210,9 +451,20 @@ class IncuversEM {
       #endif
       this->activeManagement = false;
 
-      digitalWrite(this->outputPin, LOW);
+      this->SwitchOff();
       this->inWork = false;
       this->inStep = false;
+      this->warmUpState = 0;
+      this->warmUpTiming = false;
+      this->openLoop = false;
+    }
+
+    void SetRecoveryMode(boolean recovering) {
+      if (this->recoveryMode && !recovering) {
+        // Give the undershoot alarm a fresh start rather than holding the recovery against us.
+        this->startedWorkAt = millis();
+      }
+      this->recoveryMode = recovering;
     }
 
     void UpdateDesiredLevel(float level) {
@@ -231,6 +483,11 @@ class IncuversEM {
         }
       }
 
+      if (level != this->desiredLevel) {
+        // What we learned only holds for the old level.
+        this->dutyLearned = false;
+        this->ResetDutyWindow(millis());
+      }
       this->desiredLevel = level;
     }
 
@@ -240,6 +497,23 @@ class IncuversEM {
         Serial.print(newLevel);
         Serial.println(F("!"));
       #endif
+      long nowTime = millis();
+      long dt = nowTime - this->lastLevelAt;
+      if (this->openLoop) {
+        // Our sensor is back, pick up where the feedback tells us we are.
+        #ifdef DEBUG_EM
+          Serial.print(this->ident);
+          Serial.println(F(" :: Closing the loop"));
+        #endif
+        this->openLoop = false;
+        this->ResetDutyWindow(nowTime);
+        this->mostRecentLevel = -100;
+      }
+      if (this->lastLevelAt != 0 && nowTime > this->lastLevelAt && this->mostRecentLevel > -40) {
+        float instRate = (newLevel - this->mostRecentLevel) * 1000.0 / (nowTime - this->lastLevelAt);
+        this->levelRate = this->levelRate + (instRate - this->levelRate) * EM_RATE_WEIGHT;
+      }
+      this->lastLevelAt = nowTime;
       this->mostRecentLevel = newLevel;
 
       if (this->activeManagement) {
@@ -251,8 +525,63 @@ class IncuversEM {
           this->percentageToDesired = (this->defaultLevel - this->mostRecentLevel) / (this->defaultLevel - this->desiredLevel) * 100;
         }
 
+        if (this->warmUpTiming && this->percentageToDesired >= 99.5) {
+          this->timeToDesired = nowTime - this->warmUpStartedAt;
+          this->warmUpTiming = false;
+          #ifdef DEBUG_EM
+            Serial.print(this->ident);
+            Serial.print(F(" :: Reached the desired level in "));
+            Serial.print(this->timeToDesired / 1000);
+            Serial.println(F("s"));
+          #endif
+        }
+
+        this->UpdateDuty(nowTime, dt);
         this->CheckMaintenance();
       }
+      this->UpdateAlarms();
+    }
+
+    void DoOpenLoopTick() {
+      // Called instead of DoUpdateTick when our sensor is lost; hold the output at a duty cycle we know to be safe.
+      long nowTime = millis();
+
+      this->UpdateAlarms();
+      if (!this->activeManagement) {
+        return;
+      }
+      this->DoQuickTick();
+
+      if (!this->openLoop) {
+        #ifdef DEBUG_EM
+          Serial.print(this->ident);
+          Serial.print(F(" :: Open loop @ "));
+          Serial.println(this->GetOpenLoopDuty(), 3);
+        #endif
+        this->openLoop = true;
+        this->warmUpState = 0;
+        this->warmUpTiming = false;
+        this->SwitchOff();
+        this->activeWork = false;
+        this->inStep = false;
+        this->openLoopCycleStart = nowTime - OPENLOOP_PERIOD;
+      }
+
+      if (nowTime - this->openLoopCycleStart >= OPENLOOP_PERIOD) {
+        long onTime = (long)(this->GetOpenLoopDuty() * OPENLOOP_PERIOD);
+        if (onTime <= 0) {
+          this->openLoopCycleStart = nowTime;
+        } else if (this->SwitchOn()) {
+          this->scheduledWorkEnd = nowTime + onTime;
+          this->activeWork = true;
+          this->inWork = true;
+          this->inStep = false;
+          this->openLoopCycleStart = nowTime;
+        } // if the power was deferred we will start the cycle on the next tick.
+      } else if (this->activeWork) {
+        // We may have been paused for a more urgent load.
+        this->SwitchOn();
+      }
     }
 
     void DoQuickTick() {
@@ -260,11 +589,11 @@ class IncuversEM {
 
       if (this->activeManagement && this->activeWork) {
         if (this->scheduledWorkEnd <= nowTime) {
-          digitalWrite(this->outputPin, LOW);
+          this->SwitchOff();
           #ifdef DEBUG_EM
             Serial.print(this->ident);
             Serial.print(F(" :: Shut "));
-            Serial.print(this->outputPin);
+            Serial.print(this->powerChannel);
             Serial.print(F(" "));
             Serial.print((nowTime - this->scheduledWorkEnd));
             Serial.println(F("ms late"));
@@ -274,41 +603,17 @@ class IncuversEM {
       }
     }
 
-    void DoJoltTick(float newLevel) {
-      /*
-       * This is a new function which is designed to allow the door to be Jolted for 0.5 secs between work on the chamber for power management reasons.
-       */
-      this->mostRecentLevel = newLevel;
-      if (this->activeManagement && !this->inWork) {
-        if (this->additiveElement) {
-          this->percentageToDesired = this->mostRecentLevel / this->desiredLevel;
-        } else {
-          this->percentageToDesired = (this->defaultLevel - this->mostRecentLevel) / (this->defaultLevel - this->desiredLevel);
-        }
-
-        if (this->percentageToDesired < 100.0) {
-          digitalWrite(this->outputPin, HIGH);
-          delay(500);
-          digitalWrite(this->outputPin, LOW);
-          this->scheduledWorkEnd = millis();
-        }
-      }
-    }
-
     bool isAlarm_Overshoot() {
-      if (this->percentageToDesired > this->overshootAlarmLevel && !this->alarmSupressor) {
-        return true;
-      } else {
-        return false;
-      }
+      return this->overshootAlarm.isAlarmed();
     }
 
     bool isAlarm_Undershoot() {
-      if (this->percentageToDesired < 100.0 && this->startedWorkAt + this->undershootAlarmDelta < millis() && !this->alarmSupressor) {
-        return true;
-      } else {
-        return false;
-      }
+      return this->undershootAlarm.isAlarmed();
+    }
+
+    void ResetAlarms() {
+      this->overshootAlarm.Reset();
+      this->undershootAlarm.Reset();
     }
 
     bool isActive() {
@@ -319,4 +624,24 @@ class IncuversEM {
       return this->inStep;
     }
 
+    bool isOpenLoop() {
+      return this->openLoop;
+    }
+
+    float getLearnedDuty() {
+      // -1 = not learned at the current desired level
+      if (!this->dutyLearned) {
+        return -1;
+      }
+      return this->learnedDuty;
+    }
+
+    bool isWarmingUp() {
+      return this->warmUpState != 0;
+    }
+
+    long getTimeToDesired() {
+      return this->timeToDesired;
+    }
+
 };
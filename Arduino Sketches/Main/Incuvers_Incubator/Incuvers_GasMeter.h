@@ -0,0 +1,191 @@
+/*
+ * Incuvers gas meter.
+ *
+ * Keeps track of how long a gas valve has been open and how many times it was opened, and uses a flow coefficient
+ * to estimate the volume of gas used.  Totals are checkpointed to the EEPROM so we can forecast when a cylinder will
+ * run dry; once attached to the persistence service it does the writing.
+ */
+struct GasMeterStruct {
+  byte ident;
+  unsigned long openMillis;       // Cumulative time the valve has been open
+  unsigned long pulseCount;       // Count of valve openings
+  unsigned long cylinderStart;    // Value of openMillis when the current cylinder was installed
+};
+
+struct GasMeterStatus {
+  char ident;
+  unsigned long openSeconds;      // Valve open time, s
+  unsigned long pulseCount;       // Valve openings
+  float volume;                   // Volume used, L
+  float rate;                     // Consumption rate, mL/h
+  long hoursToEmpty;              // Hours until the cylinder is empty (-1 = not known yet)
+};
+
+class IncuversGasMeter {
+  private:
+    char ident;                     // Character to identify the gas in the status output ('C' = CO2, 'N' = N2)
+    int eepromAddress;              // Where to checkpoint the totals
+    float flowCoefficient;          // Estimated flow through the open valve, in mL/s
+    float cylinderSize;             // Usable gas in a full cylinder, in L
+
+    GasMeterStruct totals;
+    IncuversPersistence* persist;   // Writes the checkpoints for us (NULL = write them ourselves)
+    byte persistRegion;
+
+    boolean valveOpen;              // Currently timing an opening
+    unsigned long openedAt;         // When the current opening started
+
+    unsigned long lastCheckpoint;   // When the totals were last written to the EEPROM
+    unsigned long windowStart;      // When the current consumption rate window started
+    unsigned long windowStartMillis;// Value of openMillis at the start of the current window
+    float rate;                     // Rolling consumption rate, in mL/h (negative until the first window completes)
+
+    void UpdateRate(unsigned long nowTime) {
+      float windowVolume = (this->totals.openMillis - this->windowStartMillis) * this->flowCoefficient / 1000.0;
+      float windowRate = windowVolume * (3600000.0 / (nowTime - this->windowStart));
+
+      if (this->rate < 0) {
+        this->rate = windowRate;
+      } else {
+        this->rate = this->rate + (windowRate - this->rate) * GASMETER_RATE_WEIGHT;
+      }
+      this->windowStart = nowTime;
+      this->windowStartMillis = this->totals.openMillis;
+
+      #ifdef DEBUG_GAS
+        Serial.print(this->ident);
+        Serial.print(F(" :: Rate "));
+        Serial.print(this->rate);
+        Serial.println(F("mL/h"));
+      #endif
+    }
+
+  public:
+    void SetupGasMeter(char id, int address, float flow, float cylinder) {
+      this->ident = id;
+      this->eepromAddress = address;
+      this->flowCoefficient = flow;
+      this->cylinderSize = cylinder;
+      this->valveOpen = false;
+      this->persist = NULL;
+      this->rate = -1;
+      this->lastCheckpoint = millis();
+      this->windowStart = this->lastCheckpoint;
+
+      for (unsigned int i = 0; i < sizeof(this->totals); i++) {
+        *((char*)&this->totals + i) = EEPROM.read(this->eepromAddress + i);
+      }
+      if (this->totals.ident != GASMETER_IDENT) {
+        #ifdef DEBUG_GAS
+          Serial.print(this->ident);
+          Serial.println(F(" :: No gas totals found, starting from zero"));
+        #endif
+        this->totals.ident = GASMETER_IDENT;
+        this->totals.openMillis = 0;
+        this->totals.pulseCount = 0;
+        this->totals.cylinderStart = 0;
+      }
+      this->windowStartMillis = this->totals.openMillis;
+    }
+
+    void ValveOpened(unsigned long nowTime) {
+      if (!this->valveOpen) {
+        this->valveOpen = true;
+        this->openedAt = nowTime;
+        this->totals.pulseCount++;
+      }
+    }
+
+    void ValveClosed(unsigned long nowTime) {
+      if (this->valveOpen) {
+        this->valveOpen = false;
+        this->totals.openMillis += nowTime - this->openedAt;
+      }
+    }
+
+    void AddPulse(long len) {
+      // Used for the short, blocking, steps where the valve is already closed by the time we get here.
+      this->totals.pulseCount++;
+      this->totals.openMillis += len;
+    }
+
+    void AttachPersistence(IncuversPersistence* iPersist) {
+      this->persist = iPersist;
+      this->persistRegion = this->persist->RegisterRegion(&this->totals, this->eepromAddress, sizeof(this->totals));
+    }
+
+    void Checkpoint() {
+      #ifdef DEBUG_GAS
+        Serial.print(this->ident);
+        Serial.println(F(" :: Checkpoint"));
+      #endif
+      if (this->persist != NULL) {
+        this->persist->MarkDirty(this->persistRegion);
+        return;
+      }
+      for (unsigned int i = 0; i < sizeof(this->totals); i++) {
+        EEPROM.update(this->eepromAddress + i, *((char*)&this->totals + i));
+      }
+    }
+
+    void ResetCylinder() {
+      this->totals.cylinderStart = this->totals.openMillis;
+      this->Checkpoint();
+    }
+
+    void DoTick() {
+      unsigned long nowTime = millis();
+
+      if (nowTime - this->windowStart >= GASMETER_RATE_WINDOW) {
+        this->UpdateRate(nowTime);
+      }
+      if (nowTime - this->lastCheckpoint >= GASMETER_CHECKPOINT_PERIOD) {
+        this->Checkpoint();
+        this->lastCheckpoint = nowTime;
+      }
+    }
+
+    unsigned long getOpenMillis() {
+      return this->totals.openMillis;
+    }
+
+    unsigned long getPulseCount() {
+      return this->totals.pulseCount;
+    }
+
+    float getVolume() {
+      // Volume in L
+      return this->totals.openMillis * this->flowCoefficient / 1000000.0;
+    }
+
+    float getCylinderRemaining() {
+      // Volume in L
+      float used = (this->totals.openMillis - this->totals.cylinderStart) * this->flowCoefficient / 1000000.0;
+      return this->cylinderSize - used;
+    }
+
+    float getRate() {
+      return this->rate;
+    }
+
+    long getHoursToEmpty() {
+      // -1 = not enough information yet
+      if (this->rate <= 0) {
+        return -1;
+      }
+      float remaining = this->getCylinderRemaining();
+      if (remaining <= 0) {
+        return 0;
+      }
+      return (long)(remaining * 1000.0 / this->rate);
+    }
+
+    void FillStatus(GasMeterStatus* status) {
+      status->ident = this->ident;
+      status->openSeconds = this->totals.openMillis / 1000;
+      status->pulseCount = this->totals.pulseCount;
+      status->volume = this->getVolume();
+      status->rate = this->rate;
+      status->hoursToEmpty = this->getHoursToEmpty();
+    }
+};
@@ -1,7 +1,7 @@
 /*
  * INCUVERS INCUBATOR 
  *    Date:    March 2019
- *    Software version: 1.11
+ *    Software version: 1.12
  *    Hardware version: 1.0.1
  *    http://incuvers.com/   
  *    
@@ -13,6 +13,32 @@
 
  /* Changelog
   * 
+  * 1.12 - Added gas consumption metering and cylinder depletion forecasts.
+  *      - Replaced the door jolt with a power arbiter which keeps all outputs within a current budget.
+  *      - Added a warm-up mode which heats the chamber at full power and coasts into the set point.
+  *      - Added door opening detection, with faster recovery and logging of the recovery time.
+  *      - Added an open loop degraded mode for the chamber heater and CO2 when their sensor is lost.
+  *      - Settings are saved to a wear-levelled ring of EEPROM slots, writing only the bytes which changed.
+  *      - Settings records carry a layout version and CRC, older layouts are migrated rather than discarded.
+  *      - EEPROM saves are deferred until things are quiet and written a byte at a time, so they never stall the loop.
+  *      - Settings are packed into fixed point set points and bitfield modes, hardware definitions are read as needed.
+  *      - Added set point profiles: programs of ramp and hold segments, stored in the EEPROM and edited from the menu.
+  *      - The LCD, USB status and PiLink report from one status snapshot, collected at most once per pass of the loop.
+  *      - Units are provisioned with an EEPROM image built on the host, replacing the hardware definition writer sketch.
+  *      - Any number of temperature sensors, their ROMs and roles are kept in the EEPROM with a guided setup for new ones.
+  *      - The status screens draw into a framebuffer and only the changed characters are sent to the LCD.
+  *      - The setup menu no longer stops the controllers, it handles a button press per pass of the loop and settings apply live.
+  *      - The buttons raise an interrupt and are only read over I2C when they change, presses are queued as events.
+  *      - I2C transfers are queued and run from the TWI interrupt at 400 kHz, replacing the Wire and LiquidTWI2 libraries.
+  *      - Alarms are back on: the buzzer plays a pattern for the most severe alarm without stopping the loop, either button mutes it.
+  *      - Alarms have hysteresis and a minimum duration, latch until acknowledged and their recent history is reported.
+  *      - The UI text lives in a flash string table and numbers are formatted into fixed buffers, no Strings on the heap.
+  *      - Added trend pages with sparklines of the last 40 minutes and the lowest, mean and highest over the last day.
+  *      - The USB status line is buffered and sent without holding up the loop, lines the host can't take are dropped and counted.
+  *      - The PiLink sends binary frames (COBS, CRC16, fixed point, schema version) at a rate agreed with the Pi, with a host decoder.
+  *      - PiLink statuses go at a fixed rate, on change past per-field deadbands or on request, as the Pi asks, with heartbeats.
+  *      - The Pi can set set points and modes, save, acknowledge alarms and query stats over the PiLink, with acked commands.
+  *      
   * 1.11 - General code clean up and housekeeping.
   *      - Switched serial sensors from streaming mode to on-demand polling.
   *      - Added support for Modbus-based or voltage-based luminox sensors.
@@ -71,6 +97,11 @@
 //#define DEBUG_TEMP true
 //#define DEBUG_LIGHT true
 //#define DEBUG_MEMORY true
+//#define DEBUG_GAS true
+//#define DEBUG_POWER true
+//#define DEBUG_DOOR true
+//#define DEBUG_PROFILE true
+//#define DEBUG_TWI true
 
 // Build/upload-time options - comment out unneeded modules in order to save program space.  Please only ensure only one O2 module is included at any given time.
 #define INCLUDE_O2_SERIAL true
@@ -86,6 +117,9 @@
 #define PINASSIGN_HEATDOOR 8
 #define PINASSIGN_HEATCHAMBER 9
 #define PINASSIGN_FAN 10
+// INTA of the LCD's MCP23017, wired to an external interrupt pin (3 = INT5).  Comment out to read the buttons every pass.
+// Without the wire the buttons are only polled every BUTTON_SECONDPOLLDELAY, see Incuvers_Buttons.h.
+#define PINASSIGN_BUTTON_INT 3
 
 // Includes
 // OneWire and DallasTemperature libraries used for reading the heat sensors
@@ -95,15 +129,25 @@
   // Serial library used for querying the CO2/O2 sensor (ATMEGA 328 compatibility)
   #include "SoftwareSerial.h"
 #endif
-// Wire and LiquidTWI2 libraries used for the LCD display and button interface
-#include "Wire.h"
-#include "LiquidTWI2.h"
+// AVR TWI and interrupt definitions used by the I2C bus driver for the LCD display and button interface
+#include <avr/interrupt.h>
+#include <util/twi.h>
+#include <util/atomic.h>
 // EEPROM library used for accessing settings
 #include <EEPROM.h>  
 
 // Incuvers modules 
 #include "Incuvers_Common.h"
+#include "Incuvers_UIText.h"
+#include "Incuvers_StatusLine.h"
+#include "Incuvers_EEPROMLayout.h"
+#include "Incuvers_PowerArbiter.h"
+#include "Incuvers_AlarmEngine.h"
 #include "Incuvers_EnvironmentalManager.h"
+#include "Incuvers_SettingsStore.h"
+#include "Incuvers_Persistence.h"
+#include "Incuvers_GasMeter.h"
+#include "Incuvers_SensorBus.h"
 
 #ifdef INCLUDE_O2_MODBUS
  #include <ModbusMaster.h>
@@ -126,21 +170,37 @@
 #include "Env_CO2_COZIR.h"
 #include "Opt_Light.h"
 #include "Incuvers_Settings.h"
-#include "Opt_PiLink.h"
+#include "Incuvers_DoorMonitor.h"
+#include "Incuvers_Profile.h"
+#include "Incuvers_Status.h"
+#include "Incuvers_TWI.h"
+#include "Incuvers_LCD.h"
+#include "Incuvers_LCDBuffer.h"
+#include "Incuvers_Alarm.h"
+#include "Incuvers_Buttons.h"
+#include "Incuvers_Trend.h"
 #include "Incuvers_UI.h"
+#include "Incuvers_PiLinkFrame.h"
+#include "Opt_PiLink.h"
 
 // Globals
 IncuversSettingsHandler* iSettings;
+IncuversPersistence* iPersist;
+IncuversPowerArbiter* iPower;
 IncuversHeatingSystem* iHeat;
 IncuversLightingSystem* iLight;
 IncuversCO2System* iCO2;
 IncuversO2System* iO2;
+IncuversDoorMonitor* iDoor;
+IncuversProfileRunner* iProfile;
+IncuversStatus* iStatus;
 IncuversPiLink* iPi;
 IncuversUI* iUI;
 
 void setup() {
   // Start serial port
-  Serial.begin(9600);
+  Serial.begin(STATUS_SERIAL_BAUD);
+  statusLine.SetupStatusLine();
 
   iUI = new IncuversUI();
   iUI->SetupUI();
@@ -157,6 +217,12 @@ void setup() {
     iUI->WarnOfMissingHardwareSettings();
   }
 
+  iPersist = new IncuversPersistence();
+  iSettings->AttachIncuversModule(iPersist);
+
+  iPower = new IncuversPowerArbiter();
+  iSettings->AttachIncuversModule(iPower);
+
   iHeat = new IncuversHeatingSystem();
   iSettings->AttachIncuversModule(iHeat);
 
@@ -169,14 +235,36 @@ void setup() {
   iO2 = new IncuversO2System();
   iSettings->AttachIncuversModule(iO2);
 
+  iDoor = new IncuversDoorMonitor();
+  iDoor->SetupDoorMonitor(iSettings);
+
+  iProfile = new IncuversProfileRunner();
+  iProfile->SetupProfile(iSettings);
+
+  iStatus = new IncuversStatus();
+  iStatus->SetupStatus(iSettings, iDoor, iProfile);
+
   iPi = new IncuversPiLink();
-  iPi->SetupPiLink(iSettings);
+  iPi->SetupPiLink(iSettings, iStatus, iUI);
   
   iUI->AttachSettings(iSettings);
+  iUI->AttachStatus(iStatus);
+  iUI->AttachProfile(iProfile);
   iUI->DisplayRunMode(runMode); 
   if (runMode == 2) {
     // Don't have the info we need, load default settings and go into setup
     iUI->EnterSetupMode();
+  } else if (iHeat->getSensorBus()->isSetupNeeded()) {
+    iUI->EnterSensorSetup();
+  }
+}
+
+void yield() {
+  // delay() and the temperature sensors' conversion wait call this, the status line and PiLink frames keep going out
+  // meanwhile.
+  statusLine.DoTick();
+  if (iPi != NULL) {
+    iPi->DoQuickTick();
   }
 }
 
@@ -187,16 +275,22 @@ void loop() {
     #ifdef DEBUG_GENERAL
       Serial.println(F("loop() call detected the Arduino has been on for a month, need to reset"));
     #endif
+    iPersist->FlushAll();
     asm volatile ("  jmp 0"); 
   }
   
   // Give all the modules a chance to do some work - While we used to use mini-ticks to support multiple Software-emulated serial connections, switching away from streaming mode
   // on the serial sensors negates the need to employ these extra steps.
+  iStatus->NextCycle();
+  iUI->DoQuickTick();
+  iProfile->DoTick();
   iHeat->DoTick();
   iCO2->DoTick();
   iO2->DoTick();
   iHeat->DoQuickTick();
+  iDoor->DoTick();
   iLight->DoTick();
   iUI->DoTick(); 
   iPi->DoTick();
+  iPersist->DoTick();
 }
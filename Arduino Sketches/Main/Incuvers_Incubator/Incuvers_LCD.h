@@ -0,0 +1,107 @@
+/*
+ * Incuvers LCD.
+ *
+ * The HD44780 16x2 LCD hangs off port B of the MCP23017, wired as the LiquidTWI2 library expected it:
+ *   B7 RS, B6 RW, B5 EN, B4 D4, B3 D5, B2 D6, B1 D7, B0 buzzer
+ * in 4 bit mode.  Every character or command is one queued TWI transaction which strobes both nibbles in, so printing
+ * never waits for the bus unless the queue is full.  The MCP23017 is put in byte mode (IOCON.SEQOP) so a transaction
+ * doesn't walk through its registers; the address toggles between GPIOB and GPIOA, the port A bytes are fillers (the
+ * buttons are inputs, writing the port A latch does nothing).
+ *
+ * The buzzer shares port B, so its state is kept here and put into every byte written to the port.
+ */
+#define LCD_MCP_ADDRESS 0x20
+#define LCD_BIT_RS 0x80
+#define LCD_BIT_EN 0x20
+#define LCD_BIT_BUZZER 0x01
+
+class IncuversLCD : public Print {
+  private:
+    byte extraBits;                   // Port B bits which aren't the LCD's (the buzzer)
+
+    byte NibbleBits(byte nibble) {
+      byte bits = 0;
+      if (nibble & 0x01) bits |= 0x10;
+      if (nibble & 0x02) bits |= 0x08;
+      if (nibble & 0x04) bits |= 0x04;
+      if (nibble & 0x08) bits |= 0x02;
+      return bits;
+    }
+
+    void SendNibble(byte nibble) {
+      // Only for the power-up sequence, while the LCD is still in 8 bit mode.
+      byte bits = this->NibbleBits(nibble) | this->extraBits;
+      byte data[4] = { 0x13, (byte)(bits | LCD_BIT_EN), 0x00, bits };
+      incTWI.QueueWait(LCD_MCP_ADDRESS, data, 4, 0, NULL, NULL);
+    }
+
+    void Send(byte value, byte mode) {
+      byte high = this->NibbleBits(value >> 4) | mode | this->extraBits;
+      byte low = this->NibbleBits(value & 0x0F) | mode | this->extraBits;
+      byte data[8] = { 0x13, (byte)(high | LCD_BIT_EN), 0x00, high, 0x00, (byte)(low | LCD_BIT_EN), 0x00, low };
+      incTWI.QueueWait(LCD_MCP_ADDRESS, data, 8, 0, NULL, NULL);
+    }
+
+    void Command(byte value) {
+      this->Send(value, 0);
+    }
+
+  public:
+    void SetupLCD() {
+      this->extraBits = 0;
+
+      incTWI.WriteRegister(LCD_MCP_ADDRESS, 0x0A, 0x20);    // IOCON: byte mode
+      incTWI.WriteRegister(LCD_MCP_ADDRESS, 0x01, 0x00);    // IODIRB: all outputs
+      incTWI.WriteRegister(LCD_MCP_ADDRESS, 0x13, 0x00);
+      incTWI.WaitForIdle();
+
+      // HD44780 power-up, from whatever state it's in to 4 bit mode.
+      delay(50);
+      this->SendNibble(0x03);
+      incTWI.WaitForIdle();
+      delay(5);
+      this->SendNibble(0x03);
+      incTWI.WaitForIdle();
+      delay(5);
+      this->SendNibble(0x03);
+      incTWI.WaitForIdle();
+      delayMicroseconds(150);
+      this->SendNibble(0x02);
+
+      this->Command(0x28);            // Function set: 4 bit, 2 lines, 5x8
+      this->Command(0x0C);            // Display on, no cursor
+      this->Command(0x06);            // Entry mode: left to right
+      this->clear();
+    }
+
+    void clear() {
+      // Clearing takes the LCD 1.5ms, so this waits: only for the startup screens, the framebuffer never clears.
+      this->Command(0x01);
+      incTWI.WaitForIdle();
+      delayMicroseconds(2000);
+    }
+
+    void setCursor(byte col, byte row) {
+      this->Command(0x80 | (col + (row == 0 ? 0x00 : 0x40)));
+    }
+
+    size_t write(uint8_t c) {
+      this->Send(c, LCD_BIT_RS);
+      return 1;
+    }
+    using Print::write;
+
+    void createChar(byte location, const byte* rows) {
+      // One of the eight custom characters, shown as character location (or location + 8).  This leaves the LCD
+      // writing to the character memory, so set the cursor before printing again.
+      this->Command(0x40 | ((location & 0x07) << 3));
+      for (byte r = 0; r < 8; r++) {
+        this->Send(rows[r], LCD_BIT_RS);
+      }
+    }
+
+    void setBuzzer(boolean on) {
+      this->extraBits = on ? LCD_BIT_BUZZER : 0;
+      incTWI.WriteRegister(LCD_MCP_ADDRESS, 0x13, this->extraBits);
+    }
+};
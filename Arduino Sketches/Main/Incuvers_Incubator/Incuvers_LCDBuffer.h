@@ -0,0 +1,94 @@
+/*
+ * Incuvers LCD framebuffer.
+ *
+ * Every character or command sent to the LCD is an MCP23017 transaction on the I2C bus, so redrawing the
+ * whole 16x2 screen once a second costs far more than the few cells which actually changed.  The status screens and
+ * the menu draw into this RAM copy of the screen instead (it is a Print, so the same print() calls work), and Flush()
+ * sends only the cells which differ from what the LCD is showing.  Changed cells close together are sent as one run,
+ * the cursor is only moved when skipping ahead is cheaper than rewriting the unchanged cells in between.
+ *
+ * Anything which draws on the LCD directly (the startup screens) has to Invalidate() the buffer when it's done, so the
+ * next Flush() redraws everything.
+ */
+class IncuversLCDBuffer : public Print {
+  private:
+    char cells[LCD_ROWS][LCD_COLS];       // What we want on the screen
+    char shown[LCD_ROWS][LCD_COLS];       // What the LCD is showing
+    byte col;
+    byte row;
+    int lastFlushBytes;                   // I2C bytes sent by the last Flush()
+
+  public:
+    void SetupBuffer() {
+      this->clear();
+      this->Invalidate();
+      this->lastFlushBytes = 0;
+    }
+
+    void clear() {
+      // Only clears the buffer, the LCD catches up on the next Flush().
+      memset(this->cells, ' ', sizeof(this->cells));
+      this->col = 0;
+      this->row = 0;
+    }
+
+    void setCursor(byte col, byte row) {
+      this->col = col;
+      this->row = row;
+    }
+
+    size_t write(uint8_t c) {
+      // Anything past the end of the row is dropped, as the LCD would.
+      if (this->row >= LCD_ROWS || this->col >= LCD_COLS) {
+        return 0;
+      }
+      this->cells[this->row][this->col++] = c;
+      return 1;
+    }
+    using Print::write;
+
+    void Invalidate() {
+      // No character we draw is 0, so every cell is sent on the next Flush().
+      memset(this->shown, 0, sizeof(this->shown));
+    }
+
+    void Flush(IncuversLCD* lcd) {
+      int sends = 0;
+
+      for (byte r = 0; r < LCD_ROWS; r++) {
+        int cursor = -1;                  // Where the LCD's cursor is on this row (-1 = elsewhere)
+        for (byte c = 0; c < LCD_COLS; c++) {
+          if (this->cells[r][c] == this->shown[r][c]) {
+            continue;
+          }
+          if (cursor < 0 || c - cursor > 1) {
+            lcd->setCursor(c, r);
+            sends++;
+          } else {
+            // A single unchanged cell in between is as cheap to rewrite as moving the cursor past it.
+            while (cursor < c) {
+              lcd->write(this->cells[r][cursor++]);
+              sends++;
+            }
+          }
+          lcd->write(this->cells[r][c]);
+          sends++;
+          this->shown[r][c] = this->cells[r][c];
+          cursor = c + 1;
+        }
+      }
+
+      this->lastFlushBytes = sends * LCD_I2C_BYTES_PER_SEND;
+      #ifdef DEBUG_UI
+        Serial.print(F("UI::Flush - "));
+        Serial.print(sends);
+        Serial.print(F(" sends, "));
+        Serial.print(this->lastFlushBytes);
+        Serial.println(F(" I2C bytes"));
+      #endif
+    }
+
+    int getLastFlushBytes() {
+      return this->lastFlushBytes;
+    }
+};
@@ -0,0 +1,197 @@
+/*
+ * Incuvers persistence service.
+ *
+ * Anything that needs to survive a reboot registers the RAM copy of its region here, and marks it dirty when it
+ * changes instead of writing the EEPROM itself.  Once nothing has changed for a quiet period the dirty regions are
+ * written out one byte per tick, and only when the EEPROM is ready, so saving never stalls the loop for the ~3.3ms an
+ * EEPROM write takes.  Bytes which already match aren't written.  A region is copied when its flush starts and written
+ * from the copy, so an owner changing it without marking it dirty can't get a value half old and half new saved.  A
+ * region which is marked dirty while it is being written is started over once things are quiet again.
+ *
+ * A region is either a plain EEPROM mirror at a fixed address, or a record kept in an IncuversSettingsStore ring.
+ */
+#define PERSIST_MAX_REGIONS 8     // Five are registered: settings, two gas meters, the profile and the sensor table
+#define PERSIST_NO_REGION 0xFF    // What RegisterRegion() returns once they're all taken
+#define PERSIST_MAX_REGION_SIZE 80 // The largest is the sensor table, 74 bytes
+
+struct PersistRegion {
+  const byte* data;               // RAM copy of the region
+  int address;                    // Where it lives in the EEPROM (-1 = in the settings store)
+  byte size;
+  byte version;                   // Layout version, for the settings store
+  boolean dirty;
+};
+
+class IncuversPersistence {
+  private:
+    PersistRegion regions[PERSIST_MAX_REGIONS];
+    byte regionCount;
+    IncuversSettingsStore* store;
+
+    unsigned long lastChange;       // When a region was last marked dirty
+    int flushRegion;                // Region being written (-1 = none)
+    byte flushOffset;               // Next byte of a plain region to write
+    byte flushData[PERSIST_MAX_REGION_SIZE]; // The region as it was when its flush started
+    unsigned long writeCount;       // EEPROM cells written since startup
+
+    int NextDirtyRegion() {
+      for (byte i = 0; i < this->regionCount; i++) {
+        if (this->regions[i].dirty) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    void StartFlush(int region) {
+      #ifdef DEBUG_EEPROM
+        Serial.print(F("Persist: flushing "));
+        Serial.println(region);
+      #endif
+      this->flushRegion = region;
+      this->flushOffset = 0;
+      this->regions[region].dirty = false;
+      memcpy(this->flushData, this->regions[region].data, this->regions[region].size);
+      if (this->regions[region].address < 0) {
+        if (!this->store->BeginSave(this->flushData, this->regions[region].size, this->regions[region].version)) {
+          this->flushRegion = -1;     // Nothing changed
+        }
+      }
+    }
+
+    boolean FlushStep() {
+      // One write at most, returns true once the region is written.
+      PersistRegion* r = &this->regions[this->flushRegion];
+
+      if (r->address < 0) {
+        int before = this->store->getLastWriteCount();
+        boolean done = this->store->SaveStep();
+        this->writeCount += this->store->getLastWriteCount() - before;
+        return done;
+      }
+
+      while (this->flushOffset < r->size) {
+        int cell = r->address + this->flushOffset;
+        if (EEPROM.read(cell) != this->flushData[this->flushOffset]) {
+          if (!eeprom_is_ready()) {
+            return false;
+          }
+          EEPROM.write(cell, this->flushData[this->flushOffset]);
+          this->writeCount++;
+          this->flushOffset++;
+          return this->flushOffset >= r->size;
+        }
+        this->flushOffset++;
+      }
+      return true;
+    }
+
+  public:
+    void SetupPersistence(IncuversSettingsStore* iStore) {
+      this->store = iStore;
+      this->regionCount = 0;
+      this->flushRegion = -1;
+      this->lastChange = 0;
+      this->writeCount = 0;
+    }
+
+    byte RegisterRegion(const void* data, int address, byte size) {
+      // Returns the id to mark the region dirty with.  Only called from setup, so running out or a region too large is
+      // a build problem: it's reported at boot and the region is never saved.
+      if (this->regionCount >= PERSIST_MAX_REGIONS) {
+        Serial.println(F("Persist: out of regions, raise PERSIST_MAX_REGIONS"));
+        return PERSIST_NO_REGION;
+      }
+      if (size > PERSIST_MAX_REGION_SIZE) {
+        Serial.println(F("Persist: region too large, raise PERSIST_MAX_REGION_SIZE"));
+        return PERSIST_NO_REGION;
+      }
+      PersistRegion* r = &this->regions[this->regionCount];
+      r->data = (const byte*)data;
+      r->address = address;
+      r->size = size;
+      r->version = 0;
+      r->dirty = false;
+      return this->regionCount++;
+    }
+
+    byte RegisterStoreRegion(const void* data, byte size, byte version) {
+      byte id = this->RegisterRegion(data, -1, size);
+      if (id != PERSIST_NO_REGION) {
+        this->regions[id].version = version;
+      }
+      return id;
+    }
+
+    void MoveRegion(byte region, int address) {
+      // Points a plain region somewhere else.  If it's still waiting to be written, or half written, it's finished at
+      // the old address first; only this region, so at most its size in EEPROM writes, the others stay queued.
+      if (region == PERSIST_NO_REGION) {
+        return;
+      }
+      PersistRegion* r = &this->regions[region];
+      if (r->dirty || this->flushRegion == region) {
+        for (byte i = 0; i < r->size; i++) {
+          if (EEPROM.read(r->address + i) != r->data[i]) {
+            EEPROM.write(r->address + i, r->data[i]);
+            this->writeCount++;
+          }
+        }
+        r->dirty = false;
+        if (this->flushRegion == region) {
+          this->flushRegion = -1;
+        }
+      }
+      r->address = address;
+    }
+
+    void MarkDirty(byte region) {
+      if (region == PERSIST_NO_REGION) {
+        return;
+      }
+      this->regions[region].dirty = true;
+      this->lastChange = millis();
+      if (this->flushRegion == region) {
+        // Start it over once things are quiet again rather than write half old, half new.
+        this->flushRegion = -1;
+      }
+    }
+
+    void DoTick() {
+      if (this->flushRegion < 0) {
+        if (millis() - this->lastChange < PERSIST_QUIET_PERIOD) {
+          return;
+        }
+        int region = this->NextDirtyRegion();
+        if (region < 0) {
+          return;
+        }
+        this->StartFlush(region);
+        if (this->flushRegion < 0) {
+          return;
+        }
+      }
+      if (this->FlushStep()) {
+        this->flushRegion = -1;
+      }
+    }
+
+    void FlushAll() {
+      // Blocking, for when we are about to reset.
+      while (this->flushRegion >= 0 || this->NextDirtyRegion() >= 0) {
+        if (this->flushRegion < 0) {
+          this->StartFlush(this->NextDirtyRegion());
+        } else if (this->FlushStep()) {
+          this->flushRegion = -1;
+        }
+      }
+    }
+
+    boolean isIdle() {
+      return this->flushRegion < 0 && this->NextDirtyRegion() < 0;
+    }
+
+    unsigned long getWriteCount() {
+      return this->writeCount;
+    }
+};
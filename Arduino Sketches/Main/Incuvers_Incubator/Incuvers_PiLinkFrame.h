@@ -0,0 +1,378 @@
+/*
+ * Incuvers PiLink frames.
+ *
+ * What goes over the PiLink serial port, shared with the host decoder in Support/IncuversPiLink.  A frame is the schema
+ * version, the frame type and the payload for that type, then a CRC16 of all of those (low byte first).  It goes out
+ * COBS encoded, so it holds no zeros, and a zero ends it: a receiver can start listening anywhere, it drops what it has
+ * at each zero, and a frame which was cut short or corrupted fails its CRC and is ignored.
+ *
+ * Payloads are packed structs of fixed width fields, little endian (as the AVR and the Pi both are), and the host
+ * includes this packed the way avr-gcc lays it out.  Readings are fixed point: temperatures and gas levels in
+ * hundredths, duties in ten thousandths.  A receiver ignores a schema version it doesn't know, so a change to a payload
+ * means a new PILINK_SCHEMA_VERSION; new frame types can be added without one, receivers drop types they don't know.
+ *
+ * How often the status is sent is up to the Pi (PILINK_FRAME_PUBLISH): at a fixed rate, when it changes, or only when
+ * asked for.  "Changes" is PiLinkStatusChanged(): anything discrete, or a reading which has moved more than its deadband
+ * from what was last sent, so sensor noise doesn't count.  Whatever the mode, a heartbeat goes when nothing else has for
+ * PILINK_HEARTBEAT_INTERVAL, so the Pi can tell a quiet unit from a dead link.
+ *
+ * The Pi can also send commands, each with a sequence number, and every command is answered with an ack carrying the
+ * same number and the result.  A command which arrives again with the sequence number of the last one is a resend
+ * (its ack was lost): it isn't carried out again, the ack is just sent again.
+ */
+#define PILINK_SCHEMA_VERSION 1
+#define PILINK_ENCODED_SIZE (PILINK_FRAME_SIZE + PILINK_FRAME_SIZE / 254 + 2)  // COBS codes and the ending zero
+
+#define PILINK_FRAME_HELLO 1        // Unit to Pi, at the default rate until a faster one has been agreed
+#define PILINK_FRAME_STATUS 2       // Unit to Pi
+#define PILINK_FRAME_BAUD 3         // Pi to unit asks for a rate, the unit answers with the rate it will use
+#define PILINK_FRAME_PUBLISH 4      // Pi to unit sets how the status is published, the unit answers with what it took
+#define PILINK_FRAME_REQUEST 5      // Pi to unit asks for a status now, no payload
+#define PILINK_FRAME_HEARTBEAT 6    // Unit to Pi
+#define PILINK_FRAME_COMMAND 7      // Pi to unit
+#define PILINK_FRAME_ACK 8          // Unit to Pi, the answer to a command
+#define PILINK_FRAME_STATS 9        // Unit to Pi, follows the ack to PILINK_COMMAND_STATS
+
+#define PILINK_PUBLISH_RATE 0       // Every interval
+#define PILINK_PUBLISH_CHANGE 1     // When it changes, at most every interval and at least every PILINK_REFRESH_INTERVAL
+#define PILINK_PUBLISH_REQUEST 2    // Only when the Pi asks
+
+#define PILINK_COMMAND_SET_TEMPERATURE 1  // value is the set point, PILINK_SCALE_LEVEL
+#define PILINK_COMMAND_SET_CO2 2
+#define PILINK_COMMAND_SET_O2 3
+#define PILINK_COMMAND_HEAT_MODE 4        // value is the mode, one the menu offers
+#define PILINK_COMMAND_FAN_MODE 5
+#define PILINK_COMMAND_CO2_MODE 6
+#define PILINK_COMMAND_O2_MODE 7
+#define PILINK_COMMAND_LIGHT_MODE 8
+#define PILINK_COMMAND_SAVE 9             // Keep the settings over a reset, as "Save" in the menu
+#define PILINK_COMMAND_ACK_ALARM 10       // As a button press while the alarm sounds, value 1 in the ack if it was
+#define PILINK_COMMAND_STATS 11
+
+#define PILINK_RESULT_OK 0
+#define PILINK_RESULT_LIMITED 1     // Set, but held to the range the menu allows, the ack's value is what was set
+#define PILINK_RESULT_REFUSED 2     // Not a value the menu allows
+#define PILINK_RESULT_BUSY 3        // Someone is in the menu on the unit
+#define PILINK_RESULT_UNKNOWN 4     // Not a command this firmware has
+
+#define PILINK_SCALE_LEVEL 100      // Temperatures and gas levels
+#define PILINK_SCALE_DUTY 10000     // Learned duties, 0 to 1
+
+#define PILINK_FLAG_DOOR_ON 0x0001
+#define PILINK_FLAG_DOOR_STEPPING 0x0002
+#define PILINK_FLAG_CHAMBER_ON 0x0004
+#define PILINK_FLAG_CHAMBER_STEPPING 0x0008
+#define PILINK_FLAG_CO2_OPEN 0x0010
+#define PILINK_FLAG_CO2_STEPPING 0x0020
+#define PILINK_FLAG_O2_OPEN 0x0040
+#define PILINK_FLAG_O2_STEPPING 0x0080
+#define PILINK_FLAG_HEAT_ALARMED 0x0100
+#define PILINK_FLAG_CO2_ALARMED 0x0200
+#define PILINK_FLAG_O2_ALARMED 0x0400
+#define PILINK_FLAG_CHAMBER_DEGRADED 0x0800
+#define PILINK_FLAG_CO2_DEGRADED 0x1000
+#define PILINK_FLAG_CHAMBER_WARMING_UP 0x2000
+#define PILINK_FLAG_CO2_METER 0x4000     // A PiLinkGasMeter for CO2 follows the status
+#define PILINK_FLAG_N_METER 0x8000       // A PiLinkGasMeter for N2 follows the status (and the CO2 one, if any)
+#define PILINK_FLAG_OUTPUTS 0x00FF       // Heaters and valves, which switch all the time
+
+struct PiLinkHello {
+  int16_t serial;
+  uint32_t maxBaud;                 // Fastest rate the unit will switch to
+};
+
+struct PiLinkBaud {
+  uint32_t baud;
+};
+
+struct PiLinkPublish {
+  uint8_t mode;                     // PILINK_PUBLISH_
+  uint16_t interval;                // ms
+  uint16_t levelDeadband;           // PILINK_SCALE_LEVEL, temperatures and gas levels
+  uint16_t dutyDeadband;            // PILINK_SCALE_DUTY
+};
+
+struct PiLinkHeartbeat {
+  uint32_t uptime;                  // ms
+  uint16_t statusFrames;            // Sent since startup, wraps
+  uint16_t badFrames;               // Received from the Pi and dropped, wraps
+};
+
+struct PiLinkCommand {
+  uint8_t sequence;
+  uint8_t command;                  // PILINK_COMMAND_
+  int16_t value;
+};
+
+struct PiLinkAck {
+  uint8_t sequence;                 // Of the command
+  uint8_t command;
+  uint8_t result;                   // PILINK_RESULT_
+  int16_t value;
+};
+
+struct PiLinkStats {
+  uint8_t sequence;                 // Of the command which asked
+  uint32_t uptime;                  // ms
+  uint16_t freeMemory;
+  uint32_t eepromWrites;            // Bytes written since startup
+  uint32_t powerDeferred;           // Outputs held back by the power budget
+  uint32_t statusLinesDropped;      // USB status lines the host didn't take
+  uint32_t framesGood;              // Received from the Pi
+  uint32_t framesBad;
+  uint16_t commands;                // Carried out, resends not counted
+  uint16_t commandsRefused;         // Answered with anything but PILINK_RESULT_OK or PILINK_RESULT_LIMITED
+  uint16_t statusFrames;
+  uint8_t alarmTransitions;         // In the alarm history
+};
+
+struct PiLinkStatus {
+  uint32_t uptime;                  // ms
+  int16_t serial;
+  // Modes and set points
+  uint8_t fanMode;
+  uint8_t heatMode;
+  uint8_t CO2Mode;
+  uint8_t O2Mode;
+  uint8_t lightMode;
+  int16_t heatSetPoint;             // C, PILINK_SCALE_LEVEL
+  int16_t CO2SetPoint;              // %, PILINK_SCALE_LEVEL
+  int16_t O2SetPoint;
+  // Readings
+  int16_t chamberTemp;
+  int16_t doorTemp;
+  int16_t otherTemp;
+  int16_t CO2Level;
+  int16_t O2Level;
+  // Outputs, alarms and controller state
+  uint16_t flags;                   // PILINK_FLAG_
+  char lightIndicator;
+  uint16_t chamberDuty;             // PILINK_SCALE_DUTY
+  uint16_t CO2Duty;
+  int16_t warmUpTime;               // s (-1 = none yet)
+  // Door events, profile
+  uint8_t doorState;
+  uint16_t doorEvents;
+  int16_t doorOpenTime;             // s
+  int16_t doorRecoveryTime;         // s
+  int8_t profileSegment;            // -1 = none
+  // Debugging
+  uint16_t freeMemory;
+};
+
+struct PiLinkGasMeter {
+  uint32_t openSeconds;
+  uint32_t pulseCount;
+  uint32_t volume;                  // mL
+  uint16_t rate;                    // mL/h
+  int16_t hoursToEmpty;             // -1 = not known yet
+};
+
+uint16_t PiLinkUpdateCRC(uint16_t crc, byte data) {
+  // CRC16-CCITT, as the settings store uses
+  crc ^= data;
+  for (byte b = 0; b < 8; b++) {
+    if (crc & 1) {
+      crc = (crc >> 1) ^ 0x8408;
+    } else {
+      crc = crc >> 1;
+    }
+  }
+  return crc;
+}
+
+int16_t PiLinkFixed(float value, int scale) {
+  // Rounded, and held at the ends of the range rather than wrapping.
+  float scaled = value * scale + (value < 0 ? -0.5 : 0.5);
+  if (scaled >= 32767) {
+    return 32767;
+  }
+  if (scaled <= -32767) {
+    return -32767;
+  }
+  return (int16_t)scaled;
+}
+
+int16_t PiLinkClamp(long value) {
+  return value > 32767 ? 32767 : (value < -32767 ? -32767 : value);
+}
+
+uint16_t PiLinkClampUnsigned(unsigned long value) {
+  return value > 65535 ? 65535 : value;
+}
+
+boolean PiLinkMoved(int16_t last, int16_t now, uint16_t deadband) {
+  long change = (long)now - last;
+  return change > deadband || change < -(long)deadband;
+}
+
+boolean PiLinkStatusChanged(const PiLinkStatus* last, const PiLinkStatus* now, const PiLinkPublish* publish) {
+  // Anything discrete which differs from what was last sent, or a reading which has moved past its deadband.  The
+  // uptime and free memory don't count, nor do the outputs (their duties do) or the gas meters; they catch up with the
+  // next status to go.
+  if (now->fanMode != last->fanMode || now->heatMode != last->heatMode || now->CO2Mode != last->CO2Mode
+      || now->O2Mode != last->O2Mode || now->lightMode != last->lightMode || now->heatSetPoint != last->heatSetPoint
+      || now->CO2SetPoint != last->CO2SetPoint || now->O2SetPoint != last->O2SetPoint
+      || (now->flags & ~PILINK_FLAG_OUTPUTS) != (last->flags & ~PILINK_FLAG_OUTPUTS)
+      || now->lightIndicator != last->lightIndicator || now->warmUpTime != last->warmUpTime
+      || now->doorState != last->doorState || now->doorEvents != last->doorEvents
+      || now->doorOpenTime != last->doorOpenTime || now->doorRecoveryTime != last->doorRecoveryTime
+      || now->profileSegment != last->profileSegment) {
+    return true;
+  }
+  return PiLinkMoved(last->chamberTemp, now->chamberTemp, publish->levelDeadband)
+    || PiLinkMoved(last->doorTemp, now->doorTemp, publish->levelDeadband)
+    || PiLinkMoved(last->otherTemp, now->otherTemp, publish->levelDeadband)
+    || PiLinkMoved(last->CO2Level, now->CO2Level, publish->levelDeadband)
+    || PiLinkMoved(last->O2Level, now->O2Level, publish->levelDeadband)
+    || PiLinkMoved(last->chamberDuty, now->chamberDuty, publish->dutyDeadband)
+    || PiLinkMoved(last->CO2Duty, now->CO2Duty, publish->dutyDeadband);
+}
+
+class PiLinkFrameWriter {
+  // COBS encodes a frame straight into the output as it's put together: each run of non-zero bytes is preceded by a
+  // code, its length + 1, which is filled in when the run ends.
+  private:
+    byte* out;
+    byte length;
+    byte codeAt;                    // Where the code for the current run goes
+    uint16_t crc;
+
+    void Stuff(byte c) {
+      if (c != 0) {
+        this->out[this->length++] = c;
+      }
+      if (c == 0 || this->length - this->codeAt == 0xFF) {
+        this->out[this->codeAt] = this->length - this->codeAt;
+        this->codeAt = this->length++;
+      }
+    }
+
+  public:
+    void Start(byte* out, byte type) {
+      // out has to hold PILINK_ENCODED_SIZE
+      this->out = out;
+      this->length = 1;
+      this->codeAt = 0;
+      this->crc = 0xFFFF;
+      this->Put(PILINK_SCHEMA_VERSION);
+      this->Put(type);
+    }
+
+    void Put(byte c) {
+      this->crc = PiLinkUpdateCRC(this->crc, c);
+      this->Stuff(c);
+    }
+
+    void Put(const void* data, byte size) {
+      for (byte i = 0; i < size; i++) {
+        this->Put(((const byte*)data)[i]);
+      }
+    }
+
+    byte Finish() {
+      // The length of the encoded frame, ending zero included.
+      uint16_t crc = this->crc;
+      this->Stuff(crc & 0xFF);
+      this->Stuff(crc >> 8);
+      this->out[this->codeAt] = this->length - this->codeAt;
+      this->out[this->length++] = 0;
+      return this->length;
+    }
+};
+
+class PiLinkFrameReader {
+  // Takes the port a byte at a time.  Bytes are kept until a zero, then decoded in place (the decoded frame is never
+  // longer) and checked.
+  private:
+    byte buffer[PILINK_ENCODED_SIZE];
+    byte length;
+    byte frameLength;               // Decoded, of the last good frame
+    boolean overrun;                // Too long for a frame, dropping up to the next zero
+    unsigned long goodFrames;
+    unsigned long badFrames;
+
+    boolean Decode() {
+      byte in = 0;
+      byte out = 0;
+      while (in < this->length) {
+        byte code = this->buffer[in++];
+        if (code == 0 || in + code - 1 > this->length) {
+          return false;
+        }
+        for (byte i = 1; i < code; i++) {
+          this->buffer[out++] = this->buffer[in++];
+        }
+        if (code != 0xFF && in < this->length) {
+          this->buffer[out++] = 0;
+        }
+      }
+      if (out < 4 || this->buffer[0] != PILINK_SCHEMA_VERSION) {
+        return false;
+      }
+      uint16_t crc = 0xFFFF;
+      for (byte i = 0; i < out - 2; i++) {
+        crc = PiLinkUpdateCRC(crc, this->buffer[i]);
+      }
+      if (this->buffer[out - 2] != (crc & 0xFF) || this->buffer[out - 1] != (crc >> 8)) {
+        return false;
+      }
+      this->frameLength = out;
+      return true;
+    }
+
+  public:
+    void Setup() {
+      this->length = 0;
+      this->frameLength = 0;
+      this->overrun = false;
+      this->goodFrames = 0;
+      this->badFrames = 0;
+    }
+
+    boolean Add(byte c) {
+      // True when c completes a good frame, which can be read until the next call.
+      if (c != 0) {
+        if (this->length < PILINK_ENCODED_SIZE) {
+          this->buffer[this->length++] = c;
+        } else {
+          this->overrun = true;
+        }
+        return false;
+      }
+      boolean good = false;
+      if (this->overrun) {
+        this->badFrames++;
+      } else if (this->length > 0) {
+        good = this->Decode();
+        if (good) {
+          this->goodFrames++;
+        } else {
+          this->badFrames++;
+        }
+      }
+      this->length = 0;
+      this->overrun = false;
+      return good;
+    }
+
+    byte getType() {
+      return this->buffer[1];
+    }
+
+    byte* getPayload() {
+      return this->buffer + 2;
+    }
+
+    byte getPayloadLength() {
+      return this->frameLength - 4;
+    }
+
+    unsigned long getGoodFrames() {
+      return this->goodFrames;
+    }
+
+    unsigned long getBadFrames() {
+      return this->badFrames;
+    }
+};
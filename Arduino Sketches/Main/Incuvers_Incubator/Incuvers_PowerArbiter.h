@@ -0,0 +1,209 @@
+/*
+ * Incuvers power arbiter.
+ *
+ * Every high-current output (heaters, gas solenoids, fan and light) is switched through the arbiter, which knows the
+ * draw of each output and keeps the sum of everything that is on below the configured budget.  Requests that don't fit
+ * may pause a less urgent, preemptible, output (its owner re-requests it on every tick), otherwise they are deferred
+ * and retried on the next tick.  A waiting request is never overtaken by a less urgent one.
+ */
+#define POWER_CH_HEATCHAMBER 0
+#define POWER_CH_HEATDOOR 1
+#define POWER_CH_CO2 2
+#define POWER_CH_N 3
+#define POWER_CH_FAN 4
+#define POWER_CH_LIGHT 5
+#define POWER_CH_COUNT 6
+
+struct PowerChannel {
+  int pin;
+  int draw;                       // Current drawn while on, in mA
+  boolean on;
+  boolean preemptible;            // Can be paused in favour of a more urgent request
+  byte urgency;                   // Urgency of the request which holds the channel on
+  byte pendingUrgency;            // Urgency of a deferred request (0 = nothing waiting)
+  unsigned long pendingSince;     // When the deferred request was last made
+};
+
+class IncuversPowerArbiter {
+  private:
+    PowerChannel channels[POWER_CH_COUNT];
+    int budget;                     // Peak current allowed, in mA
+    int currentDraw;                // Sum of the draw of every channel currently on
+    int peakDraw;                   // Highest draw seen since startup
+    unsigned long lastGrant;        // When a channel was last switched on, used to stagger inrush
+    unsigned long deferredCount;    // Number of requests we had to defer
+    unsigned long preemptedCount;   // Number of times a channel was paused for a more urgent one
+
+    boolean IsOutranked(byte ch, byte urgency, unsigned long nowTime) {
+      // Would granting this request take the room a more urgent waiting request needs?
+      for (byte i = 0; i < POWER_CH_COUNT; i++) {
+        if (i != ch && !this->channels[i].on && this->channels[i].pendingUrgency > urgency && nowTime - this->channels[i].pendingSince < POWER_REQUEST_HOLD) {
+          if (this->currentDraw + this->channels[ch].draw + this->channels[i].draw > this->budget) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    boolean PreemptFor(byte ch, byte urgency) {
+      // Pause the least urgent preemptible channels until the request fits, if that's possible.
+      int freeable = 0;
+      for (byte i = 0; i < POWER_CH_COUNT; i++) {
+        if (i != ch && this->channels[i].on && this->channels[i].preemptible && this->channels[i].urgency < urgency) {
+          freeable += this->channels[i].draw;
+        }
+      }
+      if (this->currentDraw - freeable + this->channels[ch].draw > this->budget) {
+        return false;
+      }
+
+      while (this->currentDraw + this->channels[ch].draw > this->budget) {
+        byte victim = POWER_CH_COUNT;
+        for (byte i = 0; i < POWER_CH_COUNT; i++) {
+          if (i != ch && this->channels[i].on && this->channels[i].preemptible && this->channels[i].urgency < urgency) {
+            if (victim == POWER_CH_COUNT || this->channels[i].urgency < this->channels[victim].urgency) {
+              victim = i;
+            }
+          }
+        }
+        #ifdef DEBUG_POWER
+          Serial.print(F("Power::Preempt "));
+          Serial.print(victim);
+          Serial.print(F(" for "));
+          Serial.println(ch);
+        #endif
+        this->Release(victim);
+        this->preemptedCount++;
+      }
+      return true;
+    }
+
+    void SwitchOn(byte ch, byte urgency, unsigned long nowTime) {
+      digitalWrite(this->channels[ch].pin, HIGH);
+      this->channels[ch].on = true;
+      this->channels[ch].urgency = urgency;
+      this->channels[ch].pendingUrgency = 0;
+      this->currentDraw += this->channels[ch].draw;
+      if (this->currentDraw > this->peakDraw) {
+        this->peakDraw = this->currentDraw;
+      }
+      this->lastGrant = nowTime;
+    }
+
+  public:
+    void SetupArbiter(int peakBudget) {
+      this->budget = peakBudget;
+      this->currentDraw = 0;
+      this->peakDraw = 0;
+      this->lastGrant = 0;
+      this->deferredCount = 0;
+      this->preemptedCount = 0;
+      for (byte i = 0; i < POWER_CH_COUNT; i++) {
+        this->channels[i].pin = -1;
+        this->channels[i].draw = 0;
+        this->channels[i].on = false;
+        this->channels[i].preemptible = false;
+        this->channels[i].pendingUrgency = 0;
+      }
+    }
+
+    void RegisterChannel(byte ch, int pin, int draw, boolean preemptible) {
+      #ifdef DEBUG_POWER
+        Serial.print(F("Power::Register "));
+        Serial.print(ch);
+        Serial.print(F(" on "));
+        Serial.print(pin);
+        Serial.print(F(" @ "));
+        Serial.print(draw);
+        Serial.println(F("mA"));
+      #endif
+      this->Release(ch);
+      this->channels[ch].pin = pin;
+      this->channels[ch].draw = draw;
+      this->channels[ch].preemptible = preemptible;
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+    }
+
+    boolean RequestOn(byte ch, byte urgency) {
+      unsigned long nowTime = millis();
+
+      if (this->channels[ch].pin < 0) {
+        return false;
+      }
+      if (urgency == 0) {
+        urgency = 1;
+      }
+      if (this->channels[ch].on) {
+        // Already granted, make sure the output is still driven.
+        digitalWrite(this->channels[ch].pin, HIGH);
+        this->channels[ch].urgency = urgency;
+        return true;
+      }
+
+      if (nowTime - this->lastGrant >= POWER_STAGGER_DELAY && !this->IsOutranked(ch, urgency, nowTime)) {
+        if (this->currentDraw + this->channels[ch].draw <= this->budget || this->PreemptFor(ch, urgency)) {
+          this->SwitchOn(ch, urgency, nowTime);
+          return true;
+        }
+      }
+
+      #ifdef DEBUG_POWER
+        Serial.print(F("Power::Deferred "));
+        Serial.print(ch);
+        Serial.print(F(" ("));
+        Serial.print(urgency);
+        Serial.print(F(") @ "));
+        Serial.print(this->currentDraw);
+        Serial.println(F("mA"));
+      #endif
+      this->channels[ch].pendingUrgency = urgency;
+      this->channels[ch].pendingSince = nowTime;
+      this->deferredCount++;
+      return false;
+    }
+
+    void ForceOn(byte ch) {
+      // For loads that must run (the fan).  Room is made by pausing preemptible outputs, whose owners then wait for it
+      // like any other deferred request; it only goes over the budget if the outputs which can't be paused are more than
+      // it leaves, and that's a budget too small for the hardware.
+      if (this->channels[ch].pin >= 0 && !this->channels[ch].on) {
+        if (this->currentDraw + this->channels[ch].draw > this->budget) {
+          this->PreemptFor(ch, 255);
+        }
+        this->SwitchOn(ch, 255, millis());
+      }
+    }
+
+    void Release(byte ch) {
+      if (this->channels[ch].pin >= 0) {
+        digitalWrite(this->channels[ch].pin, LOW);
+      }
+      if (this->channels[ch].on) {
+        this->channels[ch].on = false;
+        this->currentDraw -= this->channels[ch].draw;
+      }
+      this->channels[ch].pendingUrgency = 0;
+    }
+
+    boolean isOn(byte ch) {
+      return this->channels[ch].on;
+    }
+
+    int getCurrentDraw() {
+      return this->currentDraw;
+    }
+
+    int getPeakDraw() {
+      return this->peakDraw;
+    }
+
+    unsigned long getDeferredCount() {
+      return this->deferredCount;
+    }
+
+    unsigned long getPreemptedCount() {
+      return this->preemptedCount;
+    }
+};
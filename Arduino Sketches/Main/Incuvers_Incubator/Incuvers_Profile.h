@@ -0,0 +1,208 @@
+/*
+ * Incuvers set point profiles.
+ *
+ * A profile is a short program of segments.  Each segment ramps one set point (temperature, CO2 or O2) in a straight
+ * line from wherever it is when the segment starts to a target level, then holds it there before the next segment
+ * starts; e.g. ramp to 37C over 2h, hold for 30 minutes, then ramp the CO2 to 5% over 10 minutes.  While a segment ramps
+ * the interpolated set point is handed to the settings handler as it changes, so the controllers follow a trickle of
+ * small steps instead of slamming the outputs for one big one.
+ *
+ * Programs are kept in the EEPROM.  The one being run or edited is loaded into RAM and written back through the
+ * persistence service.  A program isn't resumed after a reset, the saved set points are used instead.
+ */
+#define PROFILE_MAX_SEGMENTS 6
+
+#define PROFILE_TARGET_END 0
+#define PROFILE_TARGET_TEMP 1
+#define PROFILE_TARGET_CO2 2
+#define PROFILE_TARGET_O2 3
+
+struct ProfileSegment {
+  uint8_t target;                 // PROFILE_TARGET_*, the first PROFILE_TARGET_END ends the program
+  int16_t level;                  // Level to ramp to, in hundredths as in SettingsStruct
+  uint16_t rampMinutes;           // How long to take getting there
+  uint16_t holdMinutes;           // How long to stay there before the next segment
+};
+
+struct ProfileProgram {
+  byte ident;
+  ProfileSegment segments[PROFILE_MAX_SEGMENTS];
+};
+
+class IncuversProfileRunner {
+  private:
+    IncuversSettingsHandler* incSet;
+    IncuversPersistence* persist;
+    byte persistRegion;
+
+    ProfileProgram program;         // The program being run or edited
+    byte programNumber;             // Which program that is
+
+    boolean running;
+    byte segment;                   // Segment being run
+    boolean holding;                // Ramp done, holding the level
+    unsigned long segmentStartedAt; // When the ramp or the hold started
+    float startLevel;               // Set point when the ramp started
+    unsigned long lastUpdate;
+
+    int GetProgramAddress(byte number) {
+      return PROFILE_ADDRS + number * PROFILE_STRIDE;
+    }
+
+    float GetSetPoint(byte target) {
+      switch (target) {
+        case PROFILE_TARGET_TEMP:
+          return this->incSet->getTemperatureSetPoint();
+        case PROFILE_TARGET_CO2:
+          return this->incSet->getCO2SetPoint();
+        case PROFILE_TARGET_O2:
+          return this->incSet->getO2SetPoint();
+      }
+      return 0;
+    }
+
+    void SetSetPoint(byte target, float level) {
+      switch (target) {
+        case PROFILE_TARGET_TEMP:
+          this->incSet->setTemperatureSetPoint(level);
+          break;
+        case PROFILE_TARGET_CO2:
+          this->incSet->setCO2SetPoint(level);
+          break;
+        case PROFILE_TARGET_O2:
+          this->incSet->setO2SetPoint(level);
+          break;
+      }
+    }
+
+    void StartSegment(unsigned long nowTime) {
+      if (this->segment >= PROFILE_MAX_SEGMENTS || this->program.segments[this->segment].target == PROFILE_TARGET_END) {
+        this->running = false;
+        #ifdef DEBUG_PROFILE
+          Serial.println(F("Profile done"));
+        #endif
+        return;
+      }
+      this->startLevel = this->GetSetPoint(this->program.segments[this->segment].target);
+      this->holding = false;
+      this->segmentStartedAt = nowTime;
+      this->lastUpdate = 0;
+      #ifdef DEBUG_PROFILE
+        Serial.print(F("Profile segment "));
+        Serial.println(this->segment + 1);
+      #endif
+    }
+
+  public:
+    void SetupProfile(IncuversSettingsHandler* iSettings) {
+      this->incSet = iSettings;
+      this->persist = iSettings->getPersistence();
+      this->running = false;
+      this->persistRegion = this->persist->RegisterRegion(&this->program, this->GetProgramAddress(0), sizeof(this->program));
+      this->LoadProgram(0);
+    }
+
+    boolean LoadProgram(byte number) {
+      // Not while running, the program in RAM is the one being run.  False when refused.
+      if (this->running) {
+        return false;
+      }
+      this->persist->MoveRegion(this->persistRegion, this->GetProgramAddress(number));
+      this->programNumber = number;
+      eeprom_read_block(&this->program, (const void*)(intptr_t)this->GetProgramAddress(number), sizeof(this->program));
+      if (this->program.ident != PROFILE_IDENT) {
+        #ifdef DEBUG_EEPROM
+          Serial.print(F("No profile "));
+          Serial.print(number + 1);
+          Serial.println(F(", starting empty"));
+        #endif
+        memset(&this->program, 0, sizeof(this->program));
+        this->program.ident = PROFILE_IDENT;
+      }
+      return true;
+    }
+
+    void SaveProgram() {
+      this->persist->MarkDirty(this->persistRegion);
+    }
+
+    void Start() {
+      this->running = true;
+      this->segment = 0;
+      this->StartSegment(millis());
+    }
+
+    void Stop() {
+      // The set points stay wherever the program got them to.
+      if (this->running) {
+        this->running = false;
+        #ifdef DEBUG_PROFILE
+          Serial.println(F("Profile stopped"));
+        #endif
+      }
+    }
+
+    void DoTick() {
+      unsigned long nowTime = millis();
+
+      if (!this->running || nowTime - this->lastUpdate < PROFILE_TICK_PERIOD) {
+        return;
+      }
+      this->lastUpdate = nowTime;
+
+      ProfileSegment* s = &this->program.segments[this->segment];
+      unsigned long elapsed = nowTime - this->segmentStartedAt;
+
+      if (this->holding) {
+        if (elapsed >= s->holdMinutes * 60000UL) {
+          this->segment++;
+          this->StartSegment(nowTime);
+        }
+        return;
+      }
+
+      float level = s->level / (float)SETTINGS_FIXED_SCALE;
+      unsigned long rampTime = s->rampMinutes * 60000UL;
+      if (elapsed >= rampTime) {
+        this->holding = true;
+        this->segmentStartedAt = nowTime;
+      } else {
+        level = this->startLevel + (level - this->startLevel) * elapsed / rampTime;
+      }
+
+      // Only pass it on once it has moved by the resolution of the set point.
+      if ((long)(level * SETTINGS_FIXED_SCALE + 0.5) != (long)(this->GetSetPoint(s->target) * SETTINGS_FIXED_SCALE + 0.5)) {
+        #ifdef DEBUG_PROFILE
+          Serial.print(F("Profile :: "));
+          Serial.print(s->target);
+          Serial.print(F(" -> "));
+          Serial.println(level, 2);
+        #endif
+        this->SetSetPoint(s->target, level);
+      }
+    }
+
+    ProfileSegment* getSegment(byte index) {
+      return &this->program.segments[index];
+    }
+
+    byte getProgramNumber() {
+      return this->programNumber;
+    }
+
+    boolean isRunning() {
+      return this->running;
+    }
+
+    int getRunningSegment() {
+      // -1 when no program is running
+      if (!this->running) {
+        return -1;
+      }
+      return this->segment;
+    }
+
+    boolean isHolding() {
+      return this->running && this->holding;
+    }
+};
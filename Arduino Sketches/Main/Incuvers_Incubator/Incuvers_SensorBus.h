@@ -0,0 +1,315 @@
+/*
+ * Incuvers OneWire sensor bus.
+ *
+ * Keeps the table of temperature sensors on the OneWire bus, and the role each one plays (door, chamber, ambient or an
+ * extra zone), in the EEPROM.  At boot every sensor in the table is asked to answer; if they all do, the bus isn't
+ * searched.  Otherwise it is, sensors which are still there keep their roles and new ones get one where that can be
+ * worked out:
+ *   - the door and chamber ROMs of the hardware definition, if it has them
+ *   - a single new sensor takes over the door or chamber role when that one is gone, i.e. the sensor was swapped
+ *   - once the door and chamber are known, other new sensors become the ambient sensor, then extra zones
+ * Anything else is left to the guided setup in the menu, which asks for each sensor to be warmed by hand in turn.
+ *
+ * The sensors and their roles are reported on the USB port after boot and after the setup, as one line queued on the
+ * status line, so the report never holds up the loop or lands in the middle of a status line.
+ */
+class IncuversSensorBus {
+  private:
+    SensorTableStruct table;
+    float temps[SENSORTABLE_MAX];   // Last readings, -100 when a sensor didn't give a valid one
+
+    OneWire* oneWire;
+    DallasTemperature* tempSensors;
+    IncuversPersistence* persist;
+    byte persistRegion;
+    boolean reportPending;          // The sensors are to be reported once the status line is free
+
+    int FindROM(byte rom[8]) {
+      for (byte i = 0; i < this->table.count; i++) {
+        if (memcmp(this->table.sensors[i].rom, rom, 8) == 0) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    int CountRole(byte role) {
+      int count = 0;
+      for (byte i = 0; i < this->table.count; i++) {
+        if (this->table.sensors[i].role == role) {
+          count++;
+        }
+      }
+      return count;
+    }
+
+    byte NextZoneRole() {
+      byte role = SENSOR_ROLE_ZONE;
+      for (byte i = 0; i < this->table.count; i++) {
+        if (this->table.sensors[i].role >= role) {
+          role = this->table.sensors[i].role + 1;
+        }
+      }
+      return role;
+    }
+
+    void PrintSensor(Print* out, byte index) {
+      // The ROM in the form the EEPROM image tool takes.
+      out->print(' ');
+      for (byte i = 0; i < 8; i++) {
+        if (this->table.sensors[index].rom[i] < 16) {
+          out->print('0');
+        }
+        out->print(this->table.sensors[index].rom[i], HEX);
+      }
+      out->print(':');
+      this->PrintRoleName(out, this->table.sensors[index].role);
+    }
+
+    boolean LoadTable() {
+      eeprom_read_block(&this->table, (const void*)SENSORTABLE_ADDRS, sizeof(this->table));
+      if (this->table.ident != SENSORTABLE_IDENT || this->table.count == 0 || this->table.count > SENSORTABLE_MAX) {
+        #ifdef DEBUG_TEMP
+          Serial.println(F("SensorBus: no table"));
+        #endif
+        this->table.ident = SENSORTABLE_IDENT;
+        this->table.count = 0;
+        return false;
+      }
+      return true;
+    }
+
+    boolean VerifyTable() {
+      // Every sensor in the table answers with a good scratchpad.
+      for (byte i = 0; i < this->table.count; i++) {
+        if (!this->tempSensors->isConnected(this->table.sensors[i].rom)) {
+          #ifdef DEBUG_TEMP
+            Serial.print(F("SensorBus: no answer from "));
+            Serial.println(i);
+          #endif
+          return false;
+        }
+      }
+      return true;
+    }
+
+    boolean SearchBus() {
+      // Rebuilds the table from what is on the bus, returns true if it changed.
+      SensorTableStruct found;
+      byte rom[8];
+      boolean changed = false;
+
+      memset(&found, 0, sizeof(found));
+      found.ident = SENSORTABLE_IDENT;
+      this->oneWire->reset_search();
+      while (this->oneWire->search(rom) && found.count < SENSORTABLE_MAX) {
+        if (OneWire::crc8(rom, 7) != rom[7] || !this->tempSensors->validFamily(rom)) {
+          continue;
+        }
+        int known = this->FindROM(rom);
+        memcpy(found.sensors[found.count].rom, rom, 8);
+        found.sensors[found.count].role = (known < 0) ? SENSOR_ROLE_NONE : this->table.sensors[known].role;
+        changed = changed || known < 0;
+        found.count++;
+      }
+
+      for (byte i = 0; i < this->table.count; i++) {
+        boolean stillThere = false;
+        for (byte j = 0; j < found.count; j++) {
+          stillThere = stillThere || memcmp(found.sensors[j].rom, this->table.sensors[i].rom, 8) == 0;
+        }
+        if (!stillThere) {
+          #ifdef DEBUG_TEMP
+            Serial.print(F("SensorBus: gone"));
+            this->PrintSensor(&Serial, i);
+            Serial.println();
+          #endif
+          changed = true;
+        }
+      }
+
+      memcpy(&this->table, &found, sizeof(this->table));
+      return changed;
+    }
+
+    void AssignRoles(byte doorROM[8], byte chamberROM[8]) {
+      int unassigned = this->CountRole(SENSOR_ROLE_NONE);
+
+      for (byte i = 0; i < this->table.count; i++) {
+        if (this->table.sensors[i].role != SENSOR_ROLE_NONE) {
+          continue;
+        }
+        if (this->CountRole(SENSOR_ROLE_DOOR) == 0 && memcmp(this->table.sensors[i].rom, doorROM, 8) == 0) {
+          this->table.sensors[i].role = SENSOR_ROLE_DOOR;
+          unassigned--;
+        } else if (this->CountRole(SENSOR_ROLE_CHAMBER) == 0 && memcmp(this->table.sensors[i].rom, chamberROM, 8) == 0) {
+          this->table.sensors[i].role = SENSOR_ROLE_CHAMBER;
+          unassigned--;
+        }
+      }
+
+      if (unassigned == 1 && (this->CountRole(SENSOR_ROLE_DOOR) == 0) != (this->CountRole(SENSOR_ROLE_CHAMBER) == 0)) {
+        // A swapped sensor, it takes the role of the one which is gone.
+        int i = this->FindRole(SENSOR_ROLE_NONE);
+        this->table.sensors[i].role = (this->CountRole(SENSOR_ROLE_DOOR) == 0) ? SENSOR_ROLE_DOOR : SENSOR_ROLE_CHAMBER;
+      }
+
+      if (!this->isSetupNeeded()) {
+        this->AssignLeftovers();
+      }
+    }
+
+    void AssignLeftovers() {
+      for (byte i = 0; i < this->table.count; i++) {
+        if (this->table.sensors[i].role == SENSOR_ROLE_NONE) {
+          this->table.sensors[i].role = (this->CountRole(SENSOR_ROLE_AMBIENT) == 0) ? SENSOR_ROLE_AMBIENT : this->NextZoneRole();
+        }
+      }
+    }
+
+  public:
+    void SetupSensorBus(int oneWirePin, byte doorROM[8], byte chamberROM[8], IncuversPersistence* iPersist) {
+      #ifdef DEBUG_TEMP
+        Serial.println(F("SensorBus::Setup"));
+      #endif
+      this->persist = iPersist;
+      this->reportPending = true;
+      this->persistRegion = this->persist->RegisterRegion(&this->table, SENSORTABLE_ADDRS, sizeof(this->table));
+      this->oneWire = new OneWire(oneWirePin);
+      this->tempSensors = new DallasTemperature(this->oneWire);
+      for (byte i = 0; i < SENSORTABLE_MAX; i++) {
+        this->temps[i] = -100;
+      }
+
+      if (this->LoadTable() && this->VerifyTable()) {
+        #ifdef DEBUG_TEMP
+          Serial.println(F("SensorBus: cached table answered, skipping the search"));
+        #endif
+        // begin() searches the bus itself, it's only needed to find out about parasite powered sensors.
+        for (byte i = 0; i < this->table.count; i++) {
+          if (this->tempSensors->readPowerSupply(this->table.sensors[i].rom)) {
+            this->tempSensors->begin();
+            break;
+          }
+        }
+      } else {
+        this->tempSensors->begin();
+        this->Rescan(doorROM, chamberROM);
+      }
+    }
+
+    void Rescan(byte doorROM[8], byte chamberROM[8]) {
+      if (this->SearchBus()) {
+        this->AssignRoles(doorROM, chamberROM);
+        this->SaveTable();
+      }
+    }
+
+    void SaveTable() {
+      this->persist->MarkDirty(this->persistRegion);
+    }
+
+    void DoTick() {
+      // Sends the report once the status line has nothing going out, never waiting for it.
+      if (!this->reportPending || statusLine.isSending() || !statusLine.Begin()) {
+        return;
+      }
+      statusLine.print(F("Temperature sensors"));
+      for (byte i = 0; i < this->table.count; i++) {
+        this->PrintSensor(&statusLine, i);
+      }
+      if (this->isSetupNeeded()) {
+        statusLine.print(F(" (roles unknown, run the sensor setup)"));
+      }
+      statusLine.println();
+      statusLine.Send();
+      this->reportPending = false;
+    }
+
+    void Update() {
+      // Blocks while the sensors convert, as requestTemperatures() always has.  With no sensors there's nothing to wait for.
+      if (this->table.count == 0) {
+        return;
+      }
+      this->tempSensors->requestTemperatures();
+      for (byte i = 0; i < this->table.count; i++) {
+        float t = this->tempSensors->getTempC(this->table.sensors[i].rom);
+        this->temps[i] = (t > -40.0 && t < 85.0) ? t : -100;
+      }
+    }
+
+    int FindRole(byte role) {
+      // Index of the sensor with the role, -1 when there's none.
+      for (byte i = 0; i < this->table.count; i++) {
+        if (this->table.sensors[i].role == role) {
+          return i;
+        }
+      }
+      return -1;
+    }
+
+    float getRoleTemperature(byte role) {
+      int i = this->FindRole(role);
+      if (i < 0) {
+        return -100;
+      }
+      return this->temps[i];
+    }
+
+    void setRole(byte index, byte role) {
+      // Door, chamber and ambient go to one sensor only, whichever had it before is unassigned.
+      if (role < SENSOR_ROLE_ZONE) {
+        for (byte i = 0; i < this->table.count; i++) {
+          if (this->table.sensors[i].role == role) {
+            this->table.sensors[i].role = SENSOR_ROLE_NONE;
+          }
+        }
+      }
+      this->table.sensors[index].role = role;
+    }
+
+    void FinishSetup() {
+      this->AssignLeftovers();
+      this->SaveTable();
+      this->reportPending = true;
+    }
+
+    void PrintRoleName(Print* out, byte role) {
+      switch (role) {
+        case SENSOR_ROLE_NONE:
+          out->print(UIText(UI_TEXT_ROLE_NONE));
+          return;
+        case SENSOR_ROLE_DOOR:
+          out->print(UIText(UI_TEXT_ROLE_DOOR));
+          return;
+        case SENSOR_ROLE_CHAMBER:
+          out->print(UIText(UI_TEXT_ROLE_CHAMBER));
+          return;
+        case SENSOR_ROLE_AMBIENT:
+          out->print(UIText(UI_TEXT_ROLE_AMBIENT));
+          return;
+      }
+      out->print(UIText(UI_TEXT_ROLE_ZONE));
+      out->print(role - SENSOR_ROLE_ZONE + 1);
+    }
+
+    boolean isSetupNeeded() {
+      return this->FindRole(SENSOR_ROLE_DOOR) < 0 || this->FindRole(SENSOR_ROLE_CHAMBER) < 0;
+    }
+
+    byte getCount() {
+      return this->table.count;
+    }
+
+    byte getRole(byte index) {
+      return this->table.sensors[index].role;
+    }
+
+    float getTemperature(byte index) {
+      return this->temps[index];
+    }
+
+    byte getZoneCount() {
+      return this->NextZoneRole() - SENSOR_ROLE_ZONE;
+    }
+};
@@ -1,61 +1,11 @@
-// Structures
-struct HardwareStruct {
-  byte ident[3];
-  // Identification
-  byte hVer[3];
-  int serial;
-  // Temp settings
-  byte countOfTempSensors;
-  byte sensorAddrDoorTemp[8];
-  byte sensorAddrChamberTemp[8];
-  // CO2 settings
-  bool hasCO2Sensor;
-  byte CO2RxPin;
-  byte CO2TxPin;
-  // O2 settings
-  bool hasO2Sensor;
-  byte O2RxPin;
-  byte O2TxPin;
-  // Gas Relay(s)
-  bool CO2GasRelay;
-  byte CO2RelayPin;
-  bool O2GasRelay;
-  byte O2RelayPin;
-    // PiLink
-  bool piSupport;
-  byte piRxPin;
-  byte piTxPin;
-  // Lighting
-  bool lightingSupport;
-  byte lightPin;
-};
-struct SettingsStruct {
-  byte ident;
-  // Fan settings
-  byte fanMode;       // 0 = off, 1 = on during heat + 30 seconds after, 2 = on during heat + 60 seconds, 3 = on during heat + 50% of time, 4 = on
-  // Temp settings
-  byte heatMode;      // 0 = off, 1 = on
-  float heatSetPoint;
-  // CO2 settings
-  byte CO2Mode;       // 0 = off, 1 = read, 2 = maintain
-  float CO2SetPoint;
-  // O2 settings
-  byte O2Mode;        // 0 = off, 1 = read, 2 = maintain
-  float O2SetPoint;
-  // Lighting
-  byte lightMode;     // 0 = off, 1 = internal timing, 2 = external timing
-  long millisOn;
-  long millisOff;
-  // Alarm settings
-  byte alarmMode;     // 0 = off, 1 = report, 2 = alarm
-  
-};
-
 class IncuversSettingsHandler {
   private:
-    HardwareStruct settingsHardware;
     SettingsStruct settingsHolder;
+    IncuversSettingsStore settingsStore;
   
+    IncuversPersistence* incPersist;
+    byte settingsRegion;
+    IncuversPowerArbiter* incPower;
     IncuversHeatingSystem* incHeat;
     IncuversLightingSystem* incLight;
     IncuversCO2System* incCO2;
@@ -63,6 +13,19 @@ class IncuversSettingsHandler {
     
     int personalityCount;
     
+    byte ReadHardware(int field) {
+      // Use HARDWARE_FIELD() for the offset.
+      return EEPROM.read(HARDWARE_ADDRS + field);
+    }
+
+    int16_t ToFixed(float value) {
+      return (int16_t)(value * SETTINGS_FIXED_SCALE + (value < 0 ? -0.5 : 0.5));
+    }
+
+    float FromFixed(int16_t value) {
+      return value / (float)SETTINGS_FIXED_SCALE;
+    }
+
     int VerifyEEPROMHeader(int startAddress, boolean isHardware) {
       #ifdef DEBUG_EEPROM
         Serial.println(F("VerifyHead"));
@@ -126,83 +89,142 @@ class IncuversSettingsHandler {
         return false;
       } else {
         #ifdef DEBUG_EEPROM
-          Serial.print(F("  The hardwareData ident matched, loading "));
-          Serial.print(sizeof(settingsHardware));
+          Serial.print(F("  The hardwareData ident matched, "));
+          Serial.print(sizeof(HardwareStruct));
           Serial.println(F(" bytes of hardware definitions."));
         #endif
         
-        for (int i = 0; i < sizeof(settingsHardware); i++) {
-          *((char*)&settingsHardware + i) = EEPROM.read(HARDWARE_ADDRS + i);    
-        }
         #ifdef DEBUG_EEPROM
-        Serial.print(settingsHardware.ident[0]);
-        Serial.print(settingsHardware.ident[1]);
-        Serial.println(settingsHardware.ident[2]);
-        // Identification
-        Serial.print(settingsHardware.hVer[0]);
-        Serial.print(settingsHardware.hVer[1]);
-        Serial.println(settingsHardware.hVer[2]);
-        Serial.println(settingsHardware.serial);
-        // Temp settings
-        Serial.println(settingsHardware.countOfTempSensors);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[0]);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[1]);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[2]);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[3]);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[4]);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[5]);
-        Serial.print(settingsHardware.sensorAddrDoorTemp[6]);
-        Serial.println(settingsHardware.sensorAddrDoorTemp[7]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[0]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[1]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[2]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[3]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[4]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[5]);
-        Serial.print(settingsHardware.sensorAddrChamberTemp[6]);
-        Serial.println(settingsHardware.sensorAddrChamberTemp[7]);
-        // CO2 settings
-        Serial.println(settingsHardware.hasCO2Sensor);
-        Serial.println(settingsHardware.CO2RxPin);
-        Serial.println(settingsHardware.CO2TxPin);
-        // O2 settings
-        Serial.println(settingsHardware.hasO2Sensor);
-        Serial.println(settingsHardware.O2RxPin);
-        Serial.println(settingsHardware.O2TxPin);
-        // Gas Relay
-        Serial.println(settingsHardware.firstGasRelay);
-        Serial.println(settingsHardware.gasRelayPin);
-        Serial.println(settingsHardware.secondGasRelay);
-        Serial.println(settingsHardware.gasRelayTwoPin);
-        // PiLink
-        Serial.println(settingsHardware.piSupport);
-        Serial.println(settingsHardware.piRxPin);
-        Serial.println(settingsHardware.piTxPin);
-        // Lighting
-        Serial.println(settingsHardware.lightingSupport);
-        Serial.println(settingsHardware.lightPin);
+        for (unsigned int i = 0; i < sizeof(HardwareStruct); i++) {
+          Serial.print(this->ReadHardware(i), HEX);
+          Serial.print(F(" "));
+        }
+        Serial.println();
         Serial.println(F("/RdHrdwrSet"));
         #endif
         return true;
       }
     }
 
+    boolean MigrateSettings(byte* record, byte version) {
+      // Each step converts one layout into the next, so a record of any older layout walks up the chain to the current
+      // one.  Add a step here, and keep the old layout around, whenever SettingsStruct changes.
+      while (version < SETTINGS_VERSION_CURR) {
+        #ifdef DEBUG_EEPROM
+          Serial.print(F("\tMigrating settings from v"));
+          Serial.println(version);
+        #endif
+        switch (version) {
+          case 1: {
+            // Floats and whole byte modes packed down to fixed point and bitfields.
+            SettingsStructV1 old;
+            SettingsStruct* upgraded = (SettingsStruct*)record;
+            memcpy(&old, record, sizeof(old));
+            if (old.fanMode > 4 || old.heatMode > 1 || old.CO2Mode > 2 || old.O2Mode > 2 || old.lightMode > 2 || old.alarmMode > 2) {
+              return false;   // Wouldn't fit in the bitfields
+            }
+            if (!(old.heatSetPoint >= TEMPERATURE_MIN && old.heatSetPoint <= TEMPERATURE_MAX && old.CO2SetPoint >= CO2_MIN && old.CO2SetPoint <= CO2_MAX && old.O2SetPoint >= OO_MIN && old.O2SetPoint <= OO_MAX)) {
+              return false;   // Or in an int16
+            }
+            upgraded->ident = old.ident;
+            upgraded->fanMode = old.fanMode;
+            upgraded->heatMode = old.heatMode;
+            upgraded->CO2Mode = old.CO2Mode;
+            upgraded->O2Mode = old.O2Mode;
+            upgraded->lightMode = old.lightMode;
+            upgraded->alarmMode = old.alarmMode;
+            upgraded->heatSetPoint = this->ToFixed(old.heatSetPoint);
+            upgraded->CO2SetPoint = this->ToFixed(old.CO2SetPoint);
+            upgraded->O2SetPoint = this->ToFixed(old.O2SetPoint);
+            upgraded->millisOn = old.millisOn;
+            upgraded->millisOff = old.millisOff;
+            break;
+          }
+          default:
+            return false;   // No way forward from this layout
+        }
+        version++;
+      }
+      return version == SETTINGS_VERSION_CURR;
+    }
+
+    boolean ValidateSettings() {
+      // The CRC protects the stored bytes, this protects us from anything that got past it (or a bad migration).
+      if (this->settingsHolder.fanMode > 4 || this->settingsHolder.heatMode > 1 || this->settingsHolder.CO2Mode > 2 || this->settingsHolder.O2Mode > 2 || this->settingsHolder.lightMode > 2 || this->settingsHolder.alarmMode > 2) {
+        return false;
+      }
+      if (this->settingsHolder.heatSetPoint < this->ToFixed(TEMPERATURE_MIN) || this->settingsHolder.heatSetPoint > this->ToFixed(TEMPERATURE_MAX)) {
+        return false;
+      }
+      if (this->settingsHolder.CO2SetPoint < this->ToFixed(CO2_MIN) || this->settingsHolder.CO2SetPoint > this->ToFixed(CO2_MAX)) {
+        return false;
+      }
+      if (this->settingsHolder.O2SetPoint < this->ToFixed(OO_MIN) || this->settingsHolder.O2SetPoint > this->ToFixed(OO_MAX)) {
+        return false;
+      }
+      return true;
+    }
+
     int ReadCurrentSettings() {
+      // Returns 1 when settings were loaded, 2 when none were found or they couldn't be used.
+      byte record[SETTINGSSTORE_PAYLOAD_SIZE];
+      byte version;
+      byte size;
+      boolean legacy = false;
+
       #ifdef DEBUG_EEPROM
         Serial.println(F("ReadSettings"));
-        Serial.print(F("\t"));
-        Serial.print(sizeof(settingsHolder));
-        Serial.print(F(" bytes w/ ID: "));
-        Serial.print(SETTINGS_IDENT_CURR);
-        Serial.print(F(" @ "));
-        Serial.println(SETTINGS_ADDRS);
       #endif
-      
-      for (unsigned int i = 0; i < sizeof(this->settingsHolder); i++) {
-        *((char*)&this->settingsHolder + i) = EEPROM.read(SETTINGS_ADDRS + i);    
+
+      if (this->settingsStore.Load(record)) {
+        version = this->settingsStore.getVersion();
+        size = this->settingsStore.getSize();
+      } else if (this->settingsStore.getBadSlotCount() == 0 &&
+                 VerifyEEPROMHeader((int)SETTINGS_ADDRS, false) == SETTINGS_IDENT_CURR) {
+        // Saved before the store existed, in the version 1 layout and without a CRC.  Only while the ring has never
+        // been written: once it has, this record is out of date, and a ring which is all corrupt means defaults.
+        version = 1;
+        size = sizeof(SettingsStructV1);
+        eeprom_read_block(record, (const void*)SETTINGS_ADDRS, size);
+        legacy = true;
+      } else {
+        #ifdef DEBUG_EEPROM
+          if (this->settingsStore.getBadSlotCount() > 0) {
+            Serial.println(F("Settings corrupt, using defaults"));
+          }
+        #endif
+        return 2;
+      }
+
+      if (!this->MigrateSettings(record, version)) {
+        #ifdef DEBUG_EEPROM
+          Serial.print(F("Settings v"));
+          Serial.print(version);
+          Serial.println(F(" not supported, using defaults"));
+        #endif
+        return 2;
+      }
+      memcpy(&this->settingsHolder, record, sizeof(this->settingsHolder));
+      if (!this->ValidateSettings()) {
+        #ifdef DEBUG_EEPROM
+          Serial.println(F("Settings out of range, using defaults"));
+        #endif
+        return 2;
+      }
+      if (legacy) {
+        // Into the ring straight away, and only once it's there the old record is retired, so a power loss in between
+        // leaves one or the other.
+        this->settingsHolder.ident = SETTINGS_IDENT_CURR;
+        this->settingsStore.Save(&this->settingsHolder, sizeof(this->settingsHolder), SETTINGS_VERSION_CURR);
+        EEPROM.write(SETTINGS_ADDRS, 0);
       }
  
       #ifdef DEBUG_EEPROM
+        Serial.print(F("\tv"));
+        Serial.print(version);
+        Serial.print(F(", "));
+        Serial.print(size);
+        Serial.println(F(" bytes"));
         Serial.println(settingsHolder.ident);
         Serial.println(settingsHolder.fanMode);
         Serial.println(settingsHolder.heatMode);
@@ -232,13 +254,13 @@ class IncuversSettingsHandler {
       this->settingsHolder.fanMode = 4;
       // Heat setup
       this->settingsHolder.heatMode = 1;
-      this->settingsHolder.heatSetPoint = TEMPERATURE_DEF; 
+      this->settingsHolder.heatSetPoint = this->ToFixed(TEMPERATURE_DEF);
       // CO2 setup
       this->settingsHolder.CO2Mode = 2;
-      this->settingsHolder.CO2SetPoint = CO2_DEF; 
+      this->settingsHolder.CO2SetPoint = this->ToFixed(CO2_DEF);
       // O2 setup
       this->settingsHolder.O2Mode = 2;
-      this->settingsHolder.O2SetPoint = OO_DEF; 
+      this->settingsHolder.O2SetPoint = this->ToFixed(OO_DEF);
       // Lighting
       this->settingsHolder.lightMode = 0;
       this->settingsHolder.millisOn =  60000;  // 14 hrs = 50400000 milliseconds
@@ -249,6 +271,20 @@ class IncuversSettingsHandler {
         Serial.println(F("/Defaults"));
       #endif
     }
+
+    void ApplySettings() {
+      // Hands all of settingsHolder to the modules, after it was replaced as a whole once they are attached.
+      this->incHeat->UpdateHeatMode(this->settingsHolder.heatMode);
+      this->incHeat->UpdateFanMode(this->settingsHolder.fanMode);
+      this->incHeat->SetSetPoint(this->FromFixed(this->settingsHolder.heatSetPoint));
+      this->incCO2->UpdateMode(this->settingsHolder.CO2Mode);
+      this->incCO2->SetSetPoint(this->FromFixed(this->settingsHolder.CO2SetPoint));
+      this->incO2->UpdateMode(this->settingsHolder.O2Mode);
+      this->incO2->SetSetPoint(this->FromFixed(this->settingsHolder.O2SetPoint));
+      this->incLight->UpdateLightDeltas(this->settingsHolder.millisOn, this->settingsHolder.millisOff);
+      this->incLight->UpdateMode(this->settingsHolder.lightMode);
+      this->CheckSettings();
+    }
     
     void PerformSaveSettings() {
       #ifdef DEBUG_EEPROM
@@ -262,18 +298,18 @@ class IncuversSettingsHandler {
         Serial.print(SETTINGS_IDENT_CURR);
         Serial.print(", ");
         Serial.print(sizeof(settingsHolder));
-        Serial.print(" bytes");
+        Serial.println(" bytes");
       #endif
       
-      for (unsigned int i=0; i < sizeof(settingsHolder); i++) {
-        EEPROM.write(SETTINGS_ADDRS + i, *((char*)&this->settingsHolder + i));
-        #ifdef DEBUG_EEPROM
-          Serial.print(".");
-        #endif
+      // Only the changed bytes are written, into the next slot of the ring.  Once the persistence service is running it
+      // does the writing, a byte at a time once the settings stop changing.
+      if (this->incPersist != NULL) {
+        this->incPersist->MarkDirty(this->settingsRegion);
+      } else {
+        this->settingsStore.Save(&this->settingsHolder, sizeof(this->settingsHolder), SETTINGS_VERSION_CURR);
       }
       
       #ifdef DEBUG_EEPROM
-        Serial.println("  Done.");
         Serial.println(F("/SaveSettings"));
       #endif
     }
@@ -284,11 +320,11 @@ class IncuversSettingsHandler {
       #endif
       int runMode = 0;
       
+      this->incPersist = NULL;
+      this->settingsStore.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
       if (ReadHardwareSettings()) {
-        if (VerifyEEPROMHeader((int)SETTINGS_ADDRS, false) == SETTINGS_IDENT_CURR) {
-          runMode = ReadCurrentSettings();
-        } else {
-          runMode = 2;
+        runMode = ReadCurrentSettings();
+        if (runMode == 2) {
           #ifdef DEBUG_EEPROM
             Serial.println(F("\tNo settings found, using defaults."));
           #endif
@@ -324,18 +360,49 @@ class IncuversSettingsHandler {
       #endif
     }
 
+    void AttachIncuversModule(IncuversPersistence* iPersist) {
+      this->incPersist = iPersist;
+
+      this->incPersist->SetupPersistence(&this->settingsStore);
+      this->settingsRegion = this->incPersist->RegisterStoreRegion(&this->settingsHolder, sizeof(this->settingsHolder), SETTINGS_VERSION_CURR);
+    }
+
+    IncuversPersistence* getPersistence() {
+      return this->incPersist;
+    }
+
+    void AttachIncuversModule(IncuversPowerArbiter* iPower) {
+      this->incPower = iPower;
+
+      this->incPower->SetupArbiter(POWER_BUDGET);
+    }
+
+    IncuversPowerArbiter* getPowerArbiter() {
+      return this->incPower;
+    }
+
     void AttachIncuversModule(IncuversHeatingSystem* iHeat) {
       this->incHeat = iHeat;
+      byte doorSensor[8];
+      byte chamberSensor[8];
+
+      // The heating system keeps its own copy of the sensor ROMs, they seed the roles of the sensors on the bus.
+      for (byte i = 0; i < 8; i++) {
+        doorSensor[i] = this->ReadHardware(HARDWARE_FIELD(sensorAddrDoorTemp) + i);
+        chamberSensor[i] = this->ReadHardware(HARDWARE_FIELD(sensorAddrChamberTemp) + i);
+      }
 
       this->incHeat->SetupHeating(PINASSIGN_HEATDOOR, 
                       PINASSIGN_HEATCHAMBER, 
                       PINASSIGN_ONEWIRE_BUS, 
-                      this->settingsHardware.sensorAddrDoorTemp,
-                      this->settingsHardware.sensorAddrChamberTemp,
+                      doorSensor,
+                      chamberSensor,
                       this->settingsHolder.heatMode,
                       PINASSIGN_FAN,
                       this->settingsHolder.fanMode,
-                      this->settingsHolder.heatSetPoint);
+                      this->FromFixed(this->settingsHolder.heatSetPoint),
+                      this->incPower,
+                      this->incPersist);
     }
 
     IncuversHeatingSystem* getHeatModule() {
@@ -345,8 +412,9 @@ class IncuversSettingsHandler {
     void AttachIncuversModule(IncuversLightingSystem* iLight) {
       this->incLight = iLight;
 
-      this->incLight->SetupLighting(this->settingsHardware.lightPin,
-                      this->settingsHardware.lightingSupport);
+      this->incLight->SetupLighting(this->ReadHardware(HARDWARE_FIELD(lightPin)),
+                      this->ReadHardware(HARDWARE_FIELD(lightingSupport)),
+                      this->incPower);
       this->incLight->UpdateLightDeltas(this->settingsHolder.millisOn, this->settingsHolder.millisOff);
     }
 
@@ -357,11 +425,15 @@ class IncuversSettingsHandler {
     void AttachIncuversModule(IncuversCO2System* iCO2) {
       this->incCO2 = iCO2;
       
-      this->incCO2->SetupCO2(this->settingsHardware.CO2RxPin, 
-                             this->settingsHardware.CO2TxPin,
-                             this->settingsHardware.CO2RelayPin);
+      this->incCO2->SetupCO2(this->ReadHardware(HARDWARE_FIELD(CO2RxPin)), 
+                             this->ReadHardware(HARDWARE_FIELD(CO2TxPin)),
+                             this->ReadHardware(HARDWARE_FIELD(CO2RelayPin)),
+                             this->incPower);
       this->incCO2->UpdateMode(this->settingsHolder.CO2Mode);                      
-      this->incCO2->SetSetPoint(this->settingsHolder.CO2SetPoint);
+      this->incCO2->SetSetPoint(this->FromFixed(this->settingsHolder.CO2SetPoint));
+      if (this->incCO2->getGasMeter() != NULL) {
+        this->incCO2->getGasMeter()->AttachPersistence(this->incPersist);
+      }
     }
 
     IncuversCO2System* getCO2Module() {
@@ -371,11 +443,15 @@ class IncuversSettingsHandler {
     void AttachIncuversModule(IncuversO2System* iO2) {
       this->incO2 = iO2;
       
-      this->incO2->SetupO2(this->settingsHardware.O2RxPin, 
-                           this->settingsHardware.O2TxPin,
-                           this->settingsHardware.O2RelayPin);
+      this->incO2->SetupO2(this->ReadHardware(HARDWARE_FIELD(O2RxPin)), 
+                           this->ReadHardware(HARDWARE_FIELD(O2TxPin)),
+                           this->ReadHardware(HARDWARE_FIELD(O2RelayPin)),
+                           this->incPower);
       this->incO2->UpdateMode(this->settingsHolder.O2Mode);                      
-      this->incO2->SetSetPoint(this->settingsHolder.O2SetPoint);
+      this->incO2->SetSetPoint(this->FromFixed(this->settingsHolder.O2SetPoint));
+      if (this->incO2->getGasMeter() != NULL) {
+        this->incO2->getGasMeter()->AttachPersistence(this->incPersist);
+      }
     }
 
     IncuversO2System* getO2Module() {
@@ -390,18 +466,28 @@ class IncuversSettingsHandler {
       return this->settingsHolder.heatMode;
     }
 
-    void setHeatMode(int mode) {
+    boolean setHeatMode(int mode) {
+      // The setters only take what the menu offers, for the menu and the PiLink alike.  Off or on.
+      if (mode != 0 && mode != 1) {
+        return false;
+      }
       this->settingsHolder.heatMode = mode;
       this->incHeat->UpdateHeatMode(mode);
+      return true;
     }
 
     int getFanMode() {
       return this->settingsHolder.fanMode;
     }
 
-    void setFanMode(int mode) {
+    boolean setFanMode(int mode) {
+      // Off or always on.
+      if (mode != 0 && mode != 4) {
+        return false;
+      }
       this->settingsHolder.fanMode = mode;
       this->incHeat->UpdateFanMode(mode);
+      return true;
     }
     
     float getDoorTemperature() {
@@ -425,12 +511,15 @@ class IncuversSettingsHandler {
     }
 
     float getTemperatureSetPoint() {
-      return this->settingsHolder.heatSetPoint;
+      return this->FromFixed(this->settingsHolder.heatSetPoint);
     }
 
-    void setTemperatureSetPoint(float newValue) {
-      this->settingsHolder.heatSetPoint = newValue;
-      this->incHeat->SetSetPoint(this->settingsHolder.heatSetPoint);
+    float setTemperatureSetPoint(float newValue) {
+      // Held to the range, what was set is returned.
+      newValue = constrain(newValue, TEMPERATURE_MIN, TEMPERATURE_MAX);
+      this->settingsHolder.heatSetPoint = this->ToFixed(newValue);
+      this->incHeat->SetSetPoint(this->FromFixed(this->settingsHolder.heatSetPoint));
+      return this->getTemperatureSetPoint();
     }
 
     boolean isChamberOn() {
@@ -441,13 +530,33 @@ class IncuversSettingsHandler {
       return incHeat->isChamberStepping();
     }
 
+    boolean isChamberDegraded() {
+      return incHeat->isChamberDegraded();
+    }
+
+    float getChamberDuty() {
+      return incHeat->getChamberDuty();
+    }
+
+    boolean isChamberWarmingUp() {
+      return incHeat->isChamberWarmingUp();
+    }
+
+    long getWarmUpTime() {
+      return incHeat->getWarmUpTime();
+    }
+
     int getCO2Mode() {
       return this->settingsHolder.CO2Mode;
     }
 
-    void setCO2Mode(int mode) {
+    boolean setCO2Mode(int mode) {
+      if (mode < 0 || mode > 2) {
+        return false;
+      }
       this->settingsHolder.CO2Mode = mode;
       this->incCO2->UpdateMode(mode);
+      return true;
     }
     
     float getCO2Level() {
@@ -455,12 +564,14 @@ class IncuversSettingsHandler {
     }
 
     float getCO2SetPoint() {
-      return this->settingsHolder.CO2SetPoint;
+      return this->FromFixed(this->settingsHolder.CO2SetPoint);
     }
 
-    void setCO2SetPoint(float newValue) {
-      this->settingsHolder.CO2SetPoint = newValue;
-      this->incCO2->SetSetPoint(this->settingsHolder.CO2SetPoint);
+    float setCO2SetPoint(float newValue) {
+      newValue = constrain(newValue, CO2_MIN, CO2_MAX);
+      this->settingsHolder.CO2SetPoint = this->ToFixed(newValue);
+      this->incCO2->SetSetPoint(this->FromFixed(this->settingsHolder.CO2SetPoint));
+      return this->getCO2SetPoint();
     }
 
     boolean isCO2Open() {
@@ -471,13 +582,25 @@ class IncuversSettingsHandler {
       return incCO2->isCO2Stepping();
     }
 
+    boolean isCO2Degraded() {
+      return incCO2->isDegraded();
+    }
+
+    float getCO2Duty() {
+      return incCO2->getLearnedDuty();
+    }
+
     int getO2Mode() {
       return this->settingsHolder.O2Mode;
     }
 
-    void setO2Mode(int mode) {
+    boolean setO2Mode(int mode) {
+      if (mode < 0 || mode > 2) {
+        return false;
+      }
       this->settingsHolder.O2Mode = mode;
       this->incO2->UpdateMode(mode);
+      return true;
     }
     
     float getO2Level() {
@@ -485,12 +608,14 @@ class IncuversSettingsHandler {
     }
 
     float getO2SetPoint() {
-      return this->settingsHolder.O2SetPoint;
+      return this->FromFixed(this->settingsHolder.O2SetPoint);
     }
 
-    void setO2SetPoint(float newValue) {
-      this->settingsHolder.O2SetPoint = newValue;
-      this->incO2->SetSetPoint(this->settingsHolder.O2SetPoint);
+    float setO2SetPoint(float newValue) {
+      newValue = constrain(newValue, OO_MIN, OO_MAX);
+      this->settingsHolder.O2SetPoint = this->ToFixed(newValue);
+      this->incO2->SetSetPoint(this->FromFixed(this->settingsHolder.O2SetPoint));
+      return this->getO2SetPoint();
     }
 
     boolean isO2Open() {
@@ -501,12 +626,25 @@ class IncuversSettingsHandler {
       return incO2->isNStepping();
     }
 
-    String getHardware() {
-      return String(this->settingsHardware.hVer[0])+"."+String(this->settingsHardware.hVer[1])+"."+String(this->settingsHardware.hVer[2]);  
+    IncuversGasMeter* getCO2GasMeter() {
+      return incCO2->getGasMeter();
+    }
+
+    IncuversGasMeter* getO2GasMeter() {
+      return incO2->getGasMeter();
+    }
+
+    void PrintHardware(Print* out) {
+      out->print(this->ReadHardware(HARDWARE_FIELD(hVer)));
+      out->print('.');
+      out->print(this->ReadHardware(HARDWARE_FIELD(hVer) + 1));
+      out->print('.');
+      out->print(this->ReadHardware(HARDWARE_FIELD(hVer) + 2));
     }
     
-    String getSerial() {
-      return String(this->settingsHardware.serial);
+    int getSerialNumber() {
+      int16_t serial;
+      return EEPROM.get(HARDWARE_ADDRS + HARDWARE_FIELD(serial), serial);
     }
 
     void MakeSafeState() {
@@ -516,6 +654,13 @@ class IncuversSettingsHandler {
       incO2->MakeSafeState();
     }
 
+    void SetRecoveryMode(boolean recovering) {
+      // Used while recovering from a door opening, see IncuversDoorMonitor.
+      incHeat->SetRecoveryMode(recovering);
+      incCO2->SetRecoveryMode(recovering);
+      incO2->SetRecoveryMode(recovering);
+    }
+
     void ReturnFromSafeState() {
       incHeat->ResumeState(this->settingsHolder.heatMode);
       // Lighting will resume automatically
@@ -527,32 +672,36 @@ class IncuversSettingsHandler {
       return this->settingsHolder.lightMode;
     }
 
-    void setLightMode(int mode) {
+    boolean setLightMode(int mode) {
+      if (mode < 0 || mode > 2) {
+        return false;
+      }
       this->settingsHolder.lightMode = mode;
       this->incLight->UpdateMode(mode);
+      return true;
     }
     
     boolean HasCO2Sensor() {
-      return settingsHardware.hasCO2Sensor;
+      return this->ReadHardware(HARDWARE_FIELD(hasCO2Sensor));
     }
 
     boolean HasO2Sensor() {
-      return settingsHardware.hasO2Sensor;
+      return this->ReadHardware(HARDWARE_FIELD(hasO2Sensor));
     }
 
     int CountGasRelays() {
       int count = 0;
-      if (settingsHardware.CO2GasRelay) { count++; }
-      if (settingsHardware.O2GasRelay) { count++; }
+      if (this->ReadHardware(HARDWARE_FIELD(CO2GasRelay))) { count++; }
+      if (this->ReadHardware(HARDWARE_FIELD(O2GasRelay))) { count++; }
       return count;
     }
 
     boolean HasPiLink() {
-      return settingsHardware.piSupport;
+      return this->ReadHardware(HARDWARE_FIELD(piSupport));
     }
 
     boolean HasLighting() {
-      return settingsHardware.lightingSupport;
+      return this->ReadHardware(HARDWARE_FIELD(lightingSupport));
     }
         
     boolean isHeatAlarmed() {
@@ -0,0 +1,292 @@
+/*
+ * Incuvers settings store.
+ *
+ * Rather than rewriting the same EEPROM cells on every save, records rotate through a ring of slots.  Each slot holds a
+ * small header (ident, layout version and size of the record, sequence number and a CRC of the record) followed by room
+ * for the largest record we expect to store, so a new layout doesn't move the ring.  Saving writes the payload to
+ * the slot after the newest one, touching only the bytes that differ from what the slot already holds.  The slot's
+ * ident is cleared before and set after everything else, so a save cut short by a power loss leaves a slot which is
+ * ignored and the previous record is used; the CRC catches anything else that went wrong with a slot.  A save can be
+ * done in one go or trickled out one write at a time (see IncuversPersistence).
+ *
+ * Used as the backing store of IncuversSettingsHandler, and by the host side wear simulator in Support/.
+ */
+struct SettingsStoreHeader {
+  byte ident;                     // SETTINGSSTORE_IDENT once the slot has been written
+  byte version;                   // Layout version of the record, so it can be migrated after a firmware upgrade
+  byte size;                      // Bytes of the slot used by the record
+  uint16_t seq;                   // Sequence number, the newest valid record wins
+  uint16_t crc;                   // CRC16 of the record
+};
+
+class IncuversSettingsStore {
+  private:
+    int baseAddress;                // Where the ring starts
+    byte slotCount;                 // How many slots are in the ring
+    int payloadSize;                // Room for a record in each slot
+
+    int currentSlot;                // Slot holding the newest valid record (-1 = none)
+    uint16_t currentSeq;            // Sequence number of the newest valid record
+    byte currentVersion;            // Layout version of the newest valid record
+    byte currentSize;               // Size of the newest valid record
+    int lastWriteCount;             // Cells actually written by the last save
+    byte badSlotCount;              // Slots written but unusable (bad CRC or size) found by the last load
+
+    byte saveStage;                 // Where the save in progress is up to (0 = no save in progress)
+    byte saveSlot;                  // Slot being written
+    byte saveOffset;                // Next byte of the current stage
+    const byte* saveData;           // Record being written
+    SettingsStoreHeader saveHeader; // Header to write once the record is in place
+
+    int GetSlotAddress(byte slot) {
+      return this->baseAddress + slot * (sizeof(SettingsStoreHeader) + this->payloadSize);
+    }
+
+    uint16_t UpdateCRC(uint16_t crc, byte data) {
+      // CRC16-CCITT, the same as _crc_ccitt_update() in avr-libc
+      crc ^= data;
+      for (byte b = 0; b < 8; b++) {
+        if (crc & 1) {
+          crc = (crc >> 1) ^ 0x8408;
+        } else {
+          crc = crc >> 1;
+        }
+      }
+      return crc;
+    }
+
+    uint16_t CalculateSlotCRC(int address, byte size) {
+      // Same CRC, but computed straight from the EEPROM so we don't need a second buffer.
+      uint16_t crc = 0xFFFF;
+      for (int i = 0; i < size; i++) {
+        crc = this->UpdateCRC(crc, EEPROM.read(address + i));
+      }
+      return crc;
+    }
+
+  public:
+    void SetupStore(int address, byte slots, int size) {
+      this->baseAddress = address;
+      this->slotCount = slots;
+      this->payloadSize = size;
+      this->currentSlot = -1;
+      this->currentSeq = 0;
+      this->lastWriteCount = 0;
+      this->badSlotCount = 0;
+      this->saveStage = 0;
+    }
+
+    boolean Load(void* payload) {
+      // payload must have room for getPayloadSize() bytes; check getVersion() and getSize() for what was loaded.
+      SettingsStoreHeader header;
+
+      this->currentSlot = -1;
+      this->badSlotCount = 0;
+      for (byte slot = 0; slot < this->slotCount; slot++) {
+        int address = this->GetSlotAddress(slot);
+        eeprom_read_block(&header, (const void*)(intptr_t)address, sizeof(header));
+        if (header.ident != SETTINGSSTORE_IDENT) {
+          continue;
+        }
+        if (header.size > this->payloadSize) {
+          this->badSlotCount++;
+          continue;
+        }
+        if (this->currentSlot >= 0 && (int16_t)(header.seq - this->currentSeq) <= 0) {
+          continue;
+        }
+        if (this->CalculateSlotCRC(address + sizeof(header), header.size) != header.crc) {
+          #ifdef DEBUG_EEPROM
+            Serial.print(F("Store: bad CRC in slot "));
+            Serial.println(slot);
+          #endif
+          this->badSlotCount++;
+          continue;
+        }
+        this->currentSlot = slot;
+        this->currentSeq = header.seq;
+        this->currentVersion = header.version;
+        this->currentSize = header.size;
+      }
+
+      if (this->currentSlot < 0) {
+        #ifdef DEBUG_EEPROM
+          Serial.println(F("Store: no valid record"));
+        #endif
+        return false;
+      }
+
+      eeprom_read_block(payload, (const void*)(intptr_t)(this->GetSlotAddress(this->currentSlot) + sizeof(header)), this->currentSize);
+      #ifdef DEBUG_EEPROM
+        Serial.print(F("Store: loaded v"));
+        Serial.print(this->currentVersion);
+        Serial.print(F(" seq "));
+        Serial.print(this->currentSeq);
+        Serial.print(F(" from slot "));
+        Serial.println(this->currentSlot);
+      #endif
+      return true;
+    }
+
+    boolean BeginSave(const void* payload, byte size, byte version) {
+      // Starts an incremental save, driven by SaveStep().  Returns false if there was nothing to save.  Starting again
+      // while a save is in progress restarts it in the same slot.  payload is read until the save is done and mustn't
+      // change meanwhile, IncuversPersistence hands over a copy.
+      const byte* data = (const byte*)payload;
+
+      this->saveStage = 0;
+      this->lastWriteCount = 0;
+      if (size > this->payloadSize) {
+        #ifdef DEBUG_EEPROM
+          Serial.println(F("Store: record too large"));
+        #endif
+        return false;
+      }
+      if (this->currentSlot >= 0 && this->currentVersion == version && this->currentSize == size) {
+        int address = this->GetSlotAddress(this->currentSlot) + sizeof(SettingsStoreHeader);
+        boolean changed = false;
+        for (int i = 0; i < size && !changed; i++) {
+          changed = EEPROM.read(address + i) != data[i];
+        }
+        if (!changed) {
+          return false;
+        }
+      }
+
+      this->saveSlot = 0;
+      if (this->currentSlot >= 0) {
+        this->saveSlot = (this->currentSlot + 1) % this->slotCount;
+      }
+      this->saveData = data;
+      this->saveHeader.ident = SETTINGSSTORE_IDENT;
+      this->saveHeader.version = version;
+      this->saveHeader.size = size;
+      this->saveHeader.seq = this->currentSeq + 1;
+      this->saveHeader.crc = 0xFFFF;
+      this->saveStage = 1;
+      this->saveOffset = 0;
+      return true;
+    }
+
+    boolean SaveStep() {
+      // Does at most one EEPROM write, and none if the EEPROM is still busy.  Returns true once no save is in progress.
+      //   1: clear the ident; until it is set again the slot can't pass for a record, even if what's left in it matches
+      //      its old CRC
+      //   2: the record, only the bytes which differ from what the slot holds
+      //   3: the rest of the header
+      //   4: the ident
+      int address = this->GetSlotAddress(this->saveSlot);
+
+      while (this->saveStage != 0) {
+        int cell;
+        byte value;
+
+        if (this->saveStage == 1) {
+          cell = address;
+          value = (EEPROM.read(cell) == SETTINGSSTORE_IDENT) ? 0 : EEPROM.read(cell);
+        } else if (this->saveStage == 2) {
+          cell = address + sizeof(SettingsStoreHeader) + this->saveOffset;
+          value = this->saveData[this->saveOffset];
+        } else if (this->saveStage == 3) {
+          cell = address + this->saveOffset;
+          value = *((byte*)&this->saveHeader + this->saveOffset);
+        } else {
+          cell = address;
+          value = SETTINGSSTORE_IDENT;
+        }
+
+        boolean wrote = false;
+        if (EEPROM.read(cell) != value) {
+          if (!eeprom_is_ready()) {
+            return false;
+          }
+          EEPROM.write(cell, value);
+          this->lastWriteCount++;
+          wrote = true;
+        }
+
+        if (this->saveStage == 1) {
+          this->saveStage = 2;
+        } else if (this->saveStage == 2) {
+          // The CRC is worked out as the record goes, it's only read once.
+          this->saveHeader.crc = this->UpdateCRC(this->saveHeader.crc, value);
+          this->saveOffset++;
+          if (this->saveOffset >= this->saveHeader.size) {
+            this->saveStage = 3;
+            this->saveOffset = 1;
+          }
+        } else if (this->saveStage == 3) {
+          this->saveOffset++;
+          if (this->saveOffset >= sizeof(SettingsStoreHeader)) {
+            this->saveStage = 4;
+          }
+        } else {
+          this->saveStage = 0;
+          this->currentSlot = this->saveSlot;
+          this->currentSeq = this->saveHeader.seq;
+          this->currentVersion = this->saveHeader.version;
+          this->currentSize = this->saveHeader.size;
+          #ifdef DEBUG_EEPROM
+            Serial.print(F("Store: saved seq "));
+            Serial.print(this->currentSeq);
+            Serial.print(F(" to slot "));
+            Serial.print(this->currentSlot);
+            Serial.print(F(", "));
+            Serial.print(this->lastWriteCount);
+            Serial.println(F(" bytes written"));
+          #endif
+        }
+
+        if (wrote) {
+          break;
+        }
+      }
+      return this->saveStage == 0;
+    }
+
+    boolean Save(const void* payload, byte size, byte version) {
+      // Blocking save.  Returns false if there was nothing to save.
+      if (!this->BeginSave(payload, size, version)) {
+        return false;
+      }
+      while (!this->SaveStep()) {
+      }
+      return true;
+    }
+
+    boolean isSaving() {
+      return this->saveStage != 0;
+    }
+
+    int getSlotSize() {
+      return sizeof(SettingsStoreHeader) + this->payloadSize;
+    }
+
+    int getPayloadSize() {
+      return this->payloadSize;
+    }
+
+    byte getVersion() {
+      return this->currentVersion;
+    }
+
+    byte getSize() {
+      return this->currentSize;
+    }
+
+    byte getBadSlotCount() {
+      return this->badSlotCount;
+    }
+
+    int getCurrentSlot() {
+      return this->currentSlot;
+    }
+
+    uint16_t getSequence() {
+      return this->currentSeq;
+    }
+
+    int getLastWriteCount() {
+      return this->lastWriteCount;
+    }
+};
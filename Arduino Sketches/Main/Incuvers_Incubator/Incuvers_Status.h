@@ -0,0 +1,214 @@
+/*
+ * Incuvers status snapshot.
+ *
+ * The LCD, the USB status line and the PiLink all report the same things.  Rather than each of them going through the
+ * settings handler getters (and the modules behind them) on their own, the first one to ask in a pass of loop() has
+ * everything collected into a StatusSnapshot, and the others read the same copy, so they also agree with each other.
+ */
+struct StatusSnapshot {
+  unsigned long takenAt;
+  int serial;
+  // Modes and set points
+  byte fanMode;
+  byte heatMode;
+  byte CO2Mode;
+  byte O2Mode;
+  byte lightMode;
+  float heatSetPoint;
+  float CO2SetPoint;
+  float O2SetPoint;
+  // Readings
+  float chamberTemp;
+  float doorTemp;
+  float otherTemp;
+  byte zoneCount;
+  float zoneTemp[SENSORTABLE_MAX];
+  float CO2Level;
+  float O2Level;
+  // Outputs, alarms and controller state
+  uint8_t doorOn : 1;
+  uint8_t doorStepping : 1;
+  uint8_t chamberOn : 1;
+  uint8_t chamberStepping : 1;
+  uint8_t CO2Open : 1;
+  uint8_t CO2Stepping : 1;
+  uint8_t O2Open : 1;
+  uint8_t O2Stepping : 1;
+  uint8_t heatAlarmed : 1;
+  uint8_t CO2Alarmed : 1;
+  uint8_t O2Alarmed : 1;
+  uint8_t chamberDegraded : 1;
+  uint8_t CO2Degraded : 1;
+  uint8_t chamberWarmingUp : 1;
+  uint8_t hasCO2Meter : 1;
+  uint8_t hasNMeter : 1;
+  char lightIndicator;
+  float chamberDuty;
+  float CO2Duty;
+  long warmUpTime;
+  // Power
+  int powerDraw;
+  unsigned long powerDeferred;
+  // Door events
+  byte doorState;
+  unsigned long doorEvents;
+  long doorOpenTime;
+  long doorRecoveryTime;
+  // Profile
+  int8_t profileSegment;
+  // Gas consumption
+  GasMeterStatus CO2Meter;
+  GasMeterStatus NMeter;
+};
+
+class IncuversStatus {
+  private:
+    IncuversSettingsHandler* incSet;
+    IncuversDoorMonitor* incDoor;
+    IncuversProfileRunner* incProfile;
+
+    StatusSnapshot snapshot;
+    boolean stale;                  // Not collected yet in this pass of loop()
+
+    void Collect() {
+      StatusSnapshot* s = &this->snapshot;
+
+      s->takenAt = millis();
+      s->fanMode = this->incSet->getFanMode();
+      s->heatMode = this->incSet->getHeatMode();
+      s->CO2Mode = this->incSet->getCO2Mode();
+      s->O2Mode = this->incSet->getO2Mode();
+      s->lightMode = this->incSet->getLightMode();
+      s->heatSetPoint = this->incSet->getTemperatureSetPoint();
+      s->CO2SetPoint = this->incSet->getCO2SetPoint();
+      s->O2SetPoint = this->incSet->getO2SetPoint();
+
+      s->chamberTemp = this->incSet->getChamberTemperature();
+      s->doorTemp = this->incSet->getDoorTemperature();
+      s->otherTemp = this->incSet->getOtherTemperature();
+      s->zoneCount = min(this->incSet->getHeatModule()->getZoneCount(), SENSORTABLE_MAX);
+      for (byte i = 0; i < s->zoneCount; i++) {
+        s->zoneTemp[i] = this->incSet->getHeatModule()->getZoneTemperature(i);
+      }
+      s->CO2Level = this->incSet->getCO2Level();
+      s->O2Level = this->incSet->getO2Level();
+
+      s->doorOn = this->incSet->isDoorOn();
+      s->doorStepping = this->incSet->isDoorStepping();
+      s->chamberOn = this->incSet->isChamberOn();
+      s->chamberStepping = this->incSet->isChamberStepping();
+      s->CO2Open = this->incSet->isCO2Open();
+      s->CO2Stepping = this->incSet->isCO2Stepping();
+      s->O2Open = this->incSet->isO2Open();
+      s->O2Stepping = this->incSet->isO2Stepping();
+      s->heatAlarmed = this->incSet->isHeatAlarmed();
+      s->CO2Alarmed = this->incSet->isCO2Alarmed();
+      s->O2Alarmed = this->incSet->isO2Alarmed();
+      s->chamberDegraded = this->incSet->isChamberDegraded();
+      s->CO2Degraded = this->incSet->isCO2Degraded();
+      s->chamberWarmingUp = this->incSet->isChamberWarmingUp();
+      s->lightIndicator = this->incSet->getLightModule()->GetSerialAPIndicator();
+      s->chamberDuty = this->incSet->getChamberDuty();
+      s->CO2Duty = this->incSet->getCO2Duty();
+      s->warmUpTime = this->incSet->getWarmUpTime();
+
+      s->powerDraw = this->incSet->getPowerArbiter()->getCurrentDraw();
+      s->powerDeferred = this->incSet->getPowerArbiter()->getDeferredCount();
+
+      s->doorState = this->incDoor->getState();
+      s->doorEvents = this->incDoor->getEventCount();
+      s->doorOpenTime = this->incDoor->getLastOpenTime();
+      s->doorRecoveryTime = this->incDoor->getLastRecoveryTime();
+
+      s->profileSegment = this->incProfile->getRunningSegment();
+
+      s->hasCO2Meter = (this->incSet->getCO2GasMeter() != NULL);
+      if (s->hasCO2Meter) {
+        this->incSet->getCO2GasMeter()->FillStatus(&s->CO2Meter);
+      }
+      s->hasNMeter = (this->incSet->getO2GasMeter() != NULL);
+      if (s->hasNMeter) {
+        this->incSet->getO2GasMeter()->FillStatus(&s->NMeter);
+      }
+    }
+
+    void PrintGasMeter(Print* out, GasMeterStatus* meter) {
+      out->print(F(" "));
+      out->print(meter->ident);
+      out->print(F("T "));              // Valve open time, s
+      out->print(meter->openSeconds);
+      out->print(F(" "));
+      out->print(meter->ident);
+      out->print(F("K "));              // Valve pulse count
+      out->print(meter->pulseCount);
+      out->print(F(" "));
+      out->print(meter->ident);
+      out->print(F("V "));              // Volume used, L
+      out->print(meter->volume, 2);
+      out->print(F(" "));
+      out->print(meter->ident);
+      out->print(F("R "));              // Consumption rate, mL/h
+      out->print(meter->rate, 1);
+      out->print(F(" "));
+      out->print(meter->ident);
+      out->print(F("E "));              // Hours until the cylinder is empty
+      out->print(meter->hoursToEmpty);
+    }
+
+  public:
+    void SetupStatus(IncuversSettingsHandler* iSettings, IncuversDoorMonitor* iDoor, IncuversProfileRunner* iProfile) {
+      this->incSet = iSettings;
+      this->incDoor = iDoor;
+      this->incProfile = iProfile;
+      this->snapshot.serial = this->incSet->getSerialNumber();
+      this->stale = true;
+    }
+
+    void NextCycle() {
+      // Called at the top of loop(), the modules are about to change things.
+      this->stale = true;
+    }
+
+    StatusSnapshot* Get() {
+      if (this->stale) {
+        this->Collect();
+        this->stale = false;
+      }
+      return &this->snapshot;
+    }
+
+    void PrintGasMeters(Print* out) {
+      StatusSnapshot* s = this->Get();
+      if (s->hasCO2Meter) {
+        this->PrintGasMeter(out, &s->CO2Meter);
+      }
+      if (s->hasNMeter) {
+        this->PrintGasMeter(out, &s->NMeter);
+      }
+    }
+
+    void PrintZones(Print* out) {
+      // Nothing when there are no extra zones.
+      StatusSnapshot* s = this->Get();
+      for (byte i = 0; i < s->zoneCount; i++) {
+        out->print(i == 0 ? F(" TZ ") : F(","));  // Temperatures, extra zones
+        out->print(s->zoneTemp[i], 2);
+      }
+    }
+
+    void PrintAlarmHistory(Print* out) {
+      alarmHistory.Print(out);
+    }
+
+    void PrintDoor(Print* out) {
+      StatusSnapshot* s = this->Get();
+      out->print(F(" DS "));              // Door state
+      out->print(s->doorState);
+      out->print(F(" DN "));              // Door openings
+      out->print(s->doorEvents);
+      out->print(F(" DT "));              // Door open time of the last event, s
+      out->print(s->doorOpenTime);
+      out->print(F(" DR "));              // Recovery time of the last event, s
+      out->print(s->doorRecoveryTime);
+    }
+};
@@ -0,0 +1,93 @@
+/*
+ * Incuvers USB status line.
+ *
+ * The status line is a few hundred bytes, and at 9600 baud the serial port only takes them as fast as it sends them,
+ * 64 bytes ahead.  Printed a field at a time, the loop waited on the port for most of every line.  Instead the line is
+ * printed into this buffer (it's a Print) and handed over whole with Send(), and DoTick() then feeds the port whatever
+ * it has room for, without ever waiting.  DoTick() is called on every pass of the loop and from yield(), which delay()
+ * and the temperature sensors' conversion wait call, so the line keeps going out while the loop is held up there.
+ *
+ * A new line is only started once the last has gone: when the host isn't keeping up the lines in between are
+ * dropped (counted by getDropped()), and what it gets next is the latest status rather than a backlog.
+ *
+ * Once the loop is running nothing else may write to Serial outside a DEBUG_ build: it would wait on the port like the
+ * old line did, and land in the middle of a line the host is parsing.  Anything else for the host is queued here as a
+ * line of its own, once isSending() is false (see IncuversSensorBus::DoTick()).
+ */
+class IncuversStatusLine : public Print {
+  private:
+    char buffer[STATUS_LINE_SIZE];
+    int length;
+    int sent;
+    boolean sending;                // Between Send() and the last byte going to the port
+    unsigned long dropped;
+    unsigned long truncated;        // Lines which didn't fit in the buffer
+
+  public:
+    void SetupStatusLine() {
+      this->length = 0;
+      this->sent = 0;
+      this->sending = false;
+      this->dropped = 0;
+      this->truncated = 0;
+    }
+
+    boolean Begin() {
+      // Starts a new line, false (and it's counted as dropped) if the last one is still going out.
+      if (this->sending) {
+        this->dropped++;
+        return false;
+      }
+      this->length = 0;
+      return true;
+    }
+
+    size_t write(uint8_t c) {
+      if (this->sending || this->length >= STATUS_LINE_SIZE) {
+        return 0;
+      }
+      this->buffer[this->length++] = c;
+      return 1;
+    }
+    using Print::write;
+
+    void Send() {
+      if (this->length >= STATUS_LINE_SIZE) {
+        // Cut short, but still a line.
+        this->buffer[STATUS_LINE_SIZE - 2] = '\r';
+        this->buffer[STATUS_LINE_SIZE - 1] = '\n';
+        this->truncated++;
+      }
+      this->sent = 0;
+      this->sending = this->length > 0;
+      this->DoTick();
+    }
+
+    void DoTick() {
+      if (!this->sending) {
+        return;
+      }
+      int room = Serial.availableForWrite();
+      while (room > 0 && this->sent < this->length) {
+        Serial.write((uint8_t)this->buffer[this->sent++]);
+        room--;
+      }
+      if (this->sent >= this->length) {
+        this->sending = false;
+      }
+    }
+
+    boolean isSending() {
+      return this->sending;
+    }
+
+    unsigned long getDropped() {
+      return this->dropped;
+    }
+
+    unsigned long getTruncated() {
+      return this->truncated;
+    }
+};
+
+IncuversStatusLine statusLine;
@@ -0,0 +1,260 @@
+/*
+ * Incuvers TWI (I2C) bus.
+ *
+ * The Wire library makes the CPU wait for every transfer, which at 100 kHz is the better part of a millisecond for each
+ * character sent to the LCD.  This driver takes the place of Wire: transactions are queued and the TWI interrupt runs
+ * them one after another at TWI_FREQUENCY, so the loop only ever queues work and carries on.  Everything on the bus is
+ * the LCD's MCP23017, which is good for 400 kHz.
+ *
+ * A transaction writes up to TWI_BUFFER_SIZE bytes, then (with a repeated start) reads up to as many back into the
+ * same buffer.  Once it's done its callback, if it has one, is called from DoTick() with the status and what was read,
+ * never from the interrupt.  If the bus stops making progress for TWI_TIMEOUT the transaction is failed, SCL is
+ * clocked by hand until whoever is holding SDA lets go, and the queue carries on.
+ */
+#define TWI_STATUS_PENDING 0
+#define TWI_STATUS_OK 1
+#define TWI_STATUS_NACK 2             // Nobody answered, or the device refused a byte
+#define TWI_STATUS_ERROR 3            // Bus error or lost arbitration
+#define TWI_STATUS_TIMEOUT 4          // The bus got stuck and was recovered
+
+typedef void (*TWICallback)(byte status, byte* data, byte length, void* context);
+
+struct TWITransaction {
+  byte address;
+  byte writeLength;
+  byte readLength;
+  volatile byte status;
+  byte data[TWI_BUFFER_SIZE];         // What to write, then what was read
+  TWICallback callback;
+  void* context;
+};
+
+class IncuversTWI {
+  private:
+    TWITransaction queue[TWI_QUEUE_SIZE];
+    byte done;                        // Next finished transaction to call back (loop only)
+    volatile byte active;             // Transaction on the bus, or the next to start (interrupt only, once started)
+    volatile byte tail;               // Next free entry (loop only)
+    volatile boolean busy;            // The interrupt is working through the queue
+    volatile boolean reading;         // Past the repeated start of the active transaction
+    volatile byte position;           // Byte of the active transaction being written or read
+    volatile byte progress;           // Counts interrupts, for spotting a stuck bus
+
+    byte lastProgress;
+    unsigned long lastProgressAt;
+    unsigned int errorCount;
+    unsigned int recoveryCount;
+
+    void Enable() {
+      digitalWrite(SDA, HIGH);        // Internal pull-ups, as Wire had them
+      digitalWrite(SCL, HIGH);
+      TWSR = 0;                       // Prescaler 1
+      TWBR = ((F_CPU / TWI_FREQUENCY) - 16) / 2;
+      TWCR = _BV(TWEN) | _BV(TWIE);
+    }
+
+    void Release(byte pin) {
+      pinMode(pin, INPUT_PULLUP);
+      delayMicroseconds(5);
+    }
+
+    void Pull(byte pin) {
+      digitalWrite(pin, LOW);
+      pinMode(pin, OUTPUT);
+      delayMicroseconds(5);
+    }
+
+    void RecoverBus() {
+      // Let go of the TWI hardware and clock SCL until the device holding SDA low has finished its byte, then send a
+      // stop so everyone agrees the bus is free.
+      TWCR = 0;
+      this->Release(SDA);
+      this->Release(SCL);
+      for (byte c = 0; c < 9 && digitalRead(SDA) == LOW; c++) {
+        this->Pull(SCL);
+        this->Release(SCL);
+      }
+      this->Pull(SCL);
+      this->Pull(SDA);
+      this->Release(SCL);
+      this->Release(SDA);
+      this->Enable();
+      this->recoveryCount++;
+      #ifdef DEBUG_TWI
+        Serial.print(F("TWI: bus recovered, SDA "));
+        Serial.println(digitalRead(SDA));
+      #endif
+    }
+
+  public:
+    void SetupTWI() {
+      this->done = 0;
+      this->active = 0;
+      this->tail = 0;
+      this->busy = false;
+      this->reading = false;
+      this->progress = 0;
+      this->lastProgress = 0;
+      this->lastProgressAt = millis();
+      this->errorCount = 0;
+      this->recoveryCount = 0;
+      this->Enable();
+    }
+
+    boolean Queue(byte address, const byte* data, byte writeLength, byte readLength, TWICallback callback, void* context) {
+      // false if the queue is full (or the transaction too long), nothing was queued.
+      if ((this->tail + 1) % TWI_QUEUE_SIZE == this->done || writeLength > TWI_BUFFER_SIZE || readLength > TWI_BUFFER_SIZE) {
+        return false;
+      }
+      TWITransaction* t = &this->queue[this->tail];
+      t->address = address;
+      t->writeLength = writeLength;
+      t->readLength = readLength;
+      t->status = TWI_STATUS_PENDING;
+      memcpy(t->data, data, writeLength);
+      t->callback = callback;
+      t->context = context;
+
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        this->tail = (this->tail + 1) % TWI_QUEUE_SIZE;
+        if (!this->busy) {
+          this->busy = true;
+          this->reading = false;
+          TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+        }
+      }
+      return true;
+    }
+
+    void QueueWait(byte address, const byte* data, byte writeLength, byte readLength, TWICallback callback, void* context) {
+      // Queue, waiting for room if need be.  The bus watchdog in DoTick() makes sure room turns up.
+      while (!this->Queue(address, data, writeLength, readLength, callback, context)) {
+        this->DoTick();
+      }
+    }
+
+    void WriteRegister(byte address, byte reg, byte value) {
+      byte data[2] = { reg, value };
+      this->QueueWait(address, data, 2, 0, NULL, NULL);
+    }
+
+    void WaitForIdle() {
+      // Only for the startup code, which has to let the LCD finish a command before going on.
+      while (this->busy || this->done != this->active) {
+        this->DoTick();
+      }
+    }
+
+    void HandleInterrupt() {
+      TWITransaction* t = &this->queue[this->active];
+      byte next;
+
+      this->progress++;
+      switch (TW_STATUS) {
+        case TW_START:
+        case TW_REP_START:
+          this->position = 0;
+          TWDR = (t->address << 1) | ((this->reading || t->writeLength == 0) ? TW_READ : TW_WRITE);
+          this->reading = this->reading || t->writeLength == 0;
+          TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT);
+          return;
+        case TW_MT_SLA_ACK:
+        case TW_MT_DATA_ACK:
+          if (this->position < t->writeLength) {
+            TWDR = t->data[this->position++];
+            TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT);
+          } else if (t->readLength > 0) {
+            this->reading = true;
+            TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+          } else {
+            t->status = TWI_STATUS_OK;
+            break;
+          }
+          return;
+        case TW_MR_SLA_ACK:
+          // Acknowledge every byte but the last.
+          TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | (t->readLength > 1 ? _BV(TWEA) : 0);
+          return;
+        case TW_MR_DATA_ACK:
+          t->data[this->position++] = TWDR;
+          TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | (this->position + 1 < t->readLength ? _BV(TWEA) : 0);
+          return;
+        case TW_MR_DATA_NACK:
+          t->data[this->position++] = TWDR;
+          t->status = TWI_STATUS_OK;
+          break;
+        case TW_MT_SLA_NACK:
+        case TW_MT_DATA_NACK:
+        case TW_MR_SLA_NACK:
+          t->status = TWI_STATUS_NACK;
+          break;
+        default:                      // Bus error, lost arbitration
+          t->status = TWI_STATUS_ERROR;
+          break;
+      }
+
+      // Done with this one: stop, and start the next straight away if there is one.
+      this->reading = false;
+      next = (this->active + 1) % TWI_QUEUE_SIZE;
+      this->active = next;
+      if (next != this->tail) {
+        TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTO) | _BV(TWSTA);
+      } else {
+        this->busy = false;
+        TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTO);
+      }
+    }
+
+    void DoTick() {
+      // Call back the finished transactions and keep an eye on the bus.
+      while (this->done != this->active) {
+        TWITransaction* t = &this->queue[this->done];
+        if (t->status != TWI_STATUS_OK) {
+          this->errorCount++;
+          #ifdef DEBUG_TWI
+            Serial.print(F("TWI: transaction to "));
+            Serial.print(t->address, HEX);
+            Serial.print(F(" failed, status "));
+            Serial.println(t->status);
+          #endif
+        }
+        if (t->callback != NULL) {
+          t->callback(t->status, t->data, t->readLength, t->context);
+        }
+        this->done = (this->done + 1) % TWI_QUEUE_SIZE;
+      }
+
+      unsigned long nowTime = millis();
+      if (!this->busy || this->progress != this->lastProgress) {
+        this->lastProgress = this->progress;
+        this->lastProgressAt = nowTime;
+      } else if (nowTime - this->lastProgressAt >= TWI_TIMEOUT) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+          this->queue[this->active].status = TWI_STATUS_TIMEOUT;
+          this->active = (this->active + 1) % TWI_QUEUE_SIZE;
+          this->reading = false;
+          this->RecoverBus();
+          if (this->active != this->tail) {
+            TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+          } else {
+            this->busy = false;
+          }
+        }
+        this->lastProgressAt = nowTime;
+      }
+    }
+
+    unsigned int getErrorCount() {
+      return this->errorCount;
+    }
+
+    unsigned int getRecoveryCount() {
+      return this->recoveryCount;
+    }
+};
+
+IncuversTWI incTWI;
+
+ISR(TWI_vect) {
+  incTWI.HandleInterrupt();
+}
@@ -0,0 +1,281 @@
+/*
+ * Incuvers trend history.
+ *
+ * So drift can be seen on the unit itself, the chamber temperature, CO2 and O2 are each averaged over every minute, in
+ * fixed point (TREND_SCALE), and the last TREND_MINUTES of those averages are kept for a sparkline.  The minute averages
+ * are also rolled up into blocks of TREND_BLOCK_MINUTES, and the last TREND_BLOCKS of those (their low, high and mean)
+ * plus the block in progress give the figures for the last day.  The figures are kept up to date as each minute and
+ * block closes, so reading them never goes back through the history; the lowest and highest are only looked for again
+ * when the block which held one of them drops out.
+ *
+ * To keep the history small a closed block holds its low and high as distances from its mean in TREND_SPREAD_STEP,
+ * rounded outwards, so they can read up to a step wider than they were (the trend pages show tenths anyway).  A
+ * distance past 255 steps is held there; none of the readings moves that far within a block while it's being sampled.
+ *
+ * Readings which can't be trusted (sensor lost or in error, controller off) aren't sampled, and a minute without any
+ * samples is a gap.
+ */
+#define TREND_NO_DATA -32768
+#define TREND_CHANNEL_TEMP 0
+#define TREND_CHANNEL_CO2 1
+#define TREND_CHANNEL_O2 2
+#define TREND_CHANNELS 3
+#define TREND_GLYPHS (TREND_MINUTES / 5)    // Custom characters are 5 pixels wide, a minute to a pixel
+
+struct TrendBlock {
+  int16_t mean;
+  byte below;                       // Low and high, TREND_SPREAD_STEP from the mean
+  byte above;
+  byte minutes;                     // Minutes which had samples, 0 = a gap
+};
+
+class IncuversTrendChannel {
+  private:
+    int16_t minutes[TREND_MINUTES];  // Minute averages, oldest overwritten
+    byte minuteNext;
+    long minuteSum;                 // The minute being collected
+    byte minuteSamples;
+
+    TrendBlock blocks[TREND_BLOCKS];
+    byte blockNext;
+    int16_t blockLow;               // The block being collected, from the minute averages
+    int16_t blockHigh;
+    byte blockMinutes;
+    long blockSum;
+
+    long daySum;                    // Over the blocks in the window: the sum of their minute averages
+    unsigned int dayMinutes;
+    int16_t dayLow;
+    int16_t dayHigh;
+
+    static byte Spread(long distance) {
+      long steps = (distance + TREND_SPREAD_STEP - 1) / TREND_SPREAD_STEP;
+      return steps > 255 ? 255 : steps;
+    }
+
+    static int16_t BlockLow(TrendBlock* block) {
+      return max((long)block->mean - (long)block->below * TREND_SPREAD_STEP, (long)TREND_NO_DATA + 1);
+    }
+
+    static int16_t BlockHigh(TrendBlock* block) {
+      return min((long)block->mean + (long)block->above * TREND_SPREAD_STEP, 32767L);
+    }
+
+    void FindDayExtremes() {
+      this->dayLow = TREND_NO_DATA;
+      this->dayHigh = TREND_NO_DATA;
+      for (byte b = 0; b < TREND_BLOCKS; b++) {
+        if (this->blocks[b].minutes == 0) {
+          continue;
+        }
+        int16_t low = BlockLow(&this->blocks[b]);
+        int16_t high = BlockHigh(&this->blocks[b]);
+        if (this->dayLow == TREND_NO_DATA || low < this->dayLow) {
+          this->dayLow = low;
+        }
+        if (this->dayHigh == TREND_NO_DATA || high > this->dayHigh) {
+          this->dayHigh = high;
+        }
+      }
+    }
+
+  public:
+    void Setup() {
+      for (byte m = 0; m < TREND_MINUTES; m++) {
+        this->minutes[m] = TREND_NO_DATA;
+      }
+      for (byte b = 0; b < TREND_BLOCKS; b++) {
+        this->blocks[b].minutes = 0;
+      }
+      this->minuteNext = 0;
+      this->minuteSum = 0;
+      this->minuteSamples = 0;
+      this->blockNext = 0;
+      this->blockMinutes = 0;
+      this->blockSum = 0;
+      this->daySum = 0;
+      this->dayMinutes = 0;
+      this->dayLow = TREND_NO_DATA;
+      this->dayHigh = TREND_NO_DATA;
+    }
+
+    void AddSample(float value) {
+      if (this->minuteSamples < 255) {
+        this->minuteSum += (long)(value * TREND_SCALE + 0.5);
+        this->minuteSamples++;
+      }
+    }
+
+    void CloseMinute() {
+      int16_t average = TREND_NO_DATA;
+      if (this->minuteSamples > 0) {
+        average = this->minuteSum / this->minuteSamples;
+        if (this->blockMinutes == 0 || average < this->blockLow) {
+          this->blockLow = average;
+        }
+        if (this->blockMinutes == 0 || average > this->blockHigh) {
+          this->blockHigh = average;
+        }
+        this->blockSum += average;
+        this->blockMinutes++;
+      }
+      this->minutes[this->minuteNext] = average;
+      this->minuteNext = (this->minuteNext + 1) % TREND_MINUTES;
+      this->minuteSum = 0;
+      this->minuteSamples = 0;
+    }
+
+    void CloseBlock() {
+      TrendBlock* oldest = &this->blocks[this->blockNext];
+      boolean heldExtreme = false;
+
+      if (oldest->minutes > 0) {
+        this->daySum -= (long)oldest->mean * oldest->minutes;
+        this->dayMinutes -= oldest->minutes;
+        heldExtreme = BlockLow(oldest) == this->dayLow || BlockHigh(oldest) == this->dayHigh;
+      }
+      oldest->minutes = this->blockMinutes;
+      if (this->blockMinutes > 0) {
+        oldest->mean = this->blockSum / this->blockMinutes;
+        oldest->below = Spread((long)oldest->mean - this->blockLow);
+        oldest->above = Spread((long)this->blockHigh - oldest->mean);
+        this->daySum += (long)oldest->mean * this->blockMinutes;
+        this->dayMinutes += this->blockMinutes;
+      }
+      this->blockNext = (this->blockNext + 1) % TREND_BLOCKS;
+
+      if (heldExtreme) {
+        this->FindDayExtremes();
+      } else if (oldest->minutes > 0) {
+        if (this->dayLow == TREND_NO_DATA || BlockLow(oldest) < this->dayLow) {
+          this->dayLow = BlockLow(oldest);
+        }
+        if (this->dayHigh == TREND_NO_DATA || BlockHigh(oldest) > this->dayHigh) {
+          this->dayHigh = BlockHigh(oldest);
+        }
+      }
+      this->blockMinutes = 0;
+      this->blockSum = 0;
+    }
+
+    int16_t getMinute(byte age) {
+      // 0 is the minute which closed last, TREND_NO_DATA for a gap.
+      return this->minutes[(this->minuteNext + TREND_MINUTES - 1 - age) % TREND_MINUTES];
+    }
+
+    int16_t getLow() {
+      if (this->blockMinutes > 0 && (this->dayLow == TREND_NO_DATA || this->blockLow < this->dayLow)) {
+        return this->blockLow;
+      }
+      return this->dayLow;
+    }
+
+    int16_t getHigh() {
+      if (this->blockMinutes > 0 && (this->dayHigh == TREND_NO_DATA || this->blockHigh > this->dayHigh)) {
+        return this->blockHigh;
+      }
+      return this->dayHigh;
+    }
+
+    int16_t getMean() {
+      unsigned int count = this->dayMinutes + this->blockMinutes;
+      if (count == 0) {
+        return TREND_NO_DATA;
+      }
+      return (this->daySum + this->blockSum) / count;
+    }
+};
+
+class IncuversTrend {
+  private:
+    IncuversTrendChannel channels[TREND_CHANNELS];
+    unsigned long minuteStartedAt;
+    byte minutesInBlock;
+    unsigned long minuteCount;      // Minutes closed since startup
+
+  public:
+    void SetupTrend() {
+      for (byte c = 0; c < TREND_CHANNELS; c++) {
+        this->channels[c].Setup();
+      }
+      this->minuteStartedAt = millis();
+      this->minutesInBlock = 0;
+      this->minuteCount = 0;
+    }
+
+    void DoTick(StatusSnapshot* st) {
+      // Samples the snapshot, call it every second or so.
+      if (!st->chamberDegraded && st->chamberTemp >= -20.0 && st->chamberTemp <= 60.0) {
+        this->channels[TREND_CHANNEL_TEMP].AddSample(st->chamberTemp);
+      }
+      if (st->CO2Mode > 0 && !st->CO2Degraded && st->CO2Level >= 0) {
+        this->channels[TREND_CHANNEL_CO2].AddSample(st->CO2Level);
+      }
+      if (st->O2Mode > 0 && st->O2Level >= 0) {
+        this->channels[TREND_CHANNEL_O2].AddSample(st->O2Level);
+      }
+
+      if (millis() - this->minuteStartedAt < TREND_SAMPLE_TIME) {
+        return;
+      }
+      this->minuteStartedAt += TREND_SAMPLE_TIME;
+      this->minuteCount++;
+      this->minutesInBlock++;
+      for (byte c = 0; c < TREND_CHANNELS; c++) {
+        this->channels[c].CloseMinute();
+        if (this->minutesInBlock >= TREND_BLOCK_MINUTES) {
+          this->channels[c].CloseBlock();
+        }
+      }
+      if (this->minutesInBlock >= TREND_BLOCK_MINUTES) {
+        this->minutesInBlock = 0;
+      }
+    }
+
+    void DrawSparkline(byte channel, byte glyphs[TREND_GLYPHS][8]) {
+      // The last TREND_MINUTES minutes as bars, oldest on the left, into TREND_GLYPHS custom characters.  Scaled to the
+      // minutes shown, but never to less than TREND_SPARK_MIN_SPAN so noise doesn't look like a swing.  Only needed
+      // when a minute closes, which is the only time the history is gone through.
+      IncuversTrendChannel* history = &this->channels[channel];
+      int16_t low = TREND_NO_DATA;
+      int16_t high = TREND_NO_DATA;
+
+      for (byte age = 0; age < TREND_MINUTES; age++) {
+        int16_t value = history->getMinute(age);
+        if (value == TREND_NO_DATA) {
+          continue;
+        }
+        if (low == TREND_NO_DATA || value < low) {
+          low = value;
+        }
+        if (high == TREND_NO_DATA || value > high) {
+          high = value;
+        }
+      }
+      long span = (long)high - low;
+      if (span < TREND_SPARK_MIN_SPAN) {
+        low = low - (TREND_SPARK_MIN_SPAN - span) / 2;
+        span = TREND_SPARK_MIN_SPAN;
+      }
+
+      memset(glyphs, 0, TREND_GLYPHS * 8);
+      for (byte i = 0; i < TREND_MINUTES; i++) {
+        int16_t value = history->getMinute(TREND_MINUTES - 1 - i);
+        if (value == TREND_NO_DATA) {
+          continue;
+        }
+        byte height = 1 + ((long)value - low) * 7 / span;
+        for (byte row = 8 - height; row < 8; row++) {
+          glyphs[i / 5][row] |= 0x10 >> (i % 5);
+        }
+      }
+    }
+
+    IncuversTrendChannel* getChannel(byte channel) {
+      return &this->channels[channel];
+    }
+
+    unsigned long getMinuteCount() {
+      return this->minuteCount;
+    }
+};
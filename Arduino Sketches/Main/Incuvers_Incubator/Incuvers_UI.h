@@ -1,11 +1,85 @@
+// The setup menu is a state machine driven from DoTick(), one button event per tick, so the controllers keep running
+// while someone is in it.
+#define MENU_STATE_NONE 0           // Not in the menu, the status screen is shown
+#define MENU_STATE_MESSAGE 1        // A message with a loading bar, then menuNextState
+#define MENU_STATE_PAGE 2           // One of the MAINMENU_ pages, menuScreen
+#define MENU_STATE_ADJUST 3         // Adjusting a set point, menuItem: 1 = temperature, 2 = CO2, 3 = O2
+#define MENU_STATE_TOGGLE 4         // Changing a mode, menuItem: 1 = heat, 2 = fan, 3 = CO2, 4 = O2, 5 = light
+#define MENU_STATE_PROFILE 5        // Editing a profile, menuItem is the field
+#define MENU_STATE_INFO 6           // Unit information, menuItem is the first line shown
+#define MENU_STATE_SENSORS 7        // Sensor setup, menuItem is the role being looked for
+#define MENU_STATE_SENSORS_NEXT 8   // Sensor setup, go on to menuNextRole (after a message)
+
+struct MenuPageText {
+  byte title;                       // UI_TEXT_
+  byte optOne;                      // Beside the upper button
+  byte optTwo;                      // Beside the lower button
+};
+
+// One per MAINMENU_ page, in order.
+const MenuPageText menuPageTexts[] PROGMEM = {
+  { UI_TEXT_SET_TEMP, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_SET_CO2, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_SET_O2, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_SET_LED_ON, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_SET_LED_OFF, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_SETTINGS, UI_TEXT_SAVE, UI_TEXT_ADVANCED },
+  { UI_TEXT_HEATING, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_FAN_MODE, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_CO2, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_OXYGEN, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_CO2_TANK, UI_TEXT_NEW, UI_TEXT_NEXT },
+  { UI_TEXT_N2_TANK, UI_TEXT_NEW, UI_TEXT_NEXT },
+  { UI_TEXT_LIGHT, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_PROFILE, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_TEMP_SENSORS, UI_TEXT_SETUP, UI_TEXT_NEXT },
+  { UI_TEXT_INFORMATION, UI_TEXT_SET, UI_TEXT_NEXT },
+  { UI_TEXT_DEFAULTS, UI_TEXT_RESET, UI_TEXT_NEXT },
+  { UI_TEXT_SETTINGS, UI_TEXT_SAVE, UI_TEXT_BASIC }
+};
+
 class IncuversUI {
   private:
-    LiquidTWI2* lcd;
+    IncuversLCD* lcd;
+    IncuversLCDBuffer screen;       // Everything but the startup screens draws here, see LCDDrawDefaultUI()
     IncuversSettingsHandler* incSet;
-    int lastButtonState;
-    int loopCountButtonState;
+    IncuversStatus* incStatus;
+    IncuversProfileRunner* incProfile;
+    IncuversButtons buttons;
+    IncuversAlarm alarm;
+    IncuversTrend trend;
+    byte statusPage;                // 0 = the status screen, else the trend page of channel statusPage - 1
+    byte glyphs[TREND_GLYPHS][8];   // The sparkline in the LCD's custom characters
+    byte glyphsChannel;             // Whose sparkline that is, 0xFF = none
+    unsigned long glyphsMinute;     // trend.getMinuteCount() when it was drawn
+    int loopCountButtonState;       // Repeats of the button being held, for fast forward
     unsigned long lastRefresh;
+    unsigned long lastStatusLine;
+    unsigned long lastDrawMicros;   // Time taken to draw and queue the last status screen
+
+    byte menuState;                 // MENU_STATE_*
+    int menuScreen;
+    int menuItem;
+    unsigned long menuStartedAt;    // When the message, info line or sensor search started
+    byte menuMessage;               // UI_TEXT_ shown by the message
+    int menuMessageValue;           // Printed after it, unless 0
+    byte menuNextState;
+    byte menuNextRole;
+    byte sensorReturnState;         // Where the sensor setup goes when it's done
+    float sensorBaseline[SENSORTABLE_MAX];
     
+    byte AddDebugDescription(char* desc, byte count, char letter, const __FlashStringHelper* name) {
+      // The long description goes to the serial port as we go, the letters are added to desc for the LCD.
+      if (count == 0) {
+        Serial.println(F("Debug build: "));
+      }
+      Serial.print(name);
+      size_t end = strlen(desc);
+      desc[end] = letter;
+      desc[end + 1] = 0;
+      return count + 1;
+    }
+
     void DisplayLoadingBar() {
       for (int s = 0; s<16; s++) {
         this->lcd->setCursor(s,1);
@@ -15,79 +89,92 @@ class IncuversUI {
     }
     
     void LCDDrawDualLineUI() {
+      StatusSnapshot* st = incStatus->Get();
+      char reading[8];
       #ifdef DEBUG_UI
       Serial.print(F("UI::LCDDrawDualLineUI - "));
       #endif
         
       int rowI = 0;
-      if (incSet->getHeatMode() == 1) {
+      if (st->heatMode == 1) {
         #ifdef DEBUG_UI
         Serial.print(F("Heat "));
         #endif
         
-        lcd->setCursor(0, rowI);
-        lcd->print("Temp: ");
-        if (incSet->getHeatMode() == 1) {
-          lcd->print(incSet->getChamberTemperature(), 1);
-          lcd->print("\337C  ");
-          if (incSet->getChamberTemperature() < 10.0) {
-            lcd->print(" ");
+        screen.setCursor(0, rowI);
+        screen.print(UIText(UI_TEXT_TEMP));
+        if (st->chamberDegraded) {
+          screen.print(UIText(UI_TEXT_DEGRADED));
+          screen.print(GetIndicator(st->doorOn, st->doorStepping, true, false));
+          screen.print(GetIndicator(st->chamberOn, st->chamberStepping, false, false));
+        } else if (st->heatMode == 1) {
+          FormatFixed(reading, st->chamberTemp, 1);
+          screen.print(reading);
+          screen.print(UIText(UI_TEXT_DEGREES));
+          if (st->chamberTemp < 10.0) {
+            screen.print(' ');
           }
-          lcd->print(GetIndicator(incSet->isDoorOn(), incSet->isDoorStepping(), true, false));
-          lcd->print(GetIndicator(incSet->isChamberOn(), incSet->isChamberStepping(), false, false));
-        } else if (incSet->getChamberTemperature() < -20){
-          lcd->print(F("Error   "));
+          screen.print(GetIndicator(st->doorOn, st->doorStepping, true, false));
+          screen.print(GetIndicator(st->chamberOn, st->chamberStepping, false, false));
+        } else if (st->chamberTemp < -20){
+          screen.print(UIText(UI_TEXT_ERROR));
         } else {
-          lcd->print(F("Disabled"));
+          screen.print(UIText(UI_TEXT_DISABLED));
         }
         rowI++;
       }
-      if (incSet->getCO2Mode() > 0) {
+      if (st->CO2Mode > 0) {
         #ifdef DEBUG_UI
         Serial.print(F("CO2 "));
         #endif
-        lcd->setCursor(0, rowI);
-        lcd->print(" CO2: ");
-        if (incSet->getCO2Mode() > 0 && incSet->getCO2Level() >= 0) {
-          lcd->print(incSet->getCO2Level(), 1);
-          lcd->print("%    ");
-          if (incSet->getCO2Level() < 10.0) {
-            lcd->print(" ");
+        screen.setCursor(0, rowI);
+        screen.print(UIText(UI_TEXT_CO2_LABEL));
+        if (st->CO2Degraded) {
+          screen.print(UIText(UI_TEXT_DEGRADED));
+          screen.print(' ');
+          screen.print(GetIndicator(st->CO2Open, st->CO2Stepping, false, false)); 
+        } else if (st->CO2Mode > 0 && st->CO2Level >= 0) {
+          FormatFixed(reading, st->CO2Level, 1);
+          screen.print(reading);
+          screen.print(UIText(UI_TEXT_PERCENT));
+          if (st->CO2Level < 10.0) {
+            screen.print(' ');
           }
-          lcd->print(GetIndicator(incSet->isCO2Open(), incSet->isCO2Stepping(), false, false)); 
-        } else if (incSet->getCO2Level() < 0){
-          lcd->print(F("Error   "));
+          screen.print(GetIndicator(st->CO2Open, st->CO2Stepping, false, false)); 
+        } else if (st->CO2Level < 0){
+          screen.print(UIText(UI_TEXT_ERROR));
         } else {
-          lcd->print(F("Disabled"));
+          screen.print(UIText(UI_TEXT_DISABLED));
         }
         rowI++;
       }
-      if (incSet->getO2Mode() > 0) {
+      if (st->O2Mode > 0) {
         #ifdef DEBUG_UI
         Serial.print(F("O2 "));
         #endif
-        lcd->setCursor(0, rowI);
-        lcd->print("  O2: ");
-        if (incSet->getO2Mode() > 0 && incSet->getO2Level() >= 0) {
-          lcd->print(incSet->getO2Level(), 1);
-          lcd->print("%    ");
-          if (incSet->getO2Level() < 10.0) {
-            lcd->print(" ");
+        screen.setCursor(0, rowI);
+        screen.print(UIText(UI_TEXT_O2_LABEL));
+        if (st->O2Mode > 0 && st->O2Level >= 0) {
+          FormatFixed(reading, st->O2Level, 1);
+          screen.print(reading);
+          screen.print(UIText(UI_TEXT_PERCENT));
+          if (st->O2Level < 10.0) {
+            screen.print(' ');
           }
-          lcd->print(GetIndicator(incSet->isO2Open(), incSet->isO2Stepping(), false, false)); 
-        } else if (incSet->getO2Level() < 0){
-          lcd->print(F("Error   "));
+          screen.print(GetIndicator(st->O2Open, st->O2Stepping, false, false)); 
+        } else if (st->O2Level < 0){
+          screen.print(UIText(UI_TEXT_ERROR));
         } else {
-          lcd->print(F("Disabled"));
+          screen.print(UIText(UI_TEXT_DISABLED));
         }
         rowI++;
       }
-      if (incSet->getLightMode() > 0) {
+      if (st->lightMode > 0) {
         #ifdef DEBUG_UI
         Serial.print(F("Light "));
         #endif
-        lcd->setCursor(0, rowI);
-        lcd->print(incSet->getLightModule()->GetOldUIDisplay());
+        screen.setCursor(0, rowI);
+        incSet->getLightModule()->PrintOldUIDisplay(&screen);
         rowI++;
       }
       #ifdef DEBUG_UI
@@ -96,289 +183,258 @@ class IncuversUI {
     }
     
     void LCDDrawNewUI() {
+      StatusSnapshot* st = incStatus->Get();
+      char reading[8];
       /* 0123456789ABCDEF
        * T.*+  CO2+   O2+
        * 35.5  10.5  18.2
        */
 
       // TODO: Fix this UI display to support lighting.
-      lcd->setCursor(0, 0);
-      lcd->print("T.");
-      lcd->print(GetIndicator(incSet->isDoorOn(), incSet->isDoorStepping(), true, false));
-      lcd->print(GetIndicator(incSet->isChamberOn(), incSet->isChamberStepping(), false, false));
-      lcd->print("  CO2");
-      lcd->print(GetIndicator(incSet->isCO2Open(), incSet->isCO2Stepping(), false, false)); 
-      lcd->print("   O2");
-      lcd->print(GetIndicator(incSet->isO2Open(), incSet->isO2Stepping(), false, false)); 
+      screen.setCursor(0, 0);
+      screen.print(UIText(UI_TEXT_NEW_TEMP));
+      screen.print(GetIndicator(st->doorOn, st->doorStepping, true, false));
+      screen.print(GetIndicator(st->chamberOn, st->chamberStepping, false, false));
+      screen.print(UIText(UI_TEXT_NEW_CO2));
+      screen.print(GetIndicator(st->CO2Open, st->CO2Stepping, false, false)); 
+      screen.print(UIText(UI_TEXT_NEW_O2));
+      screen.print(GetIndicator(st->O2Open, st->O2Stepping, false, false)); 
       
-      lcd->setCursor(0, 1);
-      if (incSet->getChamberTemperature() > 60.0 || incSet->getChamberTemperature() < -20.0) {
-        lcd->print(CentreStringForDisplay("err", 5));
+      screen.setCursor(0, 1);
+      if (st->chamberDegraded) {
+        PrintCentred(&screen, UIText(UI_TEXT_DEG), 5);
+      } else if (st->chamberTemp > 60.0 || st->chamberTemp < -20.0) {
+        PrintCentred(&screen, UIText(UI_TEXT_ERR), 5);
       } else {
-        lcd->print(CentreStringForDisplay(String(incSet->getChamberTemperature(), 1), 5));
+        FormatFixed(reading, st->chamberTemp, 1);
+        PrintCentred(&screen, reading, 5);
       }
-      if (incSet->getCO2Level() < 0) {
-        lcd->print(CentreStringForDisplay("err", 6));
+      if (st->CO2Degraded) {
+        PrintCentred(&screen, UIText(UI_TEXT_DEG), 6);
+      } else if (st->CO2Level < 0) {
+        PrintCentred(&screen, UIText(UI_TEXT_ERR), 6);
       } else {
-        lcd->print(CentreStringForDisplay(String(incSet->getCO2Level(), 1), 6));
+        FormatFixed(reading, st->CO2Level, 1);
+        PrintCentred(&screen, reading, 6);
       }
-      if (incSet->getO2Level() < 0) {
-        lcd->print(CentreStringForDisplay("err", 5));
+      if (st->O2Level < 0) {
+        PrintCentred(&screen, UIText(UI_TEXT_ERR), 5);
       } else {
-        lcd->print(CentreStringForDisplay(String(incSet->getO2Level(), 1), 5));
+        FormatFixed(reading, st->O2Level, 1);
+        PrintCentred(&screen, reading, 5);
       }
     }
 
-    void SerialPrintStatus() {
-      Serial.print(ConvertMillisToReadable(millis()));
-      Serial.print(F(" ID "));              // Identification
-      Serial.print(incSet->getSerial());
-      Serial.print(F(" TC "));              // Temperature, chamber
-      Serial.print(incSet->getChamberTemperature(), 2);
-      Serial.print(F(" TD "));              // Temperature, door
-      Serial.print(incSet->getDoorTemperature(), 2);
-      Serial.print(F(" TO "));              // Temperature, other
-      Serial.print(incSet->getOtherTemperature(), 2);
-      Serial.print(F(" CO "));              // CO2 level reading
-      Serial.print(incSet->getCO2Level(), 2);
-      Serial.print(F(" OO "));              // O2 level reading
-      Serial.print(incSet->getO2Level(), 2);
-      Serial.print(F(" AP "));              // Active peripherals
-      Serial.print(GetIndicator(incSet->isDoorOn(), incSet->isDoorStepping(), false, true));
-      Serial.print(GetIndicator(incSet->isChamberOn(), incSet->isChamberStepping(), false, true));
-      Serial.print(GetIndicator(incSet->isCO2Open(), incSet->isCO2Stepping(), false, true));
-      Serial.print(GetIndicator(incSet->isO2Open(), incSet->isO2Stepping(), false, true));
-      Serial.print(incSet->getLightModule()->GetSerialAPIndicator());
-      Serial.print(F(" OA "));              // Orchestrated alarms
-      Serial.print(GetIndicator(incSet->isHeatAlarmed(), false, false, true));
-      Serial.print(GetIndicator(incSet->isCO2Alarmed(), false, false, true));
-      Serial.print(GetIndicator(incSet->isO2Alarmed(), false, false, true));
-      #ifdef DEBUG_MEMORY
-      Serial.print(F(" FM "));              // Free memory
-      Serial.print(freeMemory());
-      #endif
-      Serial.println();
+    void PrintTrendValue(int16_t value, byte width) {
+      char reading[8];
+      if (value == TREND_NO_DATA) {
+        PrintCentred(&screen, UIText(UI_TEXT_NO_DATA), width);
+        return;
+      }
+      // Shown to a tenth
+      FormatScaled(reading, ((long)value + (value < 0 ? -5 : 5)) / (TREND_SCALE / 10), 1);
+      PrintCentred(&screen, reading, width);
     }
-    
-    void AlarmOrchestrator() {
-      if ((incSet->isHeatAlarmed() || incSet->isCO2Alarmed() || incSet->isO2Alarmed())/* && incSet->getAlarmMode() == 2*/) {
-        incSet->MakeSafeState();
-        Wire.beginTransmission(0x20); // Connect to chip
-        Wire.write(0x13);             // Address port B
-        Wire.write(0x01);                // Sound On
-        Wire.endTransmission();       // Close connection
-        delay(500);
-        Wire.beginTransmission(0x20); // Connect to chip
-        Wire.write(0x13);             // Address port B
-        Wire.write(0x00);                // Sound On
-        Wire.endTransmission();       // Close connection
-        delay(500);
-        incSet->ResetAlarms();
+
+    void UpdateSparkline(byte channel) {
+      // Only the custom characters which changed are sent.  The LCD redraws them wherever they're shown, the
+      // framebuffer doesn't know about it.
+      byte drawn[TREND_GLYPHS][8];
+      trend.DrawSparkline(channel, drawn);
+      for (byte g = 0; g < TREND_GLYPHS; g++) {
+        if (this->glyphsChannel == 0xFF || memcmp(drawn[g], this->glyphs[g], 8) != 0) {
+          this->lcd->createChar(g, drawn[g]);
+          memcpy(this->glyphs[g], drawn[g], 8);
+        }
       }
+      this->glyphsChannel = channel;
+      this->glyphsMinute = trend.getMinuteCount();
     }
-    
-    int PollButton() {
-      int readVal;
-      int returnVal = 0;
-      Wire.beginTransmission(0x20); // Connect to chip
-      Wire.write(0x12);             // Address port A
-      Wire.endTransmission();       // Close connection
-      Wire.requestFrom(0x20, 1);    // Request one Byte
-      readVal = Wire.read();
-      returnVal = readVal & 3; 
-      #ifdef DEBUG_UI
-        Serial.print(F("Poll: "));
-        Serial.print(readVal);
-        Serial.print(F(" --> "));
-        Serial.println(returnVal);
-      #endif
-      
-      return(returnVal);          // Return the state 
-                                    //  0 = no buttons pushed
-                                    //  1 = upper button pushed
-                                    //  2 = lower button pushed
-                                    //  3 = both buttons pushed
+
+    void LCDDrawTrendPage(byte channel) {
+      /* 0123456789ABCDEF
+       * T 24h   ########     the last TREND_MINUTES minutes, oldest on the left
+       * 35.1  37.0  37.2     lowest, mean and highest over the last day
+       */
+      IncuversTrendChannel* history = trend.getChannel(channel);
+      if (channel != this->glyphsChannel || trend.getMinuteCount() != this->glyphsMinute) {
+        UpdateSparkline(channel);
+      }
+
+      screen.setCursor(0, 0);
+      screen.print(UIText(UI_TEXT_TREND_TEMP + channel));
+      screen.setCursor(LCD_COLS - TREND_GLYPHS, 0);
+      for (byte g = 0; g < TREND_GLYPHS; g++) {
+        screen.write(8 + g);          // 0 to 7 are the same characters, but 0 marks a cell the framebuffer must send
+      }
+      screen.setCursor(0, 1);
+      PrintTrendValue(history->getLow(), 5);
+      PrintTrendValue(history->getMean(), 6);
+      PrintTrendValue(history->getHigh(), 5);
     }
-    
-    int GetButtonState() {
-      // instead of reading the button once which can cause misreads during a button change operation, if the first reading is not 0, take two more readings a few moments apart to verify what the user wants to do.
-      int c = 0, s = 0, r = 0;
-    
-      c = PollButton();
-      
-      
-      
-      if (c != 0) {
-        if (c == lastButtonState) {
-          // the button is in the same state as it was at the previous polling,
-          r = c;
-          loopCountButtonState++;
-        } else {
-          loopCountButtonState = 0;
-          // let's do an extra polling, to make sure we get the right value.
-          delay(BUTTON_SECONDPOLLDELAY);
-          s = PollButton();
-          if (c == 3 || s == 3 || (c == 1 && s == 2) || (c == 2 && s == 1)) {
-            r = 3;
-          } else if (c == 2 || s == 2) {
-            r = 2;
-          } else if (c == 1 || s == 1) {
-            r = 1;
-          }
-        }
-        lastButtonState = r;
+
+    boolean IsTrendShown(byte channel) {
+      switch (channel) {
+        case TREND_CHANNEL_CO2:
+          return incSet->getCO2Mode() > 0;
+        case TREND_CHANNEL_O2:
+          return incSet->getO2Mode() > 0;
+      }
+      return true;
+    }
+
+    void StepStatusPage(int userInput) {
+      // The lower button goes on through the trend pages of whatever is enabled and back round, the upper one goes
+      // straight back to the status screen.
+      if (userInput == 1) {
+        statusPage = 0;
       } else {
-        lastButtonState = 0;
-        loopCountButtonState = 0;
+        do {
+          statusPage = (statusPage + 1) % (TREND_CHANNELS + 1);
+        } while (statusPage != 0 && !IsTrendShown(statusPage - 1));
       }
-      
-      return r;
+      this->lastRefresh = 0;          // Show it straight away
     }
 
-    void DoFeatureToggle(int feat)
-    {
-      boolean doLoop = true;
-      boolean redraw = true;
-      int userInput;
-      int mode;
-      String tag;
-      String onTag;
-      
-      while (doLoop) {
-        if (redraw) {
-          switch (feat) {
-            case 1: // heat
-              mode = incSet->getHeatMode();
-              tag = F("Heat: ");
-              onTag = F("Enabled ");
-              break;
-            case 2: // fan
-              mode = incSet->getFanMode();
-              tag = F("Fan: ");
-              onTag = F("Always  ");
-              break;
-            case 3: // CO2
-              mode = incSet->getCO2Mode();
-              tag = F("CO2: ");
-              if (incSet->getCO2Mode() == 1) { onTag = F("Monitor "); }
-              if (incSet->getCO2Mode() == 2) { onTag = F("Maintain"); }
-              break;
-            case 4: // O2
-              mode = incSet->getO2Mode();
-              tag = F("O2: ");
-              if (incSet->getO2Mode() == 1) { onTag = F("Monitor "); }
-              if (incSet->getO2Mode() == 2) { onTag = F("Maintain"); }
-              break;
-            case 5: // Light
-              mode = incSet->getLightMode();
-              tag = F("Light: ");
-              if (incSet->getLightMode() == 1) { onTag = F("Int."); }
-              if (incSet->getLightMode() == 2) { onTag = F("Ext."); }
-              break;
-          }
-          lcd->clear();
-          lcd->setCursor(0, 0);
-          lcd->print(tag);
-          if (mode != 0) {
-            lcd->print(onTag);
-          } else {
-            lcd->print(F("Disabled"));
-          }
-          delay(MENU_UI_POST_DELAY);
-        }
-       
-        userInput = GetButtonState();
-        
-        switch (userInput) {
-          case 0:
-            delay(100);
-            redraw=false;
-            break;
-          case 1:
-            // Toggle Heat
-            switch (feat) {
-              case 1: // heat
-                if (incSet->getHeatMode() == 0) {
-                  incSet->setHeatMode(1);
-                } else {
-                  incSet->setHeatMode(0);
-                }
-                break;
-              case 2: // fan
-                if (incSet->getFanMode() == 0) {
-                  incSet->setFanMode(4);
-                } else {
-                  incSet->setFanMode(0);
-                }
-                break;
-              case 3: // CO2
-                if (incSet->getCO2Mode() == 0) {
-                  incSet->setCO2Mode(1);
-                } else if (incSet->getCO2Mode() == 1) {
-                  incSet->setCO2Mode(2);
-                } else {
-                  incSet->setCO2Mode(0);
-                }
-                break;
-              case 4: // O2
-                if (incSet->getO2Mode() == 0) {
-                  incSet->setO2Mode(1);
-                } else if (incSet->getO2Mode() == 1) {
-                  incSet->setO2Mode(2);
-                } else {
-                  incSet->setO2Mode(0);
-                }
-                break;
-              case 5: // Light
-                if (incSet->getLightMode() == 0) {
-                  incSet->setLightMode(1);
-                } else if (incSet->getLightMode() == 1) {
-                  incSet->setLightMode(2);
-                } else {
-                  incSet->setLightMode(0);
-                }
-                break;
-            }
-            
-            redraw = true;
-            break;
-          case 2:
-            // Do nothing
-            break;
-          case 3:
-            // exit
-            doLoop=false;
+    void SerialPrintStatus() {
+      // Formatted into the status line buffer, which sends it without holding up the loop.
+      if (!statusLine.Begin()) {
+        return;
+      }
+      StatusSnapshot* st = incStatus->Get();
+      char uptime[LCD_COLS + 1];
+      FormatDuration(uptime, millis(), 20, true);
+      statusLine.print(uptime);
+      statusLine.print(F(" ID "));          // Identification
+      statusLine.print(st->serial);
+      statusLine.print(F(" TC "));          // Temperature, chamber
+      statusLine.print(st->chamberTemp, 2);
+      statusLine.print(F(" TD "));          // Temperature, door
+      statusLine.print(st->doorTemp, 2);
+      statusLine.print(F(" TO "));          // Temperature, other
+      statusLine.print(st->otherTemp, 2);
+      incStatus->PrintZones(&statusLine);
+      statusLine.print(F(" TW "));          // Temperature, warming up
+      statusLine.print(GetIndicator(st->chamberWarmingUp, false, false, true));
+      statusLine.print(F(" WT "));          // Time to setpoint of the last warm-up, s
+      statusLine.print(st->warmUpTime);
+      statusLine.print(F(" CO "));          // CO2 level reading
+      statusLine.print(st->CO2Level, 2);
+      statusLine.print(F(" OO "));          // O2 level reading
+      statusLine.print(st->O2Level, 2);
+      statusLine.print(F(" AP "));          // Active peripherals
+      statusLine.print(GetIndicator(st->doorOn, st->doorStepping, false, true));
+      statusLine.print(GetIndicator(st->chamberOn, st->chamberStepping, false, true));
+      statusLine.print(GetIndicator(st->CO2Open, st->CO2Stepping, false, true));
+      statusLine.print(GetIndicator(st->O2Open, st->O2Stepping, false, true));
+      statusLine.print(st->lightIndicator);
+      statusLine.print(F(" OA "));          // Orchestrated alarms
+      statusLine.print(GetIndicator(st->heatAlarmed, false, false, true));
+      statusLine.print(GetIndicator(st->CO2Alarmed, false, false, true));
+      statusLine.print(GetIndicator(st->O2Alarmed, false, false, true));
+      statusLine.print(F(" AK "));          // Alarms acknowledged (muted), ALARM_SOURCE_ bits
+      statusLine.print(alarm.getMuted());
+      incStatus->PrintAlarmHistory(&statusLine);
+      statusLine.print(F(" DG "));          // Degraded (open loop) controllers
+      statusLine.print(GetIndicator(st->chamberDegraded, false, false, true));
+      statusLine.print(GetIndicator(st->CO2Degraded, false, false, true));
+      statusLine.print(F(" DC "));          // Learned duty, chamber heater
+      statusLine.print(st->chamberDuty, 3);
+      statusLine.print(F(" DK "));          // Learned duty, CO2 valve
+      statusLine.print(st->CO2Duty, 4);
+      incStatus->PrintGasMeters(&statusLine);
+      statusLine.print(F(" PW "));          // Power draw, mA
+      statusLine.print(st->powerDraw);
+      statusLine.print(F(" PD "));          // Power requests deferred
+      statusLine.print(st->powerDeferred);
+      incStatus->PrintDoor(&statusLine);
+      statusLine.print(F(" PS "));          // Profile segment being run (-1 = none)
+      statusLine.print(st->profileSegment);
+      statusLine.print(F(" LB "));          // I2C bytes sent by the last LCD refresh
+      statusLine.print(screen.getLastFlushBytes());
+      statusLine.print(F(" LT "));          // Time to draw the last status screen, us
+      statusLine.print(this->lastDrawMicros);
+      statusLine.print(F(" SD "));          // Status lines dropped, the host wasn't keeping up
+      statusLine.print(statusLine.getDropped());
+      #ifdef DEBUG_MEMORY
+      statusLine.print(F(" FM "));          // Free memory
+      statusLine.print(freeMemory());
+      statusLine.print(F(" SX "));          // Status lines cut short
+      statusLine.print(statusLine.getTruncated());
+      #endif
+      statusLine.println();
+      statusLine.Send();
+    }
+    
+    int GetButtonEvent() {
+      // One event per press, repeated every MENU_UI_REDRAW_DELAY while the button is held (loopCountButtonState counts
+      // the repeats for fast forward).  Returns 0 = nothing, 1 = upper, 2 = lower or 3 = both.  Never waits.
+      this->DoQuickTick();
+
+      byte event;
+      while ((event = this->buttons.GetEvent()) != 0) {
+        switch (BUTTON_EVENT_TYPE(event)) {
+          case BUTTON_EVENT_PRESS:
+          case BUTTON_EVENT_CHORD:
+            loopCountButtonState = 0;
+            return BUTTON_EVENT_BUTTONS(event);
+          case BUTTON_EVENT_LONG:
+            loopCountButtonState++;
+            return BUTTON_EVENT_BUTTONS(event);
+          case BUTTON_EVENT_RELEASE:
+            loopCountButtonState = 0;
             break;
         }
       }
+      return 0;
     }
 
-    void DoSaveSettings() {
-      incSet->PerformSaveSettings();
-      lcd->clear();
-      lcd->setCursor(0, 0);
-      lcd->print(F("Settings saved."));
-      lcd->setCursor(0, 1);
-      lcd->print(F("Exiting setup..."));  
+    void ShowMessage(byte lineOne, int value, byte nextState) {
+      // Shown for MENU_UI_MESSAGE_TIME with a loading bar, then the menu carries on in nextState.
+      menuMessage = lineOne;
+      menuMessageValue = value;
+      menuNextState = nextState;
+      menuStartedAt = millis();
+      menuState = MENU_STATE_MESSAGE;
+    }
+
+    void ExitSetup(byte message) {
       incSet->CheckSettings();
-      delay(MENU_UI_POST_DELAY * 4);
-      lcd->clear();
+      ShowMessage(message, 0, MENU_STATE_NONE);
     }
 
-    void DrawVariableMenuPage(String title, float value) {
-      lcd->clear();
-      lcd->setCursor(0, 0);
-      lcd->print(title);
-      lcd->setCursor(2, 1);
-      lcd->print(value, 1);
-      lcd->setCursor(15, 0);
-      lcd->print("+");
-      lcd->setCursor(15, 1);
-      lcd->print("-");
-      delay(MENU_UI_POST_DELAY);
+    void DrawMessage() {
+      screen.setCursor(0, 0);
+      screen.print(UIText(menuMessage));
+      if (menuMessageValue != 0) {
+        screen.print(menuMessageValue);
+      }
+      unsigned long shown = millis() - menuStartedAt;
+      for (unsigned long s = 0; s < LCD_COLS && s * MENU_UI_MESSAGE_TIME < shown * LCD_COLS; s++) {
+        screen.setCursor(s, 1);
+        screen.print('.');
+      }
+    }
+
+    void DrawAdjustMarks() {
+      screen.setCursor(15, 0);
+      screen.print('+');
+      screen.setCursor(15, 1);
+      screen.print('-');
+    }
+
+    void DrawVariableMenuPage(byte title, float value) {
+      char reading[8];
+      screen.setCursor(0, 0);
+      screen.print(UIText(title));
+      screen.setCursor(2, 1);
+      FormatFixed(reading, value, 1);
+      screen.print(reading);
+      DrawAdjustMarks();
     }
 
     void AdjustTempSetting(boolean upWards) {
+      // The settings handler holds set points to their range.
       float newSet = incSet->getTemperatureSetPoint();
       if (upWards && loopCountButtonState >= BUTTON_LOOPCOUNTFASTFORWARD) {
         #ifdef DEBUG_UI
@@ -401,12 +457,6 @@ class IncuversUI {
         #endif
         newSet = newSet - TEMPERATURE_DLT;
       }
-      if (newSet < TEMPERATURE_MIN) { 
-        newSet = TEMPERATURE_MIN; 
-      }
-      if (newSet > TEMPERATURE_MAX) { 
-        newSet = TEMPERATURE_MAX; 
-      }
       incSet->setTemperatureSetPoint(newSet);
     }
 
@@ -421,12 +471,6 @@ class IncuversUI {
       } else if (!upWards && loopCountButtonState < BUTTON_LOOPCOUNTFASTFORWARD) {
         newSet = newSet - CO2_DLT;
       }
-      if (newSet < CO2_MIN) { 
-        newSet = CO2_MIN; 
-      }
-      if (newSet > CO2_MAX) { 
-        newSet = CO2_MAX; 
-      }
       incSet->setCO2SetPoint(newSet);
     }
 
@@ -441,207 +485,430 @@ class IncuversUI {
       } else if (!upWards && loopCountButtonState < BUTTON_LOOPCOUNTFASTFORWARD) {
         newSet = newSet - OO_DLT;
       }
-      if (newSet < OO_MIN) { 
-        newSet = OO_MIN; 
-      }
-      if (newSet > OO_MAX) { 
-        newSet = OO_MAX; 
-      }
       incSet->setO2SetPoint(newSet);
     }
     
-    void DoVariableAdjust(int screenId) {
-      boolean doLoop = true;
-      boolean redraw = true;
-      int userInput;
-    
-      while (doLoop) {
-        switch (screenId) {
-          case 1 :
-            if (redraw) {
-              DrawVariableMenuPage(F("Temperature"), incSet->getTemperatureSetPoint());
-              redraw = false;
-            } else if (userInput == 1 || userInput == 2) {
-              if (userInput == 1) { AdjustTempSetting(true); } else { AdjustTempSetting(false); }
-              redraw = true;
-              delay(MENU_UI_REDRAW_DELAY);
-            }
-            break;
-          case 2 :
-            if (redraw) {
-              DrawVariableMenuPage(F("CO2 %"), incSet->getCO2SetPoint());
-              redraw = false;
-            } else if (userInput == 1 || userInput == 2) {
-              if (userInput == 1) { AdjustCO2Setting(true); } else { AdjustCO2Setting(false); }
-              redraw = true;
-              delay(MENU_UI_REDRAW_DELAY);
-            }
-            break;
-          case 3 :
-            if (redraw) {
-              DrawVariableMenuPage(F("O2 %"), incSet->getO2SetPoint());
-              redraw = false;
-            } else if (userInput == 1 || userInput == 2) {
-              if (userInput == 1) { AdjustO2Setting(true); } else { AdjustO2Setting(false); }
-              redraw = true;
-              delay(MENU_UI_REDRAW_DELAY);
-            }
-            break;
-          }
-        
-        if (!redraw) {
-          userInput = GetButtonState();
-        }
-        
-        switch (userInput) {
+    byte GetProfileTargetName(byte target) {
+      switch (target) {
+        case PROFILE_TARGET_TEMP:
+          return UI_TEXT_TEMPERATURE;
+        case PROFILE_TARGET_CO2:
+          return UI_TEXT_CO2_PERCENT;
+        case PROFILE_TARGET_O2:
+          return UI_TEXT_O2_PERCENT;
+      }
+      return UI_TEXT_END;
+    }
+
+    void FormatProfileMinutes(char* out, uint16_t minutes) {
+      out = FormatUnsigned(out, minutes / 60, 1);
+      *out++ = 'h';
+      FormatUnsigned(out, minutes % 60, 2);
+    }
+
+    int AdjustProfileValue(int value, boolean upWards, int delta, int minimum, int maximum) {
+      if (loopCountButtonState >= BUTTON_LOOPCOUNTFASTFORWARD) {
+        delta = delta * BUTTON_FASTFORWARDRATE;
+      }
+      value = upWards ? value + delta : value - delta;
+      if (value < minimum) {
+        value = minimum;
+      }
+      if (value > maximum) {
+        value = maximum;
+      }
+      return value;
+    }
+
+    void AdjustProfileLevel(ProfileSegment* s, boolean upWards) {
+      switch (s->target) {
+        case PROFILE_TARGET_TEMP:
+          s->level = AdjustProfileValue(s->level, upWards, TEMPERATURE_DLT * SETTINGS_FIXED_SCALE, TEMPERATURE_MIN * SETTINGS_FIXED_SCALE, TEMPERATURE_MAX * SETTINGS_FIXED_SCALE);
+          break;
+        case PROFILE_TARGET_CO2:
+          s->level = AdjustProfileValue(s->level, upWards, CO2_DLT * SETTINGS_FIXED_SCALE, CO2_MIN * SETTINGS_FIXED_SCALE, CO2_MAX * SETTINGS_FIXED_SCALE);
+          break;
+        case PROFILE_TARGET_O2:
+          s->level = AdjustProfileValue(s->level, upWards, OO_DLT * SETTINGS_FIXED_SCALE, OO_MIN * SETTINGS_FIXED_SCALE, OO_MAX * SETTINGS_FIXED_SCALE);
+          break;
+      }
+    }
+
+    void DrawProfileField(byte title) {
+      // Prefixed "P1 S2 " with the program and segment being edited, except for the program itself.  The value goes
+      // where this leaves the cursor.
+      DrawAdjustMarks();
+      screen.setCursor(0, 0);
+      if (menuItem > 0) {
+        screen.print('P');
+        screen.print(incProfile->getProgramNumber() + 1);
+        screen.print(UIText(UI_TEXT_SEGMENT));
+        screen.print((menuItem - 1) / 4 + 1);
+        screen.print(' ');
+      }
+      screen.print(UIText(title));
+      screen.setCursor(2, 1);
+    }
+
+    boolean IsProfileFieldPastEnd() {
+      byte segment = (menuItem - 1) / 4;
+      return menuItem > 0 && (segment >= PROFILE_MAX_SEGMENTS || (((menuItem - 1) % 4) > 0 && incProfile->getSegment(segment)->target == PROFILE_TARGET_END));
+    }
+
+    void DrawProfileEdit() {
+      // Field 0 picks the program, then each segment has a target, level, ramp time and hold time, up to the first
+      // "End".  Past the last one the program is saved, and can be started.
+      ProfileSegment* s = incProfile->getSegment((menuItem - 1) / 4);
+      char value[LCD_COLS + 1];
+
+      if (IsProfileFieldPastEnd()) {
+        DrawMainMenuPage(UI_TEXT_PROGRAM, UI_TEXT_RUN, UI_TEXT_SAVE);
+        screen.setCursor(UITextLength(UI_TEXT_PROGRAM), 0);
+        screen.print(incProfile->getProgramNumber() + 1);
+      } else if (menuItem == 0) {
+        DrawProfileField(UI_TEXT_PROGRAM);
+        screen.print(incProfile->getProgramNumber() + 1);
+      } else {
+        switch ((menuItem - 1) % 4) {
           case 0:
-            redraw=false;
-            delay(MENU_UI_POST_DELAY);
+            DrawProfileField(UI_TEXT_TARGET);
+            screen.print(UIText(GetProfileTargetName(s->target)));
             break;
           case 1:
-            // Will take care of it on the next loop run
+            // Fixed point in SETTINGS_FIXED_SCALE, shown to a tenth
+            FormatScaled(value, (s->level + (s->level < 0 ? -5 : 5)) / (SETTINGS_FIXED_SCALE / 10), 1);
+            DrawProfileField(UI_TEXT_LEVEL);
+            screen.print(value);
             break;
           case 2:
-            // Will take care of it on the next loop run
+            FormatProfileMinutes(value, s->rampMinutes);
+            DrawProfileField(UI_TEXT_RAMP);
+            screen.print(value);
             break;
           case 3:
-            // exit
-            doLoop=false;
+            FormatProfileMinutes(value, s->holdMinutes);
+            DrawProfileField(UI_TEXT_HOLD);
+            screen.print(value);
             break;
         }
       }
     }
-    
-    void ShowInfo() {
-      boolean doLoop = true;
-      boolean redraw = true;
-      int userInput;
-      int firstline = 1;
-      int lineId = 0;
-      long displayRedraw = 0;
-    
-      while (doLoop) {
-        if (redraw) {
-          displayRedraw = millis();
-          lineId = 0;
-          lcd->clear();
-          if (firstline == 1) {
-            lcd->setCursor(0, lineId);
-            lcd->print(F("Hrd Rev: "));
-            lcd->print(incSet->getHardware());
-            lineId++;
-          }
-          if (firstline == 1 || firstline == 2) {
-            lcd->setCursor(0, lineId);
-            lcd->print(F("SN: "));
-            lcd->print(incSet->getSerial());
-            lineId++;
-          }
-          if (firstline == 2 || firstline == 3) {
-            lcd->setCursor(0, lineId);
-            lcd->print(F("Hardware opts: "));
-            //lcd->print();
-            lineId++;
-          }
-          if (firstline == 3 || firstline == 4) {
-            String hwSup = F("H ");
-            if (incSet->HasCO2Sensor()) {
-              hwSup = String(hwSup + F("CO2 "));
-            }
-            if (incSet->HasO2Sensor()) {
-              hwSup = String(hwSup + F("O2 "));
-            }
-            if (incSet->CountGasRelays() > 0) {
-              hwSup = String(hwSup + incSet->CountGasRelays() + F("S "));
-            }
-            if (incSet->HasLighting()) {
-              hwSup = String(hwSup + F("L "));
-            }
-            if (incSet->HasPiLink()) {
-              hwSup = String(hwSup + F("PL "));
-            }
-            lcd->setCursor(0, lineId);
-            lcd->print(hwSup);
-            //lcd->print();
-            lineId++;
-          }
-          if (firstline == 4 || firstline == 5) {
-            lcd->setCursor(0, lineId);
-            lcd->print(F("Software incld: "));
-            //lcd->print();
-            lineId++;
-          }
-          if (firstline == 5 || firstline == 6) {
-            String swSup = F("H ");
-            #ifdef INCLUDE_CO2
-            swSup = String(swSup + F("CO2 "));
-            #endif
-            #ifdef INCLUDE_O2
-            swSup = String(swSup + F("O2 "));
-            #endif
-            #ifdef INCLUDE_LIGHT
-            swSup = String(swSup + F("L "));
-            #endif
-            #ifdef INCLUDE_ETHERNET
-            swSup = String(swSup + F("E "));
-            #endif
-            lcd->setCursor(0, lineId);
-            lcd->print(swSup);
-            //lcd->print();
-            lineId++;
-          }
-          redraw = false;
+
+    void DoProfileEditEvent(int userInput) {
+      // + and - adjust, pressing both moves on to the next field.  The program being run is never changed under it.
+      if (incProfile->isRunning()) {
+        ShowMessage(UI_TEXT_PROFILE_RUNNING, 0, MENU_STATE_PAGE);
+        return;
+      }
+      if (IsProfileFieldPastEnd()) {
+        incProfile->SaveProgram();
+        if (userInput == 1) {
+          incProfile->Start();
         }
-        userInput = GetButtonState();
-        
-        if (userInput != 0) {
-          switch (userInput) {
-            case 1:
-              if (firstline > 1) { firstline--; }
-              redraw = true;
-              break;
-            case 2:
-              if (firstline < 5) { firstline++; }
-              redraw = true;
-              break;
-            case 3:
-              doLoop=false;
-              break;
-          }
-          delay(MENU_UI_POST_DELAY);
-        } else {
-          delay(MENU_UI_POST_DELAY);
-          if (displayRedraw + 10000 < millis()) {
-            firstline++;
-            if (firstline > 5) {
-              firstline = 1;
-            }
-          }
+        menuState = MENU_STATE_PAGE;
+        return;
+      }
+
+      if (userInput == 3) {
+        menuItem++;
+        return;
+      }
+
+      boolean upWards = (userInput == 1);
+      ProfileSegment* s = incProfile->getSegment((menuItem - 1) / 4);
+      if (menuItem == 0) {
+        if (!incProfile->LoadProgram((incProfile->getProgramNumber() + (upWards ? 1 : PROFILE_COUNT - 1)) % PROFILE_COUNT)) {
+          ShowMessage(UI_TEXT_PROFILE_RUNNING, 0, MENU_STATE_PAGE);
         }
+        return;
+      }
+      switch ((menuItem - 1) % 4) {
+        case 0:
+          s->target = (s->target + (upWards ? 1 : PROFILE_TARGET_O2)) % (PROFILE_TARGET_O2 + 1);
+          s->level = 0;
+          AdjustProfileLevel(s, true);    // Start from the bottom of the new target's range
+          break;
+        case 1:
+          AdjustProfileLevel(s, upWards);
+          break;
+        case 2:
+          s->rampMinutes = AdjustProfileValue(s->rampMinutes, upWards, PROFILE_MINUTES_DLT, 0, PROFILE_MINUTES_MAX);
+          break;
+        case 3:
+          s->holdMinutes = AdjustProfileValue(s->holdMinutes, upWards, PROFILE_MINUTES_DLT, 0, PROFILE_MINUTES_MAX);
+          break;
       }
     }
 
-    void DrawMainMenuPage(String lineOne, String lineTwo, boolean isStandardPage, String optOne, String optTwo) {
-      lcd->clear();
-      lcd->setCursor(0, 0);
-      lcd->print(lineOne);
-      if (lineTwo.length() > 0) {
-        lcd->setCursor(0, 1);
-        lcd->print(lineTwo);
-      }
-      if (isStandardPage) {
-        lcd->setCursor(13, 0);
-        lcd->print("Set");
-        lcd->setCursor(12, 1);
-        lcd->print("Next");
+    void DrawFeatureToggle() {
+      int mode = 0;
+      byte tag = UI_TEXT_NONE;
+      byte onTag = UI_TEXT_NONE;
+
+      switch (menuItem) {
+        case 1: // heat
+          mode = incSet->getHeatMode();
+          tag = UI_TEXT_HEAT_TAG;
+          onTag = UI_TEXT_ENABLED;
+          break;
+        case 2: // fan
+          mode = incSet->getFanMode();
+          tag = UI_TEXT_FAN_TAG;
+          onTag = UI_TEXT_ALWAYS;
+          break;
+        case 3: // CO2
+          mode = incSet->getCO2Mode();
+          tag = UI_TEXT_CO2_TAG;
+          if (incSet->getCO2Mode() == 1) { onTag = UI_TEXT_MONITOR; }
+          if (incSet->getCO2Mode() == 2) { onTag = UI_TEXT_MAINTAIN; }
+          break;
+        case 4: // O2
+          mode = incSet->getO2Mode();
+          tag = UI_TEXT_O2_TAG;
+          if (incSet->getO2Mode() == 1) { onTag = UI_TEXT_MONITOR; }
+          if (incSet->getO2Mode() == 2) { onTag = UI_TEXT_MAINTAIN; }
+          break;
+        case 5: // Light
+          mode = incSet->getLightMode();
+          tag = UI_TEXT_LIGHT_TAG;
+          if (incSet->getLightMode() == 1) { onTag = UI_TEXT_INTERNAL; }
+          if (incSet->getLightMode() == 2) { onTag = UI_TEXT_EXTERNAL; }
+          break;
+      }
+      screen.setCursor(0, 0);
+      screen.print(UIText(tag));
+      if (mode != 0) {
+        screen.print(UIText(onTag));
       } else {
-        lcd->setCursor((16 - optOne.length()), 0);
-        lcd->print(optOne);
-        lcd->setCursor((16 - optTwo.length()), 1);
-        lcd->print(optTwo);
+        screen.print(UIText(UI_TEXT_DISABLED));
       }
     }
 
+    void DoFeatureToggleEvent(int userInput) {
+      // The upper button steps through the modes, which take effect straight away.
+      if (userInput == 3) {
+        menuState = MENU_STATE_PAGE;
+        return;
+      }
+      if (userInput != 1) {
+        return;
+      }
+      switch (menuItem) {
+        case 1: // heat
+          incSet->setHeatMode(incSet->getHeatMode() == 0 ? 1 : 0);
+          break;
+        case 2: // fan
+          incSet->setFanMode(incSet->getFanMode() == 0 ? 4 : 0);
+          break;
+        case 3: // CO2
+          incSet->setCO2Mode((incSet->getCO2Mode() + 1) % 3);
+          break;
+        case 4: // O2
+          incSet->setO2Mode((incSet->getO2Mode() + 1) % 3);
+          break;
+        case 5: // Light
+          incSet->setLightMode((incSet->getLightMode() + 1) % 3);
+          break;
+      }
+    }
+
+    void DrawVariableAdjust() {
+      switch (menuItem) {
+        case 1:
+          DrawVariableMenuPage(UI_TEXT_TEMPERATURE, incSet->getTemperatureSetPoint());
+          break;
+        case 2:
+          DrawVariableMenuPage(UI_TEXT_CO2_PERCENT, incSet->getCO2SetPoint());
+          break;
+        case 3:
+          DrawVariableMenuPage(UI_TEXT_O2_PERCENT, incSet->getO2SetPoint());
+          break;
+      }
+    }
+
+    void DoVariableAdjustEvent(int userInput) {
+      // The controllers are handed each new set point as it's adjusted.
+      if (userInput == 3) {
+        menuState = MENU_STATE_PAGE;
+        return;
+      }
+      switch (menuItem) {
+        case 1:
+          AdjustTempSetting(userInput == 1);
+          break;
+        case 2:
+          AdjustCO2Setting(userInput == 1);
+          break;
+        case 3:
+          AdjustO2Setting(userInput == 1);
+          break;
+      }
+    }
+
+    void DrawInfo() {
+      int lineId = 0;
+
+      if (millis() - menuStartedAt > 10000) {
+        // Scroll on by itself
+        menuItem = (menuItem % 5) + 1;
+        menuStartedAt = millis();
+      }
+      if (menuItem == 1) {
+        screen.setCursor(0, lineId);
+        screen.print(UIText(UI_TEXT_HARDWARE_REV));
+        incSet->PrintHardware(&screen);
+        lineId++;
+      }
+      if (menuItem == 1 || menuItem == 2) {
+        screen.setCursor(0, lineId);
+        screen.print(UIText(UI_TEXT_SERIAL));
+        screen.print(incSet->getSerialNumber());
+        lineId++;
+      }
+      if (menuItem == 2 || menuItem == 3) {
+        screen.setCursor(0, lineId);
+        screen.print(UIText(UI_TEXT_HARDWARE_OPTS));
+        lineId++;
+      }
+      if (menuItem == 3 || menuItem == 4) {
+        screen.setCursor(0, lineId);
+        screen.print(UIText(UI_TEXT_OPT_HEAT));
+        if (incSet->HasCO2Sensor()) {
+          screen.print(UIText(UI_TEXT_OPT_CO2));
+        }
+        if (incSet->HasO2Sensor()) {
+          screen.print(UIText(UI_TEXT_OPT_O2));
+        }
+        if (incSet->CountGasRelays() > 0) {
+          screen.print(incSet->CountGasRelays());
+          screen.print(UIText(UI_TEXT_OPT_SOLENOIDS));
+        }
+        if (incSet->HasLighting()) {
+          screen.print(UIText(UI_TEXT_OPT_LIGHT));
+        }
+        if (incSet->HasPiLink()) {
+          screen.print(UIText(UI_TEXT_OPT_PILINK));
+        }
+        lineId++;
+      }
+      if (menuItem == 4 || menuItem == 5) {
+        screen.setCursor(0, lineId);
+        screen.print(UIText(UI_TEXT_SOFTWARE_INCLD));
+        lineId++;
+      }
+      if (menuItem == 5) {
+        screen.setCursor(0, lineId);
+        screen.print(UIText(UI_TEXT_OPT_HEAT));
+        #ifdef INCLUDE_CO2
+        screen.print(UIText(UI_TEXT_OPT_CO2));
+        #endif
+        #ifdef INCLUDE_O2
+        screen.print(UIText(UI_TEXT_OPT_O2));
+        #endif
+        #ifdef INCLUDE_LIGHT
+        screen.print(UIText(UI_TEXT_OPT_LIGHT));
+        #endif
+        #ifdef INCLUDE_ETHERNET
+        screen.print(UIText(UI_TEXT_OPT_ETHERNET));
+        #endif
+      }
+    }
+
+    void DoInfoEvent(int userInput) {
+      switch (userInput) {
+        case 1:
+          if (menuItem > 1) { menuItem--; }
+          break;
+        case 2:
+          if (menuItem < 5) { menuItem++; }
+          break;
+        case 3:
+          menuState = MENU_STATE_PAGE;
+          return;
+      }
+      menuStartedAt = millis();
+    }
+
+    void StartSensorRole(byte role) {
+      // Waits for a sensor to warm up SENSORSETUP_RISE from its reading now, see DoSensorSetupTick().
+      IncuversSensorBus* bus = incSet->getHeatModule()->getSensorBus();
+
+      if (role == SENSOR_ROLE_AMBIENT && bus->getCount() <= 2) {
+        role = SENSOR_ROLE_NONE;      // Nothing left over to be the ambient sensor
+      }
+      if (role == SENSOR_ROLE_NONE) {
+        bus->FinishSetup();
+        incSet->ReturnFromSafeState();
+        menuState = sensorReturnState;
+        return;
+      }
+      for (byte i = 0; i < bus->getCount(); i++) {
+        sensorBaseline[i] = bus->getTemperature(i);
+      }
+      menuItem = role;
+      menuStartedAt = millis();
+      menuState = MENU_STATE_SENSORS;
+    }
+
+    byte GetNextSensorRole(byte role) {
+      // Chamber, door, then ambient, then done.
+      switch (role) {
+        case SENSOR_ROLE_CHAMBER:
+          return SENSOR_ROLE_DOOR;
+        case SENSOR_ROLE_DOOR:
+          return SENSOR_ROLE_AMBIENT;
+      }
+      return SENSOR_ROLE_NONE;
+    }
+
+    void DoSensorSetupTick(int userInput) {
+      // The heating system keeps the bus readings fresh.  Pressing both buttons skips the role, and so does giving up
+      // after SENSORSETUP_TIMEOUT; either way it keeps its old sensor.
+      IncuversSensorBus* bus = incSet->getHeatModule()->getSensorBus();
+
+      if (userInput == 3 || millis() - menuStartedAt > SENSORSETUP_TIMEOUT) {
+        StartSensorRole(GetNextSensorRole(menuItem));
+        return;
+      }
+      for (byte i = 0; i < bus->getCount(); i++) {
+        if (sensorBaseline[i] <= -100) {
+          sensorBaseline[i] = bus->getTemperature(i);   // No reading yet when we started
+        } else if (bus->getTemperature(i) - sensorBaseline[i] >= SENSORSETUP_RISE) {
+          bus->setRole(i, menuItem);
+          menuNextRole = GetNextSensorRole(menuItem);
+          ShowMessage(UI_TEXT_FOUND_SENSOR, i + 1, MENU_STATE_SENSORS_NEXT);
+          return;
+        }
+      }
+    }
+
+    void DrawSensorSetup() {
+      screen.setCursor(0, 1);
+      screen.print(UIText(UI_TEXT_BY_HAND));
+      DrawMainMenuPage(UI_TEXT_WARM, UI_TEXT_NONE, UI_TEXT_SKIP);
+      screen.setCursor(UITextLength(UI_TEXT_WARM), 0);
+      incSet->getHeatModule()->getSensorBus()->PrintRoleName(&screen, menuItem);
+    }
+
+    void StartSensorSetup(byte returnState) {
+      // The heaters are held off, they'd warm the sensors for us.  Any sensor left over afterwards becomes the
+      // ambient sensor or an extra zone.
+      incSet->MakeSafeState();
+      incSet->getHeatModule()->RescanSensors();
+      sensorReturnState = returnState;
+      StartSensorRole(SENSOR_ROLE_CHAMBER);
+    }
+
+    void DrawMainMenuPage(byte lineOne, byte optOne, byte optTwo) {
+      // The options are right aligned beside their buttons, over anything already drawn on the second line.
+      screen.setCursor(0, 0);
+      screen.print(UIText(lineOne));
+      screen.setCursor(LCD_COLS - UITextLength(optOne), 0);
+      screen.print(UIText(optOne));
+      screen.setCursor(LCD_COLS - UITextLength(optTwo), 1);
+      screen.print(UIText(optTwo));
+    }
+
 #define MAINMENU_SET_HEAT 1
 #define MAINMENU_SET_CO2 2
 #define MAINMENU_SET_O2 3
@@ -652,10 +919,14 @@ class IncuversUI {
 #define MAINMENU_CONF_FAN 8
 #define MAINMENU_CONF_C02 9
 #define MAINMENU_CONF_O2 10
-#define MAINMENU_CONF_LITE 11
-#define MAINMENU_PAGE_INFO 12
-#define MAINMENU_PAGE_DEFAULTS 13
-#define MAINMENU_PAGE_BASIC 14
+#define MAINMENU_CONF_CO2TANK 11
+#define MAINMENU_CONF_NTANK 12
+#define MAINMENU_CONF_LITE 13
+#define MAINMENU_CONF_PROFILE 14
+#define MAINMENU_CONF_SENSORS 15
+#define MAINMENU_PAGE_INFO 16
+#define MAINMENU_PAGE_DEFAULTS 17
+#define MAINMENU_PAGE_BASIC 18
 
     int CheckScreenNumber(int screen) {
       if (screen < MAINMENU_SET_HEAT || screen > MAINMENU_PAGE_BASIC) {
@@ -689,6 +960,14 @@ class IncuversUI {
         // O2 sensor not present, skip configuartion screen
         screen++;
       }
+      if (screen == MAINMENU_CONF_CO2TANK && incSet->getCO2GasMeter() == NULL) {
+        // CO2 metering not included, skip cylinder screen
+        screen++;
+      }
+      if (screen == MAINMENU_CONF_NTANK && incSet->getO2GasMeter() == NULL) {
+        // N2 metering not included, skip cylinder screen
+        screen++;
+      }
       if (screen == MAINMENU_CONF_LITE && !incSet->HasLighting()) {
         // Lights not present, skip configuartion screen
         screen++;
@@ -696,295 +975,278 @@ class IncuversUI {
       return screen;
     }
     
-    void SetupLoop() {
-      boolean doLoop = true;
-      boolean redraw = true;
-      int screen = 0;
-      int userInput;
-      lcd->clear();
-      lcd->setCursor(0, 0);
-      lcd->print(F("Incuvers Setup"));
-      DisplayLoadingBar();
-      delay(MENU_UI_REDRAW_DELAY);
-      while (doLoop) {
+    void DrawMenuPage() {
+      // The page's text comes from menuPageTexts, only the profile and sensor pages add a second line.
+      const MenuPageText* page = &menuPageTexts[menuScreen - 1];
+      byte optOne = pgm_read_byte(&page->optOne);
 
-        screen = CheckScreenNumber(screen);
-        
-        switch (screen) {
-          case MAINMENU_SET_HEAT:
-            if (redraw) {
-              DrawMainMenuPage("Set Temp.", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoVariableAdjust(1);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_SET_CO2:
-            if (redraw) {
-              DrawMainMenuPage("Set CO2", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoVariableAdjust(2);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_SET_O2:
-            if (redraw) {
-              DrawMainMenuPage("Set O2", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoVariableAdjust(3);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_SET_LITE_ON:
-            if (redraw) {
-              DrawMainMenuPage("Set LED On", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoVariableAdjust(4);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_SET_LITE_OFF:
-            if (redraw) {
-              DrawMainMenuPage("Set LED Off", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoVariableAdjust(5);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_PAGE_ADVANCED:
-            if (redraw) {
-              DrawMainMenuPage("Settings", "", false, "Save", "Advanced");
-              redraw=false;
-            } else if (userInput == 1) {
-              DoSaveSettings();
-              doLoop = false;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_CONF_HEAT:
-            if (redraw) {
-              DrawMainMenuPage("Heating", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoFeatureToggle(1);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_CONF_FAN:
-            if (redraw) {
-              DrawMainMenuPage("Fan Mode", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoFeatureToggle(2);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_CONF_C02:
-            if (redraw) {
-              DrawMainMenuPage("CO2", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoFeatureToggle(3);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_CONF_O2:
-            if (redraw) {
-              DrawMainMenuPage("Oxygen", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoFeatureToggle(4);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_CONF_LITE:
-            if (redraw) {
-              DrawMainMenuPage("Light", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              DoFeatureToggle(5);
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_PAGE_INFO:
-            if (redraw) {
-              DrawMainMenuPage("Information", "", true, "", "");
-              delay(MENU_UI_POST_DELAY);
-              redraw=false;
-            } else if (userInput == 1) {
-              ShowInfo();
-              redraw = true;
-              userInput = 0;
-            }
-            break;  
-          case MAINMENU_PAGE_DEFAULTS:
-            if (redraw) {
-              DrawMainMenuPage("Defaults", "", false, "Reset", "Next");
-              redraw=false;
-            } else if (userInput == 1) {
-              delay(MENU_UI_POST_DELAY);
-              incSet->ResetSettingsToDefaults();
-              lcd->clear();
-              lcd->setCursor(0, 0);
-              lcd->print(F("Reset to default"));
-              DisplayLoadingBar();
-              redraw = true;
-              userInput = 0;
-            }
-            break;
-          case MAINMENU_PAGE_BASIC:
-            if (redraw) {
-              DrawMainMenuPage("Settings", "", false, "Save", "Basic");
-              redraw=false;
-            } else if (userInput == 1) {
-              DoSaveSettings();
-              delay(MENU_UI_POST_DELAY);
-              doLoop = false;
-              userInput = 0;
-            }
-            break;
-        }
+      screen.setCursor(0, 1);
+      switch (menuScreen) {
+        case MAINMENU_CONF_PROFILE:
+          if (incProfile->isRunning()) {
+            screen.print(UIText(UI_TEXT_RUNNING_SEGMENT));
+            screen.print(incProfile->getRunningSegment() + 1);
+            optOne = UI_TEXT_STOP;
+          }
+          break;
+        case MAINMENU_CONF_SENSORS:
+          screen.print(incSet->getHeatModule()->getSensorBus()->getCount());
+          screen.print(UIText(UI_TEXT_FOUND));
+          break;
+      }
+      DrawMainMenuPage(pgm_read_byte(&page->title), optOne, pgm_read_byte(&page->optTwo));
+    }
+
+    void OpenMenuItem(byte state, byte item) {
+      menuState = state;
+      menuItem = item;
+      menuStartedAt = millis();
+    }
+
+    void DoMenuPageEvent(int userInput) {
+      // The lower button goes on to the next page, both leave setup, and the upper one does what the page offers.
+      if (userInput == 2) {
+        menuScreen = CheckScreenNumber(menuScreen + 1);
+        return;
+      }
+      if (userInput == 3) {
+        ExitSetup(UI_TEXT_EXITING);
+        return;
+      }
+
+      switch (menuScreen) {
+        case MAINMENU_SET_HEAT:
+          OpenMenuItem(MENU_STATE_ADJUST, 1);
+          break;
+        case MAINMENU_SET_CO2:
+          OpenMenuItem(MENU_STATE_ADJUST, 2);
+          break;
+        case MAINMENU_SET_O2:
+          OpenMenuItem(MENU_STATE_ADJUST, 3);
+          break;
+        case MAINMENU_PAGE_ADVANCED:
+        case MAINMENU_PAGE_BASIC:
+          incSet->PerformSaveSettings();
+          ExitSetup(UI_TEXT_SAVED);
+          break;
+        case MAINMENU_CONF_HEAT:
+          OpenMenuItem(MENU_STATE_TOGGLE, 1);
+          break;
+        case MAINMENU_CONF_FAN:
+          OpenMenuItem(MENU_STATE_TOGGLE, 2);
+          break;
+        case MAINMENU_CONF_C02:
+          OpenMenuItem(MENU_STATE_TOGGLE, 3);
+          break;
+        case MAINMENU_CONF_O2:
+          OpenMenuItem(MENU_STATE_TOGGLE, 4);
+          break;
+        case MAINMENU_CONF_LITE:
+          OpenMenuItem(MENU_STATE_TOGGLE, 5);
+          break;
+        case MAINMENU_CONF_CO2TANK:
+          incSet->getCO2GasMeter()->ResetCylinder();
+          ShowMessage(UI_TEXT_CO2_TANK_RESET, 0, MENU_STATE_PAGE);
+          break;
+        case MAINMENU_CONF_NTANK:
+          incSet->getO2GasMeter()->ResetCylinder();
+          ShowMessage(UI_TEXT_N2_TANK_RESET, 0, MENU_STATE_PAGE);
+          break;
+        case MAINMENU_CONF_PROFILE:
+          if (incProfile->isRunning()) {
+            incProfile->Stop();
+          } else {
+            OpenMenuItem(MENU_STATE_PROFILE, 0);
+          }
+          break;
+        case MAINMENU_CONF_SENSORS:
+          StartSensorSetup(MENU_STATE_PAGE);
+          break;
+        case MAINMENU_PAGE_INFO:
+          OpenMenuItem(MENU_STATE_INFO, 1);
+          break;
+        case MAINMENU_PAGE_DEFAULTS:
+          incSet->ResetSettingsToDefaults();
+          incSet->ApplySettings();
+          ShowMessage(UI_TEXT_RESET_DEFAULT, 0, MENU_STATE_PAGE);
+          break;
+      }
+    }
 
-        if (!redraw) {
-          delay(MENU_UI_POST_DELAY);
-          userInput = GetButtonState();
-          switch (userInput) {
-            case 0:
-              delay(MENU_UI_LOAD_DELAY);
-              redraw=false;
-              break;
-            case 1:
-              // Will skip this now and get it on the next loop.
-              break;
-            case 2:
-              // Next
-              screen++;
-              lcd->clear();
-              delay(MENU_UI_LOAD_DELAY);
-              redraw = true;
-              break;
-            case 3:
-              // exit
-              lcd->clear();
-              lcd->setCursor(0, 0);
-              lcd->print(F("Exiting setup..."));
-              DisplayLoadingBar();
-              incSet->CheckSettings();
-              doLoop=false;
-              lcd->clear();
-              break;
+    void DoMenuTick(int userInput) {
+      // Handles at most one button event, then draws whatever state the menu is in.  Only the characters which
+      // changed go out to the LCD, so it's redrawn every tick.
+      switch (menuState) {
+        case MENU_STATE_MESSAGE:
+          if (millis() - menuStartedAt >= MENU_UI_MESSAGE_TIME) {
+            if (menuNextState == MENU_STATE_SENSORS_NEXT) {
+              StartSensorRole(menuNextRole);
+            } else {
+              menuState = menuNextState;
+            }
           }
-        }
+          break;
+        case MENU_STATE_PAGE:
+          if (userInput != 0) {
+            DoMenuPageEvent(userInput);
+          }
+          break;
+        case MENU_STATE_ADJUST:
+          if (userInput != 0) {
+            DoVariableAdjustEvent(userInput);
+          }
+          break;
+        case MENU_STATE_TOGGLE:
+          if (userInput != 0) {
+            DoFeatureToggleEvent(userInput);
+          }
+          break;
+        case MENU_STATE_PROFILE:
+          if (userInput != 0) {
+            DoProfileEditEvent(userInput);
+          }
+          break;
+        case MENU_STATE_INFO:
+          if (userInput != 0) {
+            DoInfoEvent(userInput);
+          }
+          break;
+        case MENU_STATE_SENSORS:
+          DoSensorSetupTick(userInput);
+          break;
       }
+
+      screen.clear();
+      switch (menuState) {
+        case MENU_STATE_NONE:
+          this->lastRefresh = 0;      // Back to the status screen straight away
+          return;
+        case MENU_STATE_MESSAGE:
+          DrawMessage();
+          break;
+        case MENU_STATE_PAGE:
+          menuScreen = CheckScreenNumber(menuScreen);
+          DrawMenuPage();
+          break;
+        case MENU_STATE_ADJUST:
+          DrawVariableAdjust();
+          break;
+        case MENU_STATE_TOGGLE:
+          DrawFeatureToggle();
+          break;
+        case MENU_STATE_PROFILE:
+          DrawProfileEdit();
+          break;
+        case MENU_STATE_INFO:
+          DrawInfo();
+          break;
+        case MENU_STATE_SENSORS:
+          DrawSensorSetup();
+          break;
+      }
+      screen.Flush(lcd);
     }
     
+
   public:
     void SetupUI() {
+      this->incSet = NULL;
       this->lastRefresh = 0;
-      this->lcd = new LiquidTWI2(0);
-      this->lcd->setMCPType(LTI_TYPE_MCP23017);
-      this->lcd->begin(16, 2);
-  
-      Wire.begin(); // wake up I2C bus
-      Wire.beginTransmission(0x20);
-      Wire.write(0x00); // IODIRA register
-      Wire.write(0xFF); // set all of port A to input
-      Wire.endTransmission();
+      this->lastStatusLine = 0;
+      this->lastDrawMicros = 0;
+      this->statusPage = 0;
+      this->glyphsChannel = 0xFF;
+      this->trend.SetupTrend();
+      this->loopCountButtonState = 0;
+      this->menuState = MENU_STATE_NONE;
+      incTWI.SetupTWI();
+      this->lcd = new IncuversLCD();
+      this->lcd->SetupLCD();
+      this->screen.SetupBuffer();
+      this->buttons.SetupButtons();
     }
 
     void AttachSettings(IncuversSettingsHandler* iSettings) {
       this->incSet = iSettings;
+      this->alarm.SetupAlarm(iSettings, this->lcd);
+    }
+
+    void AttachStatus(IncuversStatus* iStatus) {
+      this->incStatus = iStatus;
+    }
+
+    void AttachProfile(IncuversProfileRunner* iProfile) {
+      this->incProfile = iProfile;
     }
   
     void DisplayStartup() {
       this->lcd->setCursor(0,0);
-      this->lcd->print(F("Incuvers Model 1"));
+      this->lcd->print(UIText(UI_TEXT_MODEL));
       this->lcd->setCursor(0,1);
-      this->lcd->print(CentreStringForDisplay(F("V1.11"),16));
+      PrintCentred(this->lcd, UIText(UI_TEXT_VERSION), 16);
       delay(1000);
       this->lcd->clear();
   
-      String longDebugDesc = "";
-      String shortDebugDesc = "";
+      char debugDesc[24];             // "Debug: " and a letter for each kind of debugging built in
+      byte debugCount = 0;
+      strcpy_P(debugDesc, (PGM_P)UIText(UI_TEXT_DEBUG));
   
       #ifdef DEBUG_GENERAL
-        longDebugDesc += F("General, ");
-        shortDebugDesc += "G";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'G', F("General, "));
       #endif
   
       #ifdef DEBUG_SERIAL
-        longDebugDesc += F("Serial, ");
-        shortDebugDesc += "S";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'S', F("Serial, "));
       #endif
-      
+  
       #ifdef DEBUG_EEPROM
-        longDebugDesc += F("EEPROM, ");
-        shortDebugDesc += "E";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'E', F("EEPROM, "));
       #endif
-
+  
       #ifdef DEBUG_UI
-        longDebugDesc += F("UI, ");
-        shortDebugDesc += "U";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'U', F("UI, "));
       #endif
-
+  
       #ifdef DEBUG_CO2
-        longDebugDesc += F("CO2, ");
-        shortDebugDesc += "C";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'C', F("CO2, "));
       #endif
-      
+  
       #ifdef DEBUG_O2
-        longDebugDesc += F("O2, ");
-        shortDebugDesc += "O";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'O', F("O2, "));
       #endif
-      
+  
       #ifdef DEBUG_TEMP
-        longDebugDesc += F("Temperature, ");
-        shortDebugDesc += "T";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'T', F("Temperature, "));
       #endif
-
+  
       #ifdef DEBUG_LIGHT
-        longDebugDesc += F("Light, ");
-        shortDebugDesc += "L";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'L', F("Light, "));
       #endif
-      
+  
       #ifdef DEBUG_MEMORY
-        longDebugDesc += F("Memory, ");
-        shortDebugDesc += "M";
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'M', F("Memory, "));
+      #endif
+  
+      #ifdef DEBUG_GAS
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'V', F("Gas, "));
       #endif
-      
-      if (longDebugDesc.length() > 0) {
-        Serial.println(F("Debug build: "));
-        Serial.println(longDebugDesc);
-      }
   
-      if (shortDebugDesc.length() > 0) {
+      #ifdef DEBUG_POWER
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'P', F("Power, "));
+      #endif
+  
+      #ifdef DEBUG_DOOR
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'D', F("Door, "));
+      #endif
+  
+      #ifdef DEBUG_PROFILE
+        debugCount = AddDebugDescription(debugDesc, debugCount, 'R', F("Profile, "));
+      #endif
+  
+      if (debugCount > 0) {
+        Serial.println();
         this->lcd->setCursor(0,0);
-        this->lcd->print(CentreStringForDisplay(String("Debug: " + shortDebugDesc),16));
+        PrintCentred(this->lcd, debugDesc, 16);
         this->DisplayLoadingBar();
         this->lcd->clear();
       }
@@ -994,14 +1256,14 @@ class IncuversUI {
       lcd->setCursor(0,0);
       switch (runMode) {
         case 0 :
-          lcd->print(CentreStringForDisplay(F("Uninitialized"),16));
+          PrintCentred(lcd, UIText(UI_TEXT_UNINITIALIZED), 16);
           break;
         case 1 :
-          lcd->print(CentreStringForDisplay(F("Saved Settings"),16));
+          PrintCentred(lcd, UIText(UI_TEXT_SAVED_SETTINGS), 16);
           break;
         case 2 :
         case 3 :
-          lcd->print(CentreStringForDisplay(F("Default Settings"),16));
+          PrintCentred(lcd, UIText(UI_TEXT_DEFAULT_SETTINGS), 16);
           break;
       }
       this->DisplayLoadingBar();
@@ -1009,18 +1271,39 @@ class IncuversUI {
     }
   
     void LCDDrawDefaultUI() {
-      if (incSet->getPersonalityCount() >= 3) {
+      // Drawn from scratch into the framebuffer, only what changed since the last refresh goes to the LCD.
+      unsigned long startedAt = micros();
+      screen.clear();
+      if (statusPage != 0) {
+        LCDDrawTrendPage(statusPage - 1);
+      } else if (incSet->getPersonalityCount() >= 3) {
         LCDDrawNewUI();
-      }
-      if (incSet->getPersonalityCount() < 3) {
+      } else {
         LCDDrawDualLineUI();
       }
+      screen.Flush(lcd);
+      this->lastDrawMicros = micros() - startedAt;
     }
 
     void EnterSetupMode() {
-      incSet->MakeSafeState();
-      SetupLoop();
-      incSet->ReturnFromSafeState();
+      // Settings take effect as they are changed, "Save" keeps them over a reset.
+      menuScreen = 0;
+      statusPage = 0;
+      ShowMessage(UI_TEXT_INCUVERS_SETUP, 0, MENU_STATE_PAGE);
+    }
+
+    boolean isInMenu() {
+      return menuState != MENU_STATE_NONE;
+    }
+
+    boolean AcknowledgeAlarm() {
+      // As a button press on the status screen, for the PiLink.  False if nothing was sounding.
+      return alarm.Acknowledge();
+    }
+
+    void EnterSensorSetup() {
+      // At boot, when the roles of the temperature sensors couldn't be worked out.
+      StartSensorSetup(MENU_STATE_NONE);
     }
 
     void WarnOfMissingHardwareSettings() {
@@ -1028,28 +1311,48 @@ class IncuversUI {
         this->lcd->clear();
         delay(500);
         this->lcd->setCursor(0,0);
-        this->lcd->print(CentreStringForDisplay(F("Hardware not"),16));
+        PrintCentred(this->lcd, UIText(UI_TEXT_HARDWARE_NOT), 16);
         this->lcd->setCursor(0,1);
-        this->lcd->print(CentreStringForDisplay(F("initialized!"),16));
+        PrintCentred(this->lcd, UIText(UI_TEXT_INITIALIZED), 16);
         delay(4500);
       }
     }
     
+    void DoQuickTick() {
+      // Called early in each pass of the loop too, so a button read queued here is back by the time DoTick() wants it.
+      incTWI.DoTick();
+      statusLine.DoTick();
+      this->buttons.DoTick();
+      if (this->incSet != NULL) {
+        this->alarm.DoTick();
+      }
+    }
+
     void DoTick() {
+      int userInput = GetButtonEvent();
+      if (menuState == MENU_STATE_NONE) {
+        if (userInput == 3) {
+          EnterSetupMode();
+        } else if (userInput != 0 && !alarm.Acknowledge()) {
+          // Either button on its own acknowledges a sounding alarm, otherwise they page through the trends.
+          StepStatusPage(userInput);
+        }
+      }
+      if (menuState != MENU_STATE_NONE) {
+        DoMenuTick(userInput);
+      }
+
       if ((this->lastRefresh + 1000) < millis()) {
-        LCDDrawDefaultUI();
-        SerialPrintStatus();
+        trend.DoTick(incStatus->Get());
+        if (menuState == MENU_STATE_NONE) {
+          LCDDrawDefaultUI();
+        }
         this->lastRefresh = millis();  
       }
-      
-      int userInput = GetButtonState();
-      if (userInput == 3) {
-        EnterSetupMode();  
+      if (millis() - this->lastStatusLine >= STATUS_LINE_INTERVAL) {
+        SerialPrintStatus();
+        this->lastStatusLine = millis();
       }
-   
-      // Do the alarm orchestrator last as it will reset alarms which we want present in the PrintStatus above.
-      // Temporarily diabling the alarm orchestrator to help diagnose intermittent issues.
-      //AlarmOrchestrator();
     }
     
 };
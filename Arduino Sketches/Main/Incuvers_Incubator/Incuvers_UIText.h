@@ -0,0 +1,257 @@
+/*
+ * Incuvers UI text.
+ *
+ * Every piece of text the LCD shows lives in flash, in uiTexts, and is looked up by its UI_TEXT_ number with
+ * UIText(), which hands back something print() takes.  Keep the numbers and the table in the same order.  Numbers,
+ * names and the like are printed after or between these pieces, never joined into Strings.
+ */
+#define UI_TEXT_NONE 0
+// Status screens
+#define UI_TEXT_TEMP 1
+#define UI_TEXT_CO2_LABEL 2
+#define UI_TEXT_O2_LABEL 3
+#define UI_TEXT_DEGRADED 4
+#define UI_TEXT_ERROR 5
+#define UI_TEXT_DISABLED 6
+#define UI_TEXT_DEGREES 7
+#define UI_TEXT_PERCENT 8
+#define UI_TEXT_DEG 9
+#define UI_TEXT_ERR 10
+#define UI_TEXT_NEW_TEMP 11
+#define UI_TEXT_NEW_CO2 12
+#define UI_TEXT_NEW_O2 13
+#define UI_TEXT_LED 14
+#define UI_TEXT_LED_ON 15
+#define UI_TEXT_LED_OFF 16
+#define UI_TEXT_LED_NOT_INCL 17
+#define UI_TEXT_NOT_INCL 18
+// Menu pages
+#define UI_TEXT_SET_TEMP 19
+#define UI_TEXT_SET_CO2 20
+#define UI_TEXT_SET_O2 21
+#define UI_TEXT_SET_LED_ON 22
+#define UI_TEXT_SET_LED_OFF 23
+#define UI_TEXT_SETTINGS 24
+#define UI_TEXT_HEATING 25
+#define UI_TEXT_FAN_MODE 26
+#define UI_TEXT_CO2 27
+#define UI_TEXT_OXYGEN 28
+#define UI_TEXT_CO2_TANK 29
+#define UI_TEXT_N2_TANK 30
+#define UI_TEXT_LIGHT 31
+#define UI_TEXT_PROFILE 32
+#define UI_TEXT_TEMP_SENSORS 33
+#define UI_TEXT_INFORMATION 34
+#define UI_TEXT_DEFAULTS 35
+#define UI_TEXT_RUNNING_SEGMENT 36
+#define UI_TEXT_FOUND 37
+// Menu options
+#define UI_TEXT_SET 38
+#define UI_TEXT_NEXT 39
+#define UI_TEXT_SAVE 40
+#define UI_TEXT_ADVANCED 41
+#define UI_TEXT_BASIC 42
+#define UI_TEXT_NEW 43
+#define UI_TEXT_STOP 44
+#define UI_TEXT_SETUP 45
+#define UI_TEXT_RESET 46
+#define UI_TEXT_RUN 47
+#define UI_TEXT_SKIP 48
+// Set points and profiles
+#define UI_TEXT_TEMPERATURE 49
+#define UI_TEXT_CO2_PERCENT 50
+#define UI_TEXT_O2_PERCENT 51
+#define UI_TEXT_END 52
+#define UI_TEXT_PROGRAM 53
+#define UI_TEXT_SEGMENT 54
+#define UI_TEXT_TARGET 55
+#define UI_TEXT_LEVEL 56
+#define UI_TEXT_RAMP 57
+#define UI_TEXT_HOLD 58
+// Modes
+#define UI_TEXT_HEAT_TAG 59
+#define UI_TEXT_FAN_TAG 60
+#define UI_TEXT_CO2_TAG 61
+#define UI_TEXT_O2_TAG 62
+#define UI_TEXT_LIGHT_TAG 63
+#define UI_TEXT_ENABLED 64
+#define UI_TEXT_ALWAYS 65
+#define UI_TEXT_MONITOR 66
+#define UI_TEXT_MAINTAIN 67
+#define UI_TEXT_INTERNAL 68
+#define UI_TEXT_EXTERNAL 69
+// Information
+#define UI_TEXT_HARDWARE_REV 70
+#define UI_TEXT_SERIAL 71
+#define UI_TEXT_HARDWARE_OPTS 72
+#define UI_TEXT_SOFTWARE_INCLD 73
+#define UI_TEXT_OPT_HEAT 74
+#define UI_TEXT_OPT_CO2 75
+#define UI_TEXT_OPT_O2 76
+#define UI_TEXT_OPT_SOLENOIDS 77
+#define UI_TEXT_OPT_LIGHT 78
+#define UI_TEXT_OPT_PILINK 79
+#define UI_TEXT_OPT_ETHERNET 80
+// Messages
+#define UI_TEXT_EXITING 81
+#define UI_TEXT_SAVED 82
+#define UI_TEXT_CO2_TANK_RESET 83
+#define UI_TEXT_N2_TANK_RESET 84
+#define UI_TEXT_RESET_DEFAULT 85
+#define UI_TEXT_INCUVERS_SETUP 86
+#define UI_TEXT_FOUND_SENSOR 87
+#define UI_TEXT_WARM 88
+#define UI_TEXT_BY_HAND 89
+// Sensor roles
+#define UI_TEXT_ROLE_NONE 90
+#define UI_TEXT_ROLE_DOOR 91
+#define UI_TEXT_ROLE_CHAMBER 92
+#define UI_TEXT_ROLE_AMBIENT 93
+#define UI_TEXT_ROLE_ZONE 94
+// Startup
+#define UI_TEXT_MODEL 95
+#define UI_TEXT_VERSION 96
+#define UI_TEXT_DEBUG 97
+#define UI_TEXT_UNINITIALIZED 98
+#define UI_TEXT_SAVED_SETTINGS 99
+#define UI_TEXT_DEFAULT_SETTINGS 100
+#define UI_TEXT_HARDWARE_NOT 101
+#define UI_TEXT_INITIALIZED 102
+// Trend pages, in TREND_CHANNEL_ order
+#define UI_TEXT_TREND_TEMP 103
+#define UI_TEXT_TREND_CO2 104
+#define UI_TEXT_TREND_O2 105
+#define UI_TEXT_NO_DATA 106
+// More messages
+#define UI_TEXT_PROFILE_RUNNING 107
+
+const char uiText000[] PROGMEM = "";
+const char uiText001[] PROGMEM = "Temp: ";
+const char uiText002[] PROGMEM = " CO2: ";
+const char uiText003[] PROGMEM = "  O2: ";
+const char uiText004[] PROGMEM = "Degraded";
+const char uiText005[] PROGMEM = "Error   ";
+const char uiText006[] PROGMEM = "Disabled";
+const char uiText007[] PROGMEM = "\337C  ";
+const char uiText008[] PROGMEM = "%    ";
+const char uiText009[] PROGMEM = "deg";
+const char uiText010[] PROGMEM = "err";
+const char uiText011[] PROGMEM = "T.";
+const char uiText012[] PROGMEM = "  CO2";
+const char uiText013[] PROGMEM = "   O2";
+const char uiText014[] PROGMEM = "LED: ";
+const char uiText015[] PROGMEM = "On ";
+const char uiText016[] PROGMEM = "Off ";
+const char uiText017[] PROGMEM = "LED: not incl.";
+const char uiText018[] PROGMEM = "n/i";
+const char uiText019[] PROGMEM = "Set Temp.";
+const char uiText020[] PROGMEM = "Set CO2";
+const char uiText021[] PROGMEM = "Set O2";
+const char uiText022[] PROGMEM = "Set LED On";
+const char uiText023[] PROGMEM = "Set LED Off";
+const char uiText024[] PROGMEM = "Settings";
+const char uiText025[] PROGMEM = "Heating";
+const char uiText026[] PROGMEM = "Fan Mode";
+const char uiText027[] PROGMEM = "CO2";
+const char uiText028[] PROGMEM = "Oxygen";
+const char uiText029[] PROGMEM = "CO2 Tank";
+const char uiText030[] PROGMEM = "N2 Tank";
+const char uiText031[] PROGMEM = "Light";
+const char uiText032[] PROGMEM = "Profile";
+const char uiText033[] PROGMEM = "Temp Sensors";
+const char uiText034[] PROGMEM = "Information";
+const char uiText035[] PROGMEM = "Defaults";
+const char uiText036[] PROGMEM = "Running S";
+const char uiText037[] PROGMEM = " found";
+const char uiText038[] PROGMEM = "Set";
+const char uiText039[] PROGMEM = "Next";
+const char uiText040[] PROGMEM = "Save";
+const char uiText041[] PROGMEM = "Advanced";
+const char uiText042[] PROGMEM = "Basic";
+const char uiText043[] PROGMEM = "New";
+const char uiText044[] PROGMEM = "Stop";
+const char uiText045[] PROGMEM = "Setup";
+const char uiText046[] PROGMEM = "Reset";
+const char uiText047[] PROGMEM = "Run";
+const char uiText048[] PROGMEM = "Skip";
+const char uiText049[] PROGMEM = "Temperature";
+const char uiText050[] PROGMEM = "CO2 %";
+const char uiText051[] PROGMEM = "O2 %";
+const char uiText052[] PROGMEM = "End";
+const char uiText053[] PROGMEM = "Program ";
+const char uiText054[] PROGMEM = " S";
+const char uiText055[] PROGMEM = "Target";
+const char uiText056[] PROGMEM = "Level";
+const char uiText057[] PROGMEM = "Ramp";
+const char uiText058[] PROGMEM = "Hold";
+const char uiText059[] PROGMEM = "Heat: ";
+const char uiText060[] PROGMEM = "Fan: ";
+const char uiText061[] PROGMEM = "CO2: ";
+const char uiText062[] PROGMEM = "O2: ";
+const char uiText063[] PROGMEM = "Light: ";
+const char uiText064[] PROGMEM = "Enabled ";
+const char uiText065[] PROGMEM = "Always  ";
+const char uiText066[] PROGMEM = "Monitor ";
+const char uiText067[] PROGMEM = "Maintain";
+const char uiText068[] PROGMEM = "Int.";
+const char uiText069[] PROGMEM = "Ext.";
+const char uiText070[] PROGMEM = "Hrd Rev: ";
+const char uiText071[] PROGMEM = "SN: ";
+const char uiText072[] PROGMEM = "Hardware opts: ";
+const char uiText073[] PROGMEM = "Software incld: ";
+const char uiText074[] PROGMEM = "H ";
+const char uiText075[] PROGMEM = "CO2 ";
+const char uiText076[] PROGMEM = "O2 ";
+const char uiText077[] PROGMEM = "S ";
+const char uiText078[] PROGMEM = "L ";
+const char uiText079[] PROGMEM = "PL ";
+const char uiText080[] PROGMEM = "E ";
+const char uiText081[] PROGMEM = "Exiting setup...";
+const char uiText082[] PROGMEM = "Settings saved.";
+const char uiText083[] PROGMEM = "CO2 tank reset";
+const char uiText084[] PROGMEM = "N2 tank reset";
+const char uiText085[] PROGMEM = "Reset to default";
+const char uiText086[] PROGMEM = "Incuvers Setup";
+const char uiText087[] PROGMEM = "Found sensor ";
+const char uiText088[] PROGMEM = "Warm ";
+const char uiText089[] PROGMEM = "sensor by hand";
+const char uiText090[] PROGMEM = "Unassigned";
+const char uiText091[] PROGMEM = "Door";
+const char uiText092[] PROGMEM = "Chamber";
+const char uiText093[] PROGMEM = "Ambient";
+const char uiText094[] PROGMEM = "Zone ";
+const char uiText095[] PROGMEM = "Incuvers Model 1";
+const char uiText096[] PROGMEM = "V1.12";
+const char uiText097[] PROGMEM = "Debug: ";
+const char uiText098[] PROGMEM = "Uninitialized";
+const char uiText099[] PROGMEM = "Saved Settings";
+const char uiText100[] PROGMEM = "Default Settings";
+const char uiText101[] PROGMEM = "Hardware not";
+const char uiText102[] PROGMEM = "initialized!";
+const char uiText103[] PROGMEM = "T 24h";
+const char uiText104[] PROGMEM = "CO2 24h";
+const char uiText105[] PROGMEM = "O2 24h";
+const char uiText106[] PROGMEM = "--";
+const char uiText107[] PROGMEM = "Profile running";
+
+const char* const uiTexts[] PROGMEM = {
+  uiText000, uiText001, uiText002, uiText003, uiText004, uiText005, uiText006, uiText007, uiText008, uiText009,
+  uiText010, uiText011, uiText012, uiText013, uiText014, uiText015, uiText016, uiText017, uiText018, uiText019,
+  uiText020, uiText021, uiText022, uiText023, uiText024, uiText025, uiText026, uiText027, uiText028, uiText029,
+  uiText030, uiText031, uiText032, uiText033, uiText034, uiText035, uiText036, uiText037, uiText038, uiText039,
+  uiText040, uiText041, uiText042, uiText043, uiText044, uiText045, uiText046, uiText047, uiText048, uiText049,
+  uiText050, uiText051, uiText052, uiText053, uiText054, uiText055, uiText056, uiText057, uiText058, uiText059,
+  uiText060, uiText061, uiText062, uiText063, uiText064, uiText065, uiText066, uiText067, uiText068, uiText069,
+  uiText070, uiText071, uiText072, uiText073, uiText074, uiText075, uiText076, uiText077, uiText078, uiText079,
+  uiText080, uiText081, uiText082, uiText083, uiText084, uiText085, uiText086, uiText087, uiText088, uiText089,
+  uiText090, uiText091, uiText092, uiText093, uiText094, uiText095, uiText096, uiText097, uiText098, uiText099,
+  uiText100, uiText101, uiText102, uiText103, uiText104, uiText105, uiText106, uiText107
+};
+
+const __FlashStringHelper* UIText(byte id) {
+  return (const __FlashStringHelper*)pgm_read_ptr(&uiTexts[id]);
+}
+
+byte UITextLength(byte id) {
+  return strlen_P((PGM_P)pgm_read_ptr(&uiTexts[id]));
+}
@@ -11,9 +11,11 @@ class IncuversLightingSystem {
     boolean enabled;
     boolean currentlyOn;
     boolean useInternalTiming;
+
+    IncuversPowerArbiter* arbiter;
     
   public:
-    void SetupLighting(int pin, boolean enabled) {
+    void SetupLighting(int pin, boolean enabled, IncuversPowerArbiter* iPower) {
       #ifdef DEBUG_LIGHT
         Serial.println(F("Light::Setup"));
         Serial.println(pin);
@@ -23,7 +25,8 @@ class IncuversLightingSystem {
       // Setup Light 
       this->useInternalTiming = enabled;
       this->pinAssignment = pin;
-      pinMode(this->pinAssignment, OUTPUT);  
+      this->arbiter = iPower;
+      this->arbiter->RegisterChannel(POWER_CH_LIGHT, this->pinAssignment, POWER_DRAW_LIGHT, true);
       this->MakeSafeState();
       this->currentlyOn = false;
     }
@@ -46,12 +49,12 @@ class IncuversLightingSystem {
         #ifdef DEBUG_LIGHT
           Serial.println(F("Light::Turning On"));
         #endif
-        digitalWrite(this->pinAssignment, HIGH);
+        this->arbiter->RequestOn(POWER_CH_LIGHT, POWER_PRIORITY_LIGHT);
       } else {
         #ifdef DEBUG_LIGHT
           Serial.println(F("Light::Turning Off"));
         #endif
-        digitalWrite(this->pinAssignment, LOW);
+        this->arbiter->Release(POWER_CH_LIGHT);
       }
     }
 
@@ -59,7 +62,7 @@ class IncuversLightingSystem {
       #ifdef DEBUG_LIGHT
         Serial.println(F("Light::SafeState"));
       #endif
-      digitalWrite(this->pinAssignment, LOW);     // Set LOW (light off)
+      this->arbiter->Release(POWER_CH_LIGHT);     // Set LOW (light off)
       // this->currentlyOn = false; // don't set this so we can resume old operation when we are done.
     }
 
@@ -84,15 +87,15 @@ class IncuversLightingSystem {
       if (this->useInternalTiming && this->nextStatusChangeTimestamp < this->tickTime) {
         if (this->currentlyOn) {
           this->nextStatusChangeTimestamp = this->tickTime + this->setMSecondsOff;
-          digitalWrite(this->pinAssignment, LOW);
+          this->arbiter->Release(POWER_CH_LIGHT);
           this->currentlyOn = false;
         } else {
           this->nextStatusChangeTimestamp = this->tickTime + this->setMSecondsOn;
-          digitalWrite(this->pinAssignment, HIGH);
+          this->arbiter->RequestOn(POWER_CH_LIGHT, POWER_PRIORITY_LIGHT);
           this->currentlyOn = true;
         } 
       } else if (this->currentlyOn) {
-        digitalWrite(this->pinAssignment, HIGH); // this will allow us to resume after a suspended state ie setup mode.
+        this->arbiter->RequestOn(POWER_CH_LIGHT, POWER_PRIORITY_LIGHT); // this will allow us to resume after a suspended state ie setup mode, or retry a deferred request.
       }
     }
 
@@ -100,28 +103,31 @@ class IncuversLightingSystem {
       return GetIndicator(this->currentlyOn, false, false, true);
     }
 
-    String GetOldUIDisplay() {
+    void PrintOldUIDisplay(Print* out) {
       //0123456789012345
       //LED: Off 10h18m
-      
-      String line = F("LED: "); // 5 chars
+      char remaining[LCD_COLS + 1];
+
+      out->print(UIText(UI_TEXT_LED)); // 5 chars
       if (this->currentlyOn) {
-        line = String(line + F("On "));  // 8 chars
+        out->print(UIText(UI_TEXT_LED_ON));  // 8 chars
       } else {
-        line = String(line + F("Off ")); // 9 chars
+        out->print(UIText(UI_TEXT_LED_OFF)); // 9 chars
       }
 
-      line = String(line + ConvertMillisToScaledReadable(this->nextStatusChangeTimestamp - this->tickTime, 7, false) + F("    "));
-
-      return line;
+      FormatDuration(remaining, this->nextStatusChangeTimestamp - this->tickTime, 7, false);
+      out->print(remaining);
+      PrintSpaces(out, 4);
     }
 
     char GetNewUIIndicator() {
       return GetIndicator(this->currentlyOn, false, false, true);
     }
 
-    String GetNewUIReading() {
-      return ConvertMillisToScaledReadable(this->nextStatusChangeTimestamp, 4, false);
+    void PrintNewUIReading(Print* out) {
+      char reading[LCD_COLS + 1];
+      FormatDuration(reading, this->nextStatusChangeTimestamp, 4, false);
+      out->print(reading);
     }
     
 };
@@ -129,7 +135,7 @@ class IncuversLightingSystem {
 class IncuversLightingSystem {
   private:
   public:
-    void SetupLighting(int pin, boolean enabled) {
+    void SetupLighting(int pin, boolean enabled, IncuversPowerArbiter* iPower) {
     }
 
     void UpdateLightDeltas(long on, long off) {
@@ -151,16 +157,16 @@ class IncuversLightingSystem {
       return 'x';
     }
 
-    String GetOldUIDisplay() {
-      return F("LED: not incl.");
+    void PrintOldUIDisplay(Print* out) {
+      out->print(UIText(UI_TEXT_LED_NOT_INCL));
     }
 
     char GetNewUIIndicator() {
       return 'x';
     }
 
-    String GetNewUIReading() {
-      return F("n/i");
+    void PrintNewUIReading(Print* out) {
+      out->print(UIText(UI_TEXT_NOT_INCL));
     }
 };
 #endif
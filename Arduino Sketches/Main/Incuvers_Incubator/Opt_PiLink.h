@@ -2,94 +2,444 @@
 /*
  * Incuvers PiLink code.
  * 
- * Only functional on 1.0.0+ control board units.
+ * Only functional on 1.0.0+ control board units.  The status goes to the Pi as binary frames (Incuvers_PiLinkFrame.h),
+ * sent from a buffer as the port has room so the loop never waits on it.  The link starts at PILINK_BAUD_DEFAULT with
+ * the unit saying hello; the Pi answers with a PILINK_FRAME_BAUD asking for a faster rate, the unit answers that at the
+ * old rate and then switches.  The Pi has to send something at least every PILINK_LINK_TIMEOUT (asking for the same rate
+ * again will do), or the unit takes it that the Pi restarted and goes back to the default rate and publishing.
+ *
+ * The status is published the way the Pi last asked for with a PILINK_FRAME_PUBLISH (until then PILINK_PUBLISH_MODE),
+ * and a status is never built unless one could be due.
+ *
+ * Commands from the Pi go through the settings handler's setters, which only take what the menu offers, and while
+ * someone is in the menu on the unit the ones which change settings are answered PILINK_RESULT_BUSY.  Only what has
+ * arrived is read on each pass, and nothing more is read while an answer is waiting to go: the rest waits in the
+ * port's receive buffer, so the Pi should wait for each ack before sending the next command.
  */
 class IncuversPiLink {
   private:
     IncuversSettingsHandler* incSet;
+    IncuversStatus* incStatus;
+    IncuversUI* incUI;
     bool isEnabled;
 
+    PiLinkFrameReader reader;
+    byte txBuffer[PILINK_ENCODED_SIZE];
+    byte txLength;
+    byte txSent;
+    unsigned long baud;
+    unsigned long answerBaud;       // Rate to tell the Pi, 0 = no request to answer
+    unsigned long switchBaud;       // Rate to switch to once the answer has gone, 0 = none
+    unsigned long lastHeard;        // Last good frame from the Pi
+    unsigned long lastHello;
+
+    PiLinkPublish publish;
+    boolean answerPublish;          // The Pi set the publishing, tell it what was taken
+    boolean statusRequested;
+    PiLinkStatus status;            // Filled in when one could be due
+    PiLinkStatus lastStatus;        // As it was sent
+    unsigned long lastStatusAt;
+    unsigned long lastSentAt;       // Any frame
+    uint16_t statusFrames;
+
+    PiLinkAck ack;                  // The last, sent again if its command is
+    boolean ackPending;
+    boolean haveAck;
+    boolean statsPending;
+    uint16_t commands;
+    uint16_t commandsRefused;
+
+    void Begin(unsigned long baud) {
+      // Parity and two stop bits at the default rate, where the Pi starts out.  Above it the CRC does the checking.
+      if (this->baud != 0) {
+        Serial1.end();
+      }
+      Serial1.begin(baud, baud == PILINK_BAUD_DEFAULT ? SERIAL_8E2 : SERIAL_8N1);
+      this->baud = baud;
+      #ifdef DEBUG_GENERAL
+        Serial.print(F("PiLink at "));
+        Serial.println(baud);
+      #endif
+    }
+
     void CheckForCommands() {
-      
+      // Only what has arrived, a frame cut off here is finished on a later pass.
+      int count = Serial1.available();
+      while (count-- > 0 && !this->isAnswerPending()) {
+        if (this->reader.Add(Serial1.read())) {
+          this->lastHeard = millis();
+          this->HandleFrame();
+        }
+      }
+    }
+
+    void HandleFrame() {
+      if (this->reader.getType() == PILINK_FRAME_BAUD && this->reader.getPayloadLength() == sizeof(PiLinkBaud)) {
+        // Any rate in range is taken, the Pi should stick to the standard ones.  Out of range the answer is the rate
+        // we're at.
+        PiLinkBaud* request = (PiLinkBaud*)this->reader.getPayload();
+        this->answerBaud = this->baud;
+        if (request->baud >= PILINK_BAUD_DEFAULT && request->baud <= PILINK_BAUD_MAX) {
+          this->answerBaud = request->baud;
+        }
+      } else if (this->reader.getType() == PILINK_FRAME_PUBLISH && this->reader.getPayloadLength() == sizeof(PiLinkPublish)) {
+        // An unknown mode keeps the one we have, and the interval is held to PILINK_INTERVAL_MIN.  A status goes
+        // straight away, so in PILINK_PUBLISH_CHANGE the Pi has what the changes are from.
+        PiLinkPublish* request = (PiLinkPublish*)this->reader.getPayload();
+        if (request->mode <= PILINK_PUBLISH_REQUEST) {
+          this->publish.mode = request->mode;
+        }
+        this->publish.interval = max(request->interval, PILINK_INTERVAL_MIN);
+        this->publish.levelDeadband = request->levelDeadband;
+        this->publish.dutyDeadband = request->dutyDeadband;
+        this->answerPublish = true;
+        this->statusRequested = true;
+      } else if (this->reader.getType() == PILINK_FRAME_REQUEST && this->reader.getPayloadLength() == 0) {
+        this->statusRequested = true;
+      } else if (this->reader.getType() == PILINK_FRAME_COMMAND && this->reader.getPayloadLength() == sizeof(PiLinkCommand)) {
+        this->HandleCommand((PiLinkCommand*)this->reader.getPayload());
+      }
+    }
+
+    boolean isAnswerPending() {
+      return this->answerBaud != 0 || this->answerPublish || this->ackPending || this->statsPending;
+    }
+
+    void HandleCommand(PiLinkCommand* command) {
+      this->ackPending = true;
+      if (this->haveAck && command->sequence == this->ack.sequence && command->command == this->ack.command) {
+        // Sent again, the ack must have been lost.
+        this->statsPending = command->command == PILINK_COMMAND_STATS;
+        return;
+      }
+      this->ack.sequence = command->sequence;
+      this->ack.command = command->command;
+      this->ack.value = command->value;
+      this->ack.result = this->RunCommand(command->command, &this->ack.value);
+      this->haveAck = true;
+      if (this->ack.result == PILINK_RESULT_OK || this->ack.result == PILINK_RESULT_LIMITED) {
+        this->commands++;
+      } else {
+        this->commandsRefused++;
+      }
+      #ifdef DEBUG_GENERAL
+        Serial.print(F("PiLink command "));
+        Serial.print(command->command);
+        Serial.print(F(", result "));
+        Serial.println(this->ack.result);
+      #endif
+    }
+
+    byte RunCommand(byte command, int16_t* value) {
+      // value in, and what was set out.
+      if (command >= PILINK_COMMAND_SET_TEMPERATURE && command <= PILINK_COMMAND_SAVE && this->incUI->isInMenu()) {
+        return PILINK_RESULT_BUSY;
+      }
+      switch (command) {
+        case PILINK_COMMAND_SET_TEMPERATURE:
+          return this->SetPointResult(value, this->incSet->setTemperatureSetPoint(*value / (float)PILINK_SCALE_LEVEL));
+        case PILINK_COMMAND_SET_CO2:
+          return this->SetPointResult(value, this->incSet->setCO2SetPoint(*value / (float)PILINK_SCALE_LEVEL));
+        case PILINK_COMMAND_SET_O2:
+          return this->SetPointResult(value, this->incSet->setO2SetPoint(*value / (float)PILINK_SCALE_LEVEL));
+        case PILINK_COMMAND_HEAT_MODE:
+          return this->ModeResult(this->incSet->setHeatMode(*value));
+        case PILINK_COMMAND_FAN_MODE:
+          return this->ModeResult(this->incSet->setFanMode(*value));
+        case PILINK_COMMAND_CO2_MODE:
+          return this->ModeResult(this->incSet->setCO2Mode(*value));
+        case PILINK_COMMAND_O2_MODE:
+          return this->ModeResult(this->incSet->setO2Mode(*value));
+        case PILINK_COMMAND_LIGHT_MODE:
+          return this->ModeResult(this->incSet->setLightMode(*value));
+        case PILINK_COMMAND_SAVE:
+          this->incSet->PerformSaveSettings();
+          return PILINK_RESULT_OK;
+        case PILINK_COMMAND_ACK_ALARM:
+          *value = this->incUI->AcknowledgeAlarm() ? 1 : 0;
+          return PILINK_RESULT_OK;
+        case PILINK_COMMAND_STATS:
+          this->statsPending = true;
+          return PILINK_RESULT_OK;
+      }
+      return PILINK_RESULT_UNKNOWN;
+    }
+
+    byte SetPointResult(int16_t* value, float set) {
+      int16_t requested = *value;
+      *value = PiLinkFixed(set, PILINK_SCALE_LEVEL);
+      this->statusRequested = true;
+      return *value == requested ? PILINK_RESULT_OK : PILINK_RESULT_LIMITED;
+    }
+
+    byte ModeResult(boolean taken) {
+      if (!taken) {
+        return PILINK_RESULT_REFUSED;
+      }
+      this->incSet->CheckSettings();
+      this->statusRequested = true;
+      return PILINK_RESULT_OK;
+    }
+
+    void DefaultPublishing() {
+      this->publish.mode = PILINK_PUBLISH_MODE;
+      this->publish.interval = PILINK_STATUS_INTERVAL;
+      this->publish.levelDeadband = PILINK_DEADBAND_LEVEL;
+      this->publish.dutyDeadband = PILINK_DEADBAND_DUTY;
+    }
+
+    boolean isSending() {
+      return this->txSent < this->txLength;
+    }
+
+    void SendFrame(byte type, const void* payload, byte size) {
+      PiLinkFrameWriter frame;
+      frame.Start(this->txBuffer, type);
+      frame.Put(payload, size);
+      this->txLength = frame.Finish();
+      this->txSent = 0;
+      this->lastSentAt = millis();
+    }
+
+    void SendHello() {
+      PiLinkHello hello;
+      hello.serial = this->incSet->getSerialNumber();
+      hello.maxBaud = PILINK_BAUD_MAX;
+      this->SendFrame(PILINK_FRAME_HELLO, &hello, sizeof(hello));
+      this->lastHello = millis();
+    }
+
+    void FillGasMeter(PiLinkGasMeter* out, GasMeterStatus* meter) {
+      out->openSeconds = meter->openSeconds;
+      out->pulseCount = meter->pulseCount;
+      out->volume = meter->volume * 1000 + 0.5;
+      out->rate = PiLinkClampUnsigned(meter->rate + 0.5);
+      out->hoursToEmpty = PiLinkClamp(meter->hoursToEmpty);
+    }
+
+    void SendHeartbeat() {
+      PiLinkHeartbeat heartbeat;
+      heartbeat.uptime = millis();
+      heartbeat.statusFrames = this->statusFrames;
+      heartbeat.badFrames = this->reader.getBadFrames();
+      this->SendFrame(PILINK_FRAME_HEARTBEAT, &heartbeat, sizeof(heartbeat));
+    }
+
+    void SendStats() {
+      PiLinkStats stats;
+      stats.sequence = this->ack.sequence;
+      stats.uptime = millis();
+      stats.freeMemory = freeMemory();
+      stats.eepromWrites = this->incSet->getPersistence()->getWriteCount();
+      stats.powerDeferred = this->incSet->getPowerArbiter()->getDeferredCount();
+      stats.statusLinesDropped = statusLine.getDropped();
+      stats.framesGood = this->reader.getGoodFrames();
+      stats.framesBad = this->reader.getBadFrames();
+      stats.commands = this->commands;
+      stats.commandsRefused = this->commandsRefused;
+      stats.statusFrames = this->statusFrames;
+      stats.alarmTransitions = alarmHistory.getCount();
+      this->SendFrame(PILINK_FRAME_STATS, &stats, sizeof(stats));
     }
-    
+
+    void FillStatus(PiLinkStatus* out) {
+      StatusSnapshot* st = incStatus->Get();
+
+      out->uptime = millis();
+      out->serial = st->serial;
+      out->fanMode = st->fanMode;
+      out->heatMode = st->heatMode;
+      out->CO2Mode = st->CO2Mode;
+      out->O2Mode = st->O2Mode;
+      out->lightMode = st->lightMode;
+      out->heatSetPoint = PiLinkFixed(st->heatSetPoint, PILINK_SCALE_LEVEL);
+      out->CO2SetPoint = PiLinkFixed(st->CO2SetPoint, PILINK_SCALE_LEVEL);
+      out->O2SetPoint = PiLinkFixed(st->O2SetPoint, PILINK_SCALE_LEVEL);
+      out->chamberTemp = PiLinkFixed(st->chamberTemp, PILINK_SCALE_LEVEL);
+      out->doorTemp = PiLinkFixed(st->doorTemp, PILINK_SCALE_LEVEL);
+      out->otherTemp = PiLinkFixed(st->otherTemp, PILINK_SCALE_LEVEL);
+      out->CO2Level = PiLinkFixed(st->CO2Level, PILINK_SCALE_LEVEL);
+      out->O2Level = PiLinkFixed(st->O2Level, PILINK_SCALE_LEVEL);
+
+      out->flags = 0;
+      if (st->doorOn) out->flags |= PILINK_FLAG_DOOR_ON;
+      if (st->doorStepping) out->flags |= PILINK_FLAG_DOOR_STEPPING;
+      if (st->chamberOn) out->flags |= PILINK_FLAG_CHAMBER_ON;
+      if (st->chamberStepping) out->flags |= PILINK_FLAG_CHAMBER_STEPPING;
+      if (st->CO2Open) out->flags |= PILINK_FLAG_CO2_OPEN;
+      if (st->CO2Stepping) out->flags |= PILINK_FLAG_CO2_STEPPING;
+      if (st->O2Open) out->flags |= PILINK_FLAG_O2_OPEN;
+      if (st->O2Stepping) out->flags |= PILINK_FLAG_O2_STEPPING;
+      if (st->heatAlarmed) out->flags |= PILINK_FLAG_HEAT_ALARMED;
+      if (st->CO2Alarmed) out->flags |= PILINK_FLAG_CO2_ALARMED;
+      if (st->O2Alarmed) out->flags |= PILINK_FLAG_O2_ALARMED;
+      if (st->chamberDegraded) out->flags |= PILINK_FLAG_CHAMBER_DEGRADED;
+      if (st->CO2Degraded) out->flags |= PILINK_FLAG_CO2_DEGRADED;
+      if (st->chamberWarmingUp) out->flags |= PILINK_FLAG_CHAMBER_WARMING_UP;
+      if (st->hasCO2Meter) out->flags |= PILINK_FLAG_CO2_METER;
+      if (st->hasNMeter) out->flags |= PILINK_FLAG_N_METER;
+      out->lightIndicator = st->lightIndicator;
+      out->chamberDuty = PiLinkFixed(st->chamberDuty, PILINK_SCALE_DUTY);
+      out->CO2Duty = PiLinkFixed(st->CO2Duty, PILINK_SCALE_DUTY);
+      out->warmUpTime = PiLinkClamp(st->warmUpTime);
+
+      out->doorState = st->doorState;
+      out->doorEvents = PiLinkClampUnsigned(st->doorEvents);
+      out->doorOpenTime = PiLinkClamp(st->doorOpenTime);
+      out->doorRecoveryTime = PiLinkClamp(st->doorRecoveryTime);
+      out->profileSegment = st->profileSegment;
+      out->freeMemory = freeMemory();
+    }
+
+    boolean isStatusDue(unsigned long nowTime) {
+      // Fills in status when one could be due, which in PILINK_PUBLISH_CHANGE is only every interval.
+      unsigned long sinceLast = nowTime - this->lastStatusAt;
+      if (!this->statusRequested && (this->publish.mode == PILINK_PUBLISH_REQUEST || sinceLast < this->publish.interval)) {
+        return false;
+      }
+      this->FillStatus(&this->status);
+      if (this->statusRequested || this->publish.mode == PILINK_PUBLISH_RATE || sinceLast >= PILINK_REFRESH_INTERVAL) {
+        return true;
+      }
+      return PiLinkStatusChanged(&this->lastStatus, &this->status, &this->publish);
+    }
+
     void SendStatus() {
-      // General Identification
-      Serial1.print(millis());
-      Serial1.print(F(" ID "));              // Identification
-      Serial1.print(incSet->getSerial());
-      // Heating/Fan system
-      Serial1.print(F(" FM "));              // Fan, mode
-      Serial1.print(incSet->getFanMode());
-      Serial1.print(F(" TM "));              // Temperature, mode
-      Serial1.print(incSet->getHeatMode());
-      Serial1.print(F(" TP "));              // Temperature, setpoint
-      Serial1.print(incSet->getTemperatureSetPoint(), 2);
-      Serial1.print(F(" TC "));              // Temperature, chamber
-      Serial1.print(incSet->getChamberTemperature(), 2);
-      Serial1.print(F(" TD "));              // Temperature, door
-      Serial1.print(incSet->getDoorTemperature(), 2);
-      Serial1.print(F(" TO "));              // Temperature, other
-      Serial1.print(incSet->getOtherTemperature(), 2);
-      Serial1.print(F(" TS "));              // Temperature, status
-      Serial1.print(GetIndicator(incSet->isDoorOn(), incSet->isDoorStepping(), false, true));
-      Serial1.print(GetIndicator(incSet->isChamberOn(), incSet->isChamberStepping(), false, true));
-      Serial1.print(F(" TA "));              // Temperature, alarms
-      Serial1.print(GetIndicator(incSet->isHeatAlarmed(), false, false, true));
-      // CO2 system
-      Serial1.print(F(" CM "));              // CO2, mode
-      Serial1.print(incSet->getCO2Mode());
-      Serial1.print(F(" CP "));              // CO2, setpoint
-      Serial1.print(incSet->getCO2SetPoint(), 2);
-      Serial1.print(F(" CC "));              // CO2, reading
-      Serial1.print(incSet->getCO2Level(), 2);
-      Serial1.print(F(" CS "));              // CO2, status
-      Serial1.print(GetIndicator(incSet->isCO2Open(), incSet->isCO2Stepping(), false, true));
-      Serial1.print(F(" CA "));              // CO2, alarms
-      Serial1.print(GetIndicator(incSet->isCO2Alarmed(), false, false, true));
-      // O2 system
-      Serial1.print(F(" OM "));              // O2, mode
-      Serial1.print(incSet->getO2Mode());
-      Serial1.print(F(" OP "));              // O2, setpoint
-      Serial1.print(incSet->getO2SetPoint(), 2);
-      Serial1.print(F(" OC "));              // O2, reading
-      Serial1.print(incSet->getO2Level(), 2);
-      Serial1.print(F(" OS "));              // CO2, status
-      Serial1.print(GetIndicator(incSet->isO2Open(), incSet->isO2Stepping(), false, true));
-      Serial1.print(F(" OA "));              // CO2, alarms
-      Serial1.print(GetIndicator(incSet->isO2Alarmed(), false, false, true));
-      // Options
-      Serial1.print(F(" LM "));              // Light Mode
-      Serial1.print(incSet->getLightMode());
-      Serial1.print(F(" LS "));              // Light System
-      Serial1.print(incSet->getLightModule()->GetSerialAPIndicator());
-      // Debugging
-      Serial1.print(F(" FM "));              // Free memory
-      Serial1.print(freeMemory());
-      Serial1.println();
-    }
-    
+      // The status filled in by isStatusDue(), with the gas meters.
+      StatusSnapshot* st = incStatus->Get();
+      PiLinkGasMeter meter;
+      PiLinkFrameWriter frame;
+
+      frame.Start(this->txBuffer, PILINK_FRAME_STATUS);
+      frame.Put(&this->status, sizeof(this->status));
+      if (st->hasCO2Meter) {
+        this->FillGasMeter(&meter, &st->CO2Meter);
+        frame.Put(&meter, sizeof(meter));
+      }
+      if (st->hasNMeter) {
+        this->FillGasMeter(&meter, &st->NMeter);
+        frame.Put(&meter, sizeof(meter));
+      }
+      this->txLength = frame.Finish();
+      this->txSent = 0;
+      this->lastStatus = this->status;
+      this->lastStatusAt = millis();
+      this->lastSentAt = this->lastStatusAt;
+      this->statusFrames++;
+      this->statusRequested = false;
+    }
+
   public:
-    void SetupPiLink(IncuversSettingsHandler* iSettings) {
+    void SetupPiLink(IncuversSettingsHandler* iSettings, IncuversStatus* iStatus, IncuversUI* iUI) {
       this->incSet = iSettings;
-      if (this->incSet->HasPiLink()) {
-        Serial1.begin(9600, SERIAL_8E2);
+      this->incStatus = iStatus;
+      this->incUI = iUI;
+      this->isEnabled = this->incSet->HasPiLink();
+      this->reader.Setup();
+      this->txLength = 0;
+      this->txSent = 0;
+      this->baud = 0;
+      this->answerBaud = 0;
+      this->switchBaud = 0;
+      this->lastHeard = millis();
+      this->lastHello = millis() - PILINK_HELLO_INTERVAL;
+      this->DefaultPublishing();
+      this->answerPublish = false;
+      this->statusRequested = true;
+      this->lastStatusAt = millis();
+      this->lastSentAt = millis();
+      this->statusFrames = 0;
+      this->ackPending = false;
+      this->haveAck = false;
+      this->statsPending = false;
+      this->commands = 0;
+      this->commandsRefused = 0;
+      if (this->isEnabled) {
+        this->Begin(PILINK_BAUD_DEFAULT);
+      }
+    }
+
+    void DoQuickTick() {
+      // Feeds the port what it has room for, never waiting on it.  Also called from yield().
+      if (!this->isSending()) {
+        return;
+      }
+      int room = Serial1.availableForWrite();
+      while (room > 0 && this->txSent < this->txLength) {
+        Serial1.write(this->txBuffer[this->txSent++]);
+        room--;
       }
     }
 
     void DoTick() {
-      if (this->incSet->HasPiLink()) {
-        CheckForCommands();
-        SendStatus();
+      if (!this->isEnabled) {
+        return;
       }
+      this->CheckForCommands();
+      this->DoQuickTick();
+      if (this->isSending()) {
+        return;
+      }
+
+      if (this->switchBaud != 0) {
+        // The answer went at the old rate, wait for the port to have sent all of it.
+        if (Serial1.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1) {
+          return;
+        }
+        this->Begin(this->switchBaud);
+        this->switchBaud = 0;
+        this->lastHeard = millis();
+      }
+
+      unsigned long nowTime = millis();
+      if (this->answerBaud != 0) {
+        PiLinkBaud answer;
+        answer.baud = this->answerBaud;
+        this->SendFrame(PILINK_FRAME_BAUD, &answer, sizeof(answer));
+        if (this->answerBaud != this->baud) {
+          this->switchBaud = this->answerBaud;
+        }
+        this->answerBaud = 0;
+      } else if (this->ackPending) {
+        this->SendFrame(PILINK_FRAME_ACK, &this->ack, sizeof(this->ack));
+        this->ackPending = false;
+      } else if (this->statsPending) {
+        this->SendStats();
+        this->statsPending = false;
+      } else if (this->answerPublish) {
+        this->SendFrame(PILINK_FRAME_PUBLISH, &this->publish, sizeof(this->publish));
+        this->answerPublish = false;
+      } else if (this->baud != PILINK_BAUD_DEFAULT && nowTime - this->lastHeard > PILINK_LINK_TIMEOUT) {
+        // The Pi has gone quiet, it may have restarted at the default rate.
+        this->Begin(PILINK_BAUD_DEFAULT);
+        this->DefaultPublishing();
+        this->SendHello();
+      } else if (this->baud == PILINK_BAUD_DEFAULT && nowTime - this->lastHello >= PILINK_HELLO_INTERVAL) {
+        this->SendHello();
+      } else if (this->isStatusDue(nowTime)) {
+        this->SendStatus();
+      } else if (nowTime - this->lastSentAt >= PILINK_HEARTBEAT_INTERVAL) {
+        this->SendHeartbeat();
+      }
+      this->DoQuickTick();
+    }
+
+    unsigned long getBaud() {
+      return this->baud;
     }
 
+    unsigned long getBadFrames() {
+      return this->reader.getBadFrames();
+    }
 };
 
 #else
 class IncuversPiLink {
   public:
-    void SetupPiLink(IncuversSettingsHandler* iSettings) {
+    void SetupPiLink(IncuversSettingsHandler* iSettings, IncuversStatus* iStatus, IncuversUI* iUI) {
+    }
+
+    void DoQuickTick() {
     }
 
     void DoTick() {
@@ -0,0 +1,506 @@
+/*
+ * Incuvers EEPROM image tool.
+ *
+ * Builds the EEPROM image for a unit (its hardware definition and the default settings) from a small per-unit config
+ * file, and decodes and checks images read back from units.  The records are laid out with the firmware's own headers
+ * (Incuvers_EEPROMLayout.h and Incuvers_SettingsStore.h), so the image is byte for byte what the firmware expects.
+ *
+ * Build on the host:
+ *   g++ -O2 -o eepimage IncuversEEPROMImage.cpp
+ *
+ * Provision a unit, firmware and EEPROM in one go:
+ *   ./eepimage build unit.cfg unit.eep
+ *   avrdude -p m2560 -c wiring -P <port> -b 115200 -D -U flash:w:Incuvers_Incubator.ino.hex:i -U eeprom:w:unit.eep:i
+ *
+ * Check a unit:
+ *   avrdude -p m2560 -c wiring -P <port> -b 115200 -U eeprom:r:readback.eep:i
+ *   ./eepimage decode readback.eep
+ *
+ * The config file is "key = value" lines, # starts a comment.  Anything left out takes the value in DefaultHardware():
+ *   serial = 666                    # Serial number as printed inside the top cover
+ *   hardware = 1.0.1                # PCB revision
+ *   temp_sensors = 2                # Count of temperature sensors installed
+ *   door_sensor = 28FF4C1D001604A1  # ROMs of the door and chamber DS18B20s, 8 bytes in hex starting with the family
+ *   chamber_sensor = 28FF8B2C00160512  #   code (28).  Optional, without them the roles are set by the sensor setup
+ *                                   #   in the menu on the first boot
+ *   co2_sensor = yes
+ *   co2_rx = 17
+ *   co2_tx = 16
+ *   o2_sensor = yes                 # o2_rx, o2_tx as for the CO2 sensor
+ *   co2_valve = yes
+ *   co2_valve_pin = 6
+ *   o2_valve = yes                  # o2_valve_pin as for the CO2 valve
+ *   pilink = yes                    # pilink_rx, pilink_tx as for the sensors
+ *   lighting = no
+ *   light_pin = 2
+ *   temperature = 37.0              # Set points to start with, instead of the firmware defaults
+ *   co2 = 5.0
+ *   o2 = 5.0
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// Just enough of the Arduino environment for the firmware headers.
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define EEPROM_SIZE 4096
+
+class ImageEEPROM {
+  public:
+    byte cells[EEPROM_SIZE];
+
+    void Erase() {
+      memset(this->cells, 0xFF, sizeof(this->cells));
+    }
+
+    byte read(int address) {
+      return this->cells[address];
+    }
+
+    void write(int address, byte value) {
+      this->cells[address] = value;
+    }
+};
+
+ImageEEPROM EEPROM;
+
+void eeprom_read_block(void* dst, const void* src, size_t len) {
+  memcpy(dst, EEPROM.cells + (intptr_t)src, len);
+}
+
+int eeprom_is_ready() {
+  return 1;
+}
+
+#include "../../Main/Incuvers_Incubator/Definitions.h"
+#pragma pack(push, 1)               // avr-gcc doesn't pad, keep the layout identical
+#include "../../Main/Incuvers_Incubator/Incuvers_EEPROMLayout.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_SettingsStore.h"
+#pragma pack(pop)
+
+// What avr-gcc makes of the layout.  If one of these fails the firmware's records changed: update the tool (and the
+// numbers here) to match, and remember that units in the field need a migration for settings changes.
+static_assert(sizeof(HardwareStruct) == 40, "HardwareStruct layout changed");
+static_assert(HARDWARE_FIELD(serial) == 6 && HARDWARE_FIELD(sensorAddrDoorTemp) == 9 && HARDWARE_FIELD(lightPin) == 39, "HardwareStruct layout changed");
+static_assert(sizeof(SettingsStruct) == 17, "SettingsStruct layout changed");
+static_assert(offsetof(SettingsStruct, heatSetPoint) == 3 && offsetof(SettingsStruct, millisOn) == 9, "SettingsStruct layout changed");
+static_assert(sizeof(SettingsStoreHeader) == 7, "SettingsStoreHeader layout changed");
+static_assert(sizeof(SettingsStruct) <= SETTINGSSTORE_PAYLOAD_SIZE, "SettingsStruct doesn't fit in a settings store slot");
+static_assert(SETTINGSSTORE_ADDRS + SETTINGSSTORE_SLOTS * (sizeof(SettingsStoreHeader) + SETTINGSSTORE_PAYLOAD_SIZE) <= PROFILE_ADDRS, "The settings store runs into the profiles");
+static_assert(sizeof(SensorTableStruct) == 2 + SENSORTABLE_MAX * 9, "SensorTableStruct layout changed");
+static_assert(PROFILE_ADDRS + PROFILE_COUNT * PROFILE_STRIDE <= SENSORTABLE_ADDRS, "The profiles run into the sensor table");
+static_assert(SENSORTABLE_ADDRS + sizeof(SensorTableStruct) <= EEPROM_SIZE, "The sensor table doesn't fit in the EEPROM");
+
+int16_t ToFixed(float value) {
+  return (int16_t)(value * SETTINGS_FIXED_SCALE + (value < 0 ? -0.5 : 0.5));
+}
+
+float FromFixed(int16_t value) {
+  return value / (float)SETTINGS_FIXED_SCALE;
+}
+
+void DefaultHardware(HardwareStruct* h) {
+  // The same defaults the writer sketch used to start from.
+  memset(h, 0, sizeof(*h));
+  memcpy(h->ident, HARDWARE_IDENT, 3);
+  h->hVer[0] = 1;
+  h->hVer[1] = 0;
+  h->hVer[2] = 0;
+  h->serial = 0;
+  h->countOfTempSensors = 2;
+  h->hasCO2Sensor = 1;
+  h->CO2RxPin = 17;
+  h->CO2TxPin = 16;
+  h->hasO2Sensor = 1;
+  h->O2RxPin = 15;
+  h->O2TxPin = 14;
+  h->CO2GasRelay = 1;
+  h->CO2RelayPin = 6;
+  h->O2GasRelay = 1;
+  h->O2RelayPin = 7;
+  h->piSupport = 1;
+  h->piRxPin = 19;
+  h->piTxPin = 18;
+  h->lightingSupport = 0;
+  h->lightPin = 2;
+}
+
+void DefaultSettings(SettingsStruct* s) {
+  // As IncuversSettingsHandler::ResetSettingsToDefaults()
+  memset(s, 0, sizeof(*s));
+  s->ident = SETTINGS_IDENT_CURR;
+  s->fanMode = 4;
+  s->heatMode = 1;
+  s->heatSetPoint = ToFixed(TEMPERATURE_DEF);
+  s->CO2Mode = 2;
+  s->CO2SetPoint = ToFixed(CO2_DEF);
+  s->O2Mode = 2;
+  s->O2SetPoint = ToFixed(OO_DEF);
+  s->lightMode = 0;
+  s->millisOn = 60000;
+  s->millisOff = 30000;
+  s->alarmMode = 2;
+}
+
+// Config file
+
+bool ParseBool(const char* value, uint8_t* out) {
+  if (!strcmp(value, "yes") || !strcmp(value, "true") || !strcmp(value, "1")) {
+    *out = 1;
+  } else if (!strcmp(value, "no") || !strcmp(value, "false") || !strcmp(value, "0")) {
+    *out = 0;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseByte(const char* value, uint8_t* out) {
+  char* end;
+  long v = strtol(value, &end, 10);
+  if (*end != 0 || v < 0 || v > 255) {
+    return false;
+  }
+  *out = (uint8_t)v;
+  return true;
+}
+
+bool ParseROM(const char* value, uint8_t* out) {
+  // 16 hex digits, addr[0] (the family code) first.
+  if (strlen(value) != 16) {
+    return false;
+  }
+  for (int i = 0; i < 8; i++) {
+    char digits[3] = { value[i * 2], value[i * 2 + 1], 0 };
+    char* end;
+    if (!isxdigit(digits[0]) || !isxdigit(digits[1])) {
+      return false;
+    }
+    out[i] = (uint8_t)strtol(digits, &end, 16);
+  }
+  return true;
+}
+
+bool ParseSetPoint(const char* value, float minimum, float maximum, int16_t* out) {
+  char* end;
+  float v = strtof(value, &end);
+  if (*end != 0 || !(v >= minimum && v <= maximum)) {
+    return false;
+  }
+  *out = ToFixed(v);
+  return true;
+}
+
+bool ApplyConfig(const char* key, const char* value, HardwareStruct* h, SettingsStruct* s) {
+  if (!strcmp(key, "serial")) {
+    char* end;
+    long v = strtol(value, &end, 10);
+    if (*end != 0 || v < 0 || v > 32767) {
+      return false;
+    }
+    h->serial = (int16_t)v;
+    return true;
+  }
+  if (!strcmp(key, "hardware")) {
+    unsigned int a, b, c;
+    if (sscanf(value, "%u.%u.%u", &a, &b, &c) != 3 || a > 255 || b > 255 || c > 255) {
+      return false;
+    }
+    h->hVer[0] = a;
+    h->hVer[1] = b;
+    h->hVer[2] = c;
+    return true;
+  }
+  if (!strcmp(key, "temp_sensors")) return ParseByte(value, &h->countOfTempSensors);
+  if (!strcmp(key, "door_sensor")) return ParseROM(value, h->sensorAddrDoorTemp);
+  if (!strcmp(key, "chamber_sensor")) return ParseROM(value, h->sensorAddrChamberTemp);
+  if (!strcmp(key, "co2_sensor")) return ParseBool(value, &h->hasCO2Sensor);
+  if (!strcmp(key, "co2_rx")) return ParseByte(value, &h->CO2RxPin);
+  if (!strcmp(key, "co2_tx")) return ParseByte(value, &h->CO2TxPin);
+  if (!strcmp(key, "o2_sensor")) return ParseBool(value, &h->hasO2Sensor);
+  if (!strcmp(key, "o2_rx")) return ParseByte(value, &h->O2RxPin);
+  if (!strcmp(key, "o2_tx")) return ParseByte(value, &h->O2TxPin);
+  if (!strcmp(key, "co2_valve")) return ParseBool(value, &h->CO2GasRelay);
+  if (!strcmp(key, "co2_valve_pin")) return ParseByte(value, &h->CO2RelayPin);
+  if (!strcmp(key, "o2_valve")) return ParseBool(value, &h->O2GasRelay);
+  if (!strcmp(key, "o2_valve_pin")) return ParseByte(value, &h->O2RelayPin);
+  if (!strcmp(key, "pilink")) return ParseBool(value, &h->piSupport);
+  if (!strcmp(key, "pilink_rx")) return ParseByte(value, &h->piRxPin);
+  if (!strcmp(key, "pilink_tx")) return ParseByte(value, &h->piTxPin);
+  if (!strcmp(key, "lighting")) return ParseBool(value, &h->lightingSupport);
+  if (!strcmp(key, "light_pin")) return ParseByte(value, &h->lightPin);
+  if (!strcmp(key, "temperature")) return ParseSetPoint(value, TEMPERATURE_MIN, TEMPERATURE_MAX, &s->heatSetPoint);
+  if (!strcmp(key, "co2")) return ParseSetPoint(value, CO2_MIN, CO2_MAX, &s->CO2SetPoint);
+  if (!strcmp(key, "o2")) return ParseSetPoint(value, OO_MIN, OO_MAX, &s->O2SetPoint);
+  return false;
+}
+
+char* Trim(char* str) {
+  while (isspace((unsigned char)*str)) {
+    str++;
+  }
+  char* end = str + strlen(str);
+  while (end > str && isspace((unsigned char)end[-1])) {
+    *--end = 0;
+  }
+  return str;
+}
+
+bool ReadConfig(const char* path, HardwareStruct* h, SettingsStruct* s) {
+  FILE* f = fopen(path, "r");
+  char line[256];
+  int lineNumber = 0;
+  bool ok = true;
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineNumber++;
+    char* hash = strchr(line, '#');
+    if (hash != NULL) {
+      *hash = 0;
+    }
+    char* key = Trim(line);
+    if (*key == 0) {
+      continue;
+    }
+    char* equals = strchr(key, '=');
+    if (equals == NULL) {
+      fprintf(stderr, "%s:%d: expected key = value\n", path, lineNumber);
+      ok = false;
+      continue;
+    }
+    *equals = 0;
+    char* value = Trim(equals + 1);
+    key = Trim(key);
+    if (!ApplyConfig(key, value, h, s)) {
+      fprintf(stderr, "%s:%d: unknown key %s, or bad value '%s'\n", path, lineNumber, key, value);
+      ok = false;
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+// Intel HEX, as avrdude reads and writes .eep files
+
+bool WriteHex(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  for (int address = 0; address < EEPROM_SIZE; address += 16) {
+    uint8_t sum = 16 + (address >> 8) + (address & 0xFF);
+    fprintf(f, ":10%04X00", address);
+    for (int i = 0; i < 16; i++) {
+      fprintf(f, "%02X", EEPROM.cells[address + i]);
+      sum += EEPROM.cells[address + i];
+    }
+    fprintf(f, "%02X\n", (uint8_t)-sum);
+  }
+  fprintf(f, ":00000001FF\n");
+  fclose(f);
+  return true;
+}
+
+bool ReadHex(const char* path) {
+  FILE* f = fopen(path, "r");
+  char line[600];
+  int lineNumber = 0;
+
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  EEPROM.Erase();
+  while (fgets(line, sizeof(line), f) != NULL) {
+    unsigned int count, address, type, value;
+    uint8_t sum = 0;
+
+    lineNumber++;
+    char* record = Trim(line);
+    if (*record == 0) {
+      continue;
+    }
+    if (*record != ':' || sscanf(record + 1, "%2x%4x%2x", &count, &address, &type) != 3 || strlen(record) != 11 + count * 2) {
+      fprintf(stderr, "%s:%d: not an Intel HEX record\n", path, lineNumber);
+      fclose(f);
+      return false;
+    }
+    for (unsigned int i = 0; i < count + 5; i++) {
+      sscanf(record + 1 + i * 2, "%2x", &value);
+      sum += value;
+    }
+    if (sum != 0) {
+      fprintf(stderr, "%s:%d: bad checksum\n", path, lineNumber);
+      fclose(f);
+      return false;
+    }
+    if (type == 1) {
+      break;
+    }
+    if (type != 0) {
+      continue;           // Segment/linear address records, the EEPROM is smaller than 64K
+    }
+    for (unsigned int i = 0; i < count; i++) {
+      sscanf(record + 9 + i * 2, "%2x", &value);
+      if (address + i < EEPROM_SIZE) {
+        EEPROM.cells[address + i] = value;
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// Commands
+
+void PrintROM(const char* name, const uint8_t* rom) {
+  printf("  %-16s", name);
+  for (int i = 0; i < 8; i++) {
+    printf("%02X", rom[i]);
+  }
+  printf("\n");
+}
+
+const char* GetRoleName(uint8_t role) {
+  // As IncuversSensorBus::GetRoleName(), without the zone number.
+  switch (role) {
+    case SENSOR_ROLE_NONE:
+      return "unassigned";
+    case SENSOR_ROLE_DOOR:
+      return "door";
+    case SENSOR_ROLE_CHAMBER:
+      return "chamber";
+    case SENSOR_ROLE_AMBIENT:
+      return "ambient";
+  }
+  return "zone";
+}
+
+int Build(const char* configPath, const char* imagePath) {
+  HardwareStruct hardware;
+  SettingsStruct settings;
+  IncuversSettingsStore store;
+
+  DefaultHardware(&hardware);
+  DefaultSettings(&settings);
+  if (!ReadConfig(configPath, &hardware, &settings)) {
+    return 1;
+  }
+
+  // Everything else is left erased, so nothing stale on the unit survives (old settings records, gas totals...).
+  EEPROM.Erase();
+  memcpy(EEPROM.cells + HARDWARE_ADDRS, &hardware, sizeof(hardware));
+  store.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
+  store.Save(&settings, sizeof(settings), SETTINGS_VERSION_CURR);
+
+  if (!WriteHex(imagePath)) {
+    return 1;
+  }
+  printf("Unit %d (hardware %d.%d.%d): %d byte hardware definition at %d, settings v%d in slot %d of the store at %d\n",
+         hardware.serial, hardware.hVer[0], hardware.hVer[1], hardware.hVer[2], (int)sizeof(hardware), HARDWARE_ADDRS,
+         SETTINGS_VERSION_CURR, store.getCurrentSlot(), SETTINGSSTORE_ADDRS);
+  return 0;
+}
+
+int Decode(const char* imagePath) {
+  HardwareStruct hardware;
+  SettingsStruct settings;
+  byte record[SETTINGSSTORE_PAYLOAD_SIZE];
+  IncuversSettingsStore store;
+  int problems = 0;
+
+  if (!ReadHex(imagePath)) {
+    return 1;
+  }
+
+  memcpy(&hardware, EEPROM.cells + HARDWARE_ADDRS, sizeof(hardware));
+  if (memcmp(hardware.ident, HARDWARE_IDENT, 3) != 0) {
+    printf("Hardware definition: missing (ident %02X %02X %02X), the firmware won't run\n", hardware.ident[0], hardware.ident[1], hardware.ident[2]);
+    problems++;
+  } else {
+    printf("Hardware definition:\n");
+    printf("  %-16s%d\n", "serial", hardware.serial);
+    printf("  %-16s%d.%d.%d\n", "hardware", hardware.hVer[0], hardware.hVer[1], hardware.hVer[2]);
+    printf("  %-16s%d\n", "temp_sensors", hardware.countOfTempSensors);
+    PrintROM("door_sensor", hardware.sensorAddrDoorTemp);
+    PrintROM("chamber_sensor", hardware.sensorAddrChamberTemp);
+    printf("  %-16s%d (rx %d, tx %d)\n", "co2_sensor", hardware.hasCO2Sensor, hardware.CO2RxPin, hardware.CO2TxPin);
+    printf("  %-16s%d (rx %d, tx %d)\n", "o2_sensor", hardware.hasO2Sensor, hardware.O2RxPin, hardware.O2TxPin);
+    printf("  %-16s%d (pin %d)\n", "co2_valve", hardware.CO2GasRelay, hardware.CO2RelayPin);
+    printf("  %-16s%d (pin %d)\n", "o2_valve", hardware.O2GasRelay, hardware.O2RelayPin);
+    printf("  %-16s%d (rx %d, tx %d)\n", "pilink", hardware.piSupport, hardware.piRxPin, hardware.piTxPin);
+    printf("  %-16s%d (pin %d)\n", "lighting", hardware.lightingSupport, hardware.lightPin);
+  }
+
+  store.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
+  if (!store.Load(record)) {
+    if (EEPROM.cells[SETTINGS_ADDRS] == SETTINGS_IDENT_CURR) {
+      printf("Settings: only the old version 1 record, the firmware will migrate it\n");
+    } else {
+      printf("Settings: none, the firmware will start from its defaults\n");
+    }
+  } else if (store.getVersion() != SETTINGS_VERSION_CURR || store.getSize() != sizeof(settings)) {
+    printf("Settings: version %d (%d bytes) in slot %d, seq %d, the firmware will migrate it\n", store.getVersion(), store.getSize(), store.getCurrentSlot(), store.getSequence());
+  } else {
+    memcpy(&settings, record, sizeof(settings));
+    printf("Settings: version %d in slot %d, seq %d\n", store.getVersion(), store.getCurrentSlot(), store.getSequence());
+    printf("  %-16s%d\n", "fan mode", settings.fanMode);
+    printf("  %-16s%d, %.2f C\n", "heat", settings.heatMode, FromFixed(settings.heatSetPoint));
+    printf("  %-16s%d, %.2f %%\n", "CO2", settings.CO2Mode, FromFixed(settings.CO2SetPoint));
+    printf("  %-16s%d, %.2f %%\n", "O2", settings.O2Mode, FromFixed(settings.O2SetPoint));
+    printf("  %-16s%d, on %ld ms, off %ld ms\n", "light", settings.lightMode, (long)settings.millisOn, (long)settings.millisOff);
+    printf("  %-16s%d\n", "alarm mode", settings.alarmMode);
+    // As IncuversSettingsHandler::ValidateSettings()
+    if (settings.fanMode > 4 || settings.CO2Mode > 2 || settings.O2Mode > 2 || settings.lightMode > 2 || settings.alarmMode > 2
+        || settings.heatSetPoint < ToFixed(TEMPERATURE_MIN) || settings.heatSetPoint > ToFixed(TEMPERATURE_MAX)
+        || settings.CO2SetPoint < ToFixed(CO2_MIN) || settings.CO2SetPoint > ToFixed(CO2_MAX)
+        || settings.O2SetPoint < ToFixed(OO_MIN) || settings.O2SetPoint > ToFixed(OO_MAX)) {
+      printf("  out of range, the firmware will use its defaults\n");
+      problems++;
+    }
+  }
+  if (store.getBadSlotCount() > 0) {
+    printf("Settings store: %d corrupt slot(s)\n", store.getBadSlotCount());
+    problems++;
+  }
+
+  SensorTableStruct sensors;
+  memcpy(&sensors, EEPROM.cells + SENSORTABLE_ADDRS, sizeof(sensors));
+  if (sensors.ident != SENSORTABLE_IDENT || sensors.count == 0 || sensors.count > SENSORTABLE_MAX) {
+    printf("Temperature sensors: none cached, the firmware will search the bus\n");
+  } else {
+    printf("Temperature sensors: %d cached\n", sensors.count);
+    for (int i = 0; i < sensors.count; i++) {
+      char name[24];
+      if (sensors.sensors[i].role >= SENSOR_ROLE_ZONE) {
+        snprintf(name, sizeof(name), "zone %d", sensors.sensors[i].role - SENSOR_ROLE_ZONE + 1);
+      } else {
+        snprintf(name, sizeof(name), "%s", GetRoleName(sensors.sensors[i].role));
+      }
+      PrintROM(name, sensors.sensors[i].rom);
+    }
+  }
+
+  return problems == 0 ? 0 : 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 4 && !strcmp(argv[1], "build")) {
+    return Build(argv[2], argv[3]);
+  }
+  if (argc == 3 && !strcmp(argv[1], "decode")) {
+    return Decode(argv[2]);
+  }
+  fprintf(stderr, "usage: %s build <unit config> <image.eep>\n       %s decode <image.eep>\n", argv[0], argv[0]);
+  return 1;
+}
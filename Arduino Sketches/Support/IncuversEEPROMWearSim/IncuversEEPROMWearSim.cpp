@@ -0,0 +1,191 @@
+/*
+ * Incuvers EEPROM wear simulator.
+ *
+ * Runs the firmware's settings store (Incuvers_SettingsStore.h) against a simulated EEPROM that counts writes per cell,
+ * replays a pattern of settings saves and projects how long the most worn cell will last, compared to the old
+ * rewrite-everything-in-place save.  It also cuts random saves short to check that a record always survives a power
+ * loss.
+ *
+ * Build and run on the host:
+ *   g++ -O2 -o wearsim IncuversEEPROMWearSim.cpp
+ *   ./wearsim [saves per day] [simulated saves] [cell endurance]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Just enough of the Arduino environment for the firmware header.
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define EEPROM_SIZE 4096
+
+class SimEEPROM {
+  public:
+    byte cells[EEPROM_SIZE];
+    unsigned long writes[EEPROM_SIZE];
+    long writeBudget;               // Writes left before the simulated power loss (-1 = no loss)
+
+    void Reset() {
+      memset(this->cells, 0xFF, sizeof(this->cells));
+      memset(this->writes, 0, sizeof(this->writes));
+      this->writeBudget = -1;
+    }
+
+    byte read(int address) {
+      return this->cells[address];
+    }
+
+    void write(int address, byte value) {
+      if (this->writeBudget == 0) {
+        return;
+      }
+      if (this->writeBudget > 0) {
+        this->writeBudget--;
+      }
+      this->cells[address] = value;
+      this->writes[address]++;
+    }
+};
+
+SimEEPROM EEPROM;
+
+void eeprom_read_block(void* dst, const void* src, size_t len) {
+  memcpy(dst, EEPROM.cells + (intptr_t)src, len);
+}
+
+int eeprom_is_ready() {
+  return 1;
+}
+
+#include "../../Main/Incuvers_Incubator/Definitions.h"
+#pragma pack(push, 1)               // avr-gcc doesn't pad, keep the slot layout identical
+#include "../../Main/Incuvers_Incubator/Incuvers_EEPROMLayout.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_SettingsStore.h"
+#pragma pack(pop)
+
+typedef SettingsStruct SimSettings;
+
+int16_t ToFixed(float value) {
+  return (int16_t)(value * SETTINGS_FIXED_SCALE + (value < 0 ? -0.5 : 0.5));
+}
+
+void SetDefaults(SimSettings* s) {
+  s->ident = SETTINGS_IDENT_CURR;
+  s->fanMode = 4;
+  s->heatMode = 1;
+  s->heatSetPoint = ToFixed(TEMPERATURE_DEF);
+  s->CO2Mode = 2;
+  s->CO2SetPoint = ToFixed(CO2_DEF);
+  s->O2Mode = 2;
+  s->O2SetPoint = ToFixed(OO_DEF);
+  s->lightMode = 0;
+  s->millisOn = 60000;
+  s->millisOff = 30000;
+  s->alarmMode = 2;
+}
+
+void ApplyUserChange(SimSettings* s) {
+  // What a visit to the setup menu typically does: nudge a set point, now and then flip a mode, sometimes nothing.
+  int r = rand() % 10;
+  if (r < 5) {
+    s->heatSetPoint += ToFixed((rand() % 2) ? TEMPERATURE_DLT : -TEMPERATURE_DLT);
+  } else if (r < 7) {
+    s->CO2SetPoint += ToFixed((rand() % 2) ? CO2_DLT : -CO2_DLT);
+  } else if (r < 8) {
+    s->O2SetPoint += ToFixed((rand() % 2) ? OO_DLT : -OO_DLT);
+  } else if (r < 9) {
+    s->lightMode = (s->lightMode + 1) % 3;
+  }
+}
+
+unsigned long MaxWrites() {
+  unsigned long m = 0;
+  for (int i = 0; i < EEPROM_SIZE; i++) {
+    if (EEPROM.writes[i] > m) {
+      m = EEPROM.writes[i];
+    }
+  }
+  return m;
+}
+
+double ProjectYears(unsigned long maxWrites, long saves, double savesPerDay, double endurance) {
+  if (maxWrites == 0) {
+    return -1;
+  }
+  return endurance / ((double)maxWrites / saves) / savesPerDay / 365.0;
+}
+
+int main(int argc, char** argv) {
+  double savesPerDay = argc > 1 ? atof(argv[1]) : 10;
+  long saves = argc > 2 ? atol(argv[2]) : 100000;
+  double endurance = argc > 3 ? atof(argv[3]) : 100000;
+  SimSettings settings;
+  unsigned long totalWritten;
+
+  printf("Settings record: %d bytes, %d saves at %.1f saves/day, %.0f cycle endurance\n", (int)sizeof(settings), (int)saves, savesPerDay, endurance);
+
+  // The old save: every byte rewritten in place with EEPROM.write.
+  EEPROM.Reset();
+  srand(1);
+  SetDefaults(&settings);
+  for (long i = 0; i < saves; i++) {
+    ApplyUserChange(&settings);
+    for (unsigned int j = 0; j < sizeof(settings); j++) {
+      EEPROM.write(SETTINGS_ADDRS + j, *((byte*)&settings + j));
+    }
+  }
+  printf("In place:   worst cell %lu writes, %.2f writes/save, projected life %.1f years\n", MaxWrites(), (double)sizeof(settings), ProjectYears(MaxWrites(), saves, savesPerDay, endurance));
+
+  // The settings store.
+  EEPROM.Reset();
+  srand(1);
+  SetDefaults(&settings);
+  IncuversSettingsStore store;
+  store.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
+  totalWritten = 0;
+  for (long i = 0; i < saves; i++) {
+    ApplyUserChange(&settings);
+    store.Save(&settings, sizeof(settings), SETTINGS_VERSION_CURR);
+    totalWritten += store.getLastWriteCount();
+  }
+  printf("Store:      worst cell %lu writes, %.2f writes/save, projected life %.1f years\n", MaxWrites(), (double)totalWritten / saves, ProjectYears(MaxWrites(), saves, savesPerDay, endurance));
+  printf("            ring of %d slots x %d bytes = %d bytes of EEPROM\n", SETTINGSSTORE_SLOTS, store.getSlotSize(), SETTINGSSTORE_SLOTS * store.getSlotSize());
+
+  // Power loss: cut saves short at random points and check that what we load is either the old or the new record.
+  int failures = 0;
+  int trials = 10000;
+  EEPROM.Reset();
+  srand(2);
+  SetDefaults(&settings);
+  store.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
+  store.Save(&settings, sizeof(settings), SETTINGS_VERSION_CURR);
+  for (int i = 0; i < trials; i++) {
+    SimSettings before = settings;
+    byte record[SETTINGSSTORE_PAYLOAD_SIZE];
+    SimSettings loaded;
+    ApplyUserChange(&settings);
+    ApplyUserChange(&settings);
+    EEPROM.writeBudget = rand() % (store.getSlotSize() + 1);
+    store.Save(&settings, sizeof(settings), SETTINGS_VERSION_CURR);
+    EEPROM.writeBudget = -1;
+
+    IncuversSettingsStore reboot;
+    reboot.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
+    if (!reboot.Load(record) || reboot.getVersion() != SETTINGS_VERSION_CURR || reboot.getSize() != sizeof(loaded)) {
+      failures++;
+      continue;
+    }
+    memcpy(&loaded, record, sizeof(loaded));
+    if (memcmp(&loaded, &before, sizeof(loaded)) != 0 && memcmp(&loaded, &settings, sizeof(loaded)) != 0) {
+      failures++;
+    }
+    // Carry on from whatever survived, as the firmware would.
+    settings = loaded;
+    store = reboot;
+  }
+  printf("Power loss: %d of %d interrupted saves lost the record\n", failures, trials);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,483 @@
+/*
+ * Incuvers PiLink benchmark.
+ *
+ * Compares the binary status frames with the text line the PiLink used to send, on the same simulated status: the
+ * bytes per update, how long each takes on the wire at the old 9600 8E2 and at the agreed rate, and the host's time to
+ * decode a frame (IncuversPiLinkDecoder.h) against parsing the text.  It also checks that every frame decodes back to
+ * what was sent, and that a stream with bytes corrupted in it never yields a wrong reading.
+ *
+ * Then it runs the firmware's publishing rules over a simulated hour with a door opening in it, and shows what each
+ * publishing mode costs on the link against how far behind the Pi's view of the chamber gets.
+ *
+ * Build and run on the host:
+ *   g++ -O2 -o pilinkbench IncuversPiLinkBench.cpp
+ *   ./pilinkbench [updates] [agreed baud]
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "IncuversPiLinkDecoder.h"
+
+struct SimMeter {
+  unsigned long openSeconds;
+  unsigned long pulseCount;
+  float volume;
+  float rate;
+  long hoursToEmpty;
+};
+
+struct SimSnapshot {
+  // What Opt_PiLink takes from the firmware's StatusSnapshot
+  unsigned long uptime;
+  int serial;
+  byte fanMode, heatMode, CO2Mode, O2Mode, lightMode;
+  float heatSetPoint, CO2SetPoint, O2SetPoint;
+  float chamberTemp, doorTemp, otherTemp, CO2Level, O2Level;
+  unsigned int flags;
+  char lightIndicator;
+  float chamberDuty, CO2Duty;
+  long warmUpTime;
+  byte doorState;
+  unsigned long doorEvents;
+  long doorOpenTime, doorRecoveryTime;
+  int profileSegment;
+  unsigned int freeMemory;
+  SimMeter CO2Meter, NMeter;
+};
+
+float Noise(float range) {
+  return range * (rand() / (float)RAND_MAX - 0.5f);
+}
+
+void Simulate(SimSnapshot* s, unsigned long n, bool meters) {
+  s->uptime = 3600000UL + n * 1000;
+  s->serial = 666;
+  s->fanMode = 1;
+  s->heatMode = 1;
+  s->CO2Mode = 1;
+  s->O2Mode = 1;
+  s->lightMode = 0;
+  s->heatSetPoint = 37.0f;
+  s->CO2SetPoint = 5.0f;
+  s->O2SetPoint = 5.0f;
+  s->chamberTemp = 37.0f + Noise(0.2f);
+  s->doorTemp = 37.5f + Noise(0.4f);
+  s->otherTemp = 24.0f + Noise(1.0f);
+  s->CO2Level = 5.0f + Noise(0.3f);
+  s->O2Level = 5.0f + Noise(0.3f);
+  s->flags = rand() & (PILINK_FLAG_CO2_METER - 1);
+  if (meters) {
+    s->flags |= PILINK_FLAG_CO2_METER | PILINK_FLAG_N_METER;
+  }
+  s->lightIndicator = 'x';
+  s->chamberDuty = 0.3f + Noise(0.05f);
+  s->CO2Duty = 0.02f + Noise(0.01f);
+  s->warmUpTime = 1834;
+  s->doorState = rand() % 3;
+  s->doorEvents = 12 + n / 600;
+  s->doorOpenTime = 25;
+  s->doorRecoveryTime = 412;
+  s->profileSegment = -1;
+  s->freeMemory = 2900 + rand() % 200;
+  s->CO2Meter.openSeconds = 81234 + n / 20;
+  s->CO2Meter.pulseCount = 40311 + n / 10;
+  s->CO2Meter.volume = 1218.37f + n * 0.001f;
+  s->CO2Meter.rate = 1521.4f + Noise(50.0f);
+  s->CO2Meter.hoursToEmpty = 33;
+  s->NMeter = s->CO2Meter;
+  s->NMeter.volume = 4012.5f + n * 0.004f;
+  s->NMeter.hoursToEmpty = 496;
+}
+
+char Indicator(const SimSnapshot* s, unsigned int on, unsigned int stepping) {
+  return !(s->flags & on) ? '-' : ((s->flags & stepping) ? '+' : '*');
+}
+
+int FormatText(char* out, size_t size, const SimSnapshot* s) {
+  // The line Opt_PiLink used to print, field for field.
+  int n = snprintf(out, size,
+    "%lu ID %d FM %d TM %d TP %.2f TC %.2f TD %.2f TO %.2f TS %c%c TA %c TG %c TU %.3f TW %c WT %ld"
+    " CM %d CP %.2f CC %.2f CS %c CA %c CG %c CU %.4f OM %d OP %.2f OC %.2f OS %c OA %c",
+    s->uptime, s->serial, s->fanMode, s->heatMode, s->heatSetPoint, s->chamberTemp, s->doorTemp, s->otherTemp,
+    Indicator(s, PILINK_FLAG_DOOR_ON, PILINK_FLAG_DOOR_STEPPING), Indicator(s, PILINK_FLAG_CHAMBER_ON, PILINK_FLAG_CHAMBER_STEPPING),
+    Indicator(s, PILINK_FLAG_HEAT_ALARMED, 0), Indicator(s, PILINK_FLAG_CHAMBER_DEGRADED, 0), s->chamberDuty,
+    Indicator(s, PILINK_FLAG_CHAMBER_WARMING_UP, 0), s->warmUpTime,
+    s->CO2Mode, s->CO2SetPoint, s->CO2Level, Indicator(s, PILINK_FLAG_CO2_OPEN, PILINK_FLAG_CO2_STEPPING),
+    Indicator(s, PILINK_FLAG_CO2_ALARMED, 0), Indicator(s, PILINK_FLAG_CO2_DEGRADED, 0), s->CO2Duty,
+    s->O2Mode, s->O2SetPoint, s->O2Level, Indicator(s, PILINK_FLAG_O2_OPEN, PILINK_FLAG_O2_STEPPING),
+    Indicator(s, PILINK_FLAG_O2_ALARMED, 0));
+  const SimMeter* meters[2] = { &s->CO2Meter, &s->NMeter };
+  const char idents[2] = { 'C', 'N' };
+  for (int i = 0; i < 2; i++) {
+    if (s->flags & (i == 0 ? PILINK_FLAG_CO2_METER : PILINK_FLAG_N_METER)) {
+      char c = idents[i];
+      n += snprintf(out + n, size - n, " %cT %lu %cK %lu %cV %.2f %cR %.1f %cE %ld", c, meters[i]->openSeconds, c,
+        meters[i]->pulseCount, c, meters[i]->volume, c, meters[i]->rate, c, meters[i]->hoursToEmpty);
+    }
+  }
+  n += snprintf(out + n, size - n, " DS %d DN %lu DT %ld DR %ld PS %d LM %d LS %c FM %u\r\n", s->doorState,
+    s->doorEvents, s->doorOpenTime, s->doorRecoveryTime, s->profileSegment, s->lightMode, s->lightIndicator,
+    s->freeMemory);
+  return n;
+}
+
+void FillMeter(PiLinkGasMeter* out, const SimMeter* meter) {
+  // As Opt_PiLink does
+  out->openSeconds = meter->openSeconds;
+  out->pulseCount = meter->pulseCount;
+  out->volume = meter->volume * 1000 + 0.5;
+  out->rate = PiLinkClampUnsigned(meter->rate + 0.5);
+  out->hoursToEmpty = PiLinkClamp(meter->hoursToEmpty);
+}
+
+void FillStatus(PiLinkStatus* out, const SimSnapshot* s) {
+  // As Opt_PiLink does
+  out->uptime = s->uptime;
+  out->serial = s->serial;
+  out->fanMode = s->fanMode;
+  out->heatMode = s->heatMode;
+  out->CO2Mode = s->CO2Mode;
+  out->O2Mode = s->O2Mode;
+  out->lightMode = s->lightMode;
+  out->heatSetPoint = PiLinkFixed(s->heatSetPoint, PILINK_SCALE_LEVEL);
+  out->CO2SetPoint = PiLinkFixed(s->CO2SetPoint, PILINK_SCALE_LEVEL);
+  out->O2SetPoint = PiLinkFixed(s->O2SetPoint, PILINK_SCALE_LEVEL);
+  out->chamberTemp = PiLinkFixed(s->chamberTemp, PILINK_SCALE_LEVEL);
+  out->doorTemp = PiLinkFixed(s->doorTemp, PILINK_SCALE_LEVEL);
+  out->otherTemp = PiLinkFixed(s->otherTemp, PILINK_SCALE_LEVEL);
+  out->CO2Level = PiLinkFixed(s->CO2Level, PILINK_SCALE_LEVEL);
+  out->O2Level = PiLinkFixed(s->O2Level, PILINK_SCALE_LEVEL);
+  out->flags = s->flags;
+  out->lightIndicator = s->lightIndicator;
+  out->chamberDuty = PiLinkFixed(s->chamberDuty, PILINK_SCALE_DUTY);
+  out->CO2Duty = PiLinkFixed(s->CO2Duty, PILINK_SCALE_DUTY);
+  out->warmUpTime = PiLinkClamp(s->warmUpTime);
+  out->doorState = s->doorState;
+  out->doorEvents = PiLinkClampUnsigned(s->doorEvents);
+  out->doorOpenTime = PiLinkClamp(s->doorOpenTime);
+  out->doorRecoveryTime = PiLinkClamp(s->doorRecoveryTime);
+  out->profileSegment = s->profileSegment;
+  out->freeMemory = s->freeMemory;
+}
+
+int EncodeFrame(byte* out, const SimSnapshot* s) {
+  PiLinkStatus status;
+  PiLinkGasMeter meter;
+  PiLinkFrameWriter frame;
+
+  FillStatus(&status, s);
+  frame.Start(out, PILINK_FRAME_STATUS);
+  frame.Put(&status, sizeof(status));
+  if (s->flags & PILINK_FLAG_CO2_METER) {
+    FillMeter(&meter, &s->CO2Meter);
+    frame.Put(&meter, sizeof(meter));
+  }
+  if (s->flags & PILINK_FLAG_N_METER) {
+    FillMeter(&meter, &s->NMeter);
+    frame.Put(&meter, sizeof(meter));
+  }
+  return frame.Finish();
+}
+
+bool Matches(const PiLinkReading* r, const SimSnapshot* s) {
+  // Within the fixed point resolution
+  bool ok = r->uptime == s->uptime && r->serial == s->serial && r->flags == s->flags && r->doorState == s->doorState
+    && r->doorEvents == s->doorEvents && r->freeMemory == s->freeMemory && r->profileSegment == s->profileSegment
+    && r->lightIndicator == s->lightIndicator && r->warmUpTime == s->warmUpTime;
+  ok = ok && fabs(r->chamberTemp - s->chamberTemp) <= 0.0051 && fabs(r->doorTemp - s->doorTemp) <= 0.0051
+    && fabs(r->CO2Level - s->CO2Level) <= 0.0051 && fabs(r->O2Level - s->O2Level) <= 0.0051
+    && fabs(r->chamberDuty - s->chamberDuty) <= 0.00006 && fabs(r->CO2Duty - s->CO2Duty) <= 0.00006;
+  if (s->flags & PILINK_FLAG_CO2_METER) {
+    ok = ok && r->CO2Meter.present && r->CO2Meter.pulseCount == s->CO2Meter.pulseCount
+      && fabs(r->CO2Meter.volume - s->CO2Meter.volume) <= 0.0011;
+  }
+  if (s->flags & PILINK_FLAG_N_METER) {
+    ok = ok && r->NMeter.present && fabs(r->NMeter.volume - s->NMeter.volume) <= 0.0011;
+  }
+  return ok;
+}
+
+int ParseText(const char* line, PiLinkReading* r) {
+  // What the Pi had to do with each text line: split it into key and value pairs and convert the values.  Returns
+  // the number of fields.
+  const char* p = line;
+  char* end;
+  int fields = 0;
+
+  r->uptime = strtoul(p, &end, 10);
+  p = end;
+  while (*p == ' ') {
+    char key0 = p[1];
+    char key1 = p[2];
+    p += 4;
+    fields++;
+    if (!isdigit(p[0]) && !(p[0] == '-' && isdigit(p[1]))) {
+      // Indicators
+      while (*p != ' ' && *p != '\r') {
+        p++;
+      }
+      continue;
+    }
+    double value = strtod(p, &end);
+    p = end;
+    switch (key0 * 256 + key1) {
+      case 'T' * 256 + 'C': r->chamberTemp = value; break;
+      case 'T' * 256 + 'D': r->doorTemp = value; break;
+      case 'T' * 256 + 'O': r->otherTemp = value; break;
+      case 'C' * 256 + 'C': r->CO2Level = value; break;
+      case 'O' * 256 + 'C': r->O2Level = value; break;
+      case 'C' * 256 + 'V': r->CO2Meter.volume = value; break;
+      case 'N' * 256 + 'V': r->NMeter.volume = value; break;
+      default: r->freeMemory = value; break;
+    }
+  }
+  return fields;
+}
+
+double Seconds(clock_t from) {
+  return (double)(clock() - from) / CLOCKS_PER_SEC;
+}
+
+double LinkMillis(double bytes, int bitsPerByte, unsigned long baud) {
+  return bytes * bitsPerByte * 1000.0 / baud;
+}
+
+void SimulateHour(SimSnapshot* s, double t, unsigned long pass) {
+  // A settled chamber read by DS18B20s (sixteenths of a degree) with sensor noise, and a door opening half way
+  // through: open for 30 s, then recovering.
+  Simulate(s, pass, false);
+  s->uptime = 3600000UL + (unsigned long)(t * 1000);
+  double dip = 0;
+  if (t >= 1800) {
+    dip = t < 1830 ? (t - 1800) / 30 : exp(-(t - 1830) / 300);
+  }
+  double temp = 37.0 + 0.04 * sin(t / 600) - 1.5 * dip + Noise(0.08f);
+  s->chamberTemp = floor(temp * 16 + 0.5) / 16;
+  s->doorTemp = floor((37.5 - dip + Noise(0.08f)) * 16 + 0.5) / 16;
+  s->otherTemp = floor((24.0 + 0.3 * sin(t / 1200)) * 16 + 0.5) / 16;
+  s->CO2Level = 5.0 - 2.0 * dip + Noise(0.06f);
+  s->O2Level = 5.0 + 3.0 * dip + Noise(0.06f);
+  s->chamberDuty = 0.30 + 0.2 * dip;
+  s->CO2Duty = 0.020 + 0.01 * dip;
+  s->flags = rand() & PILINK_FLAG_OUTPUTS;
+  s->doorState = t < 1800 ? 0 : (t < 1830 ? 1 : (dip > 0.02 ? 2 : 0));
+  s->doorEvents = t < 1800 ? 12 : 13;
+  s->doorOpenTime = t < 1830 ? 25 : 30;
+  s->doorRecoveryTime = t < 1830 || dip > 0.02 ? 412 : 1174;
+  s->freeMemory = 2900 + rand() % 200;
+}
+
+void SimulatePublishing(const char* name, byte mode, unsigned int interval, unsigned long baud) {
+  // One pass of loop() every 250 ms, with Opt_PiLink's choice of status or heartbeat.  The link is taken to be free
+  // at each pass, which at the agreed rate it is.
+  const double passTime = 0.25;
+  PiLinkPublish publish;
+  publish.mode = mode;
+  publish.interval = interval;
+  publish.levelDeadband = PILINK_DEADBAND_LEVEL;
+  publish.dutyDeadband = PILINK_DEADBAND_DUTY;
+
+  SimSnapshot s;
+  PiLinkStatus status;
+  PiLinkStatus lastStatus;
+  byte frame[PILINK_ENCODED_SIZE];
+  unsigned long lastStatusAt = 0;
+  unsigned long lastSentAt = 0;
+  unsigned long statuses = 0;
+  unsigned long heartbeats = 0;
+  unsigned long bytes = 0;
+  double worstTemp = 0;
+  double worstCO2 = 0;
+  unsigned long worstQuiet = 0;
+  bool first = true;
+
+  srand(2);
+  for (unsigned long pass = 0; pass * passTime < 3600; pass++) {
+    double t = pass * passTime;
+    unsigned long nowTime = (unsigned long)(t * 1000);
+    SimulateHour(&s, t, pass);
+
+    unsigned long sinceLast = nowTime - lastStatusAt;
+    bool due = first;
+    if (!due && mode != PILINK_PUBLISH_REQUEST && sinceLast >= interval) {
+      FillStatus(&status, &s);
+      due = mode == PILINK_PUBLISH_RATE || sinceLast >= PILINK_REFRESH_INTERVAL
+        || PiLinkStatusChanged(&lastStatus, &status, &publish);
+    }
+    if (due) {
+      FillStatus(&status, &s);
+      bytes += EncodeFrame(frame, &s);
+      lastStatus = status;
+      lastStatusAt = nowTime;
+      lastSentAt = nowTime;
+      statuses++;
+      first = false;
+    } else if (nowTime - lastSentAt >= PILINK_HEARTBEAT_INTERVAL) {
+      PiLinkHeartbeat heartbeat = { (uint32_t)nowTime, (uint16_t)statuses, 0 };
+      PiLinkFrameWriter writer;
+      writer.Start(frame, PILINK_FRAME_HEARTBEAT);
+      writer.Put(&heartbeat, sizeof(heartbeat));
+      bytes += writer.Finish();
+      lastSentAt = nowTime;
+      heartbeats++;
+    }
+
+    // What the Pi has against what the chamber is at
+    worstTemp = fmax(worstTemp, fabs(s.chamberTemp - (double)lastStatus.chamberTemp / PILINK_SCALE_LEVEL));
+    worstCO2 = fmax(worstCO2, fabs(s.CO2Level - (double)lastStatus.CO2Level / PILINK_SCALE_LEVEL));
+    if (nowTime - lastSentAt > worstQuiet) {
+      worstQuiet = nowTime - lastSentAt;
+    }
+  }
+  printf("  %-22s %6lu %6lu  %7.1f  %5.2f%%  %6.2f  %6.2f  %5.1f\n", name, statuses, heartbeats, bytes / 3600.0,
+    bytes * 10.0 * 100 / (3600.0 * baud), worstTemp, worstCO2, worstQuiet / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  long updates = argc > 1 ? atol(argv[1]) : 200000;
+  unsigned long fastBaud = argc > 2 ? strtoul(argv[2], NULL, 10) : PILINK_BAUD_MAX;
+  if (updates <= 0 || fastBaud < PILINK_BAUD_DEFAULT || fastBaud > PILINK_BAUD_MAX) {
+    fprintf(stderr, "usage: %s [updates] [agreed baud, %d to %d]\n", argv[0], PILINK_BAUD_DEFAULT, PILINK_BAUD_MAX);
+    return 1;
+  }
+
+  // A stream of each, half of the updates with both gas meters fitted
+  SimSnapshot* snapshots = (SimSnapshot*)malloc(updates * sizeof(SimSnapshot));
+  char* text = (char*)malloc(updates * 512);
+  byte* frames = (byte*)malloc(updates * PILINK_ENCODED_SIZE);
+  size_t textBytes = 0;
+  size_t frameBytes = 0;
+  size_t textBytesMeters = 0;
+  size_t frameBytesMeters = 0;
+  int failures = 0;
+
+  srand(1);
+  for (long n = 0; n < updates; n++) {
+    bool meters = (n & 1) != 0;
+    Simulate(&snapshots[n], n, meters);
+    int t = FormatText(text + textBytes, 512, &snapshots[n]);
+    int f = EncodeFrame(frames + frameBytes, &snapshots[n]);
+    textBytes += t;
+    frameBytes += f;
+    if (meters) {
+      textBytesMeters += t;
+      frameBytesMeters += f;
+    }
+  }
+  long withMeters = updates / 2;
+  long without = updates - withMeters;
+  double textAvg = (double)textBytes / updates;
+  double frameAvg = (double)frameBytes / updates;
+
+  printf("Bytes per update          text  binary  ratio\n");
+  printf("  without gas meters    %6.1f  %6.1f  %5.2fx\n", (double)(textBytes - textBytesMeters) / without,
+    (double)(frameBytes - frameBytesMeters) / without, (double)(textBytes - textBytesMeters) / (frameBytes - frameBytesMeters));
+  if (withMeters > 0) {
+    printf("  with both gas meters  %6.1f  %6.1f  %5.2fx\n", (double)textBytesMeters / withMeters,
+      (double)frameBytesMeters / withMeters, (double)textBytesMeters / frameBytesMeters);
+  }
+  printf("  overall               %6.1f  %6.1f  %5.2fx\n\n", textAvg, frameAvg, textAvg / frameAvg);
+
+  double textLink = LinkMillis(textAvg, 12, PILINK_BAUD_DEFAULT);
+  double frameLinkSlow = LinkMillis(frameAvg, 12, PILINK_BAUD_DEFAULT);
+  double frameLinkFast = LinkMillis(frameAvg, 10, fastBaud);
+  printf("Link time per update                 ms   updates/s  vs text\n");
+  printf("  text,   %6d 8E2            %7.2f  %9.1f\n", PILINK_BAUD_DEFAULT, textLink, 1000.0 / textLink);
+  printf("  binary, %6d 8E2            %7.2f  %9.1f  %6.2fx\n", PILINK_BAUD_DEFAULT, frameLinkSlow, 1000.0 / frameLinkSlow,
+    textLink / frameLinkSlow);
+  printf("  binary, %6lu 8N1 (agreed)   %7.2f  %9.1f  %6.2fx\n\n", fastBaud, frameLinkFast, 1000.0 / frameLinkFast,
+    textLink / frameLinkFast);
+
+  // Host decode time: the whole stream through the decoder, and every text line through the parser.
+  IncuversPiLinkDecoder decoder;
+  decoder.SetupDecoder();
+  long decoded = 0;
+  clock_t started = clock();
+  for (size_t i = 0; i < frameBytes; i++) {
+    if (decoder.Add(frames[i]) == PILINK_FRAME_STATUS) {
+      if (!Matches(decoder.getReading(), &snapshots[decoded])) {
+        failures++;
+      }
+      decoded++;
+    }
+  }
+  double frameCpu = Seconds(started);
+  if (decoded != updates || decoder.getBadFrames() != 0) {
+    printf("FAIL: %ld of %ld frames decoded, %lu bad\n", decoded, updates, decoder.getBadFrames());
+    failures++;
+  }
+
+  PiLinkReading parsed;
+  long fields = 0;
+  started = clock();
+  for (char* line = text; line < text + textBytes; ) {
+    fields += ParseText(line, &parsed);
+    line = strchr(line, '\n') + 1;
+  }
+  double textCpu = Seconds(started);
+
+  double frameMicros = frameCpu * 1e6 / updates;
+  double textMicros = textCpu * 1e6 / updates;
+  printf("Host time per update                 us\n");
+  printf("  parse text (%4.1f fields)       %7.3f\n", (double)fields / updates, textMicros);
+  printf("  decode frame, checks included   %7.3f  %6.2fx\n\n", frameMicros, textMicros / frameMicros);
+  printf("Latency, first byte sent to reading   ms\n");
+  printf("  text,   %6d                 %7.2f\n", PILINK_BAUD_DEFAULT, textLink + textMicros / 1000);
+  printf("  binary, %6lu                 %7.2f  %6.2fx\n\n", fastBaud, frameLinkFast + frameMicros / 1000,
+    (textLink + textMicros / 1000) / (frameLinkFast + frameMicros / 1000));
+
+  // Noise on the line: flip a bit in about one frame in ten.  The decoder has to drop the hit frames and come back on
+  // the next, and must never hand over a reading that differs from what was sent.
+  decoder.SetupDecoder();
+  long hit = 0;
+  long wrong = 0;
+  long frameIndex = 0;
+  bool frameHit = false;
+  decoded = 0;
+  for (size_t i = 0; i < frameBytes; i++) {
+    byte c = frames[i];
+    if (rand() % (10 * (int)frameAvg) == 0) {
+      c ^= 1 << (rand() % 8);
+      frameHit = true;
+    }
+    if (decoder.Add(c) == PILINK_FRAME_STATUS) {
+      const PiLinkReading* r = decoder.getReading();
+      long sent = (r->uptime - snapshots[0].uptime) / 1000;
+      if (sent < 0 || sent >= updates || !Matches(r, &snapshots[sent])) {
+        wrong++;
+      }
+      decoded++;
+    }
+    if (frames[i] == 0) {
+      hit += frameHit ? 1 : 0;
+      frameHit = false;
+      frameIndex++;
+    }
+  }
+  printf("Corrupted stream: %ld of %ld frames hit, %ld readings decoded, %ld wrong\n", hit, frameIndex, decoded, wrong);
+  if (wrong > 0 || decoded < updates - 2 * hit) {
+    failures++;
+  }
+
+  printf("\nPublishing over an hour with a door opening, %lu 8N1, a loop pass every 250 ms\n", fastBaud);
+  printf("  mode                 statuses  beats  bytes/s   link   worst C  worst %%  quiet s\n");
+  SimulatePublishing("every pass (before)", PILINK_PUBLISH_RATE, 0, fastBaud);
+  SimulatePublishing("fixed rate, 1 s", PILINK_PUBLISH_RATE, 1000, fastBaud);
+  SimulatePublishing("fixed rate, 10 s", PILINK_PUBLISH_RATE, 10000, fastBaud);
+  SimulatePublishing("on change (defaults)", PILINK_PUBLISH_CHANGE, PILINK_STATUS_INTERVAL, fastBaud);
+  SimulatePublishing("on request only", PILINK_PUBLISH_REQUEST, PILINK_STATUS_INTERVAL, fastBaud);
+  printf("  (worst C and %% are how far the Pi's last status was from the chamber's temperature and CO2)\n\n");
+
+  free(snapshots);
+  free(text);
+  free(frames);
+  if (failures > 0) {
+    printf("FAIL: %d checks failed\n", failures);
+    return 1;
+  }
+  printf("All frames decoded to what was sent.\n");
+  return 0;
+}
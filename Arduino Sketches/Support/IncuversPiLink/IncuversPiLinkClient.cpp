@@ -0,0 +1,129 @@
+/*
+ * Incuvers PiLink client.
+ *
+ * Drives a unit over its PiLink port from a Linux host (the Pi, or a PC on a USB serial adapter wired to Serial1).  It
+ * waits for the unit's hello at 9600 8E2, agrees the fastest rate both ends have, then sends one command and waits for
+ * its ack, sending it again (same sequence number, so it's never carried out twice) when none comes.  A unit still at a
+ * rate agreed with an earlier client goes back to 9600 once it has heard nothing for PILINK_LINK_TIMEOUT, so the first
+ * hello can take that long.
+ *
+ * IncuversPiLinkLoopback.cpp checks the client against the firmware.
+ *
+ * Build and run on the host:
+ *   g++ -O2 -o pilink IncuversPiLinkClient.cpp
+ *   ./pilink <port> monitor
+ *   ./pilink <port> set temp|co2|o2 <value>
+ *   ./pilink <port> mode heat|fan|co2|o2|light <mode>
+ *   ./pilink <port> save|ack-alarm|stats
+ */
+#include <math.h>
+
+#include "IncuversPiLinkClient.h"
+
+static const char* ResultName(int result) {
+  switch (result) {
+    case PILINK_RESULT_OK: return "ok";
+    case PILINK_RESULT_LIMITED: return "limited";
+    case PILINK_RESULT_REFUSED: return "refused";
+    case PILINK_RESULT_BUSY: return "busy, someone is in the menu";
+    case PILINK_RESULT_UNKNOWN: return "unknown to this firmware";
+  }
+  return "?";
+}
+
+static void PrintStats(const PiLinkStats* stats) {
+  printf("Up %lu s, %u bytes free\n", (unsigned long)stats->uptime / 1000, stats->freeMemory);
+  printf("EEPROM bytes written %lu, outputs held back by the power budget %lu\n", (unsigned long)stats->eepromWrites,
+    (unsigned long)stats->powerDeferred);
+  printf("Status lines dropped %lu, alarm transitions %u\n", (unsigned long)stats->statusLinesDropped, stats->alarmTransitions);
+  printf("PiLink frames in %lu good, %lu bad; commands %u carried out, %u refused; statuses sent %u\n",
+    (unsigned long)stats->framesGood, (unsigned long)stats->framesBad, stats->commands, stats->commandsRefused,
+    stats->statusFrames);
+}
+
+static void PrintReading(const PiLinkReading* r) {
+  printf("%8.1f s  chamber %6.2f C (%.2f)  door %6.2f C  CO2 %5.2f %% (%.2f)  O2 %5.2f %% (%.2f)  flags %04X\n",
+    r->uptime / 1000.0, r->chamberTemp, r->heatSetPoint, r->doorTemp, r->CO2Level, r->CO2SetPoint, r->O2Level,
+    r->O2SetPoint, r->flags);
+}
+
+static int Monitor(PiLinkClient* client) {
+  IncuversPiLinkDecoder* decoder = client->getDecoder();
+  for (;;) {
+    int type = client->Next(1000);
+    if (type == PILINK_FRAME_STATUS) {
+      PrintReading(decoder->getReading());
+    } else if (type == PILINK_FRAME_HEARTBEAT) {
+      printf("%8.1f s  heartbeat\n", decoder->getHeartbeat()->uptime / 1000.0);
+    }
+    fflush(stdout);
+    client->KeepAlive();
+  }
+  return 0;
+}
+
+static int RunCommand(PiLinkClient* client, byte command, int value) {
+  PiLinkAck ack;
+  memset(&ack, 0, sizeof(ack));
+  if (!client->Command(command, value, &ack)) {
+    fprintf(stderr, "No answer from the unit\n");
+    return 1;
+  }
+  printf("%s", ResultName(ack.result));
+  if (command <= PILINK_COMMAND_SET_O2 && (ack.result == PILINK_RESULT_OK || ack.result == PILINK_RESULT_LIMITED)) {
+    printf(", set to %.2f", (double)ack.value / PILINK_SCALE_LEVEL);
+  } else if (command == PILINK_COMMAND_ACK_ALARM) {
+    printf(ack.value ? ", alarm silenced" : ", no alarm sounding");
+  }
+  printf("\n");
+  if (command == PILINK_COMMAND_STATS && ack.result == PILINK_RESULT_OK) {
+    PrintStats(client->getDecoder()->getStats());
+  }
+  return ack.result == PILINK_RESULT_OK || ack.result == PILINK_RESULT_LIMITED ? 0 : 1;
+}
+
+static int Usage(const char* name) {
+  fprintf(stderr, "usage: %s <port> monitor\n"
+    "       %s <port> set temp|co2|o2 <value>\n"
+    "       %s <port> mode heat|fan|co2|o2|light <mode>\n"
+    "       %s <port> save|ack-alarm|stats\n", name, name, name, name);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    return Usage(argv[0]);
+  }
+
+  byte command = 0;
+  int value = 0;
+  const char* what = argv[2];
+  const char* which = argc > 3 ? argv[3] : "";
+  if (strcmp(what, "set") == 0 && argc == 5) {
+    value = (int)lround(atof(argv[4]) * PILINK_SCALE_LEVEL);
+    command = strcmp(which, "temp") == 0 ? PILINK_COMMAND_SET_TEMPERATURE :
+      strcmp(which, "co2") == 0 ? PILINK_COMMAND_SET_CO2 :
+      strcmp(which, "o2") == 0 ? PILINK_COMMAND_SET_O2 : 0;
+  } else if (strcmp(what, "mode") == 0 && argc == 5) {
+    value = atoi(argv[4]);
+    command = strcmp(which, "heat") == 0 ? PILINK_COMMAND_HEAT_MODE :
+      strcmp(which, "fan") == 0 ? PILINK_COMMAND_FAN_MODE :
+      strcmp(which, "co2") == 0 ? PILINK_COMMAND_CO2_MODE :
+      strcmp(which, "o2") == 0 ? PILINK_COMMAND_O2_MODE :
+      strcmp(which, "light") == 0 ? PILINK_COMMAND_LIGHT_MODE : 0;
+  } else if (argc == 3) {
+    command = strcmp(what, "save") == 0 ? PILINK_COMMAND_SAVE :
+      strcmp(what, "ack-alarm") == 0 ? PILINK_COMMAND_ACK_ALARM :
+      strcmp(what, "stats") == 0 ? PILINK_COMMAND_STATS : 0;
+  }
+  bool monitor = argc == 3 && strcmp(what, "monitor") == 0;
+  if (command == 0 && !monitor) {
+    return Usage(argv[0]);
+  }
+
+  PiLinkClient client;
+  if (!client.Open(argv[1]) || !client.Connect(PILINK_BAUD_MAX)) {
+    return 1;
+  }
+  return monitor ? Monitor(&client) : RunCommand(&client, command, value);
+}
@@ -0,0 +1,191 @@
+/*
+ * Incuvers PiLink client.
+ *
+ * The Pi's end of the link on a serial port, used by IncuversPiLinkClient.cpp and IncuversPiLinkLoopback.cpp.  Open()
+ * the port, Connect() waits for the unit's hello at 9600 8E2 and agrees the fastest rate both ends have, then
+ * Command() sends one command and waits for its ack, sending it again (same sequence number, so it's never carried out
+ * twice) when none comes.  Call KeepAlive() while waiting on anything else, or the unit goes back to 9600 once it has
+ * heard nothing for PILINK_LINK_TIMEOUT.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "IncuversPiLinkDecoder.h"
+
+#define COMMAND_TIMEOUT 2000        // ms for an ack before the command is sent again, the unit reads once a loop
+#define COMMAND_TRIES 3
+
+static unsigned long Millis() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000UL + now.tv_usec / 1000;
+}
+
+static speed_t BaudSpeed(unsigned long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+  }
+  return B0;
+}
+
+class PiLinkClient {
+  private:
+    int fd;
+    IncuversPiLinkDecoder decoder;
+    byte sequence;
+    unsigned long lastSent;
+
+  public:
+    bool Open(const char* path) {
+      this->decoder.SetupDecoder();
+      this->sequence = (byte)(getpid() ^ Millis());    // Not the last client's, or its last command looks like a resend
+      this->lastSent = Millis();
+      this->fd = open(path, O_RDWR | O_NOCTTY);
+      if (this->fd < 0) {
+        perror(path);
+        return false;
+      }
+      struct termios tio;
+      if (tcgetattr(this->fd, &tio) != 0) {
+        perror(path);
+        return false;
+      }
+      cfmakeraw(&tio);
+      tio.c_cflag |= CLOCAL | CREAD;
+      tio.c_cc[VMIN] = 0;
+      tio.c_cc[VTIME] = 0;
+      tcsetattr(this->fd, TCSANOW, &tio);
+      return this->SetBaud(PILINK_BAUD_DEFAULT);
+    }
+
+    bool SetBaud(unsigned long baud) {
+      // 8E2 at the default rate, 8N1 above it, as the unit.
+      struct termios tio;
+      tcgetattr(this->fd, &tio);
+      tio.c_cflag &= ~(PARENB | PARODD | CSTOPB | CSIZE);
+      tio.c_cflag |= CS8;
+      if (baud == PILINK_BAUD_DEFAULT) {
+        tio.c_cflag |= PARENB | CSTOPB;
+      }
+      cfsetispeed(&tio, BaudSpeed(baud));
+      cfsetospeed(&tio, BaudSpeed(baud));
+      return tcsetattr(this->fd, TCSADRAIN, &tio) == 0;
+    }
+
+    void Send(const byte* frame, size_t length) {
+      while (length > 0) {
+        ssize_t n = write(this->fd, frame, length);
+        if (n <= 0) {
+          perror("write");
+          return;
+        }
+        frame += n;
+        length -= n;
+      }
+      this->lastSent = Millis();
+    }
+
+    int Next(unsigned long timeout) {
+      // The type of the next good frame, 0 if none came within timeout ms.
+      unsigned long started = Millis();
+      while (Millis() - started < timeout) {
+        unsigned long left = timeout - (Millis() - started);
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(this->fd, &readable);
+        struct timeval wait = { (time_t)(left / 1000), (suseconds_t)(left % 1000 * 1000) };
+        if (select(this->fd + 1, &readable, NULL, NULL, &wait) <= 0) {
+          continue;
+        }
+        byte c;
+        if (read(this->fd, &c, 1) == 1) {
+          int type = this->decoder.Add(c);
+          if (type != 0) {
+            return type;
+          }
+        }
+      }
+      return 0;
+    }
+
+    bool Connect(unsigned long baud) {
+      // Waits for a hello, then asks for baud (held to what the unit takes).
+      unsigned long started = Millis();
+      while (Millis() - started < PILINK_LINK_TIMEOUT + 2 * PILINK_HELLO_INTERVAL) {
+        if (this->Next(PILINK_HELLO_INTERVAL) == PILINK_FRAME_HELLO) {
+          break;
+        }
+      }
+      if (this->decoder.getUnitSerial() < 0) {
+        fprintf(stderr, "No hello from the unit\n");
+        return false;
+      }
+      baud = baud < this->decoder.getUnitMaxBaud() ? baud : this->decoder.getUnitMaxBaud();
+      if (baud == PILINK_BAUD_DEFAULT) {
+        return true;
+      }
+      byte frame[PILINK_ENCODED_SIZE];
+      this->Send(frame, this->decoder.EncodeBaudRequest(baud, frame));
+      started = Millis();
+      while (Millis() - started < COMMAND_TIMEOUT) {
+        if (this->Next(COMMAND_TIMEOUT) == PILINK_FRAME_BAUD) {
+          return this->SetBaud(this->decoder.getAgreedBaud());
+        }
+      }
+      fprintf(stderr, "The unit didn't answer the rate request, staying at %d\n", PILINK_BAUD_DEFAULT);
+      return true;
+    }
+
+    void KeepAlive() {
+      // Anything keeps the agreed rate, asking for it again is harmless.
+      if (Millis() - this->lastSent >= PILINK_LINK_TIMEOUT / 3 && this->decoder.getAgreedBaud() > PILINK_BAUD_DEFAULT) {
+        byte frame[PILINK_ENCODED_SIZE];
+        this->Send(frame, this->decoder.EncodeBaudRequest(this->decoder.getAgreedBaud(), frame));
+      }
+    }
+
+    bool Command(byte command, int value, PiLinkAck* ack) {
+      // Sends command until its ack comes back, and for PILINK_COMMAND_STATS the stats after it.
+      byte frame[PILINK_ENCODED_SIZE];
+      size_t length = this->decoder.EncodeCommand(++this->sequence, command, value, frame);
+      for (int tries = 0; tries < COMMAND_TRIES; tries++) {
+        this->Send(frame, length);
+        unsigned long started = Millis();
+        unsigned long waited = 0;
+        bool acked = false;
+        while (waited < COMMAND_TIMEOUT) {
+          int type = this->Next(COMMAND_TIMEOUT - waited);
+          waited = Millis() - started;
+          if (type == PILINK_FRAME_ACK && this->decoder.getAck()->sequence == this->sequence) {
+            *ack = *this->decoder.getAck();
+            if (command != PILINK_COMMAND_STATS || ack->result != PILINK_RESULT_OK) {
+              return true;
+            }
+            acked = true;
+          } else if (type == PILINK_FRAME_STATS && acked && this->decoder.getStats()->sequence == this->sequence) {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    void Resend() {
+      // The last command again, as if its ack had been lost.
+      this->sequence--;
+    }
+
+    IncuversPiLinkDecoder* getDecoder() {
+      return &this->decoder;
+    }
+};
+
@@ -0,0 +1,330 @@
+/*
+ * Incuvers PiLink decoder.
+ *
+ * The host end of the PiLink (Opt_PiLink.h in the firmware), for the Pi or anything else on the other end of Serial1.
+ * Bytes from the port go into Add() one at a time, in whatever pieces they were read; frames are found and checked
+ * with the firmware's own reader (Incuvers_PiLinkFrame.h) and the status is turned back from fixed point into a
+ * PiLinkReading.  EncodeBaudRequest() builds the frame which asks the unit for a faster rate, and is also what to send
+ * every few seconds to keep the link at that rate.  EncodePublish() sets how the unit publishes its status and
+ * EncodeStatusRequest() asks for one.  The unit sends something at least every PILINK_HEARTBEAT_INTERVAL: a link
+ * which has been quiet for a few of those is dead.  EncodeCommand() builds a PILINK_COMMAND_; the unit answers each
+ * with a PILINK_FRAME_ACK carrying the same sequence number (getAck()), and PILINK_COMMAND_STATS with a
+ * PILINK_FRAME_STATS after it (getStats()).  Send the same command with the same sequence number again when no ack
+ * comes, it isn't carried out twice.
+ *
+ * Header only, include it and go:
+ *   IncuversPiLinkDecoder decoder;
+ *   decoder.SetupDecoder();
+ *   for (each byte c read from the port) {
+ *     if (decoder.Add(c) == PILINK_FRAME_STATUS) {
+ *       printf("%.2f\n", decoder.getReading()->chamberTemp);
+ *     }
+ *   }
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Just enough of the Arduino environment for the firmware headers.
+typedef uint8_t byte;
+typedef bool boolean;
+
+#include "../../Main/Incuvers_Incubator/Definitions.h"
+#pragma pack(push, 1)               // avr-gcc doesn't pad, keep the layout identical
+#include "../../Main/Incuvers_Incubator/Incuvers_PiLinkFrame.h"
+#pragma pack(pop)
+
+// What avr-gcc makes of the payloads.  If one of these fails the frames changed: update the decoder (and the numbers
+// here) to match, with a new PILINK_SCHEMA_VERSION.
+static_assert(PILINK_SCHEMA_VERSION == 1, "PiLink schema changed, check the decoder");
+static_assert(sizeof(PiLinkHello) == 6, "PiLinkHello layout changed");
+static_assert(sizeof(PiLinkBaud) == 4, "PiLinkBaud layout changed");
+static_assert(sizeof(PiLinkPublish) == 7, "PiLinkPublish layout changed");
+static_assert(sizeof(PiLinkHeartbeat) == 8, "PiLinkHeartbeat layout changed");
+static_assert(sizeof(PiLinkStatus) == 46, "PiLinkStatus layout changed");
+static_assert(offsetof(PiLinkStatus, flags) == 27 && offsetof(PiLinkStatus, freeMemory) == 44, "PiLinkStatus layout changed");
+static_assert(sizeof(PiLinkGasMeter) == 16, "PiLinkGasMeter layout changed");
+static_assert(sizeof(PiLinkCommand) == 4, "PiLinkCommand layout changed");
+static_assert(sizeof(PiLinkAck) == 5, "PiLinkAck layout changed");
+static_assert(sizeof(PiLinkStats) == 34, "PiLinkStats layout changed");
+static_assert(4 + sizeof(PiLinkStatus) + 2 * sizeof(PiLinkGasMeter) <= PILINK_FRAME_SIZE, "The status doesn't fit in a frame");
+
+struct PiLinkGasReading {
+  bool present;
+  unsigned long openSeconds;
+  unsigned long pulseCount;
+  double volume;                    // L
+  double rate;                      // mL/h
+  long hoursToEmpty;                // -1 = not known yet
+};
+
+struct PiLinkReading {
+  unsigned long uptime;             // ms
+  int serial;
+  int fanMode;
+  int heatMode;
+  int CO2Mode;
+  int O2Mode;
+  int lightMode;
+  double heatSetPoint;              // C
+  double CO2SetPoint;               // %
+  double O2SetPoint;
+  double chamberTemp;
+  double doorTemp;
+  double otherTemp;
+  double CO2Level;
+  double O2Level;
+  unsigned int flags;               // PILINK_FLAG_
+  char lightIndicator;
+  double chamberDuty;
+  double CO2Duty;
+  long warmUpTime;                  // s
+  int doorState;
+  unsigned long doorEvents;
+  long doorOpenTime;                // s
+  long doorRecoveryTime;            // s
+  int profileSegment;
+  unsigned int freeMemory;
+  PiLinkGasReading CO2Meter;
+  PiLinkGasReading NMeter;
+};
+
+class IncuversPiLinkDecoder {
+  private:
+    PiLinkFrameReader reader;
+    PiLinkReading reading;
+    unsigned long readings;
+    unsigned long malformed;        // Good CRC but not a payload we know
+    int unitSerial;                 // From the last hello, -1 = none yet
+    unsigned long unitMaxBaud;
+    unsigned long agreedBaud;       // From the last answer to a rate request, 0 = none yet
+    PiLinkPublish publish;          // From the last answer to a publish request, interval 0 = none yet
+    PiLinkHeartbeat heartbeat;      // The last one
+    PiLinkAck ack;                  // The last one
+    PiLinkStats stats;              // The last one
+
+    void DecodeGasMeter(PiLinkGasReading* out, const PiLinkGasMeter* meter) {
+      out->present = true;
+      out->openSeconds = meter->openSeconds;
+      out->pulseCount = meter->pulseCount;
+      out->volume = meter->volume / 1000.0;
+      out->rate = meter->rate;
+      out->hoursToEmpty = meter->hoursToEmpty;
+    }
+
+    bool DecodeStatus(const byte* payload, byte length) {
+      PiLinkStatus status;
+      PiLinkGasMeter meter;
+      PiLinkReading* r = &this->reading;
+
+      if (length < sizeof(status)) {
+        return false;
+      }
+      memcpy(&status, payload, sizeof(status));
+      size_t expected = sizeof(status);
+      expected += (status.flags & PILINK_FLAG_CO2_METER) ? sizeof(meter) : 0;
+      expected += (status.flags & PILINK_FLAG_N_METER) ? sizeof(meter) : 0;
+      if (length != expected) {
+        return false;
+      }
+
+      r->uptime = status.uptime;
+      r->serial = status.serial;
+      r->fanMode = status.fanMode;
+      r->heatMode = status.heatMode;
+      r->CO2Mode = status.CO2Mode;
+      r->O2Mode = status.O2Mode;
+      r->lightMode = status.lightMode;
+      r->heatSetPoint = (double)status.heatSetPoint / PILINK_SCALE_LEVEL;
+      r->CO2SetPoint = (double)status.CO2SetPoint / PILINK_SCALE_LEVEL;
+      r->O2SetPoint = (double)status.O2SetPoint / PILINK_SCALE_LEVEL;
+      r->chamberTemp = (double)status.chamberTemp / PILINK_SCALE_LEVEL;
+      r->doorTemp = (double)status.doorTemp / PILINK_SCALE_LEVEL;
+      r->otherTemp = (double)status.otherTemp / PILINK_SCALE_LEVEL;
+      r->CO2Level = (double)status.CO2Level / PILINK_SCALE_LEVEL;
+      r->O2Level = (double)status.O2Level / PILINK_SCALE_LEVEL;
+      r->flags = status.flags;
+      r->lightIndicator = status.lightIndicator;
+      r->chamberDuty = (double)status.chamberDuty / PILINK_SCALE_DUTY;
+      r->CO2Duty = (double)status.CO2Duty / PILINK_SCALE_DUTY;
+      r->warmUpTime = status.warmUpTime;
+      r->doorState = status.doorState;
+      r->doorEvents = status.doorEvents;
+      r->doorOpenTime = status.doorOpenTime;
+      r->doorRecoveryTime = status.doorRecoveryTime;
+      r->profileSegment = status.profileSegment;
+      r->freeMemory = status.freeMemory;
+
+      const byte* next = payload + sizeof(status);
+      r->CO2Meter.present = false;
+      r->NMeter.present = false;
+      if (status.flags & PILINK_FLAG_CO2_METER) {
+        memcpy(&meter, next, sizeof(meter));
+        this->DecodeGasMeter(&r->CO2Meter, &meter);
+        next += sizeof(meter);
+      }
+      if (status.flags & PILINK_FLAG_N_METER) {
+        memcpy(&meter, next, sizeof(meter));
+        this->DecodeGasMeter(&r->NMeter, &meter);
+      }
+      return true;
+    }
+
+  public:
+    void SetupDecoder() {
+      this->reader.Setup();
+      memset(&this->reading, 0, sizeof(this->reading));
+      this->readings = 0;
+      this->malformed = 0;
+      this->unitSerial = -1;
+      this->unitMaxBaud = 0;
+      this->agreedBaud = 0;
+      memset(&this->publish, 0, sizeof(this->publish));
+      memset(&this->heartbeat, 0, sizeof(this->heartbeat));
+      memset(&this->ack, 0, sizeof(this->ack));
+      memset(&this->stats, 0, sizeof(this->stats));
+    }
+
+    int Add(byte c) {
+      // The type of the frame c completed (PILINK_FRAME_), 0 when it didn't complete a good one.
+      if (!this->reader.Add(c)) {
+        return 0;
+      }
+      const byte* payload = this->reader.getPayload();
+      byte length = this->reader.getPayloadLength();
+      bool known = false;
+
+      switch (this->reader.getType()) {
+        case PILINK_FRAME_HELLO:
+          if (length == sizeof(PiLinkHello)) {
+            PiLinkHello hello;
+            memcpy(&hello, payload, sizeof(hello));
+            this->unitSerial = hello.serial;
+            this->unitMaxBaud = hello.maxBaud;
+            known = true;
+          }
+          break;
+        case PILINK_FRAME_STATUS:
+          known = this->DecodeStatus(payload, length);
+          if (known) {
+            this->readings++;
+          }
+          break;
+        case PILINK_FRAME_BAUD:
+          if (length == sizeof(PiLinkBaud)) {
+            PiLinkBaud answer;
+            memcpy(&answer, payload, sizeof(answer));
+            this->agreedBaud = answer.baud;
+            known = true;
+          }
+          break;
+        case PILINK_FRAME_PUBLISH:
+          if (length == sizeof(PiLinkPublish)) {
+            memcpy(&this->publish, payload, sizeof(this->publish));
+            known = true;
+          }
+          break;
+        case PILINK_FRAME_HEARTBEAT:
+          if (length == sizeof(PiLinkHeartbeat)) {
+            memcpy(&this->heartbeat, payload, sizeof(this->heartbeat));
+            known = true;
+          }
+          break;
+        case PILINK_FRAME_ACK:
+          if (length == sizeof(PiLinkAck)) {
+            memcpy(&this->ack, payload, sizeof(this->ack));
+            known = true;
+          }
+          break;
+        case PILINK_FRAME_STATS:
+          if (length == sizeof(PiLinkStats)) {
+            memcpy(&this->stats, payload, sizeof(this->stats));
+            known = true;
+          }
+          break;
+      }
+      if (!known) {
+        this->malformed++;
+        return 0;
+      }
+      return this->reader.getType();
+    }
+
+    size_t EncodeFrame(byte type, const void* payload, byte size, byte* out) {
+      // out has to hold PILINK_ENCODED_SIZE, the frame's length is returned.
+      PiLinkFrameWriter frame;
+      frame.Start(out, type);
+      frame.Put(payload, size);
+      return frame.Finish();
+    }
+
+    size_t EncodeBaudRequest(unsigned long baud, byte* out) {
+      PiLinkBaud request;
+      request.baud = baud;
+      return this->EncodeFrame(PILINK_FRAME_BAUD, &request, sizeof(request), out);
+    }
+
+    size_t EncodePublish(byte mode, unsigned int interval, double levelDeadband, double dutyDeadband, byte* out) {
+      // mode is PILINK_PUBLISH_, interval in ms, the deadbands in degrees or percent and in duty (0 to 1).
+      PiLinkPublish request;
+      request.mode = mode;
+      request.interval = interval;
+      request.levelDeadband = levelDeadband * PILINK_SCALE_LEVEL + 0.5;
+      request.dutyDeadband = dutyDeadband * PILINK_SCALE_DUTY + 0.5;
+      return this->EncodeFrame(PILINK_FRAME_PUBLISH, &request, sizeof(request), out);
+    }
+
+    size_t EncodeStatusRequest(byte* out) {
+      return this->EncodeFrame(PILINK_FRAME_REQUEST, NULL, 0, out);
+    }
+
+    size_t EncodeCommand(byte sequence, byte command, int value, byte* out) {
+      // value is fixed point for the set points (PILINK_SCALE_LEVEL), the mode for the modes and 0 otherwise.
+      PiLinkCommand request;
+      request.sequence = sequence;
+      request.command = command;
+      request.value = value;
+      return this->EncodeFrame(PILINK_FRAME_COMMAND, &request, sizeof(request), out);
+    }
+
+    const PiLinkReading* getReading() {
+      return &this->reading;
+    }
+
+    unsigned long getReadingCount() {
+      return this->readings;
+    }
+
+    unsigned long getBadFrames() {
+      // Failed their CRC, or were cut short, or weren't a payload we know.
+      return this->reader.getBadFrames() + this->malformed;
+    }
+
+    int getUnitSerial() {
+      return this->unitSerial;
+    }
+
+    unsigned long getUnitMaxBaud() {
+      return this->unitMaxBaud;
+    }
+
+    unsigned long getAgreedBaud() {
+      return this->agreedBaud;
+    }
+
+    const PiLinkPublish* getPublish() {
+      return &this->publish;
+    }
+
+    const PiLinkHeartbeat* getHeartbeat() {
+      return &this->heartbeat;
+    }
+
+    const PiLinkAck* getAck() {
+      return &this->ack;
+    }
+
+    const PiLinkStats* getStats() {
+      return &this->stats;
+    }
+};
@@ -0,0 +1,381 @@
+/*
+ * Incuvers PiLink loopback.
+ *
+ * Runs the client (IncuversPiLinkClient.h) against the firmware on a pseudo terminal: the unit is the firmware's own
+ * Opt_PiLink.h, settings handler, settings store and persistence, built for the host with IncuversPiLinkShim.h and run
+ * as the sketch's setup() and loop() do.  Only the modules behind the settings handler, the status sources and the UI
+ * are stand-ins, which remember what they were told.  Starting from the default settings, it checks the answer to each
+ * command and what the settings handler and the module behind it then hold: set, held to range, refused, busy while
+ * someone is in the menu, a resend not carried out again, a save which reads back from the EEPROM and corrupted frames
+ * ignored.  It exits non-zero if any check fails.
+ *
+ * Build and run on the host:
+ *   g++ -O2 -pthread -o pilinkloopback IncuversPiLinkLoopback.cpp
+ *   ./pilinkloopback
+ */
+#include <math.h>
+#include <mutex>
+#include <thread>
+
+#include "IncuversPiLinkClient.h"
+#include "IncuversPiLinkShim.h"
+
+// As in Incuvers_Incubator.ino
+#define INCLUDE_PILINK true
+#define PINASSIGN_ONEWIRE_BUS 4
+#define PINASSIGN_HEATDOOR 8
+#define PINASSIGN_HEATCHAMBER 9
+#define PINASSIGN_FAN 10
+
+#pragma pack(push, 1)
+#include "../../Main/Incuvers_Incubator/Incuvers_EEPROMLayout.h"
+#pragma pack(pop)
+#include "../../Main/Incuvers_Incubator/Incuvers_StatusLine.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_PowerArbiter.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_AlarmEngine.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_SettingsStore.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_Persistence.h"
+#include "../../Main/Incuvers_Incubator/Incuvers_GasMeter.h"
+
+class IncuversHeatingSystem {
+  public:
+    float setPoint;
+    int heatMode;
+    int fanMode;
+
+    void SetupHeating(int doorPin, int chamberPin, int busPin, byte* doorSensor, byte* chamberSensor, int heatMode,
+                      int fanPin, int fanMode, float setPoint, IncuversPowerArbiter* iPower, IncuversPersistence* iPersist) {
+      this->heatMode = heatMode;
+      this->fanMode = fanMode;
+      this->setPoint = setPoint;
+    }
+
+    void SetSetPoint(float setPoint) { this->setPoint = setPoint; }
+    void UpdateHeatMode(int mode) { this->heatMode = mode; }
+    void UpdateFanMode(int mode) { this->fanMode = mode; }
+    void ResumeState(int mode) { this->heatMode = mode; }
+    void MakeSafeState() {}
+    void SetRecoveryMode(boolean recovering) {}
+    void ResetAlarms() {}
+    float getChamberTemperature() { return 36.9; }
+    float getDoorTemperature() { return 37.2; }
+    float getOtherTemperature() { return 24.0; }
+    byte getZoneCount() { return 0; }
+    float getZoneTemperature(byte zone) { return 0; }
+    boolean isDoorOn() { return false; }
+    boolean isDoorStepping() { return false; }
+    boolean isChamberOn() { return true; }
+    boolean isChamberStepping() { return false; }
+    boolean isChamberDegraded() { return false; }
+    boolean isChamberWarmingUp() { return false; }
+    float getChamberDuty() { return 0.3; }
+    long getWarmUpTime() { return 1834; }
+    boolean isAlarmed() { return false; }
+};
+
+class IncuversLightingSystem {
+  public:
+    int mode;
+
+    void SetupLighting(int pin, int support, IncuversPowerArbiter* iPower) { this->mode = 0; }
+    void UpdateLightDeltas(long millisOn, long millisOff) {}
+    void UpdateMode(int mode) { this->mode = mode; }
+    void MakeSafeState() {}
+    char GetSerialAPIndicator() { return 'x'; }
+};
+
+class IncuversCO2System {
+  public:
+    float setPoint;
+    int mode;
+
+    void SetupCO2(int rxPin, int txPin, int relayPin, IncuversPowerArbiter* iPower) {}
+    void SetSetPoint(float setPoint) { this->setPoint = setPoint; }
+    void UpdateMode(int mode) { this->mode = mode; }
+    void MakeSafeState() {}
+    void SetRecoveryMode(boolean recovering) {}
+    void ResetAlarms() {}
+    IncuversGasMeter* getGasMeter() { return NULL; }
+    float getCO2Level() { return 5.1; }
+    boolean isCO2Open() { return false; }
+    boolean isCO2Stepping() { return false; }
+    boolean isDegraded() { return false; }
+    float getLearnedDuty() { return 0.02; }
+    boolean isAlarmed() { return false; }
+};
+
+class IncuversO2System {
+  public:
+    float setPoint;
+    int mode;
+
+    void SetupO2(int rxPin, int txPin, int relayPin, IncuversPowerArbiter* iPower) {}
+    void SetSetPoint(float setPoint) { this->setPoint = setPoint; }
+    void UpdateMode(int mode) { this->mode = mode; }
+    void MakeSafeState() {}
+    void SetRecoveryMode(boolean recovering) {}
+    void ResetAlarms() {}
+    IncuversGasMeter* getGasMeter() { return NULL; }
+    float getO2Level() { return 5.2; }
+    boolean isNOpen() { return false; }
+    boolean isNStepping() { return false; }
+    boolean isAlarmed() { return false; }
+};
+
+#include "../../Main/Incuvers_Incubator/Incuvers_Settings.h"
+
+class IncuversDoorMonitor {
+  public:
+    byte getState() { return 0; }
+    unsigned long getEventCount() { return 0; }
+    long getLastOpenTime() { return 0; }
+    long getLastRecoveryTime() { return 0; }
+};
+
+class IncuversProfileRunner {
+  public:
+    int8_t getRunningSegment() { return -1; }
+};
+
+#include "../../Main/Incuvers_Incubator/Incuvers_Status.h"
+
+class IncuversUI {
+  public:
+    boolean inMenu;
+    boolean alarmSounding;
+
+    boolean isInMenu() { return this->inMenu; }
+
+    boolean AcknowledgeAlarm() {
+      boolean was = this->alarmSounding;
+      this->alarmSounding = false;
+      return was;
+    }
+};
+
+#include "../../Main/Incuvers_Incubator/Opt_PiLink.h"
+
+#define UNIT_SERIAL 666
+
+class LoopbackUnit {
+  // The firmware end, on the master side of the pseudo terminal.  Hold lock to look at it from the test.
+  private:
+    IncuversPowerArbiter power;
+    IncuversDoorMonitor door;
+    IncuversProfileRunner profile;
+    IncuversStatus status;
+    IncuversPiLink piLink;
+    std::thread thread;
+    volatile bool running;
+
+    void Loop() {
+      while (this->running) {
+        {
+          std::lock_guard<std::mutex> hold(this->lock);
+          this->status.NextCycle();
+          this->piLink.DoTick();
+          this->persist.DoTick();
+        }
+        usleep(500);
+      }
+    }
+
+  public:
+    std::mutex lock;
+    IncuversSettingsHandler settings;
+    IncuversPersistence persist;
+    IncuversHeatingSystem heat;
+    IncuversLightingSystem light;
+    IncuversCO2System CO2;
+    IncuversO2System O2;
+    IncuversUI ui;
+
+    void Start(int fd) {
+      // A blank EEPROM with only the hardware definition in it, so the settings are the defaults.
+      HardwareStruct hardware;
+      memset(hostEEPROM, 0xFF, sizeof(hostEEPROM));
+      memset(&hardware, 0, sizeof(hardware));
+      memcpy(hardware.ident, HARDWARE_IDENT, sizeof(hardware.ident));
+      hardware.serial = UNIT_SERIAL;
+      hardware.piSupport = 1;
+      EEPROM.put(HARDWARE_ADDRS, hardware);
+
+      Serial1.Attach(fd);
+      statusLine.SetupStatusLine();
+      this->ui.inMenu = false;
+      this->ui.alarmSounding = false;
+      this->settings.PerformLoadSettings();
+      this->settings.CheckSettings();
+      this->settings.AttachIncuversModule(&this->persist);
+      this->settings.AttachIncuversModule(&this->power);
+      this->settings.AttachIncuversModule(&this->heat);
+      this->settings.AttachIncuversModule(&this->light);
+      this->settings.AttachIncuversModule(&this->CO2);
+      this->settings.AttachIncuversModule(&this->O2);
+      this->status.SetupStatus(&this->settings, &this->door, &this->profile);
+      this->piLink.SetupPiLink(&this->settings, &this->status, &this->ui);
+
+      this->running = true;
+      this->thread = std::thread(&LoopbackUnit::Loop, this);
+    }
+
+    void Stop() {
+      this->running = false;
+      this->thread.join();
+    }
+};
+
+static int failures = 0;
+
+static void Check(bool passed, const char* what) {
+  printf("  %-60s %s\n", what, passed ? "ok" : "FAILED");
+  if (!passed) {
+    failures++;
+  }
+}
+
+static bool Near(float value, float expected) {
+  return fabs(value - expected) < 0.001;
+}
+
+static bool Expect(PiLinkClient* client, byte command, int value, int result, int answer) {
+  PiLinkAck ack;
+  return client->Command(command, value, &ack) && ack.command == command && ack.result == result && ack.value == answer;
+}
+
+static const PiLinkReading* RequestStatus(PiLinkClient* client) {
+  byte frame[PILINK_ENCODED_SIZE];
+  client->Send(frame, client->getDecoder()->EncodeStatusRequest(frame));
+  while (int type = client->Next(COMMAND_TIMEOUT)) {
+    if (type == PILINK_FRAME_STATUS) {
+      return client->getDecoder()->getReading();
+    }
+  }
+  return NULL;
+}
+
+static const PiLinkStats* RequestStats(PiLinkClient* client) {
+  PiLinkAck ack;
+  if (!client->Command(PILINK_COMMAND_STATS, 0, &ack) || ack.result != PILINK_RESULT_OK) {
+    return NULL;
+  }
+  return client->getDecoder()->getStats();
+}
+
+int main() {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+  PiLinkClient client;
+  if (!client.Open(ptsname(master))) {
+    return 1;
+  }
+  LoopbackUnit unit;
+  unit.Start(master);
+
+  printf("Loopback against the firmware on %s\n", ptsname(master));
+  Check(client.Connect(PILINK_BAUD_MAX) && client.getDecoder()->getUnitSerial() == UNIT_SERIAL, "hello and rate agreed");
+  Check(client.getDecoder()->getAgreedBaud() == PILINK_BAUD_MAX, "at the fastest rate");
+
+  Check(Expect(&client, PILINK_COMMAND_SET_TEMPERATURE, 3712, PILINK_RESULT_OK, 3712), "temperature set");
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    Check(Near(unit.settings.getTemperatureSetPoint(), 37.12) && Near(unit.heat.setPoint, 37.12),
+      "settings and heating have it");
+  }
+  const PiLinkReading* reading = RequestStatus(&client);
+  Check(reading != NULL && Near(reading->heatSetPoint, 37.12), "status has the new set point");
+  Check(Expect(&client, PILINK_COMMAND_SET_TEMPERATURE, 9000, PILINK_RESULT_LIMITED, TEMPERATURE_MAX * PILINK_SCALE_LEVEL),
+    "temperature above range held to the maximum");
+  Check(Expect(&client, PILINK_COMMAND_SET_CO2, -100, PILINK_RESULT_LIMITED, CO2_MIN * PILINK_SCALE_LEVEL),
+    "CO2 below range held to the minimum");
+  Check(Expect(&client, PILINK_COMMAND_SET_O2, 500, PILINK_RESULT_OK, 500), "O2 set");
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    Check(Near(unit.settings.getTemperatureSetPoint(), TEMPERATURE_MAX) && Near(unit.heat.setPoint, TEMPERATURE_MAX) &&
+      Near(unit.settings.getCO2SetPoint(), CO2_MIN) && Near(unit.CO2.setPoint, CO2_MIN) &&
+      Near(unit.settings.getO2SetPoint(), 5.0) && Near(unit.O2.setPoint, 5.0), "settings and modules hold what was acked");
+  }
+
+  Check(Expect(&client, PILINK_COMMAND_FAN_MODE, 0, PILINK_RESULT_OK, 0), "fan mode set");
+  Check(Expect(&client, PILINK_COMMAND_FAN_MODE, 2, PILINK_RESULT_REFUSED, 2), "fan mode the menu doesn't offer refused");
+  Check(Expect(&client, PILINK_COMMAND_LIGHT_MODE, 3, PILINK_RESULT_REFUSED, 3), "light mode out of range refused");
+  int personalities;
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    Check(unit.settings.getFanMode() == 0 && unit.heat.fanMode == 0 && unit.settings.getLightMode() == 0 &&
+      unit.light.mode == 0, "refused modes left alone");
+    personalities = unit.settings.getPersonalityCount();
+  }
+  Check(Expect(&client, PILINK_COMMAND_CO2_MODE, 0, PILINK_RESULT_OK, 0), "CO2 mode set");
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    Check(unit.settings.getCO2Mode() == 0 && unit.CO2.mode == 0 && unit.settings.getPersonalityCount() == personalities - 1,
+      "settings, CO2 and the personality count have it");
+  }
+  Check(Expect(&client, 99, 0, PILINK_RESULT_UNKNOWN, 0), "unknown command answered");
+
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    unit.ui.inMenu = true;
+  }
+  Check(Expect(&client, PILINK_COMMAND_SET_TEMPERATURE, 3000, PILINK_RESULT_BUSY, 3000), "busy while in the menu");
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    Check(Near(unit.settings.getTemperatureSetPoint(), TEMPERATURE_MAX), "set point left alone");
+    unit.ui.inMenu = false;
+    unit.ui.alarmSounding = true;
+  }
+  Check(Expect(&client, PILINK_COMMAND_ACK_ALARM, 0, PILINK_RESULT_OK, 1), "sounding alarm acknowledged");
+  Check(Expect(&client, PILINK_COMMAND_ACK_ALARM, 0, PILINK_RESULT_OK, 0), "nothing to acknowledge after it");
+
+  const PiLinkStats* stats = RequestStats(&client);
+  unsigned int carriedOut = stats != NULL ? stats->commands : 0;
+  Check(Expect(&client, PILINK_COMMAND_SET_TEMPERATURE, 3650, PILINK_RESULT_OK, 3650), "temperature set again");
+  client.Resend();
+  Check(Expect(&client, PILINK_COMMAND_SET_TEMPERATURE, 3650, PILINK_RESULT_OK, 3650), "resend acked the same");
+  stats = RequestStats(&client);
+  Check(stats != NULL && stats->commands == carriedOut + 2, "resend not carried out again");
+
+  Check(Expect(&client, PILINK_COMMAND_SAVE, 0, PILINK_RESULT_OK, 0), "save");
+  {
+    // Written once things have been quiet for PERSIST_QUIET_PERIOD, flush it now as before a reset.
+    std::lock_guard<std::mutex> hold(unit.lock);
+    bool queued = !unit.persist.isIdle();
+    unit.persist.FlushAll();
+    IncuversSettingsStore store;
+    byte record[SETTINGSSTORE_PAYLOAD_SIZE];
+    SettingsStruct saved;
+    store.SetupStore(SETTINGSSTORE_ADDRS, SETTINGSSTORE_SLOTS, SETTINGSSTORE_PAYLOAD_SIZE);
+    bool loaded = store.Load(record);
+    memcpy(&saved, record, sizeof(saved));
+    Check(queued && loaded && saved.heatSetPoint == 3650 && saved.CO2Mode == 0 && saved.fanMode == 0,
+      "saved settings read back from the EEPROM");
+  }
+
+  // A command with one byte corrupted fails its CRC: no ack, and the unit counts it as bad.
+  unsigned long badBefore = stats != NULL ? stats->framesBad : 0;
+  byte frame[PILINK_ENCODED_SIZE];
+  size_t length = client.getDecoder()->EncodeCommand(200, PILINK_COMMAND_SET_TEMPERATURE, 1000, frame);
+  frame[length / 2] ^= 0x10;
+  client.Send(frame, length);
+  int type;
+  bool answered = false;
+  while ((type = client.Next(COMMAND_TIMEOUT / 4)) != 0) {
+    answered |= type == PILINK_FRAME_ACK;
+  }
+  Check(!answered, "corrupted command ignored");
+  {
+    std::lock_guard<std::mutex> hold(unit.lock);
+    Check(Near(unit.settings.getTemperatureSetPoint(), 36.50) && Near(unit.heat.setPoint, 36.50), "set point unchanged by it");
+  }
+  stats = RequestStats(&client);
+  Check(stats != NULL && stats->framesBad == badBefore + 1, "counted as a bad frame");
+
+  unit.Stop();
+  close(master);
+  printf(failures == 0 ? "All passed\n" : "%d failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/*
+ * Incuvers PiLink host shim.
+ *
+ * Just enough of the Arduino environment to build the firmware's PiLink (Opt_PiLink.h) and the settings handler behind
+ * it on a Linux host, so IncuversPiLinkLoopback.cpp can run them against the client.  Serial1 is a file descriptor (one
+ * end of a pseudo terminal) and never fills up, the EEPROM is an array which is always ready, and Serial is stdout.
+ * Include the system headers first: min(), max() and constrain() are macros here as on the Arduino.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define DEC 10
+#define HEX 16
+#define SERIAL_8N1 0x06
+#define SERIAL_8E2 0x2E
+#define SERIAL_TX_BUFFER_SIZE 64
+
+#define constrain(a, low, high) ((a) < (low) ? (low) : ((a) > (high) ? (high) : (a)))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+unsigned long millis() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000UL + now.tv_usec / 1000;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+}
+
+int freeMemory() {
+  return 2048;
+}
+
+class Print {
+  private:
+    size_t Printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+      char text[32];
+      va_list args;
+      va_start(args, format);
+      vsnprintf(text, sizeof(text), format, args);
+      va_end(args);
+      return this->write(text);
+    }
+
+  public:
+    virtual size_t write(uint8_t c) = 0;
+
+    size_t write(const char* text) {
+      size_t n = 0;
+      while (*text) {
+        n += this->write((uint8_t)*text++);
+      }
+      return n;
+    }
+
+    size_t print(const __FlashStringHelper* text) { return this->write((const char*)text); }
+    size_t print(const char* text) { return this->write(text); }
+    size_t print(char c) { return this->write((uint8_t)c); }
+    size_t print(unsigned char value, int base = DEC) { return this->print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return this->print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return this->print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC) { return this->Printf(base == HEX ? "%lX" : "%ld", value); }
+    size_t print(unsigned long value, int base = DEC) { return this->Printf(base == HEX ? "%lX" : "%lu", value); }
+    size_t print(double value, int digits = 2) { return this->Printf("%.*f", digits, value); }
+    size_t println() { return this->write("\r\n"); }
+    template <typename T> size_t println(T value) { return this->print(value) + this->println(); }
+    template <typename T> size_t println(T value, int format) { return this->print(value, format) + this->println(); }
+};
+
+class HostConsole : public Print {
+  // Serial, only the debug output and the boot time messages go here.
+  public:
+    size_t write(uint8_t c) {
+      return fputc(c, stdout) == EOF ? 0 : 1;
+    }
+    using Print::write;
+
+    int availableForWrite() {
+      return SERIAL_TX_BUFFER_SIZE - 1;
+    }
+};
+
+class HostPort : public Print {
+  // Serial1 on a file descriptor.  The rate and framing are the other end's business.
+  private:
+    int fd;
+
+  public:
+    void Attach(int fd) {
+      this->fd = fd;
+    }
+
+    void begin(unsigned long baud, byte config) {
+    }
+
+    void end() {
+    }
+
+    int available() {
+      int count = 0;
+      return ioctl(this->fd, FIONREAD, &count) == 0 ? count : 0;
+    }
+
+    int read() {
+      byte c;
+      return ::read(this->fd, &c, 1) == 1 ? c : -1;
+    }
+
+    size_t write(uint8_t c) {
+      return ::write(this->fd, &c, 1) == 1 ? 1 : 0;
+    }
+    using Print::write;
+
+    int availableForWrite() {
+      return SERIAL_TX_BUFFER_SIZE - 1;
+    }
+};
+
+HostConsole Serial;
+HostPort Serial1;
+
+#define HOST_EEPROM_SIZE 4096
+byte hostEEPROM[HOST_EEPROM_SIZE];
+
+bool eeprom_is_ready() {
+  return true;
+}
+
+void eeprom_read_block(void* data, const void* address, size_t size) {
+  memcpy(data, &hostEEPROM[(intptr_t)address], size);
+}
+
+class HostEEPROM {
+  public:
+    byte read(int address) {
+      return hostEEPROM[address];
+    }
+
+    void write(int address, byte value) {
+      hostEEPROM[address] = value;
+    }
+
+    void update(int address, byte value) {
+      hostEEPROM[address] = value;
+    }
+
+    template <typename T> T& get(int address, T& value) {
+      memcpy(&value, &hostEEPROM[address], sizeof(T));
+      return value;
+    }
+
+    template <typename T> const T& put(int address, const T& value) {
+      memcpy(&hostEEPROM[address], &value, sizeof(T));
+      return value;
+    }
+};
+
+HostEEPROM EEPROM;